@@ -0,0 +1,180 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// Just enough of Win32, D3D12 and the fallback layer's headers for the CPU builder sources that include
+// CpuBuilderPlatform.h to build without the Windows SDK. GPU virtual addresses are plain CPU pointers, as they
+// are for the CPU builders on Windows.
+
+#pragma once
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+typedef unsigned char BYTE;
+typedef unsigned int UINT;
+typedef int INT;
+typedef uint16_t UINT16;
+typedef uint32_t UINT32;
+typedef uint64_t UINT64;
+typedef float FLOAT;
+typedef int32_t HRESULT;
+typedef const wchar_t* LPCWSTR;
+
+#define E_NOTIMPL ((HRESULT)0x80004001L)
+#define E_INVALIDARG ((HRESULT)0x80070057L)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+
+#define _In_
+#define _Out_
+#define _In_reads_(x)
+#define _Out_writes_(x)
+#define __declspec(x)
+#define UNREFERENCED_PARAMETER(x) (void)(x)
+#define ZeroMemory(p, size) memset((p), 0, (size))
+
+#define _isnan(x) std::isnan(x)
+
+inline void ThrowFailure(HRESULT hr, LPCWSTR errorString = nullptr)
+{
+    UNREFERENCED_PARAMETER(errorString);
+    if (FAILED(hr))
+    {
+        throw std::runtime_error("D3D12 Raytracing Fallback Error");
+    }
+}
+
+template <typename T>
+T DivideAndRoundUp(T dividend, T divisor) { return (dividend - 1) / divisor + 1; }
+
+typedef UINT64 D3D12_GPU_VIRTUAL_ADDRESS;
+
+enum DXGI_FORMAT
+{
+    DXGI_FORMAT_UNKNOWN = 0,
+    DXGI_FORMAT_R32G32B32A32_FLOAT = 2,
+    DXGI_FORMAT_R32G32B32_FLOAT = 6,
+    DXGI_FORMAT_R32_UINT = 42,
+    DXGI_FORMAT_R16_UINT = 57
+};
+
+enum D3D12_RAYTRACING_GEOMETRY_TYPE
+{
+    D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES = 0,
+    D3D12_RAYTRACING_GEOMETRY_TYPE_PROCEDURAL_PRIMITIVE_AABBS = 1
+};
+
+enum D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE
+{
+    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL = 0,
+    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL = 1
+};
+
+enum D3D12_ELEMENTS_LAYOUT
+{
+    D3D12_ELEMENTS_LAYOUT_ARRAY = 0,
+    D3D12_ELEMENTS_LAYOUT_ARRAY_OF_POINTERS = 1
+};
+
+enum D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS
+{
+    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_NONE = 0,
+    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE = 0x1,
+    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_COMPACTION = 0x2,
+    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE = 0x4,
+    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_BUILD = 0x8,
+    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_MINIMIZE_MEMORY = 0x10,
+    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE = 0x20
+};
+
+struct D3D12_GPU_VIRTUAL_ADDRESS_AND_STRIDE
+{
+    D3D12_GPU_VIRTUAL_ADDRESS StartAddress;
+    UINT64 StrideInBytes;
+};
+
+struct D3D12_RAYTRACING_GEOMETRY_TRIANGLES_DESC
+{
+    D3D12_GPU_VIRTUAL_ADDRESS Transform3x4;
+    DXGI_FORMAT IndexFormat;
+    DXGI_FORMAT VertexFormat;
+    UINT IndexCount;
+    UINT VertexCount;
+    D3D12_GPU_VIRTUAL_ADDRESS IndexBuffer;
+    D3D12_GPU_VIRTUAL_ADDRESS_AND_STRIDE VertexBuffer;
+};
+
+struct D3D12_RAYTRACING_AABB
+{
+    FLOAT MinX;
+    FLOAT MinY;
+    FLOAT MinZ;
+    FLOAT MaxX;
+    FLOAT MaxY;
+    FLOAT MaxZ;
+};
+
+struct D3D12_RAYTRACING_GEOMETRY_AABBS_DESC
+{
+    UINT64 AABBCount;
+    D3D12_GPU_VIRTUAL_ADDRESS_AND_STRIDE AABBs;
+};
+
+struct D3D12_RAYTRACING_GEOMETRY_DESC
+{
+    D3D12_RAYTRACING_GEOMETRY_TYPE Type;
+    UINT Flags;
+    union
+    {
+        D3D12_RAYTRACING_GEOMETRY_TRIANGLES_DESC Triangles;
+        D3D12_RAYTRACING_GEOMETRY_AABBS_DESC AABBs;
+    };
+};
+
+struct D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS
+{
+    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE Type;
+    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS Flags;
+    UINT NumDescs;
+    D3D12_ELEMENTS_LAYOUT DescsLayout;
+    union
+    {
+        D3D12_GPU_VIRTUAL_ADDRESS InstanceDescs;
+        const D3D12_RAYTRACING_GEOMETRY_DESC* pGeometryDescs;
+        const D3D12_RAYTRACING_GEOMETRY_DESC* const* ppGeometryDescs;
+    };
+};
+
+struct D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC
+{
+    D3D12_GPU_VIRTUAL_ADDRESS DestAccelerationStructureData;
+    D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS Inputs;
+    D3D12_GPU_VIRTUAL_ADDRESS SourceAccelerationStructureData;
+    D3D12_GPU_VIRTUAL_ADDRESS ScratchAccelerationStructureData;
+};
+
+// From D3D12RaytracingFallback.h, for RayTracingHlslCompat.h
+struct WRAPPED_GPU_POINTER
+{
+    D3D12_GPU_VIRTUAL_ADDRESS GpuVA;
+};
+
+struct D3D12_RAYTRACING_FALLBACK_INSTANCE_DESC
+{
+    FLOAT Transform[3][4];
+    UINT InstanceID : 24;
+    UINT InstanceMask : 8;
+    UINT InstanceContributionToHitGroupIndex : 24;
+    UINT Flags : 8;
+    WRAPPED_GPU_POINTER AccelerationStructure;
+};
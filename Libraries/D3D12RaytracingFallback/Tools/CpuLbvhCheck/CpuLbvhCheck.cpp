@@ -0,0 +1,251 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// Builds random bottom-level scenes with the CPU LBVH builder and checks the output: every primitive is
+// reached exactly once, every box contains its children and its triangle, procedural leaves are flagged and
+// the same inputs always give the same bytes. Builds without the Windows SDK:
+//
+//   g++ -std=c++17 -O2 -pthread -I. -I../../src CpuLbvhCheck.cpp ../../src/CpuLbvhBuilder.cpp ../../src/CpuPrimitiveLoader.cpp -o CpuLbvhCheck
+//   CpuLbvhCheck [num_triangles]
+//
+// Returns non-zero if any build fails a check.
+
+#include "CpuBuilderPlatform.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+using namespace FallbackLayer;
+
+namespace
+{
+    static const UINT LeafFlag = 0x80000000;
+    static const UINT ProceduralGeometryFlag = 0x40000000;
+    static const float Tolerance = 1e-4f;
+
+    struct Scene
+    {
+        std::vector<float> vertices;
+        std::vector<UINT16> indices16;
+        std::vector<UINT32> indices32;
+        std::vector<D3D12_RAYTRACING_AABB> boxes;
+        std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> geometries;
+    };
+
+    // Clustered triangles drawn through each index format, next to procedural boxes
+    void CreateScene(UINT numTriangles, Scene &scene)
+    {
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> position(0.0f, 100.0f);
+        std::uniform_real_distribution<float> extent(0.0f, 1.0f);
+
+        for (UINT i = 0; i < numTriangles; i++)
+        {
+            const float center[3] = { position(rng), position(rng) * 0.3f, position(rng) };
+            for (UINT v = 0; v < 3; v++)
+            {
+                for (UINT k = 0; k < 3; k++)
+                {
+                    scene.vertices.push_back(center[k] + extent(rng));
+                }
+            }
+        }
+
+        const UINT numIndexed = std::min(numTriangles, 20000u) * 3;
+        for (UINT i = 0; i < numIndexed; i++)
+        {
+            scene.indices16.push_back((UINT16)(numIndexed - 1 - i));
+            scene.indices32.push_back(i);
+        }
+
+        scene.boxes.resize(numTriangles / 3 + 1);
+        for (D3D12_RAYTRACING_AABB &box : scene.boxes)
+        {
+            const float x = position(rng), y = position(rng), z = position(rng);
+            box = { x, y, z, x + extent(rng), y + extent(rng), z + extent(rng) };
+        }
+
+        D3D12_RAYTRACING_GEOMETRY_DESC geometry = {};
+        geometry.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
+        geometry.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
+        geometry.Triangles.VertexBuffer = { (D3D12_GPU_VIRTUAL_ADDRESS)scene.vertices.data(), 3 * sizeof(float) };
+
+        geometry.Triangles.IndexFormat = DXGI_FORMAT_UNKNOWN;
+        geometry.Triangles.VertexCount = numTriangles * 3;
+        scene.geometries.push_back(geometry);
+
+        geometry.Triangles.IndexFormat = DXGI_FORMAT_R16_UINT;
+        geometry.Triangles.IndexCount = (UINT)scene.indices16.size();
+        geometry.Triangles.IndexBuffer = (D3D12_GPU_VIRTUAL_ADDRESS)scene.indices16.data();
+        scene.geometries.push_back(geometry);
+
+        geometry.Triangles.IndexFormat = DXGI_FORMAT_R32_UINT;
+        geometry.Triangles.IndexCount = (UINT)scene.indices32.size();
+        geometry.Triangles.IndexBuffer = (D3D12_GPU_VIRTUAL_ADDRESS)scene.indices32.data();
+        scene.geometries.push_back(geometry);
+
+        geometry = {};
+        geometry.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_PROCEDURAL_PRIMITIVE_AABBS;
+        geometry.AABBs.AABBCount = scene.boxes.size();
+        geometry.AABBs.AABBs = { (D3D12_GPU_VIRTUAL_ADDRESS)scene.boxes.data(), sizeof(D3D12_RAYTRACING_AABB) };
+        scene.geometries.push_back(geometry);
+    }
+
+    bool Contains(const AABBNode &node, const float *point)
+    {
+        for (UINT k = 0; k < 3; k++)
+        {
+            if (point[k] < node.center[k] - node.halfDim[k] - Tolerance ||
+                point[k] > node.center[k] + node.halfDim[k] + Tolerance)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool Contains(const AABBNode &parent, const AABBNode &child)
+    {
+        float childMin[3], childMax[3];
+        for (UINT k = 0; k < 3; k++)
+        {
+            childMin[k] = child.center[k] - child.halfDim[k];
+            childMax[k] = child.center[k] + child.halfDim[k];
+        }
+        return Contains(parent, childMin) && Contains(parent, childMax);
+    }
+
+    // Returns the number of problems found in the tree
+    UINT CheckTree(const BYTE *pData, UINT numPrimitives)
+    {
+        const BVHOffsets &offsets = *(const BVHOffsets *)pData;
+        const AABBNode *pNodes = (const AABBNode *)(pData + offsets.offsetToBoxes);
+        const Primitive *pPrimitives = (const Primitive *)(pData + offsets.offsetToVertices);
+
+        UINT errors = 0;
+        UINT numNodesVisited = 0;
+        std::vector<UINT> timesReached(numPrimitives, 0);
+        std::vector<UINT> stack(1, 0);
+        while (!stack.empty())
+        {
+            const AABBNode &node = pNodes[stack.back()];
+            stack.pop_back();
+            numNodesVisited++;
+
+            if (node.nodeAllBits & LeafFlag)
+            {
+                const UINT leafIndex = node.nodeAllBits & ~(LeafFlag | ProceduralGeometryFlag);
+                if (leafIndex >= numPrimitives)
+                {
+                    errors++;
+                    continue;
+                }
+                timesReached[leafIndex]++;
+
+                const Primitive &primitive = pPrimitives[leafIndex];
+                const bool bProcedural = (node.nodeAllBits & ProceduralGeometryFlag) != 0;
+                if (bProcedural != (primitive.PrimitiveType == PROCEDURAL_PRIMITIVE_TYPE))
+                {
+                    errors++;
+                }
+                if (!bProcedural)
+                {
+                    for (UINT v = 0; v < 3; v++)
+                    {
+                        errors += Contains(node, &primitive.triangle.v[v].x) ? 0 : 1;
+                    }
+                }
+            }
+            else
+            {
+                const UINT left = node.internalNode.leftNodeIndex;
+                const UINT right = node.rightNodeIndex;
+                errors += Contains(node, pNodes[left]) ? 0 : 1;
+                errors += Contains(node, pNodes[right]) ? 0 : 1;
+                stack.push_back(left);
+                stack.push_back(right);
+            }
+        }
+
+        for (UINT count : timesReached)
+        {
+            errors += (count == 1) ? 0 : 1;
+        }
+        if (numNodesVisited != 2 * numPrimitives - 1)
+        {
+            errors++;
+        }
+        return errors;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const UINT numTriangles = argc > 1 ? (UINT)atoi(argv[1]) : 100000;
+
+    Scene scene;
+    CreateScene(numTriangles, scene);
+
+    D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC desc = {};
+    desc.Inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
+    desc.Inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+    desc.Inputs.NumDescs = (UINT)scene.geometries.size();
+    desc.Inputs.pGeometryDescs = scene.geometries.data();
+
+    const UINT numPrimitives = GetTotalPrimitiveCount(desc.Inputs);
+
+    // With room for the sort cache and the per-node parent indices that ALLOW_UPDATE appends
+    const UINT numNodes = 2 * numPrimitives - 1;
+    const size_t outputSize = sizeof(BVHOffsets) + numNodes * (sizeof(AABBNode) + sizeof(UINT)) +
+        numPrimitives * (sizeof(Primitive) + sizeof(PrimitiveMetaData) + sizeof(UINT));
+
+    struct
+    {
+        const char *name;
+        D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS flags;
+    } buildFlags[] =
+    {
+        { "default", D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_NONE },
+        { "fast trace", D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE },
+        { "fast build", D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_BUILD },
+        { "allow update", D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE },
+    };
+
+    printf("CPU LBVH check, %u primitives\n", numPrimitives);
+    printf("%-14s %-8s %10s %8s %14s\n", "flags", "morton", "build ms", "errors", "deterministic");
+
+    bool bPassed = true;
+    for (auto &entry : buildFlags)
+    {
+        for (UINT bits = 0; bits < 2; bits++)
+        {
+            const bool bUse63BitMortonCodes = (bits == 1);
+            desc.Inputs.Flags = entry.flags;
+
+            std::vector<BYTE> output(outputSize), repeat(outputSize);
+            auto start = std::chrono::high_resolution_clock::now();
+            BuildRaytracingAccelerationStructureOnCpuLbvh(&desc, output.data(), bUse63BitMortonCodes);
+            auto end = std::chrono::high_resolution_clock::now();
+            BuildRaytracingAccelerationStructureOnCpuLbvh(&desc, repeat.data(), bUse63BitMortonCodes);
+
+            const UINT errors = CheckTree(output.data(), numPrimitives);
+            const bool bDeterministic = (output == repeat);
+            bPassed = bPassed && errors == 0 && bDeterministic;
+
+            printf("%-14s %-8s %10.2f %8u %14s\n", entry.name, bUse63BitMortonCodes ? "63-bit" : "30-bit",
+                std::chrono::duration<double, std::milli>(end - start).count(), errors, bDeterministic ? "yes" : "no");
+        }
+    }
+
+    return bPassed ? 0 : 1;
+}
@@ -12,11 +12,15 @@
 
 namespace FallbackLayer
 {
+    // Shared with RayTracingHelper.hlsli
+    static const UINT IsProceduralGeometryFlag = 0x40000000;
+
     struct BVH
     {
         std::vector<AABBNode>   m_nodes;
-        std::vector<float> m_triangles;
-        std::vector<PrimitiveMetaData> m_metadata;
+        std::vector<Primitive>  m_primitives;       // input order
+        std::vector<PrimitiveMetaData> m_metadata;  // leaf order
+        std::vector<UINT32>     m_primitiveIds;     // leaf order -> input order
     };
 
     static
@@ -40,33 +44,6 @@ namespace FallbackLayer
         return v & 0x00ffffff;
     }
 
-    static
-        void ComputeBox(
-            AABB& overallBox,
-            const std::vector<AABB>& boxes,
-            const std::vector<PrimitiveMetaData>& metadata)
-    {
-        if (metadata.empty())
-        {
-            overallBox.max.x = overallBox.min.x = 0;
-            overallBox.max.y = overallBox.min.y = 0;
-            overallBox.max.z = overallBox.min.z = 0;
-            return;
-        }
-
-        overallBox = boxes[metadata[0].PrimitiveIndex];
-
-        const UINT32 numTris = (UINT32)metadata.size();
-        for (UINT32 i = 1; i < numTris; ++i)
-        {
-            const UINT32 triId = metadata[i].PrimitiveIndex;
-            assert(triId < boxes.size());
-            const AABB& newBox = boxes[triId];
-
-            AddExtentToBox(overallBox, newBox);
-        }
-    }
-
     //
     // Convert a 16-bit float to 32-bit.
     //
@@ -117,15 +94,10 @@ namespace FallbackLayer
     }
 
     static
-        UINT32 BuildBVHAddNode(
-            BVH& bvh,
-            const AABB& box,
-            UINT32 maxDimension)
+        void WriteNodeBox(
+            AABBNode& node,
+            const AABB& box)
     {
-        UNREFERENCED_PARAMETER(maxDimension);
-        assert(maxDimension < 3);
-        const UINT32 nodeIndex = (UINT32)bvh.m_nodes.size();
-
         float cX = (box.max.x + box.min.x) * 0.5f;
         float cY = (box.max.y + box.min.y) * 0.5f;
         float cZ = (box.max.z + box.min.z) * 0.5f;
@@ -137,88 +109,14 @@ namespace FallbackLayer
         float dY = max(box.max.y - cY, cY - box.min.y);
         float dZ = max(box.max.z - cZ, cZ - box.min.z);
 
-        AABBNode packedBox;
-        packedBox.center[0] = cX;
-        packedBox.center[1] = cY;
-        packedBox.center[2] = cZ;
-        packedBox.halfDim[0] = dX;
-        packedBox.halfDim[1] = dY;
-        packedBox.halfDim[2] = dZ;
-        packedBox.nodeAllBits = 0;
-
-        bvh.m_nodes.push_back(packedBox);
-
-        assert(bvh.m_nodes.size() - 1 == nodeIndex);
-
-        bvh.m_nodes[nodeIndex].internalNode.separatingAxis = 0;
-
-        return nodeIndex;
+        node.center[0] = cX;
+        node.center[1] = cY;
+        node.center[2] = cZ;
+        node.halfDim[0] = dX;
+        node.halfDim[1] = dY;
+        node.halfDim[2] = dZ;
     }
 
-    static
-        UINT32 BuildBVHAddLeaf(
-            BVH& bvh,
-            const AABB& box,
-            const std::vector<PrimitiveMetaData>& metadata)
-    {
-        const UINT32 nodeIndex = BuildBVHAddNode(bvh, box, 0);
-
-        bvh.m_nodes[nodeIndex].nodeAllBits = 0;
-        bvh.m_nodes[nodeIndex].leaf = true;
-
-        const UINT32 idIndex = (UINT32)bvh.m_metadata.size();
-
-        std::copy(metadata.begin(), metadata.end(), std::back_inserter(bvh.m_metadata));
-
-        assert(metadata.size() < 128);
-        assert(idIndex < (1 << 24));
-
-        bvh.m_nodes[nodeIndex].leafNode.firstTriangleId = idIndex;
-        bvh.m_nodes[nodeIndex].leafNode.numTriangleIds = (UINT32)metadata.size();
-
-        return nodeIndex;
-    }
-
-    //
-    // Sort min to max by centroid
-    //
-
-    static
-        void SortByCentroid(
-            std::vector<PrimitiveMetaData>& metadata,
-            const std::vector<AABB>& boxes,
-            UINT32 maxDimension)
-    {
-        struct TriPosition
-        {
-            float   pos;
-            UINT32  id;
-        };
-
-        std::vector<TriPosition> sortTris(metadata.size());
-
-        for (UINT32 i = 0; i < metadata.size(); ++i)
-        {
-            const UINT32 triId = metadata[i].PrimitiveIndex;
-            const AABB& box = boxes[triId];
-
-            const float boxCenter = (box.maxArr[maxDimension] + box.minArr[maxDimension]) / 2;
-
-            sortTris[i].pos = boxCenter;
-            sortTris[i].id = metadata[i].PrimitiveIndex;
-        }
-
-        // Split the list into left and right sublists
-        std::sort(sortTris.begin(), sortTris.end(), [](auto&& a, auto&& b) -> bool { return a.pos < b.pos; });
-
-        // Update the output
-        for (UINT32 i = 0; i < metadata.size(); ++i)
-        {
-            metadata[i].PrimitiveIndex = sortTris[i].id;
-        }
-    }
-
-
     static
         float ComputeBoxSurfaceArea(
             const AABB& box)
@@ -241,142 +139,355 @@ namespace FallbackLayer
         box.min.x = box.min.y = box.min.z = 10e10f;//FLT_MAX;
     }
 
-    //
-    // A feeble attempt at a SAH builder
-    //
-
     static
-        void SahSplit(
-            std::vector<PrimitiveMetaData>& metadata,
-            UINT32& maxDimension,
-            UINT32& numTrisInLeftNode,
-            const AABB& nodeBox,
-            const std::vector<AABB>& boxes)
+        float GetCentroid(
+            const AABB& box,
+            UINT32 dimension)
     {
-        static const UINT NUM_SAH_BINS = 64;
+        return (box.maxArr[dimension] + box.minArr[dimension]) * 0.5f;
+    }
 
-        struct SahBin
+    //
+    // Binned SAH builder that runs subtrees in parallel.
+    //
+    // Every primitive id lives in one shared array that is partitioned in place, so a
+    // node is just a [begin, end) range of it and the primitives of each leaf end up
+    // contiguous in their final order. A subtree over N primitives owns 2N - 1
+    // consecutive node slots, which means each range knows its node index before it is
+    // built: the right child directly follows its parent and the left child follows the
+    // right child's subtree. Independent subtrees can therefore be written concurrently
+    // without any synchronization on the output.
+    //
+    class ParallelBvhBuilder
+    {
+    public:
+        struct BuildRange
         {
-            AABB    box;
-            UINT    numTriangles;
+            UINT32 begin;
+            UINT32 end;
+            UINT32 nodeIndex;
+
+            UINT32 Count() const { return end - begin; }
         };
 
-        // NOTE: use vector if this blows out the stack?
-        SahBin  sahBins[3][NUM_SAH_BINS];
+        // Ranges at least this large are handed to the task pool when splitting
+        static const UINT32 ParallelSubtreeThreshold = 1024;
+
+        ParallelBvhBuilder(
+            const AABB *pBoxes,
+            UINT32 *pPrimitiveIds,
+            AABBNode *pNodes,
+            UINT32 maxPrimitivesInLeaf) :
+            m_pBoxes(pBoxes),
+            m_pPrimitiveIds(pPrimitiveIds),
+            m_pNodes(pNodes),
+            m_maxPrimitivesInLeaf(std::max(maxPrimitivesInLeaf, 1u))
+        {}
+
+        static UINT32 GetNodeCount(UINT32 numPrimitives)
+        {
+            return numPrimitives ? numPrimitives * 2 - 1 : 1;
+        }
 
-        // For the score to be meaningful it seems we need to normalize it to something
-        const float normalizeToParent = 1.f / ComputeBoxSurfaceArea(nodeBox);
+        void Build(UINT32 numPrimitives)
+        {
+            const BuildRange root = { 0, numPrimitives, 0 };
+            if (numPrimitives < ParallelSubtreeThreshold * 2)
+            {
+                BuildSubtree(nullptr, 0, root);
+                return;
+            }
 
-        const UINT numTris = (UINT)metadata.size();
+            // A range is only spawned when both of its children are above the threshold,
+            // which bounds the number of tasks that can ever be queued
+            CpuTaskPool<BuildRange> taskPool(numPrimitives / ParallelSubtreeThreshold + 1);
+            taskPool.Run(root, [](CpuTaskPool<BuildRange> &pool, UINT workerIndex, const BuildRange &range, void *pContext)
+            {
+                static_cast<ParallelBvhBuilder *>(pContext)->BuildSubtree(&pool, workerIndex, range);
+            }, this);
+        }
 
-        float bestSah = FLT_MAX;
-        maxDimension = 0;
-        //numTrisInLeftNode = triangleIds.size() / 2;
+    private:
+        static const UINT NUM_SAH_BINS = 64;
+        static const UINT MAX_LOCAL_STACK_DEPTH = 64;
 
-        // Compute SAH score per axis
-        for (UINT i = 0; i < 3; ++i)
+        void BuildSubtree(CpuTaskPool<BuildRange> *pPool, UINT workerIndex, BuildRange range)
         {
-            const float extents = nodeBox.maxArr[i] - nodeBox.minArr[i];
-            if (extents == 0)
-                continue;
+            // Always descending into the smaller child first keeps the deferred ranges to
+            // at most log2(N) entries, so a fixed stack is enough
+            BuildRange stack[MAX_LOCAL_STACK_DEPTH];
+            UINT stackSize = 0;
 
-            const float rangeMin = nodeBox.minArr[i];
+            for (;;)
+            {
+                BuildRange left, right;
+                if (BuildNode(range, left, right))
+                {
+                    BuildRange &smaller = left.Count() < right.Count() ? left : right;
+                    BuildRange &larger = left.Count() < right.Count() ? right : left;
 
-            const float inverseExtents = 1.f / extents;
+                    if (pPool && smaller.Count() >= ParallelSubtreeThreshold)
+                    {
+                        pPool->Push(workerIndex, larger);
+                    }
+                    else
+                    {
+                        assert(stackSize < MAX_LOCAL_STACK_DEPTH);
+                        stack[stackSize++] = larger;
+                    }
+                    range = smaller;
+                }
+                else if (stackSize)
+                {
+                    range = stack[--stackSize];
+                }
+                else
+                {
+                    break;
+                }
+            }
+        }
 
-            // Init boxes
-            for (UINT j = 0; j < NUM_SAH_BINS; ++j)
+        // Writes the node for the range and returns true with the child ranges
+        // filled out if it is an internal node
+        bool BuildNode(const BuildRange &range, BuildRange &left, BuildRange &right)
+        {
+            AABBNode &node = m_pNodes[range.nodeIndex];
+            const UINT32 count = range.Count();
+
+            AABB nodeBox;
+            AABB centroidBox;
+            if (count == 0)
             {
-                sahBins[i][j].numTriangles = 0;
-                InitBoxToInverseMax(sahBins[i][j].box);
+                nodeBox.min = nodeBox.max = { 0, 0, 0 };
+                centroidBox = nodeBox;
             }
-
-            // Place triangles into the buckets
-            for (UINT j = 0; j < metadata.size(); ++j)
+            else
             {
-                const UINT triId = metadata[j].PrimitiveIndex;
-
-                const AABB& triBox = boxes[triId];
-
-                const float centroid = (triBox.maxArr[i] + triBox.minArr[i]) * 0.5f;
-
-                const UINT binIndex = std::min(NUM_SAH_BINS - 1,
-                    UINT(NUM_SAH_BINS * ((centroid - rangeMin) * inverseExtents)));
-
-                sahBins[i][binIndex].numTriangles++;
-                AddExtentToBox(sahBins[i][binIndex].box, triBox);
+                InitBoxToInverseMax(nodeBox);
+                InitBoxToInverseMax(centroidBox);
+                for (UINT32 i = range.begin; i < range.end; i++)
+                {
+                    const AABB& box = m_pBoxes[m_pPrimitiveIds[i]];
+                    AddExtentToBox(nodeBox, box);
+                    for (UINT32 k = 0; k < 3; k++)
+                    {
+                        const float centroid = GetCentroid(box, k);
+                        centroidBox.minArr[k] = std::min(centroidBox.minArr[k], centroid);
+                        centroidBox.maxArr[k] = std::max(centroidBox.maxArr[k], centroid);
+                    }
+                }
             }
 
-            // Make sure we caught all of them once
-            UINT testTris = 0;
-            for (UINT j = 0; j < NUM_SAH_BINS; ++j)
+            WriteNodeBox(node, nodeBox);
+            node.nodeAllBits = 0;
+            node.rightNodeIndex = 0;
+
+            if (count <= m_maxPrimitivesInLeaf)
             {
-                testTris += sahBins[i][j].numTriangles;
+                assert(count < 128);
+                assert(range.begin < (1 << 24));
+
+                // The count only goes in numTriangles: traversal strips just the leaf and
+                // procedural bits to get the leaf index, so the rest of the flag word is
+                // left clear
+                node.leaf = true;
+                node.leafNode.firstTriangleId = range.begin;
+                node.numTriangles = count;
+                return false;
             }
-            assert(testTris == numTris);
 
-            // Precompute left and right boxes with counts to be able to test plane positionings
+            const UINT32 split = SahPartition(range, centroidBox);
+            assert(split > range.begin && split < range.end);
 
-            AABB leftBoxes[NUM_SAH_BINS];
-            AABB rightBoxes[NUM_SAH_BINS];
+            right.begin = split;
+            right.end = range.end;
+            right.nodeIndex = range.nodeIndex + 1;
 
-            for (UINT j = 0; j < NUM_SAH_BINS; ++j)
+            left.begin = range.begin;
+            left.end = split;
+            left.nodeIndex = range.nodeIndex + GetNodeCount(right.Count()) + 1;
+
+            assert(left.nodeIndex < (1 << 24));
+            node.internalNode.leftNodeIndex = left.nodeIndex;
+            node.internalNode.separatingAxis = 0;
+            node.rightNodeIndex = right.nodeIndex;
+            return true;
+        }
+
+        // Reorders the range so the primitives left of the returned index belong to the
+        // left child. Falls back to a median split when no bin boundary separates anything.
+        UINT32 SahPartition(const BuildRange &range, const AABB &centroidBox)
+        {
+            struct SahBin
             {
-                const UINT rightIdx = NUM_SAH_BINS - j - 1;
+                AABB    box;
+                UINT32  numPrimitives;
+            };
+            SahBin bins[3][NUM_SAH_BINS];
 
-                rightBoxes[rightIdx] = sahBins[i][rightIdx].box;
-                leftBoxes[j] = sahBins[i][j].box;
+            // Small ranges don't benefit from more bins than they have primitives
+            const UINT32 numBins = std::min(NUM_SAH_BINS, std::max(range.Count(), 4u));
 
-                if (j > 0)
+            float binScale[3];
+            for (UINT32 k = 0; k < 3; k++)
+            {
+                const float extents = centroidBox.maxArr[k] - centroidBox.minArr[k];
+                binScale[k] = extents > 0 ? numBins / extents : 0.0f;
+                for (UINT32 j = 0; j < numBins; j++)
                 {
-                    AddExtentToBox(leftBoxes[j], leftBoxes[j - 1]);
-                    AddExtentToBox(rightBoxes[rightIdx], rightBoxes[rightIdx + 1]);
+                    bins[k][j].numPrimitives = 0;
+                    InitBoxToInverseMax(bins[k][j].box);
                 }
             }
 
-            UINT numTrianglesOnLeft = 0;
-            UINT numTrianglesOnRight = numTris;
+            auto GetBinIndex = [&](const AABB &box, UINT32 k) -> UINT32
+            {
+                return std::min(numBins - 1,
+                    UINT32((GetCentroid(box, k) - centroidBox.minArr[k]) * binScale[k]));
+            };
 
-            // Find the plane with the best score
-            for (UINT j = 0; j < NUM_SAH_BINS - 1; ++j)
+            for (UINT32 i = range.begin; i < range.end; i++)
             {
-                if (!sahBins[i][j].numTriangles)
+                const AABB& box = m_pBoxes[m_pPrimitiveIds[i]];
+                for (UINT32 k = 0; k < 3; k++)
                 {
+                    if (binScale[k] == 0.0f)
+                        continue;
+
+                    SahBin &bin = bins[k][GetBinIndex(box, k)];
+                    bin.numPrimitives++;
+                    AddExtentToBox(bin.box, box);
+                }
+            }
+
+            float bestSah = FLT_MAX;
+            UINT32 bestAxis = 0;
+            UINT32 bestBin = numBins;
+            for (UINT32 k = 0; k < 3; k++)
+            {
+                if (binScale[k] == 0.0f)
                     continue;
+
+                // Sweep from the right to get the cost of everything past each plane
+                float rightCost[NUM_SAH_BINS];
+                AABB rightBox;
+                InitBoxToInverseMax(rightBox);
+                UINT32 numOnRight = 0;
+                for (UINT32 j = numBins - 1; j > 0; j--)
+                {
+                    numOnRight += bins[k][j].numPrimitives;
+                    AddExtentToBox(rightBox, bins[k][j].box);
+                    rightCost[j] = numOnRight ? numOnRight * ComputeBoxSurfaceArea(rightBox) : 0.0f;
                 }
 
-                numTrianglesOnLeft += sahBins[i][j].numTriangles;
-                numTrianglesOnRight -= sahBins[i][j].numTriangles;
+                AABB leftBox;
+                InitBoxToInverseMax(leftBox);
+                UINT32 numOnLeft = 0;
+                for (UINT32 j = 0; j + 1 < numBins; j++)
+                {
+                    numOnLeft += bins[k][j].numPrimitives;
+                    AddExtentToBox(leftBox, bins[k][j].box);
+                    if (numOnLeft == 0 || numOnLeft == range.Count())
+                        continue;
 
-                const float sah = (numTrianglesOnLeft * ComputeBoxSurfaceArea(leftBoxes[j]) +
-                    numTrianglesOnRight * ComputeBoxSurfaceArea(rightBoxes[j + 1])) *
-                    normalizeToParent;
+                    const float sah = numOnLeft * ComputeBoxSurfaceArea(leftBox) + rightCost[j + 1];
+                    if (sah < bestSah)
+                    {
+                        bestSah = sah;
+                        bestAxis = k;
+                        bestBin = j;
+                    }
+                }
+            }
 
-                assert(!_isnan(sah));
+            UINT32 *pBegin = m_pPrimitiveIds + range.begin;
+            UINT32 *pEnd = m_pPrimitiveIds + range.end;
+            if (bestBin < numBins)
+            {
+                UINT32 *pSplit = std::partition(pBegin, pEnd, [&](UINT32 id)
+                {
+                    return GetBinIndex(m_pBoxes[id], bestAxis) <= bestBin;
+                });
+                return (UINT32)(pSplit - m_pPrimitiveIds);
+            }
 
-                if (sah < bestSah)
+            // Try to balance by using the median if SAH failed
+            UINT32 *pMedian = pBegin + range.Count() / 2;
+            UINT32 widestAxis = 0;
+            for (UINT32 k = 1; k < 3; k++)
+            {
+                if (binScale[k] != 0.0f && (binScale[widestAxis] == 0.0f || binScale[k] < binScale[widestAxis]))
+                    widestAxis = k;
+            }
+            if (binScale[widestAxis] != 0.0f)
+            {
+                std::nth_element(pBegin, pMedian, pEnd, [&](UINT32 a, UINT32 b)
                 {
-                    bestSah = sah;
-                    maxDimension = i;
-                    numTrisInLeftNode = numTrianglesOnLeft;
-                }
+                    return GetCentroid(m_pBoxes[a], widestAxis) < GetCentroid(m_pBoxes[b], widestAxis);
+                });
             }
+            return (UINT32)(pMedian - m_pPrimitiveIds);
         }
 
-        //
-        // Split the set to try to get a balanced tree
-        //
+        const AABB *m_pBoxes;
+        UINT32 *m_pPrimitiveIds;
+        AABBNode *m_pNodes;
+        const UINT32 m_maxPrimitivesInLeaf;
+    };
+
+    //
+    // Recomputes every node box on an existing topology. Children are always stored
+    // after their parent, so walking the nodes backwards visits both children before
+    // the node that bounds them. getPrimitiveBox is called with the leaf order index
+    // of every primitive referenced by a leaf.
+    //
+    template <typename GetPrimitiveBox>
+    static
+        void RefitNodes(
+            AABBNode *pNodes,
+            UINT32 numNodes,
+            const GetPrimitiveBox &getPrimitiveBox)
+    {
+        for (UINT32 i = numNodes; i-- > 0;)
+        {
+            AABBNode &node = pNodes[i];
 
-        SortByCentroid(metadata, boxes, maxDimension);
+            AABB box;
+            if (node.leaf)
+            {
+                const UINT32 firstId = node.leafNode.firstTriangleId;
+                const UINT32 numIds = node.numTriangles;
+                if (numIds == 0)
+                {
+                    box.min = box.max = { 0, 0, 0 };
+                }
+                else
+                {
+                    InitBoxToInverseMax(box);
+                    for (UINT32 id = firstId; id < firstId + numIds; id++)
+                    {
+                        AddExtentToBox(box, getPrimitiveBox(id));
+                    }
+                }
+            }
+            else
+            {
+                AABB rightBox;
+                DecompressAABB(box, pNodes[node.internalNode.leftNodeIndex]);
+                DecompressAABB(rightBox, pNodes[node.rightNodeIndex]);
+                AddExtentToBox(box, rightBox);
+            }
+
+            // Only the box changes, the child/leaf bits are left untouched
+            WriteNodeBox(node, box);
+        }
     }
 
-    //
-    // It's a good idea to do a breadth-first build because then nodes from the same level
-    // get adjacent memory locations. It does take a lot of memory though.
     //
     // "Uniform BVH"
     // -- both children are valid for all internal nodes
-    // -- left child's index is +1 of the parent index, right child's index is stored
+    // -- right child's index is +1 of the parent index, left child's index is stored
     //    in the packed AABB structure.
     // -- there could be a varaible number of triangles in leaves
     //
@@ -387,281 +498,339 @@ namespace FallbackLayer
             const std::vector<PrimitiveMetaData>& primitiveMetaData,
             UINT32 maxTrisInLeaf)
     {
-        //
-        // These are huge so use pointers
-        //
-        struct StackItem
+        const UINT32 numPrimitives = (UINT32)primitiveMetaData.size();
+
+        std::vector<UINT32> &primitiveIds = bvh.m_primitiveIds;
+        primitiveIds.resize(numPrimitives);
+        for (UINT32 i = 0; i < numPrimitives; i++)
         {
-            std::vector<PrimitiveMetaData> primitiveMetaData;
-            UINT32              parentIndex;
-            UINT                right : 1;
-            UINT                axis : 2;
-        };
+            primitiveIds[i] = i;
+        }
 
-        std::deque<StackItem*>   fifoLefts;
-        std::deque<StackItem*>   fifoRights;
+        bvh.m_nodes.resize(ParallelBvhBuilder::GetNodeCount(numPrimitives));
 
-        StackItem* temp = new StackItem;
-        temp->parentIndex = (UINT)-1;
-        temp->primitiveMetaData = primitiveMetaData;
-        temp->right = false;
-        temp->axis = 0;
-        fifoRights.push_back(temp);
+        ParallelBvhBuilder builder(boxes.data(), primitiveIds.data(), bvh.m_nodes.data(), maxTrisInLeaf);
+        builder.Build(numPrimitives);
 
-        while (!fifoLefts.empty() || !fifoRights.empty())
+        // Leaves index straight into the partitioned order
+        bvh.m_metadata.resize(numPrimitives);
+        for (UINT32 i = 0; i < numPrimitives; i++)
         {
-            // Uniform BVH pops the first left node
-            StackItem* item = nullptr;
-
-            if (!fifoRights.empty())
-            {
-                item = fifoRights.back();
-                fifoRights.pop_back();
-            }
-
-            if (!item)
-            {
-                item = fifoLefts.back();
-                fifoLefts.pop_back();
-            }
+            bvh.m_metadata[i] = primitiveMetaData[primitiveIds[i]];
+        }
+    }
 
-            //
-            // Compute overall bounding box
-            //
-            AABB nodeBox;
-            ComputeBox(nodeBox, boxes, item->primitiveMetaData);
+    void BuildUniformBVH(
+        const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS &inputs,
+        BVH &bvh)
+    {
+        //
+        // Load every primitive once, straight into its final storage
+        //
 
-            const UINT32 numTrianglesInNode = (UINT32)item->primitiveMetaData.size();
-            const UINT32 parentIndex = item->parentIndex;
+        const UINT totalNumberOfPrimitives = GetTotalPrimitiveCount(inputs);
 
-            UINT32 thisNodeIndex;
+        std::vector<AABB> boxes(totalNumberOfPrimitives);
+        std::vector<PrimitiveMetaData> primitiveMetaData(totalNumberOfPrimitives);
+        bvh.m_primitives.resize(totalNumberOfPrimitives);
 
-            // Leaf or internal node?
-            if (numTrianglesInNode <= maxTrisInLeaf)
+        UINT primitiveOffset = 0;
+        for (UINT i = 0; i < inputs.NumDescs; ++i)
+        {
+            const D3D12_RAYTRACING_GEOMETRY_DESC &geometry = GetGeometryDesc(inputs, i);
+            const UINT numPrimitives = GetPrimitiveCountFromGeometryDesc(geometry);
+            if (numPrimitives == 0)
             {
-                thisNodeIndex = BuildBVHAddLeaf(bvh, nodeBox, item->primitiveMetaData);
+                continue;
             }
-            else
-            {
-                //
-                // Find separating plane. Use Median for speed.
-                // SAH is better but also more expensive to build.
-                //
-
-                UINT splitDimension;
-                UINT leftChildNumNodes;
-
-                SahSplit(item->primitiveMetaData,
-                    splitDimension,
-                    leftChildNumNodes,
-                    nodeBox,
-                    boxes);
-
-                assert(leftChildNumNodes <= item->primitiveMetaData.size());
-
-                // Try to balance by using the median if SAH failed
-                if ((leftChildNumNodes == 0 ||
-                    leftChildNumNodes == item->primitiveMetaData.size()) &&
-                    item->primitiveMetaData.size() > MAX_TRIS_IN_LEAF)
-                {
-                    leftChildNumNodes = (UINT)item->primitiveMetaData.size() / 2;
-                }
-
-                const UINT32 rightChildNumNodes = (UINT32)item->primitiveMetaData.size() - leftChildNumNodes;
 
+            Primitive *pPrimitives = &bvh.m_primitives[primitiveOffset];
+            AABB *pBoxes = &boxes[primitiveOffset];
 
-                //
-                // "Recurse"
-                //
+            LoadPrimitives(geometry, 0, numPrimitives, pPrimitives, pBoxes);
 
-                thisNodeIndex = BuildBVHAddNode(bvh, nodeBox, splitDimension);
+            for (UINT j = 0; j < numPrimitives; ++j)
+            {
+                // PrimitiveIndex is local to the geometry, matching the GPU builder
+                PrimitiveMetaData &metadata = primitiveMetaData[primitiveOffset + j];
+                metadata.GeometryContributionToHitGroupIndex = i;
+                metadata.PrimitiveIndex = j;
+                metadata.GeometryFlags = geometry.Flags;
+            }
 
-                StackItem* leftItem = new StackItem;
-                leftItem->parentIndex = thisNodeIndex;
-                leftItem->primitiveMetaData.resize(leftChildNumNodes);
-                leftItem->right = false;
-                leftItem->axis = splitDimension;
-                for (UINT32 i = 0; i < leftChildNumNodes; ++i)
-                {
-                    leftItem->primitiveMetaData[i] = item->primitiveMetaData[i];
-                }
+            primitiveOffset += numPrimitives;
+        }
 
-                StackItem* rightItem = new StackItem;
-                rightItem->parentIndex = thisNodeIndex;
-                rightItem->primitiveMetaData.resize(rightChildNumNodes);
-                rightItem->right = true;
-                rightItem->axis = splitDimension;
-                for (UINT32 i = 0; i < rightChildNumNodes; ++i)
-                {
-                    rightItem->primitiveMetaData[i] = item->primitiveMetaData[i + leftChildNumNodes];
-                }
+        //
+        // Create a BVH
+        //
 
-                fifoLefts.push_back(leftItem);
-                fifoRights.push_back(rightItem);
-            }
+        BuildBVH(bvh, boxes, primitiveMetaData, MAX_TRIS_IN_LEAF);
 
-            // Update child link of the parent
-            if (parentIndex != -1)
+        // Traversal runs the intersection shader instead of the triangle test on leaves
+        // flagged as procedural, the same as the GPU and LBVH builders
+        for (AABBNode &node : bvh.m_nodes)
+        {
+            if (node.leaf && node.numTriangles &&
+                bvh.m_primitives[bvh.m_primitiveIds[node.leafNode.firstTriangleId]].PrimitiveType == PROCEDURAL_PRIMITIVE_TYPE)
             {
-                if (!item->right)
-                {
-                    bvh.m_nodes[parentIndex].internalNode.leftNodeIndex = thisNodeIndex;
-                    bvh.m_nodes[parentIndex].rightNodeIndex = parentIndex + 1;
-                }
+                node.nodeAllBits |= IsProceduralGeometryFlag;
             }
-
-            // Free the item after use
-            delete item;
         }
     }
 
-    void BuildUniformBVH(
-        _In_  UINT NumElements,
-        _In_reads_opt_(NumElements)  const D3D12_RAYTRACING_GEOMETRY_DESC *pGeometries,
-        BVH &bvh)
+    static
+        const D3D12_RAYTRACING_INSTANCE_DESC &GetInstanceDesc(
+            const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS &inputs,
+            UINT index)
     {
-        using namespace DirectX;
-        //
-        // Compute number of triangles
-        //
+        // On the CPU path every "GPU VA" is a plain pointer to CPU memory
+        if (inputs.DescsLayout == D3D12_ELEMENTS_LAYOUT_ARRAY_OF_POINTERS)
+        {
+            return *((const D3D12_RAYTRACING_INSTANCE_DESC *const *)inputs.InstanceDescs)[index];
+        }
+        return ((const D3D12_RAYTRACING_INSTANCE_DESC *)inputs.InstanceDescs)[index];
+    }
 
-        UINT    totalNumberOfTriangles = 0;
+    static
+        void InvertAffineTransform(
+            const float(&transform)[3][4],
+            float(&inverse)[3][4])
+    {
+        const float(&m)[3][4] = transform;
+        const float cofactors[3][3] =
+        {
+            { m[1][1] * m[2][2] - m[1][2] * m[2][1], m[1][2] * m[2][0] - m[1][0] * m[2][2], m[1][0] * m[2][1] - m[1][1] * m[2][0] },
+            { m[0][2] * m[2][1] - m[0][1] * m[2][2], m[0][0] * m[2][2] - m[0][2] * m[2][0], m[0][1] * m[2][0] - m[0][0] * m[2][1] },
+            { m[0][1] * m[1][2] - m[0][2] * m[1][1], m[0][2] * m[1][0] - m[0][0] * m[1][2], m[0][0] * m[1][1] - m[0][1] * m[1][0] }
+        };
+        const float invDet = 1.0f / (m[0][0] * cofactors[0][0] + m[0][1] * cofactors[0][1] + m[0][2] * cofactors[0][2]);
 
-        for (UINT i = 0; i < NumElements; ++i)
+        for (UINT row = 0; row < 3; row++)
         {
-            auto &geometry = pGeometries[i];
-            if (geometry.Type == D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES)
+            for (UINT column = 0; column < 3; column++)
             {
-                totalNumberOfTriangles += GetPrimitiveCountFromGeometryDesc(geometry);
+                inverse[row][column] = cofactors[column][row] * invDet;
             }
-            else
+            inverse[row][3] = -(inverse[row][0] * m[0][3] + inverse[row][1] * m[1][3] + inverse[row][2] * m[2][3]);
+        }
+    }
+
+    //
+    // Bounds the box after an affine transform using the absolute values of the
+    // matrix, which gives the same result as transforming all 8 corners
+    //
+    static
+        AABB TransformBox(
+            const AABB &box,
+            const float(&transform)[3][4])
+    {
+        AABB transformedBox;
+        for (UINT row = 0; row < 3; row++)
+        {
+            transformedBox.minArr[row] = transformedBox.maxArr[row] = transform[row][3];
+            for (UINT column = 0; column < 3; column++)
             {
-                throw - 1; // Intersection shaders not supported yet
+                const float a = transform[row][column] * box.minArr[column];
+                const float b = transform[row][column] * box.maxArr[column];
+                transformedBox.minArr[row] += std::min(a, b);
+                transformedBox.maxArr[row] += std::max(a, b);
             }
-
         }
+        return transformedBox;
+    }
 
-        //
-        // Create AABBs
-        //
-
-        std::vector<AABB> boxes;
-        boxes.resize(totalNumberOfTriangles);
-
-        std::vector<PrimitiveMetaData> primitiveMetaData;
-        primitiveMetaData.resize(totalNumberOfTriangles);
+    static
+        AABB ComputeInstanceBox(
+            const D3D12_RAYTRACING_INSTANCE_DESC &instance)
+    {
+        const BYTE *pBottomLevel = (const BYTE *)instance.AccelerationStructure;
+        const BVHOffsets &offsets = *(const BVHOffsets *)pBottomLevel;
 
-        std::vector<float>  triangleVertices;
-        triangleVertices.resize(totalNumberOfTriangles * 9);
+        AABB rootBox;
+        DecompressAABB(rootBox, *(const AABBNode *)(pBottomLevel + offsets.offsetToBoxes));
+        return TransformBox(rootBox, instance.Transform);
+    }
 
-        UINT triangleIndex = 0;
-        for (UINT i = 0; i < NumElements; ++i)
-        {
-            auto &geometry = pGeometries[i];
-            if (geometry.Type != D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES)
-            {
-                throw - 1; // Intersection shaders not supported yet
-            }
+    static
+        void WriteInstanceMetadata(
+            const D3D12_RAYTRACING_INSTANCE_DESC &instance,
+            UINT instanceIndex,
+            BVHMetadata &metadata)
+    {
+        static_assert(sizeof(instance) == sizeof(metadata.instanceDesc), L"Instance desc layouts must match");
+        memcpy(&metadata.instanceDesc, &instance, sizeof(instance));
 
-            auto &triangles = geometry.Triangles;
-            if (GetPrimitiveCountFromGeometryDesc(geometry) == 0)
+        // Same as the GPU builder: traversal only needs WorldToObject in the instance desc
+        InvertAffineTransform(instance.Transform, metadata.instanceDesc.Transform);
+        memcpy(metadata.ObjectToWorld, instance.Transform, sizeof(metadata.ObjectToWorld));
+        metadata.InstanceIndex = instanceIndex;
+    }
 
-            {
-                continue;
-            }
+    //
+    // Top level layout matches the GPU builder:
+    // BVHOffsets | AABBNode[2N - 1] | BVHMetadata[N]
+    // with offsetToVertices pointing at the per-leaf metadata
+    //
+    static
+        void BuildTopLevelBVH(
+            const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS &inputs,
+            BYTE *pOutput)
+    {
+        const UINT32 numInstances = inputs.NumDescs;
 
-            // 
-            const UINT64 vertexStrideDwords = triangles.VertexBuffer.StrideInBytes / 4;
-            const UINT numTris = GetPrimitiveCountFromGeometryDesc(geometry);
+        std::vector<AABB> boxes(numInstances);
+        std::vector<UINT32> instanceIds(numInstances);
+        for (UINT32 i = 0; i < numInstances; i++)
+        {
+            boxes[i] = ComputeInstanceBox(GetInstanceDesc(inputs, i));
+            instanceIds[i] = i;
+        }
 
-            float *pVertexData = (float *)geometry.Triangles.VertexBuffer.StartAddress;
-            float *pIndexData = (float *)geometry.Triangles.IndexBuffer;
+        const UINT32 numNodes = ParallelBvhBuilder::GetNodeCount(numInstances);
+        BVHOffsets &offsets = *(BVHOffsets *)pOutput;
+        offsets.offsetToBoxes = sizeof(BVHOffsets);
+        offsets.offsetToVertices = offsets.offsetToBoxes + numNodes * sizeof(AABBNode);
+        offsets.offsetToPrimitiveMetaData = 0;
+        offsets.totalSize = offsets.offsetToVertices + numInstances * sizeof(BVHMetadata);
 
-            const float* pVertices = (float*)(pVertexData);
-            const UINT16* pIndices = (UINT16*)(pIndexData);
+        AABBNode *pNodes = (AABBNode *)(pOutput + offsets.offsetToBoxes);
+        ParallelBvhBuilder builder(boxes.data(), instanceIds.data(), pNodes, 1);
+        builder.Build(numInstances);
 
-            for (UINT j = 0; j < numTris; ++j)
-            {
-                const UINT16 i0 = pIndices[j * 3 + 0];
-                const UINT16 i1 = pIndices[j * 3 + 1];
-                const UINT16 i2 = pIndices[j * 3 + 2];
+        BVHMetadata *pMetadata = (BVHMetadata *)(pOutput + offsets.offsetToVertices);
+        for (UINT32 i = 0; i < numInstances; i++)
+        {
+            WriteInstanceMetadata(GetInstanceDesc(inputs, instanceIds[i]), instanceIds[i], pMetadata[i]);
+        }
+    }
 
-                const float* v0 = &pVertices[i0 * vertexStrideDwords];
-                const float* v1 = &pVertices[i1 * vertexStrideDwords];
-                const float* v2 = &pVertices[i2 * vertexStrideDwords];
+    //
+    // Refit-only update for frames where just the instance transforms (or the child
+    // acceleration structures' bounds) changed. The tree topology is kept as is.
+    //
+    static
+        void RefitTopLevelBVH(
+            const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS &inputs,
+            BYTE *pBVH)
+    {
+        const BVHOffsets &offsets = *(const BVHOffsets *)pBVH;
+        const UINT32 numNodes = (offsets.offsetToVertices - offsets.offsetToBoxes) / sizeof(AABBNode);
+        if (numNodes != ParallelBvhBuilder::GetNodeCount(inputs.NumDescs))
+        {
+            ThrowFailure(E_INVALIDARG, L"The number of instances can't change when performing an update");
+        }
 
-                float* pTriVerts = &triangleVertices[triangleIndex * 9];
+        AABBNode *pNodes = (AABBNode *)(pBVH + offsets.offsetToBoxes);
+        BVHMetadata *pMetadata = (BVHMetadata *)(pBVH + offsets.offsetToVertices);
+        RefitNodes(pNodes, numNodes, [&](UINT32 leafIndex) -> AABB
+        {
+            BVHMetadata &metadata = pMetadata[leafIndex];
+            const D3D12_RAYTRACING_INSTANCE_DESC &instance = GetInstanceDesc(inputs, metadata.InstanceIndex);
+            WriteInstanceMetadata(instance, metadata.InstanceIndex, metadata);
+            return ComputeInstanceBox(instance);
+        });
+    }
 
-                pTriVerts[0] = v0[0];
-                pTriVerts[1] = v0[1];
-                pTriVerts[2] = v0[2];
+    static
+        void BuildBottomLevelBVH(
+            const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS &inputs,
+            BYTE *outputData)
+    {
+        BVH bvh;
+        BuildUniformBVH(inputs, bvh);
 
-                pTriVerts[3] = v1[0];
-                pTriVerts[4] = v1[1];
-                pTriVerts[5] = v1[2];
+        BVHOffsets offsets;
+        offsets.offsetToBoxes = sizeof(BVHOffsets);
+        const UINT sizeofBoxes = (UINT)(bvh.m_nodes.size() * sizeof(*bvh.m_nodes.data()));
+        offsets.offsetToVertices = offsets.offsetToBoxes + sizeofBoxes;
 
-                pTriVerts[6] = v2[0];
-                pTriVerts[7] = v2[1];
-                pTriVerts[8] = v2[2];
+        const UINT numPrimitives = (UINT)bvh.m_primitives.size();
+        const UINT sizeofVertices = numPrimitives * sizeof(Primitive);
+        offsets.offsetToPrimitiveMetaData = offsets.offsetToVertices + sizeofVertices;
 
-                AABB& box = boxes[triangleIndex];
-                for (UINT k = 0; k < 3; ++k)
-                {
-#define AABB_Min_Padding 0.001f
-                    box.minArr[k] = std::min(v2[k], std::min(v0[k], v1[k]));
-                    box.maxArr[k] = std::max(v2[k], std::max(v0[k], v1[k])) + AABB_Min_Padding;
+        const UINT sizeofMetadata = (UINT)(bvh.m_metadata.size() * sizeof(*bvh.m_metadata.data()));
+        offsets.totalSize = offsets.offsetToPrimitiveMetaData + sizeofMetadata;
 
-                    if (_isnan(box.minArr[k]) ||
-                        _isnan(box.maxArr[k]))
-                    {
-                        box.minArr[k] = 0;
-                        box.maxArr[k] = 0;
-                    }
-                }
+        memcpy(outputData,  &offsets, sizeof(offsets));
+        memcpy(outputData + offsets.offsetToBoxes, bvh.m_nodes.data(), sizeofBoxes);
 
-                // Create out internal triangle indices.
-                PrimitiveMetaData metadata;
-                metadata.GeometryContributionToHitGroupIndex = i;
-                metadata.PrimitiveIndex = triangleIndex;
-                metadata.GeometryFlags = geometry.Flags;
-                primitiveMetaData[triangleIndex] = metadata;
+        // Primitives were loaded in input order, write them out in leaf order
+        Primitive *pPrimitives = (Primitive *)(outputData + offsets.offsetToVertices);
+        for (UINT i = 0; i < numPrimitives; i++)
+        {
+            pPrimitives[i] = bvh.m_primitives[bvh.m_primitiveIds[i]];
+        }
+        memcpy(outputData + offsets.offsetToPrimitiveMetaData, bvh.m_metadata.data(), sizeofMetadata);
+    }
 
-                // Next triangle
-                triangleIndex++;
-            }
+    //
+    // Refit-only update for deforming geometry. The leaf order metadata says which
+    // geometry and primitive every leaf slot came from, so the new positions are read
+    // straight into place and the boxes are refit bottom-up without any allocation.
+    // ALLOW_UPDATE needs no extra data on the CPU path for the same reason.
+    //
+    static
+        void RefitBottomLevelBVH(
+            const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS &inputs,
+            BYTE *pBVH)
+    {
+        const BVHOffsets &offsets = *(const BVHOffsets *)pBVH;
+        const UINT32 numNodes = (offsets.offsetToVertices - offsets.offsetToBoxes) / sizeof(AABBNode);
+        const UINT32 numPrimitives = (offsets.offsetToPrimitiveMetaData - offsets.offsetToVertices) / sizeof(Primitive);
+        if (numPrimitives != GetTotalPrimitiveCount(inputs))
+        {
+            ThrowFailure(E_INVALIDARG, L"The number of primitives can't change when performing an update");
         }
 
-        //
-        // Create a BVH
-        //
+        AABBNode *pNodes = (AABBNode *)(pBVH + offsets.offsetToBoxes);
+        Primitive *pPrimitives = (Primitive *)(pBVH + offsets.offsetToVertices);
+        const PrimitiveMetaData *pMetadata = (const PrimitiveMetaData *)(pBVH + offsets.offsetToPrimitiveMetaData);
+        RefitNodes(pNodes, numNodes, [&](UINT32 leafIndex) -> AABB
+        {
+            const PrimitiveMetaData &metadata = pMetadata[leafIndex];
+            const D3D12_RAYTRACING_GEOMETRY_DESC &geometry = GetGeometryDesc(inputs, metadata.GeometryContributionToHitGroupIndex);
 
-        BuildBVH(bvh, boxes, primitiveMetaData, MAX_TRIS_IN_LEAF);
+            AABB box;
+            LoadPrimitives(geometry, metadata.PrimitiveIndex, 1, &pPrimitives[leafIndex], &box);
+            return box;
+        });
+    }
 
-        //
-        // Now copy and compress geometry
-        //
+    //
+    // Expected cost of a random ray hitting the root under the surface area heuristic,
+    // relative to the cost of intersecting a single primitive
+    //
+    static
+        float ComputeSahCost(
+            const BYTE *pBVH)
+    {
+        static const float TraversalCost = 1.0f;
+        static const float IntersectionCost = 1.0f;
+
+        const BVHOffsets &offsets = *(const BVHOffsets *)pBVH;
+        const UINT32 numNodes = (offsets.offsetToVertices - offsets.offsetToBoxes) / sizeof(AABBNode);
+        const AABBNode *pNodes = (const AABBNode *)(pBVH + offsets.offsetToBoxes);
 
-        // Copy verts
-        const UINT numTris = triangleIndex;
-        bvh.m_triangles.resize(numTris * 3 * 3);
-        assert(bvh.m_triangles.size() == triangleVertices.size());
-        assert(sizeof(bvh.m_triangles[0]) == sizeof(triangleVertices[0]));
+        AABB rootBox;
+        DecompressAABB(rootBox, pNodes[0]);
+        const float rootArea = ComputeBoxSurfaceArea(rootBox);
+        if (rootArea <= 0.0f)
+        {
+            return 0.0f;
+        }
 
-        for (UINT i = 0; i < numTris; ++i)
+        float cost = 0.0f;
+        for (UINT32 i = 0; i < numNodes; i++)
         {
-            UINT inputIndex = bvh.m_metadata[i].PrimitiveIndex;
-            float *pInputTriangle = &triangleVertices.data()[inputIndex * 9];
-            float* pOutputTriangle = &bvh.m_triangles[i * 9];
-
-            // Construct three planes and write to pPlanes
-            XMVECTOR V0 = XMVectorSet(pInputTriangle[0], pInputTriangle[1], pInputTriangle[2], 0.0f);
-            XMVECTOR V1 = XMVectorSet(pInputTriangle[3], pInputTriangle[4], pInputTriangle[5], 0.0f);
-            XMVECTOR V2 = XMVectorSet(pInputTriangle[6], pInputTriangle[7], pInputTriangle[8], 0.0f);
-
-            XMStoreFloat3((XMFLOAT3*)pOutputTriangle + 0, V0);
-            XMStoreFloat3((XMFLOAT3*)pOutputTriangle + 1, V1);
-            XMStoreFloat3((XMFLOAT3*)pOutputTriangle + 2, V2);
+            AABB box;
+            DecompressAABB(box, pNodes[i]);
+            const float area = ComputeBoxSurfaceArea(box);
+            cost += pNodes[i].leaf ?
+                area * IntersectionCost * pNodes[i].numTriangles :
+                area * TraversalCost;
         }
+        return cost / rootArea;
     }
 }
 
@@ -669,31 +838,63 @@ void BuildRaytracingAccelerationStructureOnCpu(
     _In_  const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC *pDesc,
     _Out_ void *pData)
 {
-    FallbackLayer::BVH bvh;
-    FallbackLayer::BuildUniformBVH(pDesc->Inputs.NumDescs, pDesc->Inputs.pGeometryDescs, bvh);
-
+    const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS &inputs = pDesc->Inputs;
     BYTE* outputData = (BYTE*)pData;
-    BVHOffsets offsets;
-    offsets.offsetToBoxes = sizeof(BVHOffsets);
-    const UINT sizeofBoxes = (UINT)(bvh.m_nodes.size() * sizeof(*bvh.m_nodes.data()));
-    offsets.offsetToVertices = offsets.offsetToBoxes + sizeofBoxes;
-    
-    UINT numTriangles = (UINT)bvh.m_triangles.size() / 9;
-    const UINT sizeofVertices = numTriangles * sizeof(Primitive);
-    offsets.offsetToPrimitiveMetaData = offsets.offsetToVertices + sizeofVertices;
-
-    const UINT sizeofMetadata = (UINT)(bvh.m_metadata.size() * sizeof(*bvh.m_metadata.data()));
-    offsets.totalSize = offsets.offsetToPrimitiveMetaData + sizeofMetadata;
-
-    memcpy(outputData,  &offsets, sizeof(offsets));
-    memcpy(outputData + offsets.offsetToBoxes, bvh.m_nodes.data(), sizeofBoxes);
-
-    Primitive *pPrimitives = (Primitive *)(outputData + offsets.offsetToVertices);
-    for (UINT i = 0; i < numTriangles; i++)
+
+    const bool performUpdate = (inputs.Flags & D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE) != 0;
+    if (performUpdate)
+    {
+        // Updates are done in place, so bring the source over first if it lives elsewhere
+        const BYTE* sourceData = (const BYTE*)pDesc->SourceAccelerationStructureData;
+        if (sourceData && sourceData != outputData)
+        {
+            memcpy(outputData, sourceData, ((const BVHOffsets*)sourceData)->totalSize);
+        }
+    }
+
+    switch (inputs.Type)
     {
-        Triangle *pTriangle = (Triangle *)((BYTE *)bvh.m_triangles.data() + sizeof(Triangle) * i);
-        pPrimitives[i].PrimitiveType = TRIANGLE_TYPE;
-        pPrimitives[i].triangle = *pTriangle;
+    case D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL:
+        if (performUpdate)
+        {
+            FallbackLayer::RefitBottomLevelBVH(inputs, outputData);
+        }
+        else
+        {
+            FallbackLayer::BuildBottomLevelBVH(inputs, outputData);
+        }
+        break;
+    case D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL:
+        if (performUpdate)
+        {
+            FallbackLayer::RefitTopLevelBVH(inputs, outputData);
+        }
+        else
+        {
+            FallbackLayer::BuildTopLevelBVH(inputs, outputData);
+        }
+        break;
+    default:
+        ThrowFailure(E_INVALIDARG, L"Unrecognized D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE provided");
     }
-    memcpy(outputData + offsets.offsetToPrimitiveMetaData, bvh.m_metadata.data(), sizeofMetadata);
+}
+
+float GetAccelerationStructureSahCostOnCpu(
+    _In_ const void *pData)
+{
+    return FallbackLayer::ComputeSahCost((const BYTE*)pData);
+}
+
+float GetRefitQualityRatioOnCpu(
+    _In_  const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC *pDesc,
+    _In_  const void *pRefitData,
+    _Out_ void *pScratchData)
+{
+    D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC rebuildDesc = *pDesc;
+    rebuildDesc.Inputs.Flags &= ~D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE;
+    rebuildDesc.SourceAccelerationStructureData = 0;
+    BuildRaytracingAccelerationStructureOnCpu(&rebuildDesc, pScratchData);
+
+    const float rebuiltCost = GetAccelerationStructureSahCostOnCpu(pScratchData);
+    return rebuiltCost > 0.0f ? GetAccelerationStructureSahCostOnCpu(pRefitData) / rebuiltCost : 1.0f;
 }
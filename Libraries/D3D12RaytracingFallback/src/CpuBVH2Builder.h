@@ -0,0 +1,23 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+#pragma once
+
+namespace FallbackLayer
+{
+    // Reads primitives [firstPrimitive, firstPrimitive + numPrimitives) of a geometry desc
+    // whose buffers live in CPU memory, writing each primitive and its bounding box
+    void LoadPrimitives(
+        const D3D12_RAYTRACING_GEOMETRY_DESC &geometry,
+        UINT firstPrimitive,
+        UINT numPrimitives,
+        Primitive *pPrimitives,
+        AABB *pBoxes);
+}
@@ -0,0 +1,470 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+#include "pch.h"
+#include <intrin.h>
+#include <immintrin.h>
+
+//
+// Packet traversal of a bottom-level BVHOffsets/AABBNode/Primitive blob on the CPU.
+// Each packet carries 4 (SSE) or 8 (AVX) rays in SoA form; boxes use the same slab
+// test as RayBoxTest in TraverseFunction.hlsli and triangles use Moller-Trumbore.
+//
+namespace FallbackLayer
+{
+    static const UINT TraversalGrainSize = 64;
+    static const float MinAbsDirection = 1e-8f;
+
+    struct SseLanes
+    {
+        static const UINT Width = 4;
+        typedef __m128 Float;
+
+        static Float Set(float f) { return _mm_set1_ps(f); }
+        static Float Load(const float *p) { return _mm_load_ps(p); }
+        static void Store(float *p, Float v) { _mm_store_ps(p, v); }
+        static Float Add(Float a, Float b) { return _mm_add_ps(a, b); }
+        static Float Sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+        static Float Mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+        static Float Div(Float a, Float b) { return _mm_div_ps(a, b); }
+        static Float Min(Float a, Float b) { return _mm_min_ps(a, b); }
+        static Float Max(Float a, Float b) { return _mm_max_ps(a, b); }
+        static Float Less(Float a, Float b) { return _mm_cmplt_ps(a, b); }
+        static Float LessEqual(Float a, Float b) { return _mm_cmple_ps(a, b); }
+        static Float NotEqual(Float a, Float b) { return _mm_cmpneq_ps(a, b); }
+        static Float And(Float a, Float b) { return _mm_and_ps(a, b); }
+        static Float Select(Float mask, Float a, Float b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+        static UINT Mask(Float v) { return (UINT)_mm_movemask_ps(v); }
+    };
+
+    struct AvxLanes
+    {
+        static const UINT Width = 8;
+        typedef __m256 Float;
+
+        static Float Set(float f) { return _mm256_set1_ps(f); }
+        static Float Load(const float *p) { return _mm256_load_ps(p); }
+        static void Store(float *p, Float v) { _mm256_store_ps(p, v); }
+        static Float Add(Float a, Float b) { return _mm256_add_ps(a, b); }
+        static Float Sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+        static Float Mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+        static Float Div(Float a, Float b) { return _mm256_div_ps(a, b); }
+        static Float Min(Float a, Float b) { return _mm256_min_ps(a, b); }
+        static Float Max(Float a, Float b) { return _mm256_max_ps(a, b); }
+        static Float Less(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        static Float LessEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+        static Float NotEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ); }
+        static Float And(Float a, Float b) { return _mm256_and_ps(a, b); }
+        static Float Select(Float mask, Float a, Float b) { return _mm256_blendv_ps(b, a, mask); }
+        static UINT Mask(Float v) { return (UINT)_mm256_movemask_ps(v); }
+    };
+
+    static
+        bool IsAvxSupported()
+    {
+        int cpuInfo[4];
+        __cpuid(cpuInfo, 1);
+        const bool bOsSavesYmm = (cpuInfo[2] & (1 << 27)) != 0;
+        const bool bHasAvx = (cpuInfo[2] & (1 << 28)) != 0;
+        return bOsSavesYmm && bHasAvx && (_xgetbv(0) & 0x6) == 0x6;
+    }
+
+    struct TraversalStackEntry
+    {
+        UINT nodeIndex;
+        UINT laneMask;
+        float entryT;
+    };
+
+    template <typename Lanes>
+    class RayPacketTraversal
+    {
+        typedef typename Lanes::Float Float;
+        static const UINT Width = Lanes::Width;
+
+    public:
+        RayPacketTraversal(const BYTE *pData, std::vector<TraversalStackEntry> &stack) :
+            m_stack(stack)
+        {
+            const BVHOffsets &offsets = *(const BVHOffsets *)pData;
+            m_pNodes = (const AABBNode *)(pData + offsets.offsetToBoxes);
+            m_pPrimitives = (const Primitive *)(pData + offsets.offsetToVertices);
+            m_pMetaData = (const PrimitiveMetaData *)(pData + offsets.offsetToPrimitiveMetaData);
+            m_numPrimitives = (offsets.offsetToPrimitiveMetaData - offsets.offsetToVertices) / sizeof(Primitive);
+        }
+
+        void Trace(const CpuRay *pRays, UINT numRays, bool bAcceptFirstHit, CpuRayHit *pHits)
+        {
+            assert(numRays <= Width);
+            LoadRays(pRays, numRays);
+
+            UINT activeLanes = (1 << numRays) - 1;
+            m_stack.clear();
+            if (m_numPrimitives != 0)
+            {
+                float rootEntryT;
+                const UINT rootLanes = TestBox(m_pNodes[0], activeLanes, rootEntryT);
+                if (rootLanes)
+                {
+                    m_stack.push_back({ 0, rootLanes, rootEntryT });
+                }
+            }
+
+            while (m_stack.size() && activeLanes)
+            {
+                const TraversalStackEntry entry = m_stack.back();
+                m_stack.pop_back();
+
+                // The box was hit when it was pushed, but a closer hit may since have been found
+                alignas(32) float hitT[Width];
+                Lanes::Store(hitT, m_hitT);
+                UINT lanes = entry.laneMask & activeLanes;
+                for (UINT lane = 0; lane < Width; lane++)
+                {
+                    if ((lanes & (1 << lane)) && entry.entryT > hitT[lane])
+                    {
+                        lanes &= ~(1 << lane);
+                    }
+                }
+                if (lanes == 0)
+                {
+                    continue;
+                }
+
+                const AABBNode &node = m_pNodes[entry.nodeIndex];
+                if (node.leaf)
+                {
+                    const UINT firstPrimitive = node.leafNode.firstTriangleId;
+                    for (UINT primitiveIndex = firstPrimitive; primitiveIndex < firstPrimitive + node.numTriangles; primitiveIndex++)
+                    {
+                        const UINT hitLanes = TestPrimitive(primitiveIndex, lanes);
+                        if (bAcceptFirstHit)
+                        {
+                            activeLanes &= ~hitLanes;
+                            lanes &= ~hitLanes;
+                        }
+                    }
+                }
+                else
+                {
+                    const UINT leftIndex = node.internalNode.leftNodeIndex;
+                    const UINT rightIndex = node.rightNodeIndex;
+                    float leftEntryT, rightEntryT;
+                    const UINT leftLanes = TestBox(m_pNodes[leftIndex], lanes, leftEntryT);
+                    const UINT rightLanes = TestBox(m_pNodes[rightIndex], lanes, rightEntryT);
+
+                    // Push the farther child first so the nearer one is visited next
+                    if (leftLanes && rightLanes)
+                    {
+                        if (leftEntryT <= rightEntryT)
+                        {
+                            m_stack.push_back({ rightIndex, rightLanes, rightEntryT });
+                            m_stack.push_back({ leftIndex, leftLanes, leftEntryT });
+                        }
+                        else
+                        {
+                            m_stack.push_back({ leftIndex, leftLanes, leftEntryT });
+                            m_stack.push_back({ rightIndex, rightLanes, rightEntryT });
+                        }
+                    }
+                    else if (leftLanes)
+                    {
+                        m_stack.push_back({ leftIndex, leftLanes, leftEntryT });
+                    }
+                    else if (rightLanes)
+                    {
+                        m_stack.push_back({ rightIndex, rightLanes, rightEntryT });
+                    }
+                }
+            }
+
+            alignas(32) float hitT[Width];
+            Lanes::Store(hitT, m_hitT);
+            alignas(32) float hitU[Width];
+            Lanes::Store(hitU, m_hitU);
+            alignas(32) float hitV[Width];
+            Lanes::Store(hitV, m_hitV);
+            for (UINT lane = 0; lane < numRays; lane++)
+            {
+                CpuRayHit &hit = pHits[lane];
+                hit.T = hitT[lane];
+                hit.Barycentrics[0] = hitU[lane];
+                hit.Barycentrics[1] = hitV[lane];
+                if (m_hitPrimitive[lane] == CpuRayMiss)
+                {
+                    hit.PrimitiveIndex = CpuRayMiss;
+                    hit.GeometryIndex = CpuRayMiss;
+                }
+                else
+                {
+                    const PrimitiveMetaData &metadata = m_pMetaData[m_hitPrimitive[lane]];
+                    hit.PrimitiveIndex = metadata.PrimitiveIndex;
+                    hit.GeometryIndex = metadata.GeometryContributionToHitGroupIndex;
+                }
+            }
+        }
+
+    private:
+        void LoadRays(const CpuRay *pRays, UINT numRays)
+        {
+            // Unused lanes repeat the first ray so they never produce NaNs
+            alignas(32) float origin[3][Width];
+            alignas(32) float direction[3][Width];
+            alignas(32) float inverseDirection[3][Width];
+            alignas(32) float tMin[Width];
+            alignas(32) float tMax[Width];
+            for (UINT lane = 0; lane < Width; lane++)
+            {
+                const CpuRay &ray = pRays[lane < numRays ? lane : 0];
+                for (UINT axis = 0; axis < 3; axis++)
+                {
+                    origin[axis][lane] = ray.Origin[axis];
+                    direction[axis][lane] = ray.Direction[axis];
+
+                    // Keep the slab test finite for axis-aligned rays
+                    float d = ray.Direction[axis];
+                    if (std::abs(d) < MinAbsDirection)
+                    {
+                        d = d < 0.0f ? -MinAbsDirection : MinAbsDirection;
+                    }
+                    inverseDirection[axis][lane] = 1.0f / d;
+                }
+                tMin[lane] = ray.TMin;
+                tMax[lane] = ray.TMax;
+                m_hitPrimitive[lane] = CpuRayMiss;
+            }
+
+            for (UINT axis = 0; axis < 3; axis++)
+            {
+                m_origin[axis] = Lanes::Load(origin[axis]);
+                m_direction[axis] = Lanes::Load(direction[axis]);
+                m_inverseDirection[axis] = Lanes::Load(inverseDirection[axis]);
+                m_absInverseDirection[axis] = Lanes::Max(m_inverseDirection[axis], Lanes::Sub(Lanes::Set(0.0f), m_inverseDirection[axis]));
+            }
+            m_tMin = Lanes::Load(tMin);
+            m_hitT = Lanes::Load(tMax);
+            m_hitU = Lanes::Set(0.0f);
+            m_hitV = Lanes::Set(0.0f);
+        }
+
+        // Returns the lanes whose ray overlaps the box before their closest hit, along
+        // with the smallest entry distance among them
+        UINT TestBox(const AABBNode &node, UINT lanes, float &entryT)
+        {
+            Float nearT = m_tMin;
+            Float farT = m_hitT;
+            for (UINT axis = 0; axis < 3; axis++)
+            {
+                const Float relativeMiddle = Lanes::Mul(Lanes::Sub(Lanes::Set(node.center[axis]), m_origin[axis]), m_inverseDirection[axis]);
+                const Float extent = Lanes::Mul(Lanes::Set(node.halfDim[axis]), m_absInverseDirection[axis]);
+                nearT = Lanes::Max(nearT, Lanes::Sub(relativeMiddle, extent));
+                farT = Lanes::Min(farT, Lanes::Add(relativeMiddle, extent));
+            }
+
+            const UINT hitLanes = Lanes::Mask(Lanes::LessEqual(nearT, farT)) & lanes;
+            entryT = FLT_MAX;
+            if (hitLanes)
+            {
+                alignas(32) float nearTs[Width];
+                Lanes::Store(nearTs, nearT);
+                for (UINT lane = 0; lane < Width; lane++)
+                {
+                    if (hitLanes & (1 << lane))
+                    {
+                        entryT = std::min(entryT, nearTs[lane]);
+                    }
+                }
+            }
+            return hitLanes;
+        }
+
+        UINT TestPrimitive(UINT primitiveIndex, UINT lanes)
+        {
+            assert(primitiveIndex < m_numPrimitives);
+            const Primitive &primitive = m_pPrimitives[primitiveIndex];
+
+            Float hitMask;
+            Float t, u, v;
+            if (primitive.PrimitiveType == TRIANGLE_TYPE)
+            {
+                IntersectTriangle(primitive.triangle, hitMask, t, u, v);
+            }
+            else
+            {
+                // Intersection shaders can't run here, so procedural geometry reports
+                // a hit where the ray enters its box
+                IntersectBox(primitive.aabb, hitMask, t);
+                u = Lanes::Set(0.0f);
+                v = Lanes::Set(0.0f);
+            }
+
+            const UINT hitLanes = Lanes::Mask(hitMask) & lanes;
+            if (hitLanes)
+            {
+                alignas(32) float laneMask[Width];
+                for (UINT lane = 0; lane < Width; lane++)
+                {
+                    laneMask[lane] = (hitLanes & (1 << lane)) ? -1.0f : 0.0f;
+                    if (hitLanes & (1 << lane))
+                    {
+                        m_hitPrimitive[lane] = primitiveIndex;
+                    }
+                }
+
+                // Rebuild a full-width lane mask from the hit bits
+                const Float mask = Lanes::Less(Lanes::Load(laneMask), Lanes::Set(0.0f));
+                m_hitT = Lanes::Select(mask, t, m_hitT);
+                m_hitU = Lanes::Select(mask, u, m_hitU);
+                m_hitV = Lanes::Select(mask, v, m_hitV);
+            }
+            return hitLanes;
+        }
+
+        void IntersectTriangle(const Triangle &triangle, Float &hitMask, Float &t, Float &u, Float &v)
+        {
+            const float3 e1 = triangle.v1 - triangle.v0;
+            const float3 e2 = triangle.v2 - triangle.v0;
+            const Float edge1[3] = { Lanes::Set(e1.x), Lanes::Set(e1.y), Lanes::Set(e1.z) };
+            const Float edge2[3] = { Lanes::Set(e2.x), Lanes::Set(e2.y), Lanes::Set(e2.z) };
+
+            Float p[3], s[3], q[3];
+            Cross(m_direction, edge2, p);
+            const Float det = Dot(edge1, p);
+            const Float inverseDet = Lanes::Div(Lanes::Set(1.0f), det);
+
+            s[0] = Lanes::Sub(m_origin[0], Lanes::Set(triangle.v0.x));
+            s[1] = Lanes::Sub(m_origin[1], Lanes::Set(triangle.v0.y));
+            s[2] = Lanes::Sub(m_origin[2], Lanes::Set(triangle.v0.z));
+            u = Lanes::Mul(Dot(s, p), inverseDet);
+
+            Cross(s, edge1, q);
+            v = Lanes::Mul(Dot(m_direction, q), inverseDet);
+            t = Lanes::Mul(Dot(edge2, q), inverseDet);
+
+            const Float zero = Lanes::Set(0.0f);
+            hitMask = Lanes::NotEqual(det, zero);
+            hitMask = Lanes::And(hitMask, Lanes::LessEqual(zero, u));
+            hitMask = Lanes::And(hitMask, Lanes::LessEqual(zero, v));
+            hitMask = Lanes::And(hitMask, Lanes::LessEqual(Lanes::Add(u, v), Lanes::Set(1.0f)));
+            hitMask = Lanes::And(hitMask, Lanes::Less(m_tMin, t));
+            hitMask = Lanes::And(hitMask, Lanes::Less(t, m_hitT));
+        }
+
+        void IntersectBox(const AABB &aabb, Float &hitMask, Float &t)
+        {
+            const float boxMin[3] = { aabb.min.x, aabb.min.y, aabb.min.z };
+            const float boxMax[3] = { aabb.max.x, aabb.max.y, aabb.max.z };
+            Float nearT = m_tMin;
+            Float farT = m_hitT;
+            for (UINT axis = 0; axis < 3; axis++)
+            {
+                const Float t0 = Lanes::Mul(Lanes::Sub(Lanes::Set(boxMin[axis]), m_origin[axis]), m_inverseDirection[axis]);
+                const Float t1 = Lanes::Mul(Lanes::Sub(Lanes::Set(boxMax[axis]), m_origin[axis]), m_inverseDirection[axis]);
+                nearT = Lanes::Max(nearT, Lanes::Min(t0, t1));
+                farT = Lanes::Min(farT, Lanes::Max(t0, t1));
+            }
+            hitMask = Lanes::And(Lanes::LessEqual(nearT, farT), Lanes::Less(nearT, m_hitT));
+            t = nearT;
+        }
+
+        static void Cross(const Float a[3], const Float b[3], Float result[3])
+        {
+            result[0] = Lanes::Sub(Lanes::Mul(a[1], b[2]), Lanes::Mul(a[2], b[1]));
+            result[1] = Lanes::Sub(Lanes::Mul(a[2], b[0]), Lanes::Mul(a[0], b[2]));
+            result[2] = Lanes::Sub(Lanes::Mul(a[0], b[1]), Lanes::Mul(a[1], b[0]));
+        }
+
+        static Float Dot(const Float a[3], const Float b[3])
+        {
+            return Lanes::Add(Lanes::Add(Lanes::Mul(a[0], b[0]), Lanes::Mul(a[1], b[1])), Lanes::Mul(a[2], b[2]));
+        }
+
+        const AABBNode *m_pNodes;
+        const Primitive *m_pPrimitives;
+        const PrimitiveMetaData *m_pMetaData;
+        UINT m_numPrimitives;
+        std::vector<TraversalStackEntry> &m_stack;
+
+        Float m_origin[3];
+        Float m_direction[3];
+        Float m_inverseDirection[3];
+        Float m_absInverseDirection[3];
+        Float m_tMin;
+        Float m_hitT;
+        Float m_hitU;
+        Float m_hitV;
+        UINT m_hitPrimitive[Width];
+    };
+
+    template <typename Lanes>
+    static
+        void TraceRayPackets(
+            const BYTE *pData,
+            const CpuRay *pRays,
+            UINT numRays,
+            bool bAcceptFirstHit,
+            CpuRayHit *pHits)
+    {
+        const UINT width = Lanes::Width;
+        if (numRays == 0)
+        {
+            return;
+        }
+
+        const UINT numPackets = DivideAndRoundUp(numRays, width);
+        ParallelFor(numPackets, TraversalGrainSize, [&](UINT begin, UINT end)
+        {
+            std::vector<TraversalStackEntry> stack;
+            stack.reserve(64);
+            RayPacketTraversal<Lanes> traversal(pData, stack);
+            for (UINT packet = begin; packet < end; packet++)
+            {
+                const UINT firstRay = packet * width;
+                const UINT packetSize = std::min(numRays - firstRay, width);
+                traversal.Trace(pRays + firstRay, packetSize, bAcceptFirstHit, pHits + firstRay);
+            }
+        });
+    }
+}
+
+void TraceRaysOnCpu(
+    _In_  const void *pAccelerationStructure,
+    _In_reads_(numRays) const CpuRay *pRays,
+    UINT numRays,
+    bool bAcceptFirstHit,
+    _Out_writes_(numRays) CpuRayHit *pHits,
+    UINT packetWidth)
+{
+    using namespace FallbackLayer;
+    static const bool bAvxSupported = IsAvxSupported();
+
+    if (packetWidth == 0)
+    {
+        packetWidth = bAvxSupported ? AvxLanes::Width : SseLanes::Width;
+    }
+
+    const BYTE *pData = (const BYTE *)pAccelerationStructure;
+    if (packetWidth == AvxLanes::Width)
+    {
+        if (!bAvxSupported)
+        {
+            ThrowFailure(E_INVALIDARG, L"8-wide ray packets require a CPU with AVX support");
+        }
+        TraceRayPackets<AvxLanes>(pData, pRays, numRays, bAcceptFirstHit, pHits);
+    }
+    else if (packetWidth == SseLanes::Width)
+    {
+        TraceRayPackets<SseLanes>(pData, pRays, numRays, bAcceptFirstHit, pHits);
+    }
+    else
+    {
+        ThrowFailure(E_INVALIDARG, L"Ray packets must be 4 or 8 rays wide");
+    }
+}
@@ -0,0 +1,46 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+#pragma once
+
+//
+// Included in place of pch.h by the CPU builder sources that don't touch a device: they
+// only need the D3D12 build descs, the BVH layout shared with the shaders and the worker
+// threads. Without the Windows SDK, CpuBuilderShim.h from Tools/CpuLbvhCheck supplies
+// the D3D12 types so these sources can be built and checked on any platform.
+//
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <DirectXMath.h>
+#include <comdef.h>
+#include <atlbase.h>
+#include "d3d12_1.h"
+#include "d3dx12.h"
+#include "Util.h"
+#include "D3D12RaytracingFallback.h"
+#else
+#include "CpuBuilderShim.h"
+#include "GeometryDescUtil.h"
+#endif
+
+#include "RayTracingHlslCompat.h"
+#include "RaytracingCompatibilityDebug.h"
+#include "CpuTaskPool.h"
+#include "CpuBVH2Builder.h"
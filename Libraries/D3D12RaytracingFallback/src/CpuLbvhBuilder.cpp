@@ -0,0 +1,977 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+#include "CpuBuilderPlatform.h"
+#include "TreeletReorderBindings.h"
+
+//
+// CPU port of the bottom-level GpuBvh2Builder pipeline: scene AABB, Morton codes,
+// sort, rearrange, Karras hierarchy emission, treelet reordering and AABB
+// construction. Each stage repeats the shader arithmetic so the AABBNode output can
+// be compared node for node against a GPU build.
+//
+namespace FallbackLayer
+{
+    static const UINT LbvhGrainSize = 1024;
+
+    // Constants shared with RayTracingHelper.hlsli and TreeletReorder.hlsl
+    static const float AABBMinPadding = 0.001f;
+    static const UINT LeafFlag = 0x80000000;
+    static const UINT ProceduralGeometryFlag = 0x40000000;
+    static const float CostOfRayBoxIntersection = 1.2f;
+    static const float CostOfRayTriangleIntersection = 1.0f;
+    static const UINT NumInternalTreeletNodes = FullTreeletSize - 1;
+    static const UINT NumTreeletSplitPermutations = 1 << FullTreeletSize;
+    static const UINT FullPartitionMask = NumTreeletSplitPermutations - 1;
+    static const UINT CollapseChildrenBit = 1 << FullTreeletSize;
+    static const UINT RootNodeIndex = 0;
+
+    struct BoundingBox
+    {
+        float3 center;
+        float3 halfDim;
+    };
+
+    static
+        BoundingBox AABBtoBoundingBox(
+            const AABB &aabb)
+    {
+        BoundingBox box;
+        box.center = (aabb.min + aabb.max) * 0.5f;
+        box.halfDim = aabb.max - box.center;
+        return box;
+    }
+
+    static
+        AABB BoundingBoxToAABB(
+            const BoundingBox &box)
+    {
+        AABB aabb;
+        aabb.min = box.center - box.halfDim;
+        aabb.max = box.center + box.halfDim;
+        return aabb;
+    }
+
+    static
+        AABB CombineAABB(
+            const AABB &aabb0,
+            const AABB &aabb1)
+    {
+        AABB aabb;
+        aabb.min = min(aabb0.min, aabb1.min);
+        aabb.max = max(aabb0.max, aabb1.max);
+        return aabb;
+    }
+
+    static
+        float ComputeBoxSurfaceArea(
+            const AABB &aabb)
+    {
+        const float3 dim = aabb.max - aabb.min;
+        return 2.0f * (dim.x * dim.y + dim.x * dim.z + dim.y * dim.z);
+    }
+
+    // GetBoxDataFromTriangle for triangles, AABBtoBoundingBox for procedural geometry
+    static
+        BoundingBox GetLeafBoundingBox(
+            const Primitive &primitive)
+    {
+        if (primitive.PrimitiveType == TRIANGLE_TYPE)
+        {
+            const Triangle &tri = primitive.triangle;
+            AABB aabb;
+            aabb.min = min(min(tri.v0, tri.v1), tri.v2);
+            aabb.max = max(max(tri.v0, tri.v1), tri.v2);
+            aabb.min = min(aabb.min, aabb.max - float3{ AABBMinPadding, AABBMinPadding, AABBMinPadding });
+            return AABBtoBoundingBox(aabb);
+        }
+        return AABBtoBoundingBox(primitive.aabb);
+    }
+
+    static
+        float3 GetCentroid(
+            const Primitive &primitive)
+    {
+        if (primitive.PrimitiveType == TRIANGLE_TYPE)
+        {
+            const Triangle &tri = primitive.triangle;
+            return (tri.v0 + tri.v1 + tri.v2) / 3.0f;
+        }
+        return (primitive.aabb.min + primitive.aabb.max) / 2.0f;
+    }
+
+    static
+        int CountLeadingZeroes(UINT32 value)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        return _BitScanReverse(&index, value) ? 31 - (int)index : 32;
+#else
+        return value ? __builtin_clz(value) : 32;
+#endif
+    }
+
+    static
+        int CountLeadingZeroes(UINT64 value)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        return _BitScanReverse64(&index, value) ? 63 - (int)index : 64;
+#else
+        return value ? __builtin_clzll(value) : 64;
+#endif
+    }
+
+    static
+        UINT CountBits(UINT value)
+    {
+        UINT count = 0;
+        for (; value; value &= value - 1)
+        {
+            count++;
+        }
+        return count;
+    }
+
+    static
+        UINT FirstBitLow(UINT value)
+    {
+        UINT index = 0;
+        while (!(value & (1 << index)))
+        {
+            index++;
+        }
+        return index;
+    }
+
+    //
+    // 30-bit codes are what the GPU builder uses. 63-bit codes keep 21 bits per axis,
+    // which stops large or clustered scenes from collapsing onto equal codes, at the
+    // cost of no longer matching the GPU output.
+    //
+    template <typename MortonCodeType>
+    struct MortonCodeTraits;
+
+    template <>
+    struct MortonCodeTraits<UINT32>
+    {
+        static const UINT BitsPerAxis = 10;
+    };
+
+    template <>
+    struct MortonCodeTraits<UINT64>
+    {
+        static const UINT BitsPerAxis = 21;
+    };
+
+    template <typename MortonCodeType>
+    static
+        MortonCodeType CalculateMortonCode(
+            const float3 &centroid,
+            const AABB &sceneAABB)
+    {
+        const UINT numBits = MortonCodeTraits<MortonCodeType>::BitsPerAxis;
+        const float epsilon = 0.00001f;
+        const float3 sceneDimension = max(sceneAABB.max - sceneAABB.min, float3{ epsilon, epsilon, epsilon });
+        const float3 unitCoord = (centroid - sceneAABB.min) / sceneDimension;
+
+        // Same axis order as the shader
+        const float maxCoord = (float)(1u << numBits);
+        const float unitCoords[] = { unitCoord.y, unitCoord.x, unitCoord.z };
+        UINT coords[3];
+        for (UINT axis = 0; axis < 3; axis++)
+        {
+            coords[axis] = (UINT)std::min(maxCoord - 1, std::max(0.0f, unitCoords[axis] * maxCoord));
+        }
+
+        MortonCodeType mortonCode = 0;
+        for (UINT bitIndex = 0; bitIndex < numBits; bitIndex++)
+        {
+            for (UINT axis = 0; axis < 3; axis++)
+            {
+                if (coords[axis] & (1u << bitIndex))
+                {
+                    mortonCode |= (MortonCodeType)1 << (bitIndex * 3 + axis);
+                }
+            }
+        }
+        return mortonCode;
+    }
+
+    //
+    // Stable LSD radix sort of (key, index) pairs. Sorting keys whose indices start out
+    // ascending gives the same order as the GPU bitonic sort, which breaks ties by index.
+    //
+    template <typename KeyType>
+    static
+        void RadixSort(
+            UINT numElements,
+            UINT keyBits,
+            std::vector<KeyType> &keys,
+            std::vector<UINT> &indices)
+    {
+        static const UINT RadixBits = 8;
+        static const UINT NumBuckets = 1 << RadixBits;
+
+        const UINT numChunks = DivideAndRoundUp(numElements, LbvhGrainSize);
+        std::vector<UINT> chunkOffsets(numChunks * NumBuckets);
+        std::vector<KeyType> sortedKeys(numElements);
+        std::vector<UINT> sortedIndices(numElements);
+
+        for (UINT shift = 0; shift < keyBits; shift += RadixBits)
+        {
+            ParallelFor(numChunks, 1, [&](UINT firstChunk, UINT lastChunk)
+            {
+                for (UINT chunk = firstChunk; chunk < lastChunk; chunk++)
+                {
+                    UINT *pHistogram = &chunkOffsets[chunk * NumBuckets];
+                    std::fill(pHistogram, pHistogram + NumBuckets, 0);
+
+                    const UINT end = std::min((chunk + 1) * LbvhGrainSize, numElements);
+                    for (UINT i = chunk * LbvhGrainSize; i < end; i++)
+                    {
+                        pHistogram[(keys[i] >> shift) & (NumBuckets - 1)]++;
+                    }
+                }
+            });
+
+            // Bucket-major, chunk-minor offsets keep equal digits in their current order
+            UINT offset = 0;
+            bool bAllInOneBucket = false;
+            for (UINT bucket = 0; bucket < NumBuckets; bucket++)
+            {
+                const UINT bucketStart = offset;
+                for (UINT chunk = 0; chunk < numChunks; chunk++)
+                {
+                    const UINT count = chunkOffsets[chunk * NumBuckets + bucket];
+                    chunkOffsets[chunk * NumBuckets + bucket] = offset;
+                    offset += count;
+                }
+                bAllInOneBucket |= (offset - bucketStart == numElements);
+            }
+            if (bAllInOneBucket)
+            {
+                continue;
+            }
+
+            ParallelFor(numChunks, 1, [&](UINT firstChunk, UINT lastChunk)
+            {
+                for (UINT chunk = firstChunk; chunk < lastChunk; chunk++)
+                {
+                    UINT *pOffsets = &chunkOffsets[chunk * NumBuckets];
+
+                    const UINT end = std::min((chunk + 1) * LbvhGrainSize, numElements);
+                    for (UINT i = chunk * LbvhGrainSize; i < end; i++)
+                    {
+                        const UINT destination = pOffsets[(keys[i] >> shift) & (NumBuckets - 1)]++;
+                        sortedKeys[destination] = keys[i];
+                        sortedIndices[destination] = indices[i];
+                    }
+                }
+            });
+
+            keys.swap(sortedKeys);
+            indices.swap(sortedIndices);
+        }
+    }
+
+    //
+    // Karras 2012, "Maximizing Parallelism in the Construction of BVHs, Octrees, and
+    // k-d Trees", following BuildBVHSplits.hlsli: internal nodes are [0, N - 1) and
+    // leaf i is node N - 1 + i
+    //
+    template <typename MortonCodeType>
+    class KarrasHierarchyBuilder
+    {
+    public:
+        KarrasHierarchyBuilder(const MortonCodeType *pMortonCodes, UINT numElements, HierarchyNode *pHierarchy) :
+            m_pMortonCodes(pMortonCodes),
+            m_numElements(numElements),
+            m_pHierarchy(pHierarchy)
+        {}
+
+        void GenerateHierarchy(UINT index)
+        {
+            UINT first, last;
+            DetermineRange(index, first, last);
+            const UINT split = FindSplit(first, last);
+
+            const UINT leafNodeOffset = m_numElements - 1;
+            const UINT childAIndex = (split == first) ? leafNodeOffset + split : split;
+            const UINT childBIndex = (split + 1 == last) ? leafNodeOffset + split + 1 : split + 1;
+
+            m_pHierarchy[index].LeftChildIndex = childAIndex;
+            m_pHierarchy[index].RightChildIndex = childBIndex;
+            m_pHierarchy[childAIndex].ParentIndex = index;
+            m_pHierarchy[childBIndex].ParentIndex = index;
+        }
+
+    private:
+        // Indices outside [0, N) come from unsigned wrap-around, the same as in the shader
+        int GetLongestCommonPrefix(UINT indexA, UINT indexB) const
+        {
+            if (indexA >= m_numElements || indexB >= m_numElements)
+            {
+                return -1;
+            }
+
+            const MortonCodeType mortonCodeA = m_pMortonCodes[indexA];
+            const MortonCodeType mortonCodeB = m_pMortonCodes[indexB];
+            if (mortonCodeA != mortonCodeB)
+            {
+                return CountLeadingZeroes(mortonCodeA ^ mortonCodeB);
+            }
+            return CountLeadingZeroes(indexA ^ indexB) + (int)(sizeof(MortonCodeType) * 8 - 1);
+        }
+
+        void DetermineRange(UINT index, UINT &first, UINT &last) const
+        {
+            int d = GetLongestCommonPrefix(index, index + 1) - GetLongestCommonPrefix(index, index - 1);
+            d = std::min(std::max(d, -1), 1);
+            const int minPrefix = GetLongestCommonPrefix(index, index - d);
+
+            int maxLength = 2;
+            while (GetLongestCommonPrefix(index, index + maxLength * d) > minPrefix)
+            {
+                maxLength *= 4;
+            }
+
+            int length = 0;
+            for (int t = maxLength / 2; t > 0; t /= 2)
+            {
+                if (GetLongestCommonPrefix(index, index + (length + t) * d) > minPrefix)
+                {
+                    length = length + t;
+                }
+            }
+
+            const UINT j = index + length * d;
+            first = std::min(index, j);
+            last = std::max(index, j);
+        }
+
+        UINT FindSplit(UINT first, UINT last) const
+        {
+            const int commonPrefix = GetLongestCommonPrefix(first, last);
+            UINT split = first;
+            UINT step = last - first;
+
+            do
+            {
+                step = (step + 1) >> 1;
+                const UINT newSplit = split + step;
+
+                if (newSplit < last && GetLongestCommonPrefix(first, newSplit) > commonPrefix)
+                {
+                    split = newSplit;
+                }
+            } while (step > 1);
+
+            return split;
+        }
+
+        const MortonCodeType *m_pMortonCodes;
+        const UINT m_numElements;
+        HierarchyNode *m_pHierarchy;
+    };
+
+    static
+        void SetParentIndex(
+            HierarchyNode &node,
+            UINT parentIndex,
+            bool bCollapseChildren)
+    {
+        node.ParentIndex = parentIndex;
+        node.bCollapseChildren = bCollapseChildren;
+    }
+
+    //
+    // Karras/Aila 2013, "Fast Parallel Construction of High-Quality Bounding Volume
+    // Hierarchies", following FindTreelets.hlsl and TreeletReorder.hlsl. Each worker
+    // runs what a single thread group does on the GPU.
+    //
+    class TreeletOptimizer
+    {
+    public:
+        TreeletOptimizer(const Primitive *pPrimitives, UINT numElements, HierarchyNode *pHierarchy, AABB *pAABBs) :
+            m_pPrimitives(pPrimitives),
+            m_numElements(numElements),
+            m_numInternalNodes(numElements - 1),
+            m_pHierarchy(pHierarchy),
+            m_pAABBs(pAABBs),
+            m_numTriangles(numElements - 1),
+            m_baseTreelets(numElements / FullTreeletSize)
+        {}
+
+        void Optimize(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS buildFlags)
+        {
+            UINT numOptimizationPasses = 1;
+            if (buildFlags & D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_BUILD)
+            {
+                numOptimizationPasses = 0;
+            }
+            else if (buildFlags & D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE)
+            {
+                numOptimizationPasses = 3;
+            }
+
+            UINT minTrianglesPerTreelet = FullTreeletSize;
+            for (UINT i = 0; i < numOptimizationPasses && minTrianglesPerTreelet <= m_numElements; i++)
+            {
+                for (auto &count : m_numTriangles)
+                {
+                    count.store(0, std::memory_order_relaxed);
+                }
+                m_numBaseTreelets.store(0, std::memory_order_relaxed);
+
+                ParallelFor(m_numElements, LbvhGrainSize, [&](UINT begin, UINT end)
+                {
+                    for (UINT leafIndex = begin; leafIndex < end; leafIndex++)
+                    {
+                        FindTreelets(leafIndex, minTrianglesPerTreelet);
+                    }
+                });
+
+                ParallelFor(m_numBaseTreelets.load(), 1, [&](UINT begin, UINT end)
+                {
+                    for (UINT i = begin; i < end; i++)
+                    {
+                        ReorderTreelets(m_baseTreelets[i]);
+                    }
+                });
+
+                minTrianglesPerTreelet *= 2;
+            }
+        }
+
+    private:
+        struct Treelet
+        {
+            UINT rootIndex;
+            UINT treeletToReorder[FullTreeletSize];
+            UINT internalNodes[NumInternalTreeletNodes];
+            float optimalCost[NumTreeletSplitPermutations];
+            UINT optimalPartition[NumTreeletSplitPermutations];
+        };
+
+        bool IsLeafIndex(UINT nodeIndex) const { return nodeIndex >= m_numInternalNodes; }
+
+        // Bottom-up pass that fits the working AABBs and collects the lowest nodes
+        // covering at least minTrianglesPerTreelet primitives
+        void FindTreelets(UINT leafIndex, UINT minTrianglesPerTreelet)
+        {
+            UINT nodeIndex = m_numInternalNodes + leafIndex;
+            UINT numTriangles = 1;
+            while (true)
+            {
+                if (IsLeafIndex(nodeIndex))
+                {
+                    m_pAABBs[nodeIndex] = BoundingBoxToAABB(GetLeafBoundingBox(m_pPrimitives[leafIndex]));
+                }
+                else
+                {
+                    const HierarchyNode &node = m_pHierarchy[nodeIndex];
+                    m_pAABBs[nodeIndex] = CombineAABB(m_pAABBs[node.LeftChildIndex], m_pAABBs[node.RightChildIndex]);
+                }
+
+                if (numTriangles >= minTrianglesPerTreelet)
+                {
+                    m_baseTreelets[m_numBaseTreelets.fetch_add(1, std::memory_order_relaxed)] = nodeIndex;
+                    return;
+                }
+
+                // The shader reads the raw ParentIndex here, which only matters on passes
+                // after the first once collapse flags are set. The flag is always dropped here.
+                const UINT parentIndex = m_pHierarchy[nodeIndex].ParentIndex;
+                const UINT numTrianglesFromOtherNode = m_numTriangles[parentIndex].fetch_add(numTriangles, std::memory_order_acq_rel);
+                if (numTrianglesFromOtherNode == 0)
+                {
+                    return;
+                }
+
+                nodeIndex = parentIndex;
+                numTriangles += numTrianglesFromOtherNode;
+            }
+        }
+
+        void ReorderTreelets(UINT nodeIndex)
+        {
+            Treelet treelet;
+            treelet.rootIndex = nodeIndex;
+            while (true)
+            {
+                FormTreelet(treelet);
+                FindOptimalPartitions(treelet);
+                ReformTree(treelet);
+
+                // Move up once the sibling subtree is done too
+                if (treelet.rootIndex == RootNodeIndex)
+                {
+                    return;
+                }
+
+                const UINT parentIndex = m_pHierarchy[treelet.rootIndex].ParentIndex;
+                const UINT ourNumTriangles = m_numTriangles[treelet.rootIndex].load(std::memory_order_relaxed);
+                const UINT numTrianglesFromOtherNode = m_numTriangles[parentIndex].fetch_add(ourNumTriangles, std::memory_order_acq_rel);
+                if (numTrianglesFromOtherNode == 0)
+                {
+                    return;
+                }
+
+                const HierarchyNode &parent = m_pHierarchy[parentIndex];
+                m_pAABBs[parentIndex] = CombineAABB(m_pAABBs[parent.LeftChildIndex], m_pAABBs[parent.RightChildIndex]);
+                treelet.rootIndex = parentIndex;
+            }
+        }
+
+        // Grows the treelet by repeatedly opening the internal node with the largest area
+        void FormTreelet(Treelet &treelet) const
+        {
+            const HierarchyNode &root = m_pHierarchy[treelet.rootIndex];
+            treelet.internalNodes[0] = treelet.rootIndex;
+            treelet.treeletToReorder[0] = root.LeftChildIndex;
+            treelet.treeletToReorder[1] = root.RightChildIndex;
+
+            for (UINT treeletSize = 2; treeletSize < FullTreeletSize; treeletSize++)
+            {
+                float largestSurfaceArea = 0.0f;
+                UINT indexOfNodeIndexToTraverse = UINT_MAX;
+                for (UINT i = 0; i < treeletSize; i++)
+                {
+                    const UINT treeletNodeIndex = treelet.treeletToReorder[i];
+                    if (IsLeafIndex(treeletNodeIndex))
+                    {
+                        continue;
+                    }
+
+                    // The shader falls back to node 0 when every candidate has zero area,
+                    // which would splice the root into this treelet. Take the first
+                    // internal candidate instead.
+                    const float surfaceArea = ComputeBoxSurfaceArea(m_pAABBs[treeletNodeIndex]);
+                    if (surfaceArea > largestSurfaceArea || indexOfNodeIndexToTraverse == UINT_MAX)
+                    {
+                        largestSurfaceArea = std::max(surfaceArea, largestSurfaceArea);
+                        indexOfNodeIndexToTraverse = i;
+                    }
+                }
+
+                const UINT nodeIndexToTraverse = treelet.treeletToReorder[indexOfNodeIndexToTraverse];
+                const HierarchyNode &nodeToTraverse = m_pHierarchy[nodeIndexToTraverse];
+                treelet.internalNodes[treeletSize - 1] = nodeIndexToTraverse;
+                treelet.treeletToReorder[indexOfNodeIndexToTraverse] = nodeToTraverse.LeftChildIndex;
+                treelet.treeletToReorder[treeletSize] = nodeToTraverse.RightChildIndex;
+            }
+        }
+
+        void FindOptimalPartitions(Treelet &treelet) const
+        {
+            for (UINT treeletBitmask = 1; treeletBitmask < NumTreeletSplitPermutations; treeletBitmask++)
+            {
+                AABB aabb;
+                aabb.min = { FLT_MAX, FLT_MAX, FLT_MAX };
+                aabb.max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+                for (UINT i = 0; i < FullTreeletSize; i++)
+                {
+                    if (treeletBitmask & (1 << i))
+                    {
+                        aabb = CombineAABB(aabb, m_pAABBs[treelet.treeletToReorder[i]]);
+                    }
+                }
+                treelet.optimalCost[treeletBitmask] = ComputeBoxSurfaceArea(aabb);
+            }
+
+            const float rootAABBSurfaceArea = ComputeBoxSurfaceArea(m_pAABBs[treelet.rootIndex]);
+            for (UINT i = 0; i < FullTreeletSize; i++)
+            {
+                treelet.optimalCost[1 << i] = CostOfRayBoxIntersection * ComputeBoxSurfaceArea(m_pAABBs[treelet.treeletToReorder[i]]) / rootAABBSurfaceArea;
+            }
+
+            // A proper subset of a mask is always numerically smaller than it, so a single
+            // ascending walk sees every subset before the masks built from it. This gives
+            // the same result as the shader's pass per subset size.
+            for (UINT treeletBitmask = 1; treeletBitmask < NumTreeletSplitPermutations; treeletBitmask++)
+            {
+                const UINT subsetSize = CountBits(treeletBitmask);
+                if (subsetSize < 2)
+                {
+                    continue;
+                }
+
+                float lowestCost = FLT_MAX;
+                UINT bestPartition = 0;
+
+                const UINT delta = (treeletBitmask - 1) & treeletBitmask;
+                UINT partitionBitmask = (0 - delta) & treeletBitmask;
+                do
+                {
+                    const float cost = treelet.optimalCost[partitionBitmask] + treelet.optimalCost[treeletBitmask ^ partitionBitmask];
+                    if (cost < lowestCost)
+                    {
+                        lowestCost = cost;
+                        bestPartition = partitionBitmask;
+                    }
+                    partitionBitmask = (partitionBitmask - delta) & treeletBitmask;
+                } while (partitionBitmask != 0);
+
+                const float costAsLeafNode = CostOfRayTriangleIntersection * treelet.optimalCost[treeletBitmask] * subsetSize;
+                const float costAsInternalNode = CostOfRayBoxIntersection * treelet.optimalCost[treeletBitmask] + lowestCost;
+                treelet.optimalCost[treeletBitmask] = std::min(costAsInternalNode, costAsLeafNode);
+                treelet.optimalPartition[treeletBitmask] = bestPartition;
+                if (costAsLeafNode < costAsInternalNode)
+                {
+                    treelet.optimalPartition[treeletBitmask] |= CollapseChildrenBit;
+                }
+            }
+        }
+
+        void ReformTree(const Treelet &treelet)
+        {
+            struct PartitionEntry
+            {
+                UINT Mask;
+                UINT NodeIndex;
+            };
+            UINT nodesAllocated = 1;
+            UINT partitionStackSize = 1;
+            PartitionEntry partitionStack[FullTreeletSize];
+            partitionStack[0].Mask = FullPartitionMask;
+            partitionStack[0].NodeIndex = treelet.internalNodes[0];
+
+            while (partitionStackSize > 0)
+            {
+                const PartitionEntry partition = partitionStack[--partitionStackSize];
+
+                PartitionEntry leftEntry;
+                leftEntry.Mask = treelet.optimalPartition[partition.Mask];
+                const bool bCollapseChildren = (leftEntry.Mask & CollapseChildrenBit) != 0;
+                leftEntry.Mask &= FullPartitionMask;
+                if (CountBits(leftEntry.Mask) > 1)
+                {
+                    leftEntry.NodeIndex = treelet.internalNodes[nodesAllocated++];
+                    partitionStack[partitionStackSize++] = leftEntry;
+                }
+                else
+                {
+                    leftEntry.NodeIndex = treelet.treeletToReorder[FirstBitLow(leftEntry.Mask)];
+                }
+
+                PartitionEntry rightEntry;
+                rightEntry.Mask = partition.Mask ^ leftEntry.Mask;
+                if (CountBits(rightEntry.Mask) > 1)
+                {
+                    rightEntry.NodeIndex = treelet.internalNodes[nodesAllocated++];
+                    partitionStack[partitionStackSize++] = rightEntry;
+                }
+                else
+                {
+                    rightEntry.NodeIndex = treelet.treeletToReorder[FirstBitLow(rightEntry.Mask)];
+                }
+
+                m_pHierarchy[partition.NodeIndex].LeftChildIndex = leftEntry.NodeIndex;
+                m_pHierarchy[partition.NodeIndex].RightChildIndex = rightEntry.NodeIndex;
+                SetParentIndex(m_pHierarchy[leftEntry.NodeIndex], partition.NodeIndex, bCollapseChildren);
+                SetParentIndex(m_pHierarchy[rightEntry.NodeIndex], partition.NodeIndex, bCollapseChildren);
+            }
+
+            // The partitions were handed out top-down, so walking back is bottom-up
+            for (int j = NumInternalTreeletNodes - 1; j >= 0; j--)
+            {
+                const UINT internalNodeIndex = treelet.internalNodes[j];
+                const HierarchyNode &node = m_pHierarchy[internalNodeIndex];
+                m_pAABBs[internalNodeIndex] = CombineAABB(m_pAABBs[node.LeftChildIndex], m_pAABBs[node.RightChildIndex]);
+            }
+        }
+
+        const Primitive *m_pPrimitives;
+        const UINT m_numElements;
+        const UINT m_numInternalNodes;
+        HierarchyNode *m_pHierarchy;
+        AABB *m_pAABBs;
+
+        std::vector<std::atomic<UINT>> m_numTriangles;
+        std::vector<UINT> m_baseTreelets;
+        std::atomic<UINT> m_numBaseTreelets;
+    };
+
+    static
+        void WriteNode(
+            AABBNode &node,
+            const BoundingBox &box,
+            UINT flagX,
+            UINT flagY)
+    {
+        node.center[0] = box.center.x;
+        node.center[1] = box.center.y;
+        node.center[2] = box.center.z;
+        node.nodeAllBits = flagX;
+        node.halfDim[0] = box.halfDim.x;
+        node.halfDim[1] = box.halfDim.y;
+        node.halfDim[2] = box.halfDim.z;
+        node.rightNodeIndex = flagY;
+    }
+
+    static
+        BoundingBox ReadNodeBox(
+            const AABBNode &node)
+    {
+        return { { node.center[0], node.center[1], node.center[2] }, { node.halfDim[0], node.halfDim[1], node.halfDim[2] } };
+    }
+
+    //
+    // Bottom-up fit of the output nodes as in ComputeAABBs.hlsli. The shader puts the
+    // child with fewer primitives on the left, but when both sides hold the same number
+    // the result depends on which child finished last. Ties keep the hierarchy order here.
+    //
+    static
+        void ConstructAABBs(
+            const Primitive *pPrimitives,
+            UINT numElements,
+            const HierarchyNode *pHierarchy,
+            AABBNode *pNodes,
+            UINT *pAABBParents)
+    {
+        const UINT numInternalNodes = numElements - 1;
+        std::vector<std::atomic<UINT>> childNodesProcessedCounter(numInternalNodes);
+
+        ParallelFor(numElements, LbvhGrainSize, [&](UINT begin, UINT end)
+        {
+            for (UINT leafIndex = begin; leafIndex < end; leafIndex++)
+            {
+                UINT nodeIndex = numInternalNodes + leafIndex;
+                UINT numTriangles = 1;
+                bool swapChildIndices = false;
+                while (true)
+                {
+                    if (nodeIndex >= numInternalNodes)
+                    {
+                        const Primitive &primitive = pPrimitives[leafIndex];
+                        UINT flagX = leafIndex | LeafFlag;
+                        if (primitive.PrimitiveType == PROCEDURAL_PRIMITIVE_TYPE)
+                        {
+                            flagX |= ProceduralGeometryFlag;
+                        }
+                        WriteNode(pNodes[nodeIndex], GetLeafBoundingBox(primitive), flagX, 1);
+                    }
+                    else
+                    {
+                        UINT leftNodeIndex = pHierarchy[nodeIndex].LeftChildIndex;
+                        UINT rightNodeIndex = pHierarchy[nodeIndex].RightChildIndex;
+                        if (swapChildIndices)
+                        {
+                            std::swap(leftNodeIndex, rightNodeIndex);
+                        }
+
+                        const AABB leftAABB = BoundingBoxToAABB(ReadNodeBox(pNodes[leftNodeIndex]));
+                        const AABB rightAABB = BoundingBoxToAABB(ReadNodeBox(pNodes[rightNodeIndex]));
+                        WriteNode(pNodes[nodeIndex], AABBtoBoundingBox(CombineAABB(leftAABB, rightAABB)), leftNodeIndex & 0x00ffffff, rightNodeIndex);
+                    }
+
+                    if (nodeIndex == RootNodeIndex)
+                    {
+                        break;
+                    }
+
+                    const UINT parentNodeIndex = pHierarchy[nodeIndex].ParentIndex;
+                    const UINT trianglesFromOtherChild = childNodesProcessedCounter[parentNodeIndex].fetch_add(numTriangles, std::memory_order_acq_rel);
+                    if (trianglesFromOtherChild == 0)
+                    {
+                        break;
+                    }
+
+                    const bool isLeft = pHierarchy[parentNodeIndex].LeftChildIndex == nodeIndex;
+                    const UINT leftNumTriangles = isLeft ? numTriangles : trianglesFromOtherChild;
+                    const UINT rightNumTriangles = isLeft ? trianglesFromOtherChild : numTriangles;
+                    swapChildIndices = leftNumTriangles > rightNumTriangles;
+                    nodeIndex = parentNodeIndex;
+                    numTriangles += trianglesFromOtherChild;
+
+                    if (pAABBParents)
+                    {
+                        pAABBParents[pHierarchy[nodeIndex].LeftChildIndex] = nodeIndex;
+                        pAABBParents[pHierarchy[nodeIndex].RightChildIndex] = nodeIndex;
+                    }
+                }
+            }
+        });
+    }
+
+    template <typename MortonCodeType>
+    static
+        void BuildLbvh(
+            const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS &inputs,
+            BYTE *pOutputData)
+    {
+        const UINT numElements = GetTotalPrimitiveCount(inputs);
+        const UINT numNodes = numElements ? 2 * numElements - 1 : 1;
+
+        // Same layout as the GPU builder, with the sort cache and parent indices that a
+        // later GPU update relies on appended when updates are allowed
+        BVHOffsets &offsets = *(BVHOffsets *)pOutputData;
+        offsets.offsetToBoxes = sizeof(BVHOffsets);
+        offsets.offsetToVertices = offsets.offsetToBoxes + numNodes * sizeof(AABBNode);
+        offsets.offsetToPrimitiveMetaData = offsets.offsetToVertices + numElements * sizeof(Primitive);
+        offsets.totalSize = offsets.offsetToPrimitiveMetaData + numElements * sizeof(PrimitiveMetaData);
+
+        AABBNode *pNodes = (AABBNode *)(pOutputData + offsets.offsetToBoxes);
+        Primitive *pOutputPrimitives = (Primitive *)(pOutputData + offsets.offsetToVertices);
+        PrimitiveMetaData *pOutputMetadata = (PrimitiveMetaData *)(pOutputData + offsets.offsetToPrimitiveMetaData);
+
+        const bool updatesAllowed = (inputs.Flags & D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE) != 0;
+        UINT *pSortCache = updatesAllowed ? (UINT *)(pOutputData + offsets.totalSize) : nullptr;
+        UINT *pAABBParents = updatesAllowed ? pSortCache + numElements : nullptr;
+
+        if (numElements == 0)
+        {
+            ZeroMemory(pNodes, sizeof(AABBNode));
+            return;
+        }
+
+        //
+        // Load primitives in input order. The working AABBs used by treelet reordering
+        // double as scratch for the loader's bounding boxes.
+        //
+        std::vector<Primitive> primitives(numElements);
+        std::vector<PrimitiveMetaData> metadata(numElements);
+        std::vector<AABB> aabbs(numNodes);
+
+        UINT primitiveOffset = 0;
+        for (UINT i = 0; i < inputs.NumDescs; i++)
+        {
+            const D3D12_RAYTRACING_GEOMETRY_DESC &geometry = GetGeometryDesc(inputs, i);
+            const UINT numPrimitives = GetPrimitiveCountFromGeometryDesc(geometry);
+
+            ParallelFor(numPrimitives, LbvhGrainSize, [&](UINT begin, UINT end)
+            {
+                LoadPrimitives(geometry, begin, end - begin, &primitives[primitiveOffset + begin], &aabbs[primitiveOffset + begin]);
+                for (UINT j = begin; j < end; j++)
+                {
+                    PrimitiveMetaData &primitiveMetadata = metadata[primitiveOffset + j];
+                    primitiveMetadata.GeometryContributionToHitGroupIndex = i;
+                    primitiveMetadata.PrimitiveIndex = j;
+                    primitiveMetadata.GeometryFlags = geometry.Flags;
+                }
+            });
+
+            primitiveOffset += numPrimitives;
+        }
+
+        //
+        // Scene AABB over vertices or procedural boxes
+        //
+        const UINT numChunks = DivideAndRoundUp(numElements, LbvhGrainSize);
+        std::vector<AABB> chunkAABBs(numChunks);
+        ParallelFor(numChunks, 1, [&](UINT firstChunk, UINT lastChunk)
+        {
+            for (UINT chunk = firstChunk; chunk < lastChunk; chunk++)
+            {
+                AABB sceneAABB;
+                sceneAABB.min = { FLT_MAX, FLT_MAX, FLT_MAX };
+                sceneAABB.max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+                const UINT end = std::min((chunk + 1) * LbvhGrainSize, numElements);
+                for (UINT i = chunk * LbvhGrainSize; i < end; i++)
+                {
+                    const Primitive &primitive = primitives[i];
+                    if (primitive.PrimitiveType == TRIANGLE_TYPE)
+                    {
+                        const Triangle &tri = primitive.triangle;
+                        sceneAABB.min = min(min(min(tri.v0, sceneAABB.min), tri.v1), tri.v2);
+                        sceneAABB.max = max(max(max(tri.v0, sceneAABB.max), tri.v1), tri.v2);
+                    }
+                    else
+                    {
+                        sceneAABB = CombineAABB(sceneAABB, primitive.aabb);
+                    }
+                }
+                chunkAABBs[chunk] = sceneAABB;
+            }
+        });
+
+        AABB sceneAABB = chunkAABBs[0];
+        for (UINT chunk = 1; chunk < numChunks; chunk++)
+        {
+            sceneAABB = CombineAABB(sceneAABB, chunkAABBs[chunk]);
+        }
+
+        //
+        // Morton codes, sorted along with the input index of each primitive
+        //
+        std::vector<MortonCodeType> mortonCodes(numElements);
+        std::vector<UINT> sortedIndices(numElements);
+        ParallelFor(numElements, LbvhGrainSize, [&](UINT begin, UINT end)
+        {
+            for (UINT i = begin; i < end; i++)
+            {
+                mortonCodes[i] = CalculateMortonCode<MortonCodeType>(GetCentroid(primitives[i]), sceneAABB);
+                sortedIndices[i] = i;
+            }
+        });
+
+        RadixSort(numElements, MortonCodeTraits<MortonCodeType>::BitsPerAxis * 3, mortonCodes, sortedIndices);
+
+        ParallelFor(numElements, LbvhGrainSize, [&](UINT begin, UINT end)
+        {
+            for (UINT i = begin; i < end; i++)
+            {
+                pOutputPrimitives[i] = primitives[sortedIndices[i]];
+                pOutputMetadata[i] = metadata[sortedIndices[i]];
+                if (pSortCache)
+                {
+                    pSortCache[sortedIndices[i]] = i;
+                }
+            }
+        });
+
+        //
+        // Hierarchy, optionally reordered, then the output boxes
+        //
+        std::vector<HierarchyNode> hierarchy(numNodes);
+        KarrasHierarchyBuilder<MortonCodeType> hierarchyBuilder(mortonCodes.data(), numElements, hierarchy.data());
+        ParallelFor(numElements - 1, LbvhGrainSize, [&](UINT begin, UINT end)
+        {
+            for (UINT i = begin; i < end; i++)
+            {
+                hierarchyBuilder.GenerateHierarchy(i);
+            }
+        });
+
+#if ENABLE_TREELET_REORDERING
+        TreeletOptimizer treeletOptimizer(pOutputPrimitives, numElements, hierarchy.data(), aabbs.data());
+        treeletOptimizer.Optimize(inputs.Flags);
+#endif
+
+        ConstructAABBs(pOutputPrimitives, numElements, hierarchy.data(), pNodes, pAABBParents);
+    }
+}
+
+void BuildRaytracingAccelerationStructureOnCpuLbvh(
+    _In_  const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC *pDesc,
+    _Out_ void *pData,
+    bool bUse63BitMortonCodes)
+{
+    const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS &inputs = pDesc->Inputs;
+    if (inputs.Type != D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL)
+    {
+        ThrowFailure(E_INVALIDARG, L"The CPU LBVH builder only builds bottom-level acceleration structures");
+    }
+    if (inputs.Flags & D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE)
+    {
+        ThrowFailure(E_NOTIMPL, L"The CPU LBVH builder does not support updates");
+    }
+
+    if (bUse63BitMortonCodes)
+    {
+        FallbackLayer::BuildLbvh<UINT64>(inputs, (BYTE *)pData);
+    }
+    else
+    {
+        FallbackLayer::BuildLbvh<UINT32>(inputs, (BYTE *)pData);
+    }
+}
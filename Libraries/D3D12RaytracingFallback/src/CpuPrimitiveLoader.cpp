@@ -0,0 +1,154 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+#include "CpuBuilderPlatform.h"
+
+namespace FallbackLayer
+{
+    static
+        void ComputeTriangleBox(
+            const Triangle& triangle,
+            AABB& box)
+    {
+        for (UINT k = 0; k < 3; ++k)
+        {
+#define AABB_Min_Padding 0.001f
+            const float* v0 = &triangle.v0.x;
+            const float* v1 = &triangle.v1.x;
+            const float* v2 = &triangle.v2.x;
+            box.minArr[k] = std::min(v2[k], std::min(v0[k], v1[k]));
+            box.maxArr[k] = std::max(v2[k], std::max(v0[k], v1[k])) + AABB_Min_Padding;
+
+            if (_isnan(box.minArr[k]) ||
+                _isnan(box.maxArr[k]))
+            {
+                box.minArr[k] = 0;
+                box.maxArr[k] = 0;
+            }
+        }
+    }
+
+    static
+        float3 TransformVertex(
+            const float3& v,
+            _In_reads_(12) const float* transform)
+    {
+        return {
+            v.x * transform[0] + v.y * transform[1] + v.z * transform[2] + transform[3],
+            v.x * transform[4] + v.y * transform[5] + v.z * transform[6] + transform[7],
+            v.x * transform[8] + v.y * transform[9] + v.z * transform[10] + transform[11]
+        };
+    }
+
+    struct NullIndexBufferReader
+    {
+        UINT operator()(UINT index) const { return index; }
+    };
+
+    template <typename IndexType>
+    struct IndexBufferReader
+    {
+        const IndexType* pIndices;
+        UINT operator()(UINT index) const { return pIndices[index]; }
+    };
+
+    //
+    // Reads triangles [firstTriangle, firstTriangle + numTriangles) straight from the
+    // geometry's vertex/index buffers into their primitive and bounding box slots
+    //
+    template <typename IndexReader>
+    static
+        void LoadTriangles(
+            const D3D12_RAYTRACING_GEOMETRY_TRIANGLES_DESC& triangles,
+            const IndexReader& readIndex,
+            UINT firstTriangle,
+            UINT numTriangles,
+            Primitive* pPrimitives,
+            AABB* pBoxes)
+    {
+        const BYTE* pVertexData = (const BYTE*)triangles.VertexBuffer.StartAddress;
+        const UINT64 vertexStride = triangles.VertexBuffer.StrideInBytes;
+        const float* pTransform = (const float*)triangles.Transform3x4;
+
+        for (UINT j = 0; j < numTriangles; ++j)
+        {
+            Primitive& primitive = pPrimitives[j];
+            primitive.PrimitiveType = TRIANGLE_TYPE;
+
+            for (UINT v = 0; v < 3; ++v)
+            {
+                const float* pVertex = (const float*)(pVertexData + readIndex((firstTriangle + j) * 3 + v) * vertexStride);
+                float3 vertex = { pVertex[0], pVertex[1], pVertex[2] };
+                if (pTransform)
+                {
+                    vertex = TransformVertex(vertex, pTransform);
+                }
+                primitive.triangle.v[v] = vertex;
+            }
+
+            ComputeTriangleBox(primitive.triangle, pBoxes[j]);
+        }
+    }
+
+    static
+        void LoadProceduralAABBs(
+            const D3D12_RAYTRACING_GEOMETRY_AABBS_DESC& aabbs,
+            UINT firstAABB,
+            UINT numAABBs,
+            Primitive* pPrimitives,
+            AABB* pBoxes)
+    {
+        const BYTE* pAABBData = (const BYTE*)aabbs.AABBs.StartAddress;
+        const UINT64 stride = aabbs.AABBs.StrideInBytes;
+
+        for (UINT j = 0; j < numAABBs; ++j)
+        {
+            const D3D12_RAYTRACING_AABB& aabb = *(const D3D12_RAYTRACING_AABB*)(pAABBData + (firstAABB + j) * stride);
+
+            AABB& box = pBoxes[j];
+            box.min = { aabb.MinX, aabb.MinY, aabb.MinZ };
+            box.max = { aabb.MaxX, aabb.MaxY, aabb.MaxZ };
+
+            pPrimitives[j].PrimitiveType = PROCEDURAL_PRIMITIVE_TYPE;
+            pPrimitives[j].aabb = box;
+        }
+    }
+
+    void LoadPrimitives(
+        const D3D12_RAYTRACING_GEOMETRY_DESC &geometry,
+        UINT firstPrimitive,
+        UINT numPrimitives,
+        Primitive *pPrimitives,
+        AABB *pBoxes)
+    {
+        if (geometry.Type == D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES)
+        {
+            const D3D12_RAYTRACING_GEOMETRY_TRIANGLES_DESC &triangles = geometry.Triangles;
+            switch (triangles.IndexFormat)
+            {
+            case DXGI_FORMAT_R16_UINT:
+                LoadTriangles(triangles, IndexBufferReader<UINT16>{ (const UINT16*)triangles.IndexBuffer }, firstPrimitive, numPrimitives, pPrimitives, pBoxes);
+                break;
+            case DXGI_FORMAT_R32_UINT:
+                LoadTriangles(triangles, IndexBufferReader<UINT32>{ (const UINT32*)triangles.IndexBuffer }, firstPrimitive, numPrimitives, pPrimitives, pBoxes);
+                break;
+            case DXGI_FORMAT_UNKNOWN:
+                LoadTriangles(triangles, NullIndexBufferReader(), firstPrimitive, numPrimitives, pPrimitives, pBoxes);
+                break;
+            default:
+                ThrowFailure(E_NOTIMPL, L"Unsupported index buffer format provided");
+            }
+        }
+        else
+        {
+            LoadProceduralAABBs(geometry.AABBs, firstPrimitive, numPrimitives, pPrimitives, pBoxes);
+        }
+    }
+}
@@ -0,0 +1,336 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace FallbackLayer
+{
+    //
+    // Process-wide worker threads, created on first use and kept for the lifetime of
+    // the process. Idle workers block until a job is dispatched. Only one job runs at
+    // a time; a dispatch made while another one is running (from a task callback or
+    // from another thread) is refused and the caller runs the job on its own.
+    //
+    class CpuWorkerThreads
+    {
+    public:
+        class Job
+        {
+        public:
+            // Called once on every worker, with the dispatching thread as worker 0
+            virtual void Work(UINT workerIndex) = 0;
+        };
+
+        static CpuWorkerThreads &GetInstance()
+        {
+            // Never destroyed: joining threads from a static destructor can hang on
+            // process exit once the OS has already torn the workers down
+            static CpuWorkerThreads *pInstance = new CpuWorkerThreads();
+            return *pInstance;
+        }
+
+        // Including the dispatching thread
+        UINT GetWorkerCount() const { return m_numThreads + 1; }
+
+        // Returns false without running anything if another job is in flight
+        bool TryDispatch(Job &job)
+        {
+            std::unique_lock<std::mutex> dispatchLock(m_dispatchMutex, std::try_to_lock);
+            if (!dispatchLock.owns_lock())
+            {
+                return false;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_pJob = &job;
+                m_numActive = m_numThreads;
+                m_generation++;
+            }
+            m_wake.notify_all();
+
+            job.Work(0);
+
+            // The job may live on the caller's stack, so every worker has to be out of it
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_done.wait(lock, [this] { return m_numActive == 0; });
+            m_pJob = nullptr;
+            return true;
+        }
+
+    private:
+        CpuWorkerThreads() :
+            m_numThreads(std::max(std::thread::hardware_concurrency(), 1u) - 1),
+            m_pJob(nullptr),
+            m_numActive(0),
+            m_generation(0)
+        {
+            for (UINT i = 0; i < m_numThreads; i++)
+            {
+                std::thread(&CpuWorkerThreads::ThreadLoop, this, i + 1).detach();
+            }
+        }
+
+        void ThreadLoop(UINT workerIndex)
+        {
+            UINT64 lastGeneration = 0;
+            for (;;)
+            {
+                Job *pJob;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_wake.wait(lock, [&] { return m_generation != lastGeneration; });
+                    lastGeneration = m_generation;
+                    pJob = m_pJob;
+                }
+
+                pJob->Work(workerIndex);
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (--m_numActive == 0)
+                {
+                    m_done.notify_one();
+                }
+            }
+        }
+
+        const UINT m_numThreads;
+
+        std::mutex m_dispatchMutex;
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_done;
+        Job *m_pJob;
+        UINT m_numActive;
+        UINT64 m_generation;
+    };
+
+    //
+    // Task graph executed on the CpuWorkerThreads, sharing work through one bounded
+    // deque per worker. A worker pops the newest task from its own deque and, once
+    // that runs dry, steals the oldest task from another worker; with nothing left
+    // to steal it sleeps until a task is pushed or the graph is done. Tasks are copied
+    // by value into storage that is allocated once up front, so spawning a task never
+    // touches the heap, and a task pushed onto a full deque is run inline instead.
+    //
+    template <typename TaskType>
+    class CpuTaskPool : private CpuWorkerThreads::Job
+    {
+    public:
+        typedef void (*TaskCallback)(CpuTaskPool &pool, UINT workerIndex, const TaskType &task, void *pContext);
+
+        CpuTaskPool(UINT maxTasksPerWorker) :
+            m_threads(CpuWorkerThreads::GetInstance()),
+            m_numWorkers(m_threads.GetWorkerCount()),
+            m_maxTasksPerWorker(std::max(maxTasksPerWorker, 1u)),
+            m_callback(nullptr),
+            m_pContext(nullptr),
+            m_pendingTasks(0),
+            m_queuedTasks(0),
+            m_numSleeping(0)
+        {
+            m_pQueues = std::unique_ptr<WorkerQueue[]>(new WorkerQueue[m_numWorkers]);
+            m_taskStorage.resize(m_numWorkers * m_maxTasksPerWorker);
+            for (UINT i = 0; i < m_numWorkers; i++)
+            {
+                m_pQueues[i].pTasks = &m_taskStorage[i * m_maxTasksPerWorker];
+            }
+        }
+
+        UINT GetWorkerCount() const { return m_numWorkers; }
+
+        // Executes rootTask and every task it spawns, returning once all of them have
+        // completed. The calling thread participates as worker 0.
+        void Run(const TaskType &rootTask, TaskCallback callback, void *pContext)
+        {
+            m_callback = callback;
+            m_pContext = pContext;
+            Push(0, rootTask);
+
+            if (!m_threads.TryDispatch(*this))
+            {
+                Work(0);
+            }
+        }
+
+        // Must only be called from the worker identified by workerIndex
+        void Push(UINT workerIndex, const TaskType &task)
+        {
+            WorkerQueue &queue = m_pQueues[workerIndex];
+            queue.Lock();
+            if (queue.count == m_maxTasksPerWorker)
+            {
+                queue.Unlock();
+                m_callback(*this, workerIndex, task, m_pContext);
+                return;
+            }
+
+            m_pendingTasks.fetch_add(1, std::memory_order_relaxed);
+            queue.pTasks[(queue.head + queue.count) % m_maxTasksPerWorker] = task;
+            queue.count++;
+            queue.Unlock();
+
+            m_queuedTasks.fetch_add(1);
+            if (m_numSleeping.load())
+            {
+                std::lock_guard<std::mutex> lock(m_idleMutex);
+                m_idle.notify_one();
+            }
+        }
+
+    private:
+        struct WorkerQueue
+        {
+            WorkerQueue() : pTasks(nullptr), head(0), count(0) { busy.clear(); }
+
+            void Lock() { while (busy.test_and_set(std::memory_order_acquire)) { std::this_thread::yield(); } }
+            void Unlock() { busy.clear(std::memory_order_release); }
+
+            TaskType *pTasks;
+            UINT head;
+            UINT count;
+            std::atomic_flag busy;
+
+            // Keep neighbouring queues off the same cache line
+            BYTE padding[64];
+        };
+
+        bool PopNewest(UINT workerIndex, TaskType &task)
+        {
+            WorkerQueue &queue = m_pQueues[workerIndex];
+            bool bFound = false;
+            queue.Lock();
+            if (queue.count)
+            {
+                queue.count--;
+                task = queue.pTasks[(queue.head + queue.count) % m_maxTasksPerWorker];
+                bFound = true;
+            }
+            queue.Unlock();
+            return bFound;
+        }
+
+        bool StealOldest(UINT workerIndex, TaskType &task)
+        {
+            for (UINT i = 1; i < m_numWorkers; i++)
+            {
+                WorkerQueue &victim = m_pQueues[(workerIndex + i) % m_numWorkers];
+                bool bFound = false;
+                victim.Lock();
+                if (victim.count)
+                {
+                    task = victim.pTasks[victim.head];
+                    victim.head = (victim.head + 1) % m_maxTasksPerWorker;
+                    victim.count--;
+                    bFound = true;
+                }
+                victim.Unlock();
+
+                if (bFound)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void Work(UINT workerIndex) override
+        {
+            // A task's children are pushed before the task itself is retired, so the
+            // pending count only reaches zero once the whole task graph is done
+            while (m_pendingTasks.load(std::memory_order_acquire) != 0)
+            {
+                TaskType task;
+                if (PopNewest(workerIndex, task) || StealOldest(workerIndex, task))
+                {
+                    m_queuedTasks.fetch_sub(1);
+                    m_callback(*this, workerIndex, task, m_pContext);
+                    if (m_pendingTasks.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    {
+                        std::lock_guard<std::mutex> lock(m_idleMutex);
+                        m_idle.notify_all();
+                    }
+                }
+                else
+                {
+                    // Whoever pushes next, or retires the last task, sees the sleeper
+                    // count and wakes us up
+                    std::unique_lock<std::mutex> lock(m_idleMutex);
+                    m_numSleeping.fetch_add(1);
+                    m_idle.wait(lock, [this] { return m_queuedTasks.load() != 0 || m_pendingTasks.load() == 0; });
+                    m_numSleeping.fetch_sub(1);
+                }
+            }
+        }
+
+        CpuWorkerThreads &m_threads;
+        const UINT m_numWorkers;
+        const UINT m_maxTasksPerWorker;
+        std::unique_ptr<WorkerQueue[]> m_pQueues;
+        std::vector<TaskType> m_taskStorage;
+
+        TaskCallback m_callback;
+        void *m_pContext;
+        std::atomic<UINT> m_pendingTasks;
+        std::atomic<UINT> m_queuedTasks;
+        std::atomic<UINT> m_numSleeping;
+
+        std::mutex m_idleMutex;
+        std::condition_variable m_idle;
+    };
+
+    struct ParallelForRange
+    {
+        UINT begin;
+        UINT end;
+    };
+
+    //
+    // Runs callback(begin, end) over [0, count) in ranges of at most grainSize elements.
+    // Ranges are halved on the fly, so idle workers steal the largest remaining pieces.
+    //
+    template <typename Callback>
+    void ParallelFor(UINT count, UINT grainSize, const Callback &callback)
+    {
+        grainSize = std::max(grainSize, 1u);
+        if (count <= grainSize)
+        {
+            if (count)
+            {
+                callback(0, count);
+            }
+            return;
+        }
+
+        struct Context
+        {
+            const Callback *pCallback;
+            UINT grainSize;
+        } context = { &callback, grainSize };
+
+        CpuTaskPool<ParallelForRange> taskPool(count / grainSize + 1);
+        taskPool.Run({ 0, count }, [](CpuTaskPool<ParallelForRange> &pool, UINT workerIndex, const ParallelForRange &range, void *pContext)
+        {
+            const Context &context = *static_cast<const Context *>(pContext);
+            ParallelForRange remaining = range;
+            while (remaining.end - remaining.begin > context.grainSize)
+            {
+                const UINT middle = remaining.begin + (remaining.end - remaining.begin) / 2;
+                pool.Push(workerIndex, { middle, remaining.end });
+                remaining.end = middle;
+            }
+            (*context.pCallback)(remaining.begin, remaining.end);
+        }, &context);
+    }
+}
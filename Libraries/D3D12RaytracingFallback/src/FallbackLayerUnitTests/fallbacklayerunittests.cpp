@@ -628,6 +628,460 @@ namespace FallbackLayerUnitTests
             }
         }
 
+        TEST_METHOD(R32IndexBufferBottomLevelCpuBVHBuilder)
+        {
+            CpuGeometryDescriptor testCases[] =
+            {
+                CpuGeometryDescriptor(ReferenceVerticies0, VERTEX_COUNT(ReferenceVerticies0), ReferenceR32Indices0, ARRAYSIZE(ReferenceR32Indices0)),
+                CpuGeometryDescriptor(ReferenceVerticies1, VERTEX_COUNT(ReferenceVerticies1), ReferenceR32Indices1, ARRAYSIZE(ReferenceR32Indices1))
+            };
+
+            for (UINT testIndex = 0; testIndex < ARRAYSIZE(testCases); testIndex++)
+            {
+                TestCpuBvh2Builder(testCases[testIndex]);
+            }
+        }
+
+        TEST_METHOD(NoIndexBufferBottomLevelCpuBVHBuilder)
+        {
+            CpuGeometryDescriptor testCases[] =
+            {
+                CpuGeometryDescriptor(ReferenceVerticies0, VERTEX_COUNT(ReferenceVerticies0)),
+                CpuGeometryDescriptor(ReferenceVerticies1, VERTEX_COUNT(ReferenceVerticies1))
+            };
+
+            for (UINT testIndex = 0; testIndex < ARRAYSIZE(testCases); testIndex++)
+            {
+                TestCpuBvh2Builder(testCases[testIndex]);
+            }
+        }
+
+        TEST_METHOD(ProceduralPrimitiveBottomLevelCpuBVHBuilder)
+        {
+            const UINT numAABBs = 500;
+            std::vector<D3D12_RAYTRACING_AABB> aabbs(numAABBs);
+            std::vector<AABB> referenceBoxes(numAABBs);
+            srand(10);
+            for (UINT i = 0; i < numAABBs; i++)
+            {
+                float3 minCorner = { (float)(rand() % 100), (float)(rand() % 100), (float)(rand() % 100) };
+                float3 maxCorner = { minCorner.x + 1 + rand() % 4, minCorner.y + 1 + rand() % 4, minCorner.z + 1 + rand() % 4 };
+                aabbs[i] = { minCorner.x, minCorner.y, minCorner.z, maxCorner.x, maxCorner.y, maxCorner.z };
+                referenceBoxes[i].min = minCorner;
+                referenceBoxes[i].max = maxCorner;
+            }
+
+            D3D12_RAYTRACING_GEOMETRY_DESC geometryDesc = {};
+            geometryDesc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_PROCEDURAL_PRIMITIVE_AABBS;
+            geometryDesc.AABBs.AABBCount = numAABBs;
+            geometryDesc.AABBs.AABBs.StartAddress = (D3D12_GPU_VIRTUAL_ADDRESS)aabbs.data();
+            geometryDesc.AABBs.AABBs.StrideInBytes = sizeof(D3D12_RAYTRACING_AABB);
+
+            std::unique_ptr<BYTE[]> pData;
+            BuildBottomLevelOnCpu(&geometryDesc, 1, pData);
+
+            // Traversal only runs the intersection shader on leaves that carry the
+            // procedural flag, and takes the leaf index from the rest of the flag word
+            const UINT isLeafFlag = 0x80000000;
+            const UINT isProceduralGeometryFlag = 0x40000000;
+
+            const BVHOffsets &offsets = *(BVHOffsets *)pData.get();
+            const UINT numNodes = (offsets.offsetToVertices - offsets.offsetToBoxes) / sizeof(AABBNode);
+            const AABBNode *pNodes = (AABBNode *)(pData.get() + offsets.offsetToBoxes);
+            const Primitive *pPrimitives = (Primitive *)(pData.get() + offsets.offsetToVertices);
+            const PrimitiveMetaData *pMetadata = (PrimitiveMetaData *)(pData.get() + offsets.offsetToPrimitiveMetaData);
+
+            std::vector<bool> aabbFound(numAABBs, false);
+            for (UINT i = 0; i < numNodes; i++)
+            {
+                const AABBNode &node = pNodes[i];
+                if (!(node.nodeAllBits & isLeafFlag))
+                {
+                    continue;
+                }
+
+                Assert::IsTrue((node.nodeAllBits & isProceduralGeometryFlag) != 0, L"Procedural leaf is missing IsProceduralGeometryFlag");
+                Assert::AreEqual(1u, node.numTriangles, L"Procedural leaves should hold a single AABB");
+
+                const UINT leafIndex = node.nodeAllBits & ~(isLeafFlag | isProceduralGeometryFlag);
+                Assert::IsTrue(leafIndex < numAABBs, L"Leaf index is out of range");
+                Assert::IsTrue(pPrimitives[leafIndex].PrimitiveType == PROCEDURAL_PRIMITIVE_TYPE, L"Leaf doesn't point at a procedural primitive");
+
+                const UINT aabbIndex = pMetadata[leafIndex].PrimitiveIndex;
+                Assert::IsTrue(aabbIndex < numAABBs && !aabbFound[aabbIndex], L"AABB is referenced by more than one leaf");
+                aabbFound[aabbIndex] = true;
+
+                const AABB &leafBox = pPrimitives[leafIndex].aabb;
+                const AABB &expectedBox = referenceBoxes[aabbIndex];
+                Assert::IsTrue(
+                    leafBox.min.x == expectedBox.min.x && leafBox.min.y == expectedBox.min.y && leafBox.min.z == expectedBox.min.z &&
+                    leafBox.max.x == expectedBox.max.x && leafBox.max.y == expectedBox.max.y && leafBox.max.z == expectedBox.max.z,
+                    L"Leaf AABB doesn't match the input");
+            }
+
+            for (UINT i = 0; i < numAABBs; i++)
+            {
+                Assert::IsTrue(aabbFound[i], L"AABB is missing from the BVH");
+            }
+        }
+
+        template<UINT numBottomLevels>
+        void SimpleTopLevelCpuBVHBuilder(D3D12_ELEMENTS_LAYOUT layoutToTest, bool testRefit)
+        {
+            const UINT referenceVertexArraySize = ARRAYSIZE(ReferenceVerticies0);
+
+            std::unique_ptr<float[]> pVertices[numBottomLevels];
+            std::unique_ptr<BYTE[]> pBottomLevelData[numBottomLevels];
+            AABB containingBoxes[numBottomLevels];
+            for (UINT level = 0; level < numBottomLevels; level++)
+            {
+                for (UINT axis = 0; axis < 3; axis++)
+                {
+                    containingBoxes[level].minArr[axis] = FLT_MAX;
+                    containingBoxes[level].maxArr[axis] = -FLT_MAX;
+                }
+
+                pVertices[level] = std::unique_ptr<float[]>(new float[referenceVertexArraySize]);
+                for (UINT i = 0; i < referenceVertexArraySize; i++)
+                {
+                    float newInput = ReferenceVerticies0[i] + level;
+                    UINT axis = i % 3;
+                    containingBoxes[level].minArr[axis] = std::min(newInput, containingBoxes[level].minArr[axis]);
+                    containingBoxes[level].maxArr[axis] = std::max(newInput, containingBoxes[level].maxArr[axis]);
+                    pVertices[level][i] = newInput;
+                }
+
+                D3D12_RAYTRACING_GEOMETRY_DESC geometryDesc = {};
+                geometryDesc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
+                geometryDesc.Triangles.IndexBuffer = (D3D12_GPU_VIRTUAL_ADDRESS)ReferenceIndices0;
+                geometryDesc.Triangles.IndexFormat = DXGI_FORMAT_R16_UINT;
+                geometryDesc.Triangles.IndexCount = ARRAYSIZE(ReferenceIndices0);
+                geometryDesc.Triangles.VertexBuffer.StartAddress = (D3D12_GPU_VIRTUAL_ADDRESS)pVertices[level].get();
+                geometryDesc.Triangles.VertexBuffer.StrideInBytes = sizeof(float) * 3;
+                geometryDesc.Triangles.VertexCount = referenceVertexArraySize / 3;
+                BuildBottomLevelOnCpu(&geometryDesc, 1, pBottomLevelData[level]);
+            }
+
+            srand(10);
+            D3D12_RAYTRACING_INSTANCE_DESC instanceDescs[numBottomLevels] = {};
+            D3D12_RAYTRACING_INSTANCE_DESC *pInstanceDescs[numBottomLevels];
+            float *pTransformations[numBottomLevels];
+            for (UINT i = 0; i < numBottomLevels; i++)
+            {
+                pTransformations[i] = &instanceDescs[i].Transform[0][0];
+                GenerateRandomTranformation(pTransformations[i]);
+                instanceDescs[i].InstanceMask = 1;
+                instanceDescs[i].AccelerationStructure = (D3D12_GPU_VIRTUAL_ADDRESS)pBottomLevelData[i].get();
+                pInstanceDescs[i] = &instanceDescs[i];
+            }
+
+            D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC desc = {};
+            D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS &inputs = desc.Inputs;
+            inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
+            inputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE;
+            inputs.DescsLayout = layoutToTest;
+            inputs.NumDescs = numBottomLevels;
+            inputs.InstanceDescs = layoutToTest == D3D12_ELEMENTS_LAYOUT_ARRAY ?
+                (D3D12_GPU_VIRTUAL_ADDRESS)instanceDescs : (D3D12_GPU_VIRTUAL_ADDRESS)pInstanceDescs;
+
+            std::unique_ptr<BYTE[]> pData = std::unique_ptr<BYTE[]>(new BYTE[GetOffsetToBVHSortedIndices(numBottomLevels)]);
+            BuildRaytracingAccelerationStructureOnCpu(&desc, pData.get());
+
+            if (testRefit)
+            {
+                // Move every instance and refit the existing tree in place
+                for (UINT i = 0; i < numBottomLevels; i++)
+                {
+                    GenerateRandomTranformation(pTransformations[i]);
+                }
+                inputs.Flags |= D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE;
+                BuildRaytracingAccelerationStructureOnCpu(&desc, pData.get());
+            }
+
+            std::wstring errorMessage;
+            auto &validator = FallbackLayer::GetAccelerationStructureValidator(FallbackLayer::BVH2);
+            if (!validator.VerifyTopLevelOutput(containingBoxes, pTransformations, numBottomLevels, pData.get(), errorMessage))
+            {
+                Assert::Fail(errorMessage.c_str());
+            }
+        }
+
+        TEST_METHOD(SimpleTopLevelCpuBVHBuilder_ArrayLayout)
+        {
+            SimpleTopLevelCpuBVHBuilder<50>(D3D12_ELEMENTS_LAYOUT_ARRAY, false);
+        }
+
+        TEST_METHOD(SimpleTopLevelCpuBVHBuilder_ArrayOfPointersLayout)
+        {
+            SimpleTopLevelCpuBVHBuilder<50>(D3D12_ELEMENTS_LAYOUT_ARRAY_OF_POINTERS, false);
+        }
+
+        TEST_METHOD(SimpleTopLevelCpuBVHBuilderWithRefit)
+        {
+            SimpleTopLevelCpuBVHBuilder<50>(D3D12_ELEMENTS_LAYOUT_ARRAY, true);
+        }
+
+        TEST_METHOD(RefitBottomLevelCpuBVHBuilder)
+        {
+            const UINT vertexCount = VERTEX_COUNT(ReferenceVerticies0);
+            std::vector<float> vertices(ReferenceVerticies0, ReferenceVerticies0 + vertexCount * 3);
+            CpuGeometryDescriptor geomDesc(vertices.data(), vertexCount, ReferenceIndices0, ARRAYSIZE(ReferenceIndices0));
+
+            D3D12_RAYTRACING_GEOMETRY_DESC geometryDesc = {};
+            geometryDesc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
+            geometryDesc.Triangles.IndexBuffer = (D3D12_GPU_VIRTUAL_ADDRESS)ReferenceIndices0;
+            geometryDesc.Triangles.IndexFormat = DXGI_FORMAT_R16_UINT;
+            geometryDesc.Triangles.IndexCount = ARRAYSIZE(ReferenceIndices0);
+            geometryDesc.Triangles.VertexBuffer.StartAddress = (D3D12_GPU_VIRTUAL_ADDRESS)vertices.data();
+            geometryDesc.Triangles.VertexBuffer.StrideInBytes = sizeof(float) * 3;
+            geometryDesc.Triangles.VertexCount = vertexCount;
+
+            std::unique_ptr<BYTE[]> pData;
+            auto &validator = BuildBottomLevelOnCpu(&geometryDesc, 1, pData);
+            const UINT dataSize = ((BVHOffsets *)pData.get())->totalSize;
+            std::unique_ptr<BYTE[]> pScratchData = std::unique_ptr<BYTE[]>(new BYTE[dataSize]);
+
+            D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC desc = {};
+            D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS &inputs = desc.Inputs;
+            inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
+            inputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE | D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE;
+            inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+            inputs.NumDescs = 1;
+            inputs.pGeometryDescs = &geometryDesc;
+
+            // A rigid translation leaves the refit tree as good as a rebuilt one
+            for (auto &v : vertices)
+            {
+                v += 10.0f;
+            }
+            BuildRaytracingAccelerationStructureOnCpu(&desc, pData.get());
+
+            std::wstring errorMessage;
+            if (!validator.VerifyBottomLevelOutput(&geomDesc, 1, pData.get(), errorMessage))
+            {
+                Assert::Fail(errorMessage.c_str());
+            }
+            const float translatedRatio = GetRefitQualityRatioOnCpu(&desc, pData.get(), pScratchData.get());
+            Assert::IsTrue(translatedRatio > 0.95f && translatedRatio < 1.05f, L"Refit after a translation should match a rebuild");
+
+            // Deforming the mesh keeps the output valid, and a refit tree shouldn't beat a rebuild
+            srand(10);
+            for (auto &v : vertices)
+            {
+                v += (rand() / (float)RAND_MAX) * 4.0f;
+            }
+            BuildRaytracingAccelerationStructureOnCpu(&desc, pData.get());
+
+            if (!validator.VerifyBottomLevelOutput(&geomDesc, 1, pData.get(), errorMessage))
+            {
+                Assert::Fail(errorMessage.c_str());
+            }
+            const float deformedRatio = GetRefitQualityRatioOnCpu(&desc, pData.get(), pScratchData.get());
+            Assert::IsTrue(deformedRatio > 0.95f, L"Refit tree can't be noticeably better than a rebuild");
+        }
+
+        TEST_METHOD(CpuLbvhBuilderMatchesGpuBvh2Builder)
+        {
+            std::vector<float> vertices;
+            std::vector<UINT16> indices;
+            GenerateStressGeometry(500, vertices, indices);
+            CpuGeometryDescriptor testCase(vertices.data(), (UINT)(vertices.size() / 3), indices.data(), (UINT)indices.size());
+
+            ID3D12Device &device = m_d3d12Context.GetDevice();
+            std::unique_ptr<FallbackLayer::IAccelerationStructureBuilder> pBuilder =
+                std::unique_ptr<FallbackLayer::IAccelerationStructureBuilder>(
+                    new FallbackLayer::GpuBvh2Builder(&device, m_d3d12Context.GetTotalLaneCount(), 0));
+            InternalFallbackBuilder builderWrapper(pBuilder.get());
+
+            // PREFER_FAST_TRACE is left out: its later treelet passes read parent indices
+            // that still carry the collapse bit on the GPU
+            const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS flagsToTest[] =
+            {
+                D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_BUILD,
+                D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_NONE,
+            };
+
+            for (auto buildFlags : flagsToTest)
+            {
+                std::unique_ptr<BYTE[]> pGpuData;
+                BuildBottomLevelAccelerationStructureAndGetCpuData(builderWrapper, &testCase, 1, pGpuData, D3D12_ELEMENTS_LAYOUT_ARRAY, buildFlags);
+
+                std::unique_ptr<BYTE[]> pCpuData;
+                auto &validator = BuildBottomLevelOnCpuLbvh(&testCase, 1, buildFlags, false, pCpuData);
+
+                std::wstring errorMessage;
+                if (!validator.VerifyBottomLevelOutput(&testCase, 1, pCpuData.get(), errorMessage))
+                {
+                    Assert::Fail(errorMessage.c_str());
+                }
+
+                const BVHOffsets &gpuOffsets = *(BVHOffsets *)pGpuData.get();
+                const BVHOffsets &cpuOffsets = *(BVHOffsets *)pCpuData.get();
+                Assert::IsTrue(memcmp(&gpuOffsets, &cpuOffsets, sizeof(BVHOffsets)) == 0, L"BVH offsets differ from the GPU builder");
+                Assert::IsTrue(memcmp(pGpuData.get() + gpuOffsets.offsetToVertices, pCpuData.get() + cpuOffsets.offsetToVertices,
+                    gpuOffsets.totalSize - gpuOffsets.offsetToVertices) == 0, L"Sorted primitives differ from the GPU builder");
+
+                // Which child of an internal node lands on the left is only fixed when the
+                // two subtrees hold a different number of primitives
+                const UINT numNodes = (gpuOffsets.offsetToVertices - gpuOffsets.offsetToBoxes) / sizeof(AABBNode);
+                const AABBNode *pGpuNodes = (AABBNode *)(pGpuData.get() + gpuOffsets.offsetToBoxes);
+                const AABBNode *pCpuNodes = (AABBNode *)(pCpuData.get() + cpuOffsets.offsetToBoxes);
+                for (UINT i = 0; i < numNodes; i++)
+                {
+                    const AABBNode &gpuNode = pGpuNodes[i];
+                    const AABBNode &cpuNode = pCpuNodes[i];
+                    Assert::IsTrue(memcmp(gpuNode.center, cpuNode.center, sizeof(gpuNode.center)) == 0, L"AABB center differs from the GPU builder");
+                    Assert::IsTrue(memcmp(gpuNode.halfDim, cpuNode.halfDim, sizeof(gpuNode.halfDim)) == 0, L"AABB extents differ from the GPU builder");
+                    Assert::AreEqual((UINT)gpuNode.leaf, (UINT)cpuNode.leaf, L"Leaf flag differs from the GPU builder");
+                    if (gpuNode.leaf)
+                    {
+                        Assert::AreEqual((UINT)gpuNode.nodeAllBits, (UINT)cpuNode.nodeAllBits, L"Leaf primitive differs from the GPU builder");
+                        Assert::AreEqual((UINT)gpuNode.numTriangles, (UINT)cpuNode.numTriangles, L"Leaf primitive count differs from the GPU builder");
+                    }
+                    else
+                    {
+                        const UINT gpuLeft = gpuNode.internalNode.leftNodeIndex;
+                        const UINT cpuLeft = cpuNode.internalNode.leftNodeIndex;
+                        const bool bSameChildren =
+                            (gpuLeft == cpuLeft && gpuNode.rightNodeIndex == cpuNode.rightNodeIndex) ||
+                            (gpuLeft == cpuNode.rightNodeIndex && gpuNode.rightNodeIndex == cpuLeft);
+                        Assert::IsTrue(bSameChildren, L"Internal node children differ from the GPU builder");
+                    }
+                }
+            }
+        }
+
+        TEST_METHOD(CpuLbvhBuilderWith63BitMortonCodes)
+        {
+            std::vector<float> vertices;
+            std::vector<UINT16> indices;
+            GenerateStressGeometry(1000, vertices, indices);
+            CpuGeometryDescriptor testCase(vertices.data(), (UINT)(vertices.size() / 3), indices.data(), (UINT)indices.size());
+
+            std::unique_ptr<BYTE[]> pData;
+            auto &validator = BuildBottomLevelOnCpuLbvh(&testCase, 1, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_NONE, true, pData);
+
+            std::wstring errorMessage;
+            if (!validator.VerifyBottomLevelOutput(&testCase, 1, pData.get(), errorMessage))
+            {
+                Assert::Fail(errorMessage.c_str());
+            }
+        }
+
+        TEST_METHOD(CpuTraversalMatchesBruteForce)
+        {
+            std::vector<float> vertices;
+            std::vector<UINT16> indices;
+            GenerateStressGeometry(200, vertices, indices);
+            const D3D12_RAYTRACING_GEOMETRY_DESC geometryDesc = CreateTriangleGeometryDesc(vertices, indices);
+
+            std::unique_ptr<BYTE[]> pData;
+            BuildBottomLevelOnCpu(&geometryDesc, 1, pData);
+
+            // An odd ray count leaves the last packet partially filled
+            srand(10);
+            std::vector<CpuRay> rays(1001);
+            for (auto &ray : rays)
+            {
+                GenerateRandomRay(ray, 0.0f, 200.0f);
+            }
+
+            const UINT packetWidthsToTest[] = { 4, 0 };
+            for (UINT packetWidth : packetWidthsToTest)
+            {
+                std::vector<CpuRayHit> closestHits(rays.size());
+                std::vector<CpuRayHit> firstHits(rays.size());
+                TraceRaysOnCpu(pData.get(), rays.data(), (UINT)rays.size(), false, closestHits.data(), packetWidth);
+                TraceRaysOnCpu(pData.get(), rays.data(), (UINT)rays.size(), true, firstHits.data(), packetWidth);
+
+                for (UINT i = 0; i < rays.size(); i++)
+                {
+                    const float expectedT = TraceRayBruteForce(rays[i], vertices, indices);
+                    const bool bExpectHit = expectedT < rays[i].TMax;
+                    Assert::AreEqual(bExpectHit, closestHits[i].PrimitiveIndex != CpuRayMiss, L"Closest-hit query disagrees with brute force");
+                    Assert::AreEqual(bExpectHit, firstHits[i].PrimitiveIndex != CpuRayMiss, L"Any-hit query disagrees with brute force");
+                    if (bExpectHit)
+                    {
+                        Assert::AreEqual(expectedT, closestHits[i].T, 0.0001f, L"Closest hit distance disagrees with brute force");
+                        Assert::IsTrue(firstHits[i].T >= closestHits[i].T, L"Any hit can't be closer than the closest hit");
+                    }
+                }
+            }
+        }
+
+        TEST_METHOD(CpuTraversalThroughput)
+        {
+            std::vector<float> vertices;
+            std::vector<UINT16> indices;
+            GenerateStressGeometry(5000, vertices, indices);
+            const D3D12_RAYTRACING_GEOMETRY_DESC geometryDesc = CreateTriangleGeometryDesc(vertices, indices);
+
+            std::unique_ptr<BYTE[]> pData;
+            BuildBottomLevelOnCpu(&geometryDesc, 1, pData);
+            const float sahCost = GetAccelerationStructureSahCostOnCpu(pData.get());
+
+            // Coherent rays from a pinhole camera looking down the diagonal the copies lie on,
+            // and incoherent rays with random origins and directions
+            const UINT imageSize = 1024;
+            std::vector<CpuRay> primaryRays(imageSize * imageSize);
+            for (UINT y = 0; y < imageSize; y++)
+            {
+                for (UINT x = 0; x < imageSize; x++)
+                {
+                    CpuRay &ray = primaryRays[y * imageSize + x];
+                    ray.Origin[0] = ray.Origin[1] = ray.Origin[2] = -100.0f;
+                    ray.Direction[0] = 1.0f + (x / (float)imageSize - 0.5f);
+                    ray.Direction[1] = 1.0f + (y / (float)imageSize - 0.5f);
+                    ray.Direction[2] = 1.0f;
+                    ray.TMin = 0.0f;
+                    ray.TMax = FLT_MAX;
+                }
+            }
+
+            srand(10);
+            std::vector<CpuRay> randomRays(imageSize * imageSize);
+            for (auto &ray : randomRays)
+            {
+                GenerateRandomRay(ray, 0.0f, 5000.0f);
+            }
+
+            const struct
+            {
+                const wchar_t *pName;
+                const std::vector<CpuRay> &rays;
+            } rayTypes[] = { { L"primary", primaryRays }, { L"random", randomRays } };
+
+            std::vector<CpuRayHit> hits(primaryRays.size());
+            for (auto &rayType : rayTypes)
+            {
+                for (UINT packetWidth : { 4u, 0u })
+                {
+                    for (bool bAcceptFirstHit : { false, true })
+                    {
+                        const auto start = std::chrono::high_resolution_clock::now();
+                        TraceRaysOnCpu(pData.get(), rayType.rays.data(), (UINT)rayType.rays.size(), bAcceptFirstHit, hits.data(), packetWidth);
+                        const std::chrono::duration<double> seconds = std::chrono::high_resolution_clock::now() - start;
+
+                        UINT numHits = 0;
+                        for (auto &hit : hits)
+                        {
+                            numHits += hit.PrimitiveIndex != CpuRayMiss;
+                        }
+
+                        wchar_t message[256];
+                        swprintf_s(message, L"%s rays, %s packets, %s: %.2f Mrays/s, %u hits, SAH cost %.2f\n",
+                            rayType.pName,
+                            packetWidth ? L"4-wide" : L"widest",
+                            bAcceptFirstHit ? L"any hit" : L"closest hit",
+                            rayType.rays.size() / seconds.count() / 1e6,
+                            numHits,
+                            sahCost);
+                        Logger::WriteMessage(message);
+                    }
+                }
+            }
+        }
+
         TEST_METHOD(R16IndexBufferBottomLevelGpuBVHBuilder)
         {
             CpuGeometryDescriptor testCases[] =
@@ -1341,7 +1795,7 @@ namespace FallbackLayerUnitTests
             }
         }
 
-        void TestCpuBvh2Builder(CpuGeometryDescriptor *pGeomDescs, UINT numGeoms, D3D12_ELEMENTS_LAYOUT layoutToTest = D3D12_ELEMENTS_LAYOUT_ARRAY)
+        IAccelerationStructureValidator &BuildBottomLevelOnCpu(const D3D12_RAYTRACING_GEOMETRY_DESC *pGeomDescs, UINT numGeoms, std::unique_ptr<BYTE[]> &pData)
         {
             ID3D12Device &device = m_d3d12Context.GetDevice();
             std::unique_ptr<FallbackLayer::IAccelerationStructureBuilder> pBuilder =
@@ -1349,6 +1803,108 @@ namespace FallbackLayerUnitTests
                     new FallbackLayer::GpuBvh2Builder(&device, m_d3d12Context.GetTotalLaneCount(), 0));
             InternalFallbackBuilder builderWrapper(pBuilder.get());
 
+            D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO prebuildInfo;
+            builderWrapper.GetRaytracingAccelerationStructurePrebuildInfo(&device,
+                D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL,
+                D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_BUILD,
+                numGeoms,
+                pGeomDescs,
+                &prebuildInfo);
+            pData = std::unique_ptr<BYTE[]>(new BYTE[prebuildInfo.ResultDataMaxSizeInBytes]);
+
+            D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC desc = {};
+            D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS &inputs = desc.Inputs;
+            inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+            inputs.NumDescs = numGeoms;
+            inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
+            inputs.pGeometryDescs = pGeomDescs;
+
+            BuildRaytracingAccelerationStructureOnCpu(&desc, pData.get());
+            return FallbackLayer::GetAccelerationStructureValidator(pBuilder->GetAccelerationStructureType());
+        }
+
+        void GenerateStressGeometry(UINT numCopies, std::vector<float> &vertices, std::vector<UINT16> &indices)
+        {
+            for (UINT i = 0; i < numCopies; i++)
+            {
+                for (float f : ReferenceVerticies0)
+                {
+                    vertices.push_back(f + i);
+                }
+
+                for (UINT16 index : ReferenceIndices0)
+                {
+                    indices.push_back(index + (UINT16)ARRAYSIZE(ReferenceIndices0) * i);
+                }
+            }
+        }
+
+        D3D12_RAYTRACING_GEOMETRY_DESC CreateTriangleGeometryDesc(const std::vector<float> &vertices, const std::vector<UINT16> &indices)
+        {
+            D3D12_RAYTRACING_GEOMETRY_DESC geometryDesc = {};
+            geometryDesc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
+            geometryDesc.Triangles.IndexBuffer = (D3D12_GPU_VIRTUAL_ADDRESS)indices.data();
+            geometryDesc.Triangles.IndexFormat = DXGI_FORMAT_R16_UINT;
+            geometryDesc.Triangles.IndexCount = (UINT)indices.size();
+            geometryDesc.Triangles.VertexBuffer.StartAddress = (D3D12_GPU_VIRTUAL_ADDRESS)vertices.data();
+            geometryDesc.Triangles.VertexBuffer.StrideInBytes = sizeof(float) * 3;
+            geometryDesc.Triangles.VertexCount = (UINT)(vertices.size() / 3);
+            return geometryDesc;
+        }
+
+        void GenerateRandomRay(CpuRay &ray, float minCoordinate, float maxCoordinate)
+        {
+            for (UINT i = 0; i < 3; i++)
+            {
+                ray.Origin[i] = minCoordinate + (rand() / (float)RAND_MAX) * (maxCoordinate - minCoordinate);
+                ray.Direction[i] = (rand() / (float)RAND_MAX) * 2.0f - 1.0f;
+            }
+            ray.TMin = 0.0f;
+            ray.TMax = FLT_MAX;
+        }
+
+        // Moller-Trumbore against every triangle, returning the closest hit distance or TMax
+        float TraceRayBruteForce(const CpuRay &ray, const std::vector<float> &vertices, const std::vector<UINT16> &indices)
+        {
+            float closestT = ray.TMax;
+            for (UINT i = 0; i < indices.size(); i += 3)
+            {
+                const float3 v0 = *(const float3 *)&vertices[indices[i] * 3];
+                const float3 v1 = *(const float3 *)&vertices[indices[i + 1] * 3];
+                const float3 v2 = *(const float3 *)&vertices[indices[i + 2] * 3];
+                const float3 origin = { ray.Origin[0], ray.Origin[1], ray.Origin[2] };
+                const float3 direction = { ray.Direction[0], ray.Direction[1], ray.Direction[2] };
+
+                const float3 edge1 = v1 - v0;
+                const float3 edge2 = v2 - v0;
+                const float3 p = cross(direction, edge2);
+                const float det = dot(edge1, p);
+                if (det == 0.0f)
+                {
+                    continue;
+                }
+
+                const float inverseDet = 1.0f / det;
+                const float3 s = origin - v0;
+                const float u = dot(s, p) * inverseDet;
+                const float3 q = cross(s, edge1);
+                const float v = dot(direction, q) * inverseDet;
+                const float t = dot(edge2, q) * inverseDet;
+                if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t > ray.TMin && t < closestT)
+                {
+                    closestT = t;
+                }
+            }
+            return closestT;
+        }
+
+        IAccelerationStructureValidator &BuildBottomLevelOnCpuLbvh(
+            CpuGeometryDescriptor *pGeomDescs,
+            UINT numGeoms,
+            D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS buildFlags,
+            bool bUse63BitMortonCodes,
+            std::unique_ptr<BYTE[]> &pData)
+        {
             std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> geomDescs(numGeoms);
             for (UINT i = 0; i < numGeoms; i++)
             {
@@ -1362,25 +1918,53 @@ namespace FallbackLayerUnitTests
                 triangleDesc.VertexBuffer.StrideInBytes = sizeof(float) * 3;
             }
 
+            // The LBVH layout is sized by the GPU builder
+            ID3D12Device &device = m_d3d12Context.GetDevice();
+            std::unique_ptr<FallbackLayer::IAccelerationStructureBuilder> pBuilder =
+                std::unique_ptr<FallbackLayer::IAccelerationStructureBuilder>(
+                    new FallbackLayer::GpuBvh2Builder(&device, m_d3d12Context.GetTotalLaneCount(), 0));
+            InternalFallbackBuilder builderWrapper(pBuilder.get());
+
             D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO prebuildInfo;
             builderWrapper.GetRaytracingAccelerationStructurePrebuildInfo(&device,
                 D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL,
-                D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_BUILD,
+                buildFlags,
                 numGeoms,
                 geomDescs.data(),
                 &prebuildInfo);
-            std::unique_ptr<BYTE[]> pData = std::unique_ptr<BYTE[]>(new BYTE[prebuildInfo.ResultDataMaxSizeInBytes]);
+            pData = std::unique_ptr<BYTE[]>(new BYTE[prebuildInfo.ResultDataMaxSizeInBytes]);
 
             D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC desc = {};
             D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS &inputs = desc.Inputs;
             inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+            inputs.Flags = buildFlags;
             inputs.NumDescs = numGeoms;
             inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
             inputs.pGeometryDescs = geomDescs.data();
 
-            BuildRaytracingAccelerationStructureOnCpu(&desc, pData.get());
+            BuildRaytracingAccelerationStructureOnCpuLbvh(&desc, pData.get(), bUse63BitMortonCodes);
+            return FallbackLayer::GetAccelerationStructureValidator(pBuilder->GetAccelerationStructureType());
+        }
+
+        void TestCpuBvh2Builder(CpuGeometryDescriptor *pGeomDescs, UINT numGeoms, D3D12_ELEMENTS_LAYOUT layoutToTest = D3D12_ELEMENTS_LAYOUT_ARRAY)
+        {
+            std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> geomDescs(numGeoms);
+            for (UINT i = 0; i < numGeoms; i++)
+            {
+                geomDescs[i].Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
+                auto &triangleDesc = geomDescs[i].Triangles;
+                triangleDesc.IndexBuffer = (D3D12_GPU_VIRTUAL_ADDRESS)pGeomDescs[i].m_pIndexBuffer;
+                triangleDesc.VertexBuffer.StartAddress = (D3D12_GPU_VIRTUAL_ADDRESS)pGeomDescs[i].m_pVertexData;
+                triangleDesc.IndexFormat = pGeomDescs[i].m_indexBufferFormat;
+                triangleDesc.IndexCount = pGeomDescs[i].m_numIndicies;
+                triangleDesc.VertexCount = pGeomDescs[i].m_numVerticies;
+                triangleDesc.VertexBuffer.StrideInBytes = sizeof(float) * 3;
+            }
+
+            std::unique_ptr<BYTE[]> pData;
+            auto &validator = BuildBottomLevelOnCpu(geomDescs.data(), numGeoms, pData);
+
             std::wstring errorMessage;
-            auto &validator = FallbackLayer::GetAccelerationStructureValidator(pBuilder->GetAccelerationStructureType());
             if (!validator.VerifyBottomLevelOutput(pGeomDescs, numGeoms, pData.get(), errorMessage))
             {
                 Assert::Fail(errorMessage.c_str());
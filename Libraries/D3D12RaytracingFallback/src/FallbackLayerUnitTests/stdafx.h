@@ -10,6 +10,8 @@
 // Headers for CppUnitTest
 #include "CppUnitTest.h"
 
+#include <chrono>
+
 #include "..\pch.h"
 #include "DXGI1_4.h"
 
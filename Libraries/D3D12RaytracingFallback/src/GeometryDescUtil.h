@@ -0,0 +1,86 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+#pragma once
+
+// Geometry desc helpers that only need the D3D12 build desc types and ThrowFailure, so the CPU
+// builders can share them without the rest of Util.h
+
+static bool IsIndexBufferFormatSupported(DXGI_FORMAT format)
+{
+    switch (format)
+    {
+    case DXGI_FORMAT_R32_UINT:
+    case DXGI_FORMAT_R16_UINT:
+    case DXGI_FORMAT_UNKNOWN:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static const D3D12_RAYTRACING_GEOMETRY_DESC &GetGeometryDesc(const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS &desc, UINT geometryIndex)
+{
+    switch (desc.DescsLayout)
+    {
+    case D3D12_ELEMENTS_LAYOUT_ARRAY:
+        return desc.pGeometryDescs[geometryIndex];
+    case D3D12_ELEMENTS_LAYOUT_ARRAY_OF_POINTERS:
+        return *desc.ppGeometryDescs[geometryIndex];
+    default:
+        ThrowFailure(E_INVALIDARG, L"Unexpected value for D3D12_ELEMENTS_LAYOUT");
+        return *(D3D12_RAYTRACING_GEOMETRY_DESC *)nullptr;
+    }
+}
+
+static UINT GetPrimitiveCountFromGeometryDesc(const D3D12_RAYTRACING_GEOMETRY_DESC &geometryDesc)
+{
+    switch (geometryDesc.Type)
+    {
+        case D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES:
+        {
+            const D3D12_RAYTRACING_GEOMETRY_TRIANGLES_DESC &triangles = geometryDesc.Triangles;
+            if (!IsIndexBufferFormatSupported(triangles.IndexFormat))
+            {
+                ThrowFailure(E_NOTIMPL, L"Unsupported index buffer format provided");
+            }
+
+            const bool bNullIndexBuffer = (triangles.IndexFormat == DXGI_FORMAT_UNKNOWN);
+            const UINT vertexCount = bNullIndexBuffer ? triangles.VertexCount : triangles.IndexCount;
+            if (vertexCount % 3 != 0)
+            {
+                ThrowFailure(E_INVALIDARG, bNullIndexBuffer ?
+                    L"Invalid vertex count provided, must be a multiple of 3 when there is no index buffer since geometry is always a triangle list" :
+                    L"Invalid index count provided, must be a multiple of 3 since geometry is always a triangle list"
+                );
+            }
+            return vertexCount / 3;
+        }
+        case D3D12_RAYTRACING_GEOMETRY_TYPE_PROCEDURAL_PRIMITIVE_AABBS:
+        {
+            const D3D12_RAYTRACING_GEOMETRY_AABBS_DESC &aabbs = geometryDesc.AABBs;
+            return static_cast<UINT>(aabbs.AABBCount);
+        }
+        default:
+            ThrowFailure(E_INVALIDARG, L"Unrecognized D3D12_RAYTRACING_GEOMETRY_TYPE");
+            return 0;
+    }
+}
+
+static UINT GetTotalPrimitiveCount(const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS &desc)
+{
+    UINT totalTriangles = 0;
+    for (UINT elementIndex = 0; elementIndex < desc.NumDescs; elementIndex++)
+    {
+        const D3D12_RAYTRACING_GEOMETRY_DESC &geometryDesc = GetGeometryDesc(desc, elementIndex);
+        totalTriangles += GetPrimitiveCountFromGeometryDesc(geometryDesc);
+    }
+    return totalTriangles;
+}
@@ -22,3 +22,61 @@ void VisualizeAccelerationStructureLevel(ID3D12RaytracingFallbackDevice *pDevice
 void BuildRaytracingAccelerationStructureOnCpu(
     _In_  const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC *pDesc,
     _Out_ void *pData);
+
+// Builds a bottom-level acceleration structure on the CPU with the same stages as the GPU
+// builder (Morton codes, radix sort, Karras hierarchy, treelet reordering) and writes the
+// GpuBvh2Builder layout, so nodes can be compared against a GPU build of the same inputs.
+// pData must hold the GPU builder's ResultDataMaxSizeInBytes. 63-bit Morton codes give
+// better trees for large scenes but no longer match the GPU output.
+void BuildRaytracingAccelerationStructureOnCpuLbvh(
+    _In_  const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC *pDesc,
+    _Out_ void *pData,
+    bool bUse63BitMortonCodes = false);
+
+// SAH cost of an acceleration structure built by BuildRaytracingAccelerationStructureOnCpu,
+// normalized by the area of the root box
+float GetAccelerationStructureSahCostOnCpu(
+    _In_ const void *pData);
+
+// Builds pDesc->Inputs from scratch into pScratchData (which must be as large as the
+// result buffer) and returns the SAH cost of pRefitData relative to it. Values that
+// creep well above 1.0 mean repeated refits have degraded the tree and it should be rebuilt.
+float GetRefitQualityRatioOnCpu(
+    _In_  const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC *pDesc,
+    _In_  const void *pRefitData,
+    _Out_ void *pScratchData);
+
+// Ray in the object space of a bottom-level acceleration structure, laid out like RayDesc
+struct CpuRay
+{
+    float Origin[3];
+    float TMin;
+    float Direction[3];
+    float TMax;
+};
+
+static const UINT CpuRayMiss = UINT_MAX;
+
+// PrimitiveIndex and GeometryIndex are CpuRayMiss when nothing was hit, in which case
+// T is the ray's TMax
+struct CpuRayHit
+{
+    float T;
+    float Barycentrics[2];
+    UINT PrimitiveIndex;
+    UINT GeometryIndex;
+};
+
+// Traces rays against a bottom-level acceleration structure in CPU memory, such as one
+// written by BuildRaytracingAccelerationStructureOnCpu, in packets of 4 (SSE) or 8 (AVX)
+// rays spread across worker threads. A packetWidth of 0 picks 8 when the CPU supports AVX.
+// With bAcceptFirstHit each ray stops at the first hit found, which suits occlusion
+// queries; otherwise the closest hit is returned. Triangles are culled on neither face and
+// procedural primitives report a hit where the ray enters their box.
+void TraceRaysOnCpu(
+    _In_  const void *pAccelerationStructure,
+    _In_reads_(numRays) const CpuRay *pRays,
+    UINT numRays,
+    bool bAcceptFirstHit,
+    _Out_writes_(numRays) CpuRayHit *pHits,
+    UINT packetWidth = 0);
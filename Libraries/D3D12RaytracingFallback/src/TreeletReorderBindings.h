@@ -9,7 +9,7 @@
 //
 //*********************************************************
 #pragma once
-#include "RaytracingHlslCompat.h"
+#include "RayTracingHlslCompat.h"
 #ifdef HLSL
 #include "ShaderUtil.hlsli"
 #endif
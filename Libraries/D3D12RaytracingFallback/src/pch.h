@@ -86,6 +86,8 @@
 #include "GpuBvh2Copy.h"
 #include "TreeletReorder.h"
 #include "GpuBvh2Builder.h"
+#include "CpuTaskPool.h"
+#include "CpuBVH2Builder.h"
 
 // Dispatchers
 #include "UberShaderBindings.h"
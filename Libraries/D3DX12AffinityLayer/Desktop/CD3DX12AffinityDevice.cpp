@@ -398,6 +398,9 @@ void STDMETHODCALLTYPE CD3DX12AffinityDevice::CreateConstantBufferView(
     if (GetAffinityMode() == EAffinityMode::LDA)
     {
         ID3D12Device* Device = mDevices[0];
+        D3D12_GPU_VIRTUAL_ADDRESS BufferLocations[D3DX12_MAX_ACTIVE_NODES];
+        GetGPUVirtualAddresses(pDesc->BufferLocation, BufferLocations);
+
         for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
         {
             if (((1 << i) & EffectiveAffinityMask) != 0)
@@ -405,7 +408,7 @@ void STDMETHODCALLTYPE CD3DX12AffinityDevice::CreateConstantBufferView(
                 D3D12_CPU_DESCRIPTOR_HANDLE ActualDestDescriptor = GetCPUHeapPointer(DestDescriptor, i);
 
                 D3D12_CONSTANT_BUFFER_VIEW_DESC ActualDesc = *pDesc;
-                ActualDesc.BufferLocation = GetGPUVirtualAddress(pDesc->BufferLocation, i);
+                ActualDesc.BufferLocation = BufferLocations[i];
 
                 Device->CreateConstantBufferView(&ActualDesc, ActualDestDescriptor);
             }
@@ -1465,41 +1468,36 @@ D3D12_GPU_VIRTUAL_ADDRESS CD3DX12AffinityDevice::GetGPUVirtualAddress(D3D12_GPU_
     if (NodeIndex == 0)
         return Original;
 
-    if (Original == 0)
-        return 0;
+    D3D12_GPU_VIRTUAL_ADDRESS Addresses[D3DX12_MAX_ACTIVE_NODES];
+    GetGPUVirtualAddresses(Original, Addresses);
+    return Addresses[NodeIndex];
+}
+
+void CD3DX12AffinityDevice::GetGPUVirtualAddresses(D3D12_GPU_VIRTUAL_ADDRESS const& Original, D3D12_GPU_VIRTUAL_ADDRESS (&Addresses)[D3DX12_MAX_ACTIVE_NODES])
+{
+    // The Original pointer is assumed to be an offset into the known GPU virtual address range that starts at the
+    // next lowest (or equal) address. The table returns that offset against the range's base on every node at once,
+    // so callers recording for several nodes look it up once rather than once per node.
+    bool Translated = false;
 
+    // Resources only register their addresses when they exist on more than one node
+    if (Original != 0 && GetNodeCount() > 1
 #if TILE_MAPPING_GPUVA
-    if (GetAffinityMode() == EAffinityMode::LDA)
-        return Original;
+        && GetAffinityMode() != EAffinityMode::LDA
 #endif
-
-
-    // This function searches through our list of known GPU virtual addresses and finds the next lowest (or equal) address to the Original
-    // The Original pointer is then assumed to be an offset into some segment of memory that starts at the next lowest address.
-    // We use that offset against the equivalent base addresses across all devices.
-
-    // TODO: It is inefficient to look through this every time i.e. for each DeviceIndex.
-    // Possibly just cache the NextLowest here or change the interface to return a vector of offsetted pointers.
-    // Should probably do both, since surely the user will be using heap pointers often and it would be nice
-    // to simply save the base pointers for future lookup.
-    // Of course this would all go away if we had a way to have consistent virtual addresses across all devices!
-    // Also it might be possible to use proxy CPU memory allocated by the affinity layer to make this a simple lookup - see GetGPUHeapPointer.
-    D3D12_GPU_VIRTUAL_ADDRESS NextLowest;
-    D3D12_GPU_VIRTUAL_ADDRESS Return;
-
+        )
     {
-        std::lock_guard<std::mutex> lock(MutexGPUVirtualAddresses);
-
-        auto NextGreatestIterator = GPUVirtualAddresses.upper_bound(Original);
-        auto NextLowestIterator = --NextGreatestIterator;
-        NextLowest = NextLowestIterator->first;
-        Return = NextLowestIterator->second[NodeIndex];
+        Translated = GPUVirtualAddresses.Translate(Original, Addresses);
+        DEBUG_ASSERT(Translated);
     }
 
-    D3D12_GPU_VIRTUAL_ADDRESS const Offset = Original - NextLowest;
-    Return += Offset;
-
-    return Return;
+    if (!Translated)
+    {
+        for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES; i++)
+        {
+            Addresses[i] = Original;
+        }
+    }
 }
 
 void CD3DX12AffinityDevice::WriteApplicationMessage(D3D12_MESSAGE_SEVERITY const Severity, char const* const Message)
@@ -15,6 +15,8 @@
 #include "CD3DX12AffinityCommandList.h"
 #include "CD3DX12AffinityQueryHeap.h"
 #include "CD3DX12AffinityDevice.h"
+#include "AffinityCommandStream.h"
+#include <memory>
 
 class __declspec(uuid("BE1D71C8-88FD-4623-ABFA-D0E546D12FAF")) CD3DX12AffinityGraphicsCommandList : public CD3DX12AffinityCommandList
 {
@@ -280,6 +282,11 @@ public:
     UINT GetActiveAffinityMask();
 
 private:
+    typedef AffinityCommandStream<D3DX12_MAX_ACTIVE_NODES> CommandStream;
+
+    CommandStream& Record();
+    void ReplayCommandStream();
+
     ID3D12GraphicsCommandList* mGraphicsCommandLists[D3DX12_MAX_ACTIVE_NODES];
     UINT mAccumulatedAffinityMask;
     bool mUseDeviceActiveMaskOnReset;
@@ -288,4 +295,7 @@ private:
     std::vector<D3D12_VERTEX_BUFFER_VIEW> mCachedBufferViews;
     std::vector<D3D12_STREAM_OUTPUT_BUFFER_VIEW> mCachedStreamOutBufferViews;
     std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> mCachedRenderTargetViews;
+
+    // Only created with D3DX12_RECORD_ONCE_REPLAY_PER_NODE on multi-node devices
+    std::unique_ptr<CommandStream> mCommandStream;
 };
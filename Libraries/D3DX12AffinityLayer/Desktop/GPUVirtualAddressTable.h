@@ -0,0 +1,271 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+/**
+ * Translates GPU virtual addresses of resources duplicated on several nodes.
+ *
+ * Each range is keyed by the resource's address on node 0, which is the
+ * address the application sees. An address is treated as an offset into the
+ * range with the greatest base not above it, and comes back as the same
+ * offset into the resource on every node.
+ *
+ * Lookups take no locks. Readers binary search an immutable sorted snapshot.
+ * Writers are rare (a resource's first GetGPUVirtualAddress and its
+ * destruction). A writer copies the snapshot, edits the copy and publishes it
+ * (read-copy-update). A reader announces the snapshot it is searching in a
+ * hazard slot, and retired snapshots are only deleted once no slot holds them.
+ *
+ * Each thread also remembers the last range it hit. That cache stays valid
+ * until the table changes, so repeated bindings from the same buffer don't
+ * search at all.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+template <size_t NodeCount>
+class GPUVirtualAddressTable
+{
+public:
+    GPUVirtualAddressTable()
+        : mSnapshot(new Snapshot)
+        , mVersion(0)
+        , mTableId(NextTableId())
+    {
+        for (size_t i = 0; i < kReaderSlotCount; ++i)
+        {
+            mReaderSlots[i].Claimed.store(false, std::memory_order_relaxed);
+            mReaderSlots[i].Hazard.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~GPUVirtualAddressTable()
+    {
+        for (Snapshot const* Retired : mRetiredSnapshots)
+        {
+            delete Retired;
+        }
+        delete mSnapshot.load(std::memory_order_relaxed);
+    }
+
+    // NodeAddresses[i] is the start of the resource on node i. Registering
+    // the same node 0 address again replaces the old range.
+    void Register(uint64_t const* NodeAddresses)
+    {
+        std::lock_guard<std::mutex> lock(mWriterMutex);
+
+        Snapshot* Updated = new Snapshot(*mSnapshot.load(std::memory_order_relaxed));
+        auto Position = std::lower_bound(Updated->Ranges.begin(), Updated->Ranges.end(), NodeAddresses[0], RangeIsBelow);
+
+        Range Added;
+        std::copy(NodeAddresses, NodeAddresses + NodeCount, Added.NodeAddresses);
+        if (Position != Updated->Ranges.end() && Position->NodeAddresses[0] == NodeAddresses[0])
+        {
+            *Position = Added;
+        }
+        else
+        {
+            Updated->Ranges.insert(Position, Added);
+        }
+
+        Publish(Updated);
+    }
+
+    void Unregister(uint64_t Address)
+    {
+        std::lock_guard<std::mutex> lock(mWriterMutex);
+
+        Snapshot const* Current = mSnapshot.load(std::memory_order_relaxed);
+        auto Position = std::lower_bound(Current->Ranges.begin(), Current->Ranges.end(), Address, RangeIsBelow);
+        if (Position == Current->Ranges.end() || Position->NodeAddresses[0] != Address)
+        {
+            return;
+        }
+
+        Snapshot* Updated = new Snapshot(*Current);
+        Updated->Ranges.erase(Updated->Ranges.begin() + (Position - Current->Ranges.begin()));
+
+        Publish(Updated);
+    }
+
+    // Writes the address on every node for Address on node 0 to NodeAddresses.
+    // Returns false, writing nothing, if Address is below every range.
+    bool Translate(uint64_t Address, uint64_t* NodeAddresses) const
+    {
+        LastHit& Cache = GetLastHit();
+
+        // Read before the snapshot, so a cache entry can only be older than its version, never newer
+        uint64_t const Version = mVersion.load(std::memory_order_acquire);
+
+        if (Cache.TableId != mTableId || Cache.Version != Version || Address < Cache.Begin || Address >= Cache.End)
+        {
+            ReaderSlot& Slot = ClaimReaderSlot();
+
+            Snapshot const* Current = mSnapshot.load(std::memory_order_acquire);
+            for (;;)
+            {
+                Slot.Hazard.store(Current, std::memory_order_seq_cst);
+                Snapshot const* Check = mSnapshot.load(std::memory_order_seq_cst);
+                if (Check == Current)
+                {
+                    break;
+                }
+                Current = Check;
+            }
+
+            std::vector<Range> const& Ranges = Current->Ranges;
+            auto Next = std::upper_bound(Ranges.begin(), Ranges.end(), Address, AddressIsBelow);
+            bool const Found = Next != Ranges.begin();
+            if (Found)
+            {
+                Range const& Hit = *(Next - 1);
+                Cache.TableId = mTableId;
+                Cache.Version = Version;
+                Cache.Begin = Hit.NodeAddresses[0];
+                Cache.End = Next == Ranges.end() ? UINT64_MAX : Next->NodeAddresses[0];
+                std::copy(Hit.NodeAddresses, Hit.NodeAddresses + NodeCount, Cache.NodeAddresses);
+            }
+
+            Slot.Hazard.store(nullptr, std::memory_order_release);
+            Slot.Claimed.store(false, std::memory_order_release);
+
+            if (!Found)
+            {
+                return false;
+            }
+        }
+
+        uint64_t const Offset = Address - Cache.Begin;
+        for (size_t i = 0; i < NodeCount; ++i)
+        {
+            NodeAddresses[i] = Cache.NodeAddresses[i] + Offset;
+        }
+        return true;
+    }
+
+private:
+    struct Range
+    {
+        uint64_t NodeAddresses[NodeCount];
+    };
+
+    struct Snapshot
+    {
+        std::vector<Range> Ranges;  // Sorted by the node 0 address
+    };
+
+    struct alignas(64) ReaderSlot
+    {
+        std::atomic<bool> Claimed;
+        std::atomic<Snapshot const*> Hazard;
+    };
+
+    struct LastHit
+    {
+        uint64_t TableId;
+        uint64_t Version;
+        uint64_t Begin;
+        uint64_t End;
+        uint64_t NodeAddresses[NodeCount];
+    };
+
+    // More threads than this can search at once, but they take turns for a slot
+    static size_t const kReaderSlotCount = 64;
+
+    static bool RangeIsBelow(Range const& Left, uint64_t Address) { return Left.NodeAddresses[0] < Address; }
+    static bool AddressIsBelow(uint64_t Address, Range const& Right) { return Address < Right.NodeAddresses[0]; }
+
+    // Ids rather than table pointers key the per-thread cache, so a new table
+    // at a freed table's address doesn't see its cached ranges
+    static uint64_t NextTableId()
+    {
+        static std::atomic<uint64_t> sNextTableId(1);
+        return sNextTableId.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static LastHit& GetLastHit()
+    {
+        static thread_local LastHit sLastHit = {};
+        return sLastHit;
+    }
+
+    ReaderSlot& ClaimReaderSlot() const
+    {
+        // Threads start from different slots so that they rarely share one
+        static thread_local size_t sFirstSlot = std::hash<std::thread::id>()(std::this_thread::get_id());
+
+        for (size_t Attempt = 0; ; ++Attempt)
+        {
+            ReaderSlot& Slot = mReaderSlots[(sFirstSlot + Attempt) % kReaderSlotCount];
+            if (!Slot.Claimed.load(std::memory_order_relaxed) && !Slot.Claimed.exchange(true, std::memory_order_acquire))
+            {
+                return Slot;
+            }
+            if (Attempt % kReaderSlotCount == kReaderSlotCount - 1)
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // Called with mWriterMutex held
+    void Publish(Snapshot* Updated)
+    {
+        Snapshot const* Previous = mSnapshot.load(std::memory_order_relaxed);
+        mSnapshot.store(Updated, std::memory_order_seq_cst);
+        mVersion.fetch_add(1, std::memory_order_release);
+        mRetiredSnapshots.push_back(Previous);
+
+        // Delete every retired snapshot that no reader has announced. A reader
+        // that loads one after this point sees it has been replaced and moves on.
+        for (size_t r = 0; r < mRetiredSnapshots.size(); )
+        {
+            if (IsAnnounced(mRetiredSnapshots[r]))
+            {
+                ++r;
+            }
+            else
+            {
+                delete mRetiredSnapshots[r];
+                mRetiredSnapshots[r] = mRetiredSnapshots.back();
+                mRetiredSnapshots.pop_back();
+            }
+        }
+    }
+
+    bool IsAnnounced(Snapshot const* Retired) const
+    {
+        for (size_t i = 0; i < kReaderSlotCount; ++i)
+        {
+            if (mReaderSlots[i].Hazard.load(std::memory_order_seq_cst) == Retired)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::atomic<Snapshot const*> mSnapshot;
+    std::atomic<uint64_t> mVersion;
+    uint64_t const mTableId;
+
+    std::mutex mWriterMutex;
+    std::vector<Snapshot const*> mRetiredSnapshots;
+
+    mutable ReaderSlot mReaderSlots[kReaderSlotCount];
+};
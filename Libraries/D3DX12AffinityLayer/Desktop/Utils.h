@@ -55,6 +55,11 @@
 
 //#define ALWAYS_RESET_ALL_COMMAND_LISTS 1
 
+// Records each graphics command list once, and at Close replays it into every node's
+// command list in parallel, instead of forwarding each call to every node as it is made.
+// Translates GPUVAs and descriptors in one batch per Close. See AffinityCommandStream.h.
+//#define D3DX12_RECORD_ONCE_REPLAY_PER_NODE 1
+
 ////////////////////////////
 // DEBUG CONFIG ////////////
 ////////////////////////////
@@ -0,0 +1,1056 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "AffinityCommandStreamTest.h"
+#include "../Desktop/AffinityCommandStream.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+    const size_t kNodeCount = 2;
+    typedef AffinityCommandStream<kNodeCount> CommandStream;
+
+    // A node's addresses and descriptors are node 0's plus a per-node offset
+    const uint64_t kNodeAddressOffset = 0x0000100000000000ull;
+    const size_t kNodeDescriptorOffset = 0x01000000;
+
+    D3D12_GPU_VIRTUAL_ADDRESS NodeAddress(D3D12_GPU_VIRTUAL_ADDRESS address, size_t node)
+    {
+        return address != 0 ? address + node * kNodeAddressOffset : 0;
+    }
+
+    D3D12_CPU_DESCRIPTOR_HANDLE NodeDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE handle, size_t node)
+    {
+        handle.ptr += node * kNodeDescriptorOffset;
+        return handle;
+    }
+
+    D3D12_GPU_DESCRIPTOR_HANDLE NodeDescriptor(D3D12_GPU_DESCRIPTOR_HANDLE handle, size_t node)
+    {
+        handle.ptr += node * kNodeDescriptorOffset;
+        return handle;
+    }
+
+    struct MockTranslator
+    {
+        void TranslateAddress(D3D12_GPU_VIRTUAL_ADDRESS address, D3D12_GPU_VIRTUAL_ADDRESS (&nodeAddresses)[kNodeCount])
+        {
+            for (size_t node = 0; node < kNodeCount; ++node)
+                nodeAddresses[node] = NodeAddress(address, node);
+        }
+
+        void TranslateCPUDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE handle, D3D12_CPU_DESCRIPTOR_HANDLE (&nodeHandles)[kNodeCount])
+        {
+            for (size_t node = 0; node < kNodeCount; ++node)
+                nodeHandles[node] = NodeDescriptor(handle, node);
+        }
+
+        void TranslateGPUDescriptor(D3D12_GPU_DESCRIPTOR_HANDLE handle, D3D12_GPU_DESCRIPTOR_HANDLE (&nodeHandles)[kNodeCount])
+        {
+            for (size_t node = 0; node < kNodeCount; ++node)
+                nodeHandles[node] = NodeDescriptor(handle, node);
+        }
+    };
+
+    // Logs every call and the values it was passed.  Arrays are logged by
+    // content, so two lists that saw the same calls have the same log.
+    class MockCommandList
+    {
+    public:
+        void ClearState(ID3D12PipelineState* pPipelineState) { Call(__LINE__, pPipelineState); }
+
+        void DrawInstanced(UINT vertexCount, UINT instanceCount, UINT startVertex, UINT startInstance)
+        {
+            Call(__LINE__, vertexCount, instanceCount, startVertex, startInstance);
+        }
+
+        void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+        {
+            Call(__LINE__, indexCount, instanceCount, startIndex, baseVertex, startInstance);
+        }
+
+        void Dispatch(UINT x, UINT y, UINT z) { Call(__LINE__, x, y, z); }
+
+        void CopyBufferRegion(ID3D12Resource* pDst, UINT64 dstOffset, ID3D12Resource* pSrc, UINT64 srcOffset, UINT64 numBytes)
+        {
+            Call(__LINE__, pDst, dstOffset, pSrc, srcOffset, numBytes);
+        }
+
+        void CopyTextureRegion(const D3D12_TEXTURE_COPY_LOCATION* pDst, UINT dstX, UINT dstY, UINT dstZ,
+            const D3D12_TEXTURE_COPY_LOCATION* pSrc, const D3D12_BOX* pSrcBox)
+        {
+            Call(__LINE__, dstX, dstY, dstZ);
+            Push(*pDst);
+            Push(*pSrc);
+            PushArray(pSrcBox, 1);
+        }
+
+        void CopyResource(ID3D12Resource* pDst, ID3D12Resource* pSrc) { Call(__LINE__, pDst, pSrc); }
+
+        void CopyTiles(ID3D12Resource* pTiledResource, const D3D12_TILED_RESOURCE_COORDINATE* pStart, const D3D12_TILE_REGION_SIZE* pSize,
+            ID3D12Resource* pBuffer, UINT64 bufferOffset, D3D12_TILE_COPY_FLAGS flags)
+        {
+            Call(__LINE__, pTiledResource, pBuffer, bufferOffset, flags);
+            PushArray(pStart, 1);
+            PushArray(pSize, 1);
+        }
+
+        void ResolveSubresource(ID3D12Resource* pDst, UINT dstSubresource, ID3D12Resource* pSrc, UINT srcSubresource, DXGI_FORMAT format)
+        {
+            Call(__LINE__, pDst, dstSubresource, pSrc, srcSubresource, format);
+        }
+
+        void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology) { Call(__LINE__, topology); }
+
+        void RSSetViewports(UINT numViewports, const D3D12_VIEWPORT* pViewports)
+        {
+            Call(__LINE__, numViewports);
+            PushArray(pViewports, numViewports);
+        }
+
+        void RSSetScissorRects(UINT numRects, const D3D12_RECT* pRects)
+        {
+            Call(__LINE__, numRects);
+            PushArray(pRects, numRects);
+        }
+
+        void OMSetBlendFactor(const FLOAT blendFactor[4])
+        {
+            Call(__LINE__);
+            PushArray(blendFactor, 4);
+        }
+
+        void OMSetStencilRef(UINT stencilRef) { Call(__LINE__, stencilRef); }
+
+        void SetPipelineState(ID3D12PipelineState* pPipelineState) { Call(__LINE__, pPipelineState); }
+
+        void ResourceBarrier(UINT numBarriers, const D3D12_RESOURCE_BARRIER* pBarriers)
+        {
+            Call(__LINE__, numBarriers);
+            for (UINT b = 0; b < numBarriers; ++b)
+                Push(pBarriers[b]);
+        }
+
+        void ExecuteBundle(ID3D12GraphicsCommandList* pBundle) { Call(__LINE__, pBundle); }
+
+        void SetDescriptorHeaps(UINT numHeaps, ID3D12DescriptorHeap* const* ppHeaps)
+        {
+            Call(__LINE__, numHeaps);
+            PushArray(ppHeaps, numHeaps);
+        }
+
+        void SetComputeRootSignature(ID3D12RootSignature* pRootSignature) { Call(__LINE__, pRootSignature); }
+        void SetGraphicsRootSignature(ID3D12RootSignature* pRootSignature) { Call(__LINE__, pRootSignature); }
+
+        void SetComputeRootDescriptorTable(UINT index, D3D12_GPU_DESCRIPTOR_HANDLE base) { Call(__LINE__, index, base.ptr); }
+        void SetGraphicsRootDescriptorTable(UINT index, D3D12_GPU_DESCRIPTOR_HANDLE base) { Call(__LINE__, index, base.ptr); }
+
+        void SetComputeRoot32BitConstant(UINT index, UINT data, UINT offset) { Call(__LINE__, index, data, offset); }
+        void SetGraphicsRoot32BitConstant(UINT index, UINT data, UINT offset) { Call(__LINE__, index, data, offset); }
+
+        void SetComputeRoot32BitConstants(UINT index, UINT count, const void* pData, UINT offset)
+        {
+            Call(__LINE__, index, count, offset);
+            PushArray(static_cast<const UINT*>(pData), count);
+        }
+
+        void SetGraphicsRoot32BitConstants(UINT index, UINT count, const void* pData, UINT offset)
+        {
+            Call(__LINE__, index, count, offset);
+            PushArray(static_cast<const UINT*>(pData), count);
+        }
+
+        void SetComputeRootConstantBufferView(UINT index, D3D12_GPU_VIRTUAL_ADDRESS address) { Call(__LINE__, index, address); }
+        void SetGraphicsRootConstantBufferView(UINT index, D3D12_GPU_VIRTUAL_ADDRESS address) { Call(__LINE__, index, address); }
+        void SetComputeRootShaderResourceView(UINT index, D3D12_GPU_VIRTUAL_ADDRESS address) { Call(__LINE__, index, address); }
+        void SetGraphicsRootShaderResourceView(UINT index, D3D12_GPU_VIRTUAL_ADDRESS address) { Call(__LINE__, index, address); }
+        void SetComputeRootUnorderedAccessView(UINT index, D3D12_GPU_VIRTUAL_ADDRESS address) { Call(__LINE__, index, address); }
+        void SetGraphicsRootUnorderedAccessView(UINT index, D3D12_GPU_VIRTUAL_ADDRESS address) { Call(__LINE__, index, address); }
+
+        void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* pView)
+        {
+            Call(__LINE__);
+            PushArray(pView, 1);
+        }
+
+        void IASetVertexBuffers(UINT startSlot, UINT numViews, const D3D12_VERTEX_BUFFER_VIEW* pViews)
+        {
+            Call(__LINE__, startSlot, numViews);
+            PushArray(pViews, numViews);
+        }
+
+        void SOSetTargets(UINT startSlot, UINT numViews, const D3D12_STREAM_OUTPUT_BUFFER_VIEW* pViews)
+        {
+            Call(__LINE__, startSlot, numViews);
+            PushArray(pViews, numViews);
+        }
+
+        void OMSetRenderTargets(UINT numDescriptors, const D3D12_CPU_DESCRIPTOR_HANDLE* pDescriptors, BOOL singleHandle,
+            const D3D12_CPU_DESCRIPTOR_HANDLE* pDepthStencil)
+        {
+            Call(__LINE__, numDescriptors, singleHandle);
+            PushArray(pDescriptors, singleHandle ? (numDescriptors > 0 ? 1 : 0) : numDescriptors);
+            PushArray(pDepthStencil, 1);
+        }
+
+        void ClearDepthStencilView(D3D12_CPU_DESCRIPTOR_HANDLE view, D3D12_CLEAR_FLAGS flags, FLOAT depth, UINT8 stencil,
+            UINT numRects, const D3D12_RECT* pRects)
+        {
+            Call(__LINE__, view.ptr, flags, depth, stencil, numRects);
+            PushArray(pRects, numRects);
+        }
+
+        void ClearRenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE view, const FLOAT color[4], UINT numRects, const D3D12_RECT* pRects)
+        {
+            Call(__LINE__, view.ptr, numRects);
+            PushArray(color, 4);
+            PushArray(pRects, numRects);
+        }
+
+        void ClearUnorderedAccessViewUint(D3D12_GPU_DESCRIPTOR_HANDLE gpuView, D3D12_CPU_DESCRIPTOR_HANDLE cpuView, ID3D12Resource* pResource,
+            const UINT values[4], UINT numRects, const D3D12_RECT* pRects)
+        {
+            Call(__LINE__, gpuView.ptr, cpuView.ptr, pResource, numRects);
+            PushArray(values, 4);
+            PushArray(pRects, numRects);
+        }
+
+        void ClearUnorderedAccessViewFloat(D3D12_GPU_DESCRIPTOR_HANDLE gpuView, D3D12_CPU_DESCRIPTOR_HANDLE cpuView, ID3D12Resource* pResource,
+            const FLOAT values[4], UINT numRects, const D3D12_RECT* pRects)
+        {
+            Call(__LINE__, gpuView.ptr, cpuView.ptr, pResource, numRects);
+            PushArray(values, 4);
+            PushArray(pRects, numRects);
+        }
+
+        void DiscardResource(ID3D12Resource* pResource, const D3D12_DISCARD_REGION* pRegion)
+        {
+            Call(__LINE__, pResource, pRegion != nullptr);
+            if (pRegion)
+            {
+                Push(pRegion->NumRects, pRegion->FirstSubresource, pRegion->NumSubresources);
+                PushArray(pRegion->pRects, pRegion->NumRects);
+            }
+        }
+
+        void BeginQuery(ID3D12QueryHeap* pQueryHeap, D3D12_QUERY_TYPE type, UINT index) { Call(__LINE__, pQueryHeap, type, index); }
+        void EndQuery(ID3D12QueryHeap* pQueryHeap, D3D12_QUERY_TYPE type, UINT index) { Call(__LINE__, pQueryHeap, type, index); }
+
+        void ResolveQueryData(ID3D12QueryHeap* pQueryHeap, D3D12_QUERY_TYPE type, UINT startIndex, UINT numQueries,
+            ID3D12Resource* pDestination, UINT64 offset)
+        {
+            Call(__LINE__, pQueryHeap, type, startIndex, numQueries, pDestination, offset);
+        }
+
+        void SetPredication(ID3D12Resource* pBuffer, UINT64 offset, D3D12_PREDICATION_OP operation) { Call(__LINE__, pBuffer, offset, operation); }
+
+        void SetMarker(UINT metadata, const void* pData, UINT size)
+        {
+            Call(__LINE__, metadata, size);
+            PushArray(static_cast<const BYTE*>(pData), size);
+        }
+
+        void BeginEvent(UINT metadata, const void* pData, UINT size)
+        {
+            Call(__LINE__, metadata, size);
+            PushArray(static_cast<const BYTE*>(pData), size);
+        }
+
+        void EndEvent() { Call(__LINE__); }
+
+        void ExecuteIndirect(ID3D12CommandSignature* pSignature, UINT maxCommandCount, ID3D12Resource* pArguments, UINT64 argumentOffset,
+            ID3D12Resource* pCount, UINT64 countOffset)
+        {
+            Call(__LINE__, pSignature, maxCommandCount, pArguments, argumentOffset, pCount, countOffset);
+        }
+
+        std::vector<uint64_t> m_log;
+
+        // Where each call starts in the log, to report the first call that differs
+        std::vector<size_t> m_callStarts;
+
+    private:
+        template <typename... Args>
+        void Call(int method, Args... args)
+        {
+            m_callStarts.push_back(m_log.size());
+            m_log.push_back((uint64_t)method);
+            Push(args...);
+        }
+
+        void Push() {}
+
+        template <typename T, typename... Rest>
+        void Push(T value, Rest... rest)
+        {
+            PushValue(value);
+            Push(rest...);
+        }
+
+        template <typename T>
+        void PushValue(T* pointer) { m_log.push_back((uint64_t)(uintptr_t)pointer); }
+
+        template <typename T>
+        typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type PushValue(T value) { m_log.push_back((uint64_t)value); }
+
+        void PushValue(FLOAT value)
+        {
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            m_log.push_back(bits);
+        }
+
+        void PushValue(const D3D12_TEXTURE_COPY_LOCATION& location)
+        {
+            Push(location.pResource, location.Type);
+            if (location.Type == D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT)
+            {
+                const D3D12_SUBRESOURCE_FOOTPRINT& footprint = location.PlacedFootprint.Footprint;
+                Push(location.PlacedFootprint.Offset, footprint.Format, footprint.Width, footprint.Height, footprint.Depth, footprint.RowPitch);
+            }
+            else
+            {
+                Push(location.SubresourceIndex);
+            }
+        }
+
+        void PushValue(const D3D12_RESOURCE_BARRIER& barrier)
+        {
+            Push(barrier.Type, barrier.Flags);
+            if (barrier.Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION)
+                Push(barrier.Transition.pResource, barrier.Transition.Subresource, barrier.Transition.StateBefore, barrier.Transition.StateAfter);
+            else if (barrier.Type == D3D12_RESOURCE_BARRIER_TYPE_ALIASING)
+                Push(barrier.Aliasing.pResourceBefore, barrier.Aliasing.pResourceAfter);
+            else
+                Push(barrier.UAV.pResource);
+        }
+
+        // Logs whether the array was passed and, if it was, its bytes.  An
+        // empty array may be passed either way.
+        template <typename T>
+        void PushArray(const T* elements, size_t count)
+        {
+            m_log.push_back(elements != nullptr && count > 0);
+            if (elements == nullptr)
+                return;
+            const BYTE* bytes = reinterpret_cast<const BYTE*>(elements);
+            for (size_t i = 0; i < count * sizeof(T); ++i)
+                m_log.push_back(bytes[i]);
+        }
+    };
+
+    template <typename T>
+    struct NodeObjects
+    {
+        T* nodes[kNodeCount];
+    };
+
+    // Replays what the command list's immediate mode would have done on each node in a mask
+    class Recorder
+    {
+    public:
+        Recorder(std::mt19937& rng) : m_usedNodeMask(0), m_rng(rng), m_nodeMask(0) {}
+
+        uint32_t Random(uint32_t count) { return m_rng() % count; }
+
+        void SetNodeMask(UINT nodeMask)
+        {
+            m_stream.SetNodeMask(nodeMask);
+            m_nodeMask = nodeMask;
+        }
+
+        template <typename Function>
+        void Expect(Function&& function)
+        {
+            m_usedNodeMask |= m_nodeMask;
+            for (size_t node = 0; node < kNodeCount; ++node)
+            {
+                if ((m_nodeMask & (1 << node)) != 0)
+                    function(m_expected[node], node);
+            }
+        }
+
+        // Fake objects that are different on every node; some optional ones are null
+        template <typename T>
+        NodeObjects<T> Objects(bool optional = false)
+        {
+            NodeObjects<T> objects;
+            uintptr_t id = optional && Random(4) == 0 ? 0 : (uintptr_t)(Random(1 << 20) + 1) << 8;
+            for (size_t node = 0; node < kNodeCount; ++node)
+                objects.nodes[node] = id != 0 ? reinterpret_cast<T*>(id | (node + 1)) : nullptr;
+            return objects;
+        }
+
+        D3D12_GPU_VIRTUAL_ADDRESS Address() { return Random(8) == 0 ? 0 : 0x100000000ull + ((uint64_t)m_rng() << 8); }
+        D3D12_CPU_DESCRIPTOR_HANDLE CPUDescriptor() { D3D12_CPU_DESCRIPTOR_HANDLE handle = { 0x10000 + Random(1 << 20) * 32 }; return handle; }
+        D3D12_GPU_DESCRIPTOR_HANDLE GPUDescriptor() { D3D12_GPU_DESCRIPTOR_HANDLE handle = { 0x10000 + Random(1 << 20) * 32 }; return handle; }
+
+        // Arrays the caller owns, which are overwritten after every call
+        template <typename T>
+        T* Scratch(size_t count)
+        {
+            m_scratch.resize(count * sizeof(T) + 1);
+            for (size_t i = 0; i < m_scratch.size(); ++i)
+                m_scratch[i] = (BYTE)m_rng();
+            return reinterpret_cast<T*>(m_scratch.data());
+        }
+
+        void Scribble()
+        {
+            if (!m_scratch.empty())
+                memset(m_scratch.data(), 0xcd, m_scratch.size());
+        }
+
+        CommandStream m_stream;
+        MockCommandList m_expected[kNodeCount];
+        UINT m_usedNodeMask;
+
+    private:
+        std::mt19937& m_rng;
+        UINT m_nodeMask;
+        std::vector<BYTE> m_scratch;
+    };
+
+    const uint32_t kNumCommandTypes = 50;
+
+    void RecordRandomCommand(Recorder& r, uint32_t type)
+    {
+        CommandStream& stream = r.m_stream;
+
+        switch (type)
+        {
+        case 0:
+        {
+            NodeObjects<ID3D12PipelineState> pso = r.Objects<ID3D12PipelineState>(true);
+            stream.ClearState(pso.nodes[0] ? pso.nodes : nullptr);
+            r.Expect([&](MockCommandList& list, size_t node) { list.ClearState(pso.nodes[node]); });
+            break;
+        }
+        case 1:
+        {
+            UINT a = r.Random(1000), b = r.Random(10), c = r.Random(1000), d = r.Random(10);
+            stream.DrawInstanced(a, b, c, d);
+            r.Expect([&](MockCommandList& list, size_t) { list.DrawInstanced(a, b, c, d); });
+            break;
+        }
+        case 2:
+        {
+            UINT a = r.Random(1000), b = r.Random(10), c = r.Random(1000), e = r.Random(10);
+            INT d = (INT)r.Random(1000) - 500;
+            stream.DrawIndexedInstanced(a, b, c, d, e);
+            r.Expect([&](MockCommandList& list, size_t) { list.DrawIndexedInstanced(a, b, c, d, e); });
+            break;
+        }
+        case 3:
+        {
+            UINT x = r.Random(64), y = r.Random(64), z = r.Random(64);
+            stream.Dispatch(x, y, z);
+            r.Expect([&](MockCommandList& list, size_t) { list.Dispatch(x, y, z); });
+            break;
+        }
+        case 4:
+        {
+            NodeObjects<ID3D12Resource> dst = r.Objects<ID3D12Resource>(), src = r.Objects<ID3D12Resource>();
+            UINT64 dstOffset = r.Random(1 << 20), srcOffset = r.Random(1 << 20), numBytes = r.Random(1 << 16);
+            stream.CopyBufferRegion(dst.nodes, dstOffset, src.nodes, srcOffset, numBytes);
+            r.Expect([&](MockCommandList& list, size_t node) { list.CopyBufferRegion(dst.nodes[node], dstOffset, src.nodes[node], srcOffset, numBytes); });
+            break;
+        }
+        case 5:
+        {
+            NodeObjects<ID3D12Resource> dstResources = r.Objects<ID3D12Resource>(), srcResources = r.Objects<ID3D12Resource>();
+            D3D12_TEXTURE_COPY_LOCATION dst = {}, src = {};
+            dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+            dst.SubresourceIndex = r.Random(16);
+            src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+            src.PlacedFootprint.Offset = r.Random(1 << 20) * 512;
+            src.PlacedFootprint.Footprint.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+            src.PlacedFootprint.Footprint.Width = r.Random(4096);
+            src.PlacedFootprint.Footprint.Height = r.Random(4096);
+            src.PlacedFootprint.Footprint.Depth = 1;
+            src.PlacedFootprint.Footprint.RowPitch = 256 * r.Random(64);
+            UINT x = r.Random(64), y = r.Random(64), z = r.Random(4);
+            D3D12_BOX* box = r.Random(2) ? r.Scratch<D3D12_BOX>(1) : nullptr;
+            stream.CopyTextureRegion(dst, dstResources.nodes, x, y, z, src, srcResources.nodes, box);
+            r.Expect([&](MockCommandList& list, size_t node)
+            {
+                D3D12_TEXTURE_COPY_LOCATION nodeDst = dst, nodeSrc = src;
+                nodeDst.pResource = dstResources.nodes[node];
+                nodeSrc.pResource = srcResources.nodes[node];
+                list.CopyTextureRegion(&nodeDst, x, y, z, &nodeSrc, box);
+            });
+            break;
+        }
+        case 6:
+        {
+            NodeObjects<ID3D12Resource> dst = r.Objects<ID3D12Resource>(), src = r.Objects<ID3D12Resource>();
+            stream.CopyResource(dst.nodes, src.nodes);
+            r.Expect([&](MockCommandList& list, size_t node) { list.CopyResource(dst.nodes[node], src.nodes[node]); });
+            break;
+        }
+        case 7:
+        {
+            NodeObjects<ID3D12Resource> resources = r.Objects<ID3D12Resource>();
+            UINT target = r.Random(kNodeCount);
+            stream.CopyResourceToNode(resources.nodes, target);
+            r.Expect([&](MockCommandList& list, size_t node) { list.CopyResource(resources.nodes[target], resources.nodes[node]); });
+            break;
+        }
+        case 8:
+        {
+            NodeObjects<ID3D12Resource> tiled = r.Objects<ID3D12Resource>(), buffer = r.Objects<ID3D12Resource>();
+            D3D12_TILED_RESOURCE_COORDINATE* start = r.Scratch<D3D12_TILED_RESOURCE_COORDINATE>(1);
+            D3D12_TILE_REGION_SIZE size = { r.Random(64), TRUE, 1, 1, 1 };
+            UINT64 offset = r.Random(1 << 20);
+            D3D12_TILE_COPY_FLAGS flags = r.Random(2) ? D3D12_TILE_COPY_FLAG_NONE : D3D12_TILE_COPY_FLAG_NO_HAZARD;
+            stream.CopyTiles(tiled.nodes, start, &size, buffer.nodes, offset, flags);
+            r.Expect([&](MockCommandList& list, size_t node) { list.CopyTiles(tiled.nodes[node], start, &size, buffer.nodes[node], offset, flags); });
+            break;
+        }
+        case 9:
+        {
+            NodeObjects<ID3D12Resource> dst = r.Objects<ID3D12Resource>(), src = r.Objects<ID3D12Resource>();
+            UINT dstSubresource = r.Random(8), srcSubresource = r.Random(8);
+            stream.ResolveSubresource(dst.nodes, dstSubresource, src.nodes, srcSubresource, DXGI_FORMAT_R16G16B16A16_FLOAT);
+            r.Expect([&](MockCommandList& list, size_t node)
+            {
+                list.ResolveSubresource(dst.nodes[node], dstSubresource, src.nodes[node], srcSubresource, DXGI_FORMAT_R16G16B16A16_FLOAT);
+            });
+            break;
+        }
+        case 10:
+        {
+            D3D12_PRIMITIVE_TOPOLOGY topology = (D3D12_PRIMITIVE_TOPOLOGY)r.Random(6);
+            stream.IASetPrimitiveTopology(topology);
+            r.Expect([&](MockCommandList& list, size_t) { list.IASetPrimitiveTopology(topology); });
+            break;
+        }
+        case 11:
+        {
+            UINT count = r.Random(5);
+            D3D12_VIEWPORT* viewports = r.Scratch<D3D12_VIEWPORT>(count);
+            stream.RSSetViewports(count, viewports);
+            r.Expect([&](MockCommandList& list, size_t) { list.RSSetViewports(count, viewports); });
+            break;
+        }
+        case 12:
+        {
+            UINT count = r.Random(5);
+            D3D12_RECT* rects = r.Scratch<D3D12_RECT>(count);
+            stream.RSSetScissorRects(count, rects);
+            r.Expect([&](MockCommandList& list, size_t) { list.RSSetScissorRects(count, rects); });
+            break;
+        }
+        case 13:
+        {
+            FLOAT* blendFactor = r.Random(4) ? r.Scratch<FLOAT>(4) : nullptr;
+            stream.OMSetBlendFactor(blendFactor);
+            r.Expect([&](MockCommandList& list, size_t) { list.OMSetBlendFactor(blendFactor); });
+            break;
+        }
+        case 14:
+        {
+            UINT stencilRef = r.Random(256);
+            stream.OMSetStencilRef(stencilRef);
+            r.Expect([&](MockCommandList& list, size_t) { list.OMSetStencilRef(stencilRef); });
+            break;
+        }
+        case 15:
+        {
+            NodeObjects<ID3D12PipelineState> pso = r.Objects<ID3D12PipelineState>();
+            stream.SetPipelineState(pso.nodes);
+            r.Expect([&](MockCommandList& list, size_t node) { list.SetPipelineState(pso.nodes[node]); });
+            break;
+        }
+        case 16:
+        {
+            UINT count = r.Random(6);
+            std::vector<D3D12_RESOURCE_BARRIER> descs(count);
+            std::vector<NodeObjects<ID3D12Resource>> before(count), after(count);
+            CommandStream::Barrier* barriers = stream.ResourceBarrier(count);
+            for (UINT b = 0; b < count; ++b)
+            {
+                D3D12_RESOURCE_BARRIER& desc = descs[b];
+                memset(&desc, 0, sizeof(desc));
+                desc.Type = (D3D12_RESOURCE_BARRIER_TYPE)r.Random(3);
+                desc.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+                before[b] = r.Objects<ID3D12Resource>(true);
+                after[b] = r.Objects<ID3D12Resource>(true);
+                if (desc.Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION)
+                {
+                    desc.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+                    desc.Transition.StateBefore = D3D12_RESOURCE_STATE_RENDER_TARGET;
+                    desc.Transition.StateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+                }
+
+                barriers[b].Desc = desc;
+                for (size_t node = 0; node < kNodeCount; ++node)
+                {
+                    barriers[b].Resources[node] = before[b].nodes[node];
+                    barriers[b].ResourcesAfter[node] = after[b].nodes[node];
+                }
+            }
+            r.Expect([&](MockCommandList& list, size_t node)
+            {
+                std::vector<D3D12_RESOURCE_BARRIER> nodeBarriers = descs;
+                for (UINT b = 0; b < count; ++b)
+                {
+                    if (descs[b].Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION)
+                        nodeBarriers[b].Transition.pResource = before[b].nodes[node];
+                    else if (descs[b].Type == D3D12_RESOURCE_BARRIER_TYPE_ALIASING)
+                    {
+                        nodeBarriers[b].Aliasing.pResourceBefore = before[b].nodes[node];
+                        nodeBarriers[b].Aliasing.pResourceAfter = after[b].nodes[node];
+                    }
+                    else
+                        nodeBarriers[b].UAV.pResource = before[b].nodes[node];
+                }
+                list.ResourceBarrier(count, nodeBarriers.data());
+            });
+            break;
+        }
+        case 17:
+        {
+            NodeObjects<ID3D12GraphicsCommandList> bundle = r.Objects<ID3D12GraphicsCommandList>();
+            stream.ExecuteBundle(bundle.nodes);
+            r.Expect([&](MockCommandList& list, size_t node) { list.ExecuteBundle(bundle.nodes[node]); });
+            break;
+        }
+        case 18:
+        {
+            UINT count = 1 + r.Random(2);
+            ID3D12DescriptorHeap* heaps[2][kNodeCount] = {};
+            for (UINT h = 0; h < count; ++h)
+            {
+                NodeObjects<ID3D12DescriptorHeap> heap = r.Objects<ID3D12DescriptorHeap>();
+                for (size_t node = 0; node < kNodeCount; ++node)
+                    heaps[h][node] = heap.nodes[node];
+            }
+            stream.SetDescriptorHeaps(count, heaps);
+            r.Expect([&](MockCommandList& list, size_t node)
+            {
+                ID3D12DescriptorHeap* nodeHeaps[2] = { heaps[0][node], heaps[1][node] };
+                list.SetDescriptorHeaps(count, nodeHeaps);
+            });
+            break;
+        }
+        case 19:
+        case 20:
+        {
+            NodeObjects<ID3D12RootSignature> rootSignature = r.Objects<ID3D12RootSignature>();
+            if (type == 19)
+            {
+                stream.SetComputeRootSignature(rootSignature.nodes);
+                r.Expect([&](MockCommandList& list, size_t node) { list.SetComputeRootSignature(rootSignature.nodes[node]); });
+            }
+            else
+            {
+                stream.SetGraphicsRootSignature(rootSignature.nodes);
+                r.Expect([&](MockCommandList& list, size_t node) { list.SetGraphicsRootSignature(rootSignature.nodes[node]); });
+            }
+            break;
+        }
+        case 21:
+        case 22:
+        {
+            UINT index = r.Random(8);
+            D3D12_GPU_DESCRIPTOR_HANDLE base = r.GPUDescriptor();
+            if (type == 21)
+            {
+                stream.SetComputeRootDescriptorTable(index, base);
+                r.Expect([&](MockCommandList& list, size_t node) { list.SetComputeRootDescriptorTable(index, NodeDescriptor(base, node)); });
+            }
+            else
+            {
+                stream.SetGraphicsRootDescriptorTable(index, base);
+                r.Expect([&](MockCommandList& list, size_t node) { list.SetGraphicsRootDescriptorTable(index, NodeDescriptor(base, node)); });
+            }
+            break;
+        }
+        case 23:
+        case 24:
+        {
+            UINT index = r.Random(8), data = (UINT)r.Random(1u << 31), offset = r.Random(16);
+            if (type == 23)
+            {
+                stream.SetComputeRoot32BitConstant(index, data, offset);
+                r.Expect([&](MockCommandList& list, size_t) { list.SetComputeRoot32BitConstant(index, data, offset); });
+            }
+            else
+            {
+                stream.SetGraphicsRoot32BitConstant(index, data, offset);
+                r.Expect([&](MockCommandList& list, size_t) { list.SetGraphicsRoot32BitConstant(index, data, offset); });
+            }
+            break;
+        }
+        case 25:
+        case 26:
+        {
+            UINT index = r.Random(8), count = 1 + r.Random(16), offset = r.Random(16);
+            UINT* data = r.Scratch<UINT>(count);
+            if (type == 25)
+            {
+                stream.SetComputeRoot32BitConstants(index, count, data, offset);
+                r.Expect([&](MockCommandList& list, size_t) { list.SetComputeRoot32BitConstants(index, count, data, offset); });
+            }
+            else
+            {
+                stream.SetGraphicsRoot32BitConstants(index, count, data, offset);
+                r.Expect([&](MockCommandList& list, size_t) { list.SetGraphicsRoot32BitConstants(index, count, data, offset); });
+            }
+            break;
+        }
+        case 27:
+        case 28:
+        case 29:
+        case 30:
+        case 31:
+        case 32:
+        {
+            UINT index = r.Random(8);
+            D3D12_GPU_VIRTUAL_ADDRESS address = r.Address();
+            switch (type)
+            {
+            case 27:
+                stream.SetComputeRootConstantBufferView(index, address);
+                r.Expect([&](MockCommandList& list, size_t node) { list.SetComputeRootConstantBufferView(index, NodeAddress(address, node)); });
+                break;
+            case 28:
+                stream.SetGraphicsRootConstantBufferView(index, address);
+                r.Expect([&](MockCommandList& list, size_t node) { list.SetGraphicsRootConstantBufferView(index, NodeAddress(address, node)); });
+                break;
+            case 29:
+                stream.SetComputeRootShaderResourceView(index, address);
+                r.Expect([&](MockCommandList& list, size_t node) { list.SetComputeRootShaderResourceView(index, NodeAddress(address, node)); });
+                break;
+            case 30:
+                stream.SetGraphicsRootShaderResourceView(index, address);
+                r.Expect([&](MockCommandList& list, size_t node) { list.SetGraphicsRootShaderResourceView(index, NodeAddress(address, node)); });
+                break;
+            case 31:
+                stream.SetComputeRootUnorderedAccessView(index, address);
+                r.Expect([&](MockCommandList& list, size_t node) { list.SetComputeRootUnorderedAccessView(index, NodeAddress(address, node)); });
+                break;
+            default:
+                stream.SetGraphicsRootUnorderedAccessView(index, address);
+                r.Expect([&](MockCommandList& list, size_t node) { list.SetGraphicsRootUnorderedAccessView(index, NodeAddress(address, node)); });
+                break;
+            }
+            break;
+        }
+        case 33:
+        {
+            D3D12_INDEX_BUFFER_VIEW* view = r.Random(4) ? r.Scratch<D3D12_INDEX_BUFFER_VIEW>(1) : nullptr;
+            if (view)
+                view->BufferLocation = r.Address();
+            stream.IASetIndexBuffer(view);
+            r.Expect([&](MockCommandList& list, size_t node)
+            {
+                if (view)
+                {
+                    D3D12_INDEX_BUFFER_VIEW nodeView = *view;
+                    nodeView.BufferLocation = NodeAddress(view->BufferLocation, node);
+                    list.IASetIndexBuffer(&nodeView);
+                }
+                else
+                {
+                    list.IASetIndexBuffer(nullptr);
+                }
+            });
+            break;
+        }
+        case 34:
+        {
+            UINT startSlot = r.Random(4), count = r.Random(5);
+            D3D12_VERTEX_BUFFER_VIEW* views = r.Random(4) ? r.Scratch<D3D12_VERTEX_BUFFER_VIEW>(count) : nullptr;
+            for (UINT v = 0; views && v < count; ++v)
+                views[v].BufferLocation = r.Address();
+            stream.IASetVertexBuffers(startSlot, count, views);
+            r.Expect([&](MockCommandList& list, size_t node)
+            {
+                std::vector<D3D12_VERTEX_BUFFER_VIEW> nodeViews(views ? views : (D3D12_VERTEX_BUFFER_VIEW*)nullptr, views ? views + count : nullptr);
+                for (UINT v = 0; v < nodeViews.size(); ++v)
+                    nodeViews[v].BufferLocation = NodeAddress(views[v].BufferLocation, node);
+                list.IASetVertexBuffers(startSlot, count, views ? nodeViews.data() : nullptr);
+            });
+            break;
+        }
+        case 35:
+        {
+            UINT startSlot = r.Random(2), count = r.Random(3);
+            D3D12_STREAM_OUTPUT_BUFFER_VIEW* views = r.Random(4) ? r.Scratch<D3D12_STREAM_OUTPUT_BUFFER_VIEW>(count) : nullptr;
+            for (UINT v = 0; views && v < count; ++v)
+            {
+                views[v].BufferLocation = r.Address();
+                views[v].BufferFilledSizeLocation = r.Address();
+            }
+            stream.SOSetTargets(startSlot, count, views);
+            r.Expect([&](MockCommandList& list, size_t node)
+            {
+                std::vector<D3D12_STREAM_OUTPUT_BUFFER_VIEW> nodeViews(views ? views : (D3D12_STREAM_OUTPUT_BUFFER_VIEW*)nullptr, views ? views + count : nullptr);
+                for (UINT v = 0; v < nodeViews.size(); ++v)
+                {
+                    nodeViews[v].BufferLocation = NodeAddress(views[v].BufferLocation, node);
+                    nodeViews[v].BufferFilledSizeLocation = NodeAddress(views[v].BufferFilledSizeLocation, node);
+                }
+                list.SOSetTargets(startSlot, count, views ? nodeViews.data() : nullptr);
+            });
+            break;
+        }
+        case 36:
+        {
+            UINT count = r.Random(5);
+            BOOL singleHandle = r.Random(4) == 0;
+            D3D12_CPU_DESCRIPTOR_HANDLE* renderTargets = r.Scratch<D3D12_CPU_DESCRIPTOR_HANDLE>(count);
+            for (UINT t = 0; t < count; ++t)
+                renderTargets[t] = r.CPUDescriptor();
+            D3D12_CPU_DESCRIPTOR_HANDLE depthStencil = r.CPUDescriptor();
+            bool hasDepthStencil = r.Random(2) != 0;
+            stream.OMSetRenderTargets(count, renderTargets, singleHandle, hasDepthStencil ? &depthStencil : nullptr);
+            r.Expect([&](MockCommandList& list, size_t node)
+            {
+                std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> nodeRenderTargets(count);
+                for (UINT t = 0; t < count; ++t)
+                    nodeRenderTargets[t] = NodeDescriptor(renderTargets[t], node);
+                D3D12_CPU_DESCRIPTOR_HANDLE nodeDepthStencil = NodeDescriptor(depthStencil, node);
+                list.OMSetRenderTargets(count, nodeRenderTargets.data(), singleHandle, hasDepthStencil ? &nodeDepthStencil : nullptr);
+            });
+            break;
+        }
+        case 37:
+        {
+            D3D12_CPU_DESCRIPTOR_HANDLE view = r.CPUDescriptor();
+            D3D12_CLEAR_FLAGS flags = (D3D12_CLEAR_FLAGS)(1 + r.Random(3));
+            FLOAT depth = r.Random(2) ? 1.0f : 0.0f;
+            UINT8 stencil = (UINT8)r.Random(256);
+            UINT count = r.Random(3);
+            D3D12_RECT* rects = r.Random(2) ? r.Scratch<D3D12_RECT>(count) : nullptr;
+            stream.ClearDepthStencilView(view, flags, depth, stencil, rects ? count : 0, rects);
+            r.Expect([&](MockCommandList& list, size_t node)
+            {
+                list.ClearDepthStencilView(NodeDescriptor(view, node), flags, depth, stencil, rects ? count : 0, rects);
+            });
+            break;
+        }
+        case 38:
+        {
+            D3D12_CPU_DESCRIPTOR_HANDLE view = r.CPUDescriptor();
+            UINT count = r.Random(3);
+            FLOAT color[4] = { 0.25f, 0.5f, 0.75f, (FLOAT)r.Random(2) };
+            D3D12_RECT* rects = r.Random(2) ? r.Scratch<D3D12_RECT>(count) : nullptr;
+            stream.ClearRenderTargetView(view, color, rects ? count : 0, rects);
+            r.Expect([&](MockCommandList& list, size_t node) { list.ClearRenderTargetView(NodeDescriptor(view, node), color, rects ? count : 0, rects); });
+            break;
+        }
+        case 39:
+        case 40:
+        {
+            D3D12_GPU_DESCRIPTOR_HANDLE gpuView = r.GPUDescriptor();
+            D3D12_CPU_DESCRIPTOR_HANDLE cpuView = r.CPUDescriptor();
+            NodeObjects<ID3D12Resource> resource = r.Objects<ID3D12Resource>();
+            UINT count = r.Random(3);
+            D3D12_RECT* rects = r.Random(2) ? r.Scratch<D3D12_RECT>(count) : nullptr;
+            UINT uintValues[4] = { r.Random(256), r.Random(256), r.Random(256), r.Random(256) };
+            FLOAT floatValues[4] = { 0.0f, 1.0f, 0.5f, (FLOAT)r.Random(2) };
+            if (type == 39)
+            {
+                stream.ClearUnorderedAccessViewUint(gpuView, cpuView, resource.nodes, uintValues, rects ? count : 0, rects);
+                r.Expect([&](MockCommandList& list, size_t node)
+                {
+                    list.ClearUnorderedAccessViewUint(NodeDescriptor(gpuView, node), NodeDescriptor(cpuView, node), resource.nodes[node], uintValues, rects ? count : 0, rects);
+                });
+            }
+            else
+            {
+                stream.ClearUnorderedAccessViewFloat(gpuView, cpuView, resource.nodes, floatValues, rects ? count : 0, rects);
+                r.Expect([&](MockCommandList& list, size_t node)
+                {
+                    list.ClearUnorderedAccessViewFloat(NodeDescriptor(gpuView, node), NodeDescriptor(cpuView, node), resource.nodes[node], floatValues, rects ? count : 0, rects);
+                });
+            }
+            break;
+        }
+        case 41:
+        {
+            NodeObjects<ID3D12Resource> resource = r.Objects<ID3D12Resource>();
+            UINT count = r.Random(3);
+            D3D12_DISCARD_REGION region = { count, r.Random(2) ? r.Scratch<D3D12_RECT>(count) : nullptr, r.Random(4), 1 + r.Random(4) };
+            if (region.pRects == nullptr)
+                region.NumRects = 0;
+            bool hasRegion = r.Random(4) != 0;
+            stream.DiscardResource(resource.nodes, hasRegion ? &region : nullptr);
+            r.Expect([&](MockCommandList& list, size_t node) { list.DiscardResource(resource.nodes[node], hasRegion ? &region : nullptr); });
+            break;
+        }
+        case 42:
+        case 43:
+        {
+            NodeObjects<ID3D12QueryHeap> heap = r.Objects<ID3D12QueryHeap>();
+            D3D12_QUERY_TYPE queryType = r.Random(2) ? D3D12_QUERY_TYPE_OCCLUSION : D3D12_QUERY_TYPE_TIMESTAMP;
+            UINT index = r.Random(64);
+            if (type == 42)
+            {
+                stream.BeginQuery(heap.nodes, queryType, index);
+                r.Expect([&](MockCommandList& list, size_t node) { list.BeginQuery(heap.nodes[node], queryType, index); });
+            }
+            else
+            {
+                stream.EndQuery(heap.nodes, queryType, index);
+                r.Expect([&](MockCommandList& list, size_t node) { list.EndQuery(heap.nodes[node], queryType, index); });
+            }
+            break;
+        }
+        case 44:
+        {
+            NodeObjects<ID3D12QueryHeap> heap = r.Objects<ID3D12QueryHeap>();
+            NodeObjects<ID3D12Resource> destination = r.Objects<ID3D12Resource>();
+            UINT start = r.Random(64), count = r.Random(64);
+            UINT64 offset = r.Random(1024) * 8;
+            stream.ResolveQueryData(heap.nodes, D3D12_QUERY_TYPE_TIMESTAMP, start, count, destination.nodes, offset);
+            r.Expect([&](MockCommandList& list, size_t node)
+            {
+                list.ResolveQueryData(heap.nodes[node], D3D12_QUERY_TYPE_TIMESTAMP, start, count, destination.nodes[node], offset);
+            });
+            break;
+        }
+        case 45:
+        {
+            NodeObjects<ID3D12Resource> buffer = r.Objects<ID3D12Resource>(true);
+            UINT64 offset = r.Random(1024) * 8;
+            D3D12_PREDICATION_OP operation = r.Random(2) ? D3D12_PREDICATION_OP_EQUAL_ZERO : D3D12_PREDICATION_OP_NOT_EQUAL_ZERO;
+            stream.SetPredication(buffer.nodes[0] ? buffer.nodes : nullptr, offset, operation);
+            r.Expect([&](MockCommandList& list, size_t node) { list.SetPredication(buffer.nodes[node], offset, operation); });
+            break;
+        }
+        case 46:
+        case 47:
+        {
+            UINT metadata = r.Random(3), size = r.Random(40);
+            BYTE* data = r.Random(8) ? r.Scratch<BYTE>(size) : nullptr;
+            if (type == 46)
+            {
+                stream.SetMarker(metadata, data, size);
+                r.Expect([&](MockCommandList& list, size_t) { list.SetMarker(metadata, data, size); });
+            }
+            else
+            {
+                stream.BeginEvent(metadata, data, size);
+                r.Expect([&](MockCommandList& list, size_t) { list.BeginEvent(metadata, data, size); });
+            }
+            break;
+        }
+        case 48:
+        {
+            stream.EndEvent();
+            r.Expect([&](MockCommandList& list, size_t) { list.EndEvent(); });
+            break;
+        }
+        default:
+        {
+            NodeObjects<ID3D12CommandSignature> signature = r.Objects<ID3D12CommandSignature>();
+            NodeObjects<ID3D12Resource> arguments = r.Objects<ID3D12Resource>();
+            NodeObjects<ID3D12Resource> counts = r.Objects<ID3D12Resource>(true);
+            UINT maxCount = r.Random(1024);
+            UINT64 argumentOffset = r.Random(1024) * 4, countOffset = r.Random(1024) * 4;
+            stream.ExecuteIndirect(signature.nodes, maxCount, arguments.nodes, argumentOffset, counts.nodes[0] ? counts.nodes : nullptr, countOffset);
+            r.Expect([&](MockCommandList& list, size_t node)
+            {
+                list.ExecuteIndirect(signature.nodes[node], maxCount, arguments.nodes[node], argumentOffset, counts.nodes[node], countOffset);
+            });
+            break;
+        }
+        }
+
+        r.Scribble();
+    }
+
+    bool CompareLogs(const MockCommandList& replayed, const MockCommandList& expected, uint32_t sequence, size_t node)
+    {
+        if (replayed.m_log == expected.m_log)
+            return true;
+
+        size_t call = 0;
+        while (call < replayed.m_callStarts.size() && call < expected.m_callStarts.size())
+        {
+            size_t start = expected.m_callStarts[call];
+            size_t end = call + 1 < expected.m_callStarts.size() ? expected.m_callStarts[call + 1] : expected.m_log.size();
+            if (replayed.m_callStarts[call] != start || replayed.m_log.size() < end ||
+                !std::equal(expected.m_log.begin() + start, expected.m_log.begin() + end, replayed.m_log.begin() + start))
+            {
+                break;
+            }
+            ++call;
+        }
+
+        printf("sequence %u, node %zu: call %zu (mock line %llu) differs; %zu calls replayed, %zu expected\n", sequence, node, call,
+            call < expected.m_callStarts.size() ? (unsigned long long)expected.m_log[expected.m_callStarts[call]] : 0ull,
+            replayed.m_callStarts.size(), expected.m_callStarts.size());
+        return false;
+    }
+}
+
+int TestAffinityCommandStream(uint32_t seed)
+{
+    printf("affinity command stream test (seed %u)\n", seed);
+
+    std::mt19937 rng(seed);
+    const uint32_t numSequences = 500;
+    const uint32_t maxCommandsPerSequence = 200;
+
+    // One stream is reused throughout, as a command list reuses it after every Reset
+    CommandStream stream;
+    uint32_t numCommands = 0;
+
+    for (uint32_t sequence = 0; sequence < numSequences; ++sequence)
+    {
+        Recorder recorder(rng);
+        std::swap(recorder.m_stream, stream);
+        recorder.m_stream.Reset();
+
+        uint32_t length = recorder.Random(maxCommandsPerSequence);
+        for (uint32_t i = 0; i < length; ++i)
+        {
+            // Affinity changes now and then, sometimes to every node and sometimes to none
+            if (i == 0 || recorder.Random(16) == 0)
+                recorder.SetNodeMask(recorder.Random(1 << kNodeCount));
+
+            RecordRandomCommand(recorder, recorder.Random(kNumCommandTypes));
+        }
+        numCommands += length;
+
+        if (recorder.m_stream.GetUsedNodeMask() != recorder.m_usedNodeMask)
+        {
+            printf("sequence %u: used node mask is 0x%x, expected 0x%x\n", sequence, recorder.m_stream.GetUsedNodeMask(), recorder.m_usedNodeMask);
+            return -1;
+        }
+
+        MockTranslator translator;
+        recorder.m_stream.Translate(translator);
+        for (size_t node = 0; node < kNodeCount; ++node)
+        {
+            MockCommandList replayed;
+            recorder.m_stream.Replay(&replayed, (UINT)node);
+            if (!CompareLogs(replayed, recorder.m_expected[node], sequence, node))
+                return -1;
+        }
+
+        std::swap(recorder.m_stream, stream);
+    }
+
+    printf("  %u commands in %u sequences replay as recorded on %zu nodes: ok\n", numCommands, numSequences, kNodeCount);
+    return 0;
+}
@@ -0,0 +1,28 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+#include <stdint.h>
+
+//-----------------------------------------------------------------------------
+//  AffinityCommandStream checks
+//-----------------------------------------------------------------------------
+//  Records random sequences of every graphics command list call into the
+//  affinity layer's command stream, switching the node mask as it goes.  Each
+//  sequence is replayed for both nodes into a mock command list, which must
+//  see exactly the calls, with per-node objects, addresses and descriptors,
+//  that the immediate mode would have made on that node.  The caller's
+//  arrays are overwritten after every call to check the stream copied them.
+//  Returns 0 on success.
+//-----------------------------------------------------------------------------
+
+int TestAffinityCommandStream(uint32_t seed);
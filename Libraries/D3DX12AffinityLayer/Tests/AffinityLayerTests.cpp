@@ -0,0 +1,48 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// Checks and benchmarks for the parts of the affinity layer that don't need a
+// device.  They only include the layer's headers, so they build on their own.
+
+#include "AffinityCommandStreamTest.h"
+#include "GPUVirtualAddressTableBenchmark.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void PrintHelp()
+{
+    printf("usage:\n");
+    printf("AffinityLayerTests -test_command_stream [seed]\n");
+    printf("AffinityLayerTests -benchmark_gpuva_table [threads]\n");
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        PrintHelp();
+        return -1;
+    }
+
+    if (0 == strcmp(argv[1], "-test_command_stream"))
+    {
+        return TestAffinityCommandStream(argc > 2 ? (uint32_t)atoi(argv[2]) : 1);
+    }
+    else if (0 == strcmp(argv[1], "-benchmark_gpuva_table"))
+    {
+        return BenchmarkGPUVirtualAddressTable(argc > 2 ? (uint32_t)atoi(argv[2]) : 16);
+    }
+
+    PrintHelp();
+    return -1;
+}
@@ -0,0 +1,231 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "GPUVirtualAddressTableBenchmark.h"
+#include "../Desktop/GPUVirtualAddressTable.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const size_t kNodeCount = 2;
+    const uint32_t kBufferCount = 4096;
+    const uint64_t kBufferSize = 32 * 1024;
+
+    // Transient buffers are created in the gap after each buffer, so they move
+    // range boundaries without changing what any lookup should return
+    const uint64_t kBufferSpacing = 64 * 1024;
+    const uint64_t kTransientOffset = 48 * 1024;
+
+    // Bindings made from one buffer before moving on to the next
+    const uint32_t kBindsPerBuffer = 4;
+
+    const uint64_t kNodeHeapBase[kNodeCount] = { 0x0000000100000000ull, 0x0000004000000000ull };
+
+    // Buffers are laid out in a different order on node 1, as separate devices would place them
+    uint64_t BufferAddress(uint32_t buffer, size_t node)
+    {
+        uint32_t slot = node == 0 ? buffer : (buffer * 1031) % kBufferCount;
+        return kNodeHeapBase[node] + slot * kBufferSpacing;
+    }
+
+    // The pattern CD3DX12AffinityDevice used before GPUVirtualAddressTable, where
+    // GetGPUVirtualAddress was called, and locked, once per node
+    class MutexMapTranslator
+    {
+    public:
+        void Register(uint64_t const* nodeAddresses)
+        {
+            std::lock_guard<std::mutex> lockGuard(m_mutex);
+            m_addresses[nodeAddresses[0]].assign(nodeAddresses, nodeAddresses + kNodeCount);
+        }
+
+        void Unregister(uint64_t address)
+        {
+            std::lock_guard<std::mutex> lockGuard(m_mutex);
+            m_addresses.erase(address);
+        }
+
+        bool Translate(uint64_t address, uint64_t* nodeAddresses)
+        {
+            nodeAddresses[0] = address;
+            for (size_t node = 1; node < kNodeCount; ++node)
+            {
+                std::lock_guard<std::mutex> lockGuard(m_mutex);
+                auto next = m_addresses.upper_bound(address);
+                if (next == m_addresses.begin())
+                    return false;
+                --next;
+                nodeAddresses[node] = next->second[node] + (address - next->first);
+            }
+            return true;
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::map<uint64_t, std::vector<uint64_t>> m_addresses;
+    };
+
+    class TableTranslator
+    {
+    public:
+        void Register(uint64_t const* nodeAddresses) { m_table.Register(nodeAddresses); }
+        void Unregister(uint64_t address) { m_table.Unregister(address); }
+        bool Translate(uint64_t address, uint64_t* nodeAddresses) { return m_table.Translate(address, nodeAddresses); }
+
+    private:
+        GPUVirtualAddressTable<kNodeCount> m_table;
+    };
+
+    struct Random
+    {
+        explicit Random(uint32_t seed) : state(seed * 2654435761u + 1) {}
+
+        uint32_t Next()
+        {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            return (uint32_t)(state >> 33);
+        }
+
+        uint64_t state;
+    };
+
+    // Returns translations per second, or a negative value if a translation was wrong
+    template <typename Translator>
+    double MeasureTranslations(Translator& translator, uint32_t numThreads, uint32_t numTranslationsPerThread, uint32_t& numUpdates)
+    {
+        typedef std::chrono::high_resolution_clock Clock;
+
+        for (uint32_t buffer = 0; buffer < kBufferCount; ++buffer)
+        {
+            uint64_t nodeAddresses[kNodeCount];
+            for (size_t node = 0; node < kNodeCount; ++node)
+                nodeAddresses[node] = BufferAddress(buffer, node);
+            translator.Register(nodeAddresses);
+        }
+
+        std::atomic<bool> done(false);
+        std::atomic<bool> failed(false);
+        std::atomic<uint32_t> updates(0);
+
+        // Resource creation and destruction is rare next to binding
+        std::thread writer([&]()
+        {
+            const uint32_t kLiveTransients = 64;
+            std::vector<uint64_t> live;
+            Random random(0);
+            while (!done)
+            {
+                uint32_t buffer = random.Next() % kBufferCount;
+                uint64_t nodeAddresses[kNodeCount];
+                for (size_t node = 0; node < kNodeCount; ++node)
+                    nodeAddresses[node] = BufferAddress(buffer, node) + kTransientOffset;
+                translator.Register(nodeAddresses);
+                live.push_back(nodeAddresses[0]);
+
+                if (live.size() > kLiveTransients)
+                {
+                    size_t victim = random.Next() % live.size();
+                    translator.Unregister(live[victim]);
+                    live[victim] = live.back();
+                    live.pop_back();
+                }
+
+                updates.fetch_add(1, std::memory_order_relaxed);
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+
+        Clock::time_point start = Clock::now();
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < numThreads; ++t)
+        {
+            threads.emplace_back([&, t]()
+            {
+                Random random(t + 1);
+                uint32_t buffer = 0;
+                for (uint32_t i = 0; i < numTranslationsPerThread && !failed; ++i)
+                {
+                    if (i % kBindsPerBuffer == 0)
+                        buffer = random.Next() % kBufferCount;
+
+                    uint64_t offset = (random.Next() % kBufferSize) & ~255ull;
+                    uint64_t nodeAddresses[kNodeCount];
+                    if (!translator.Translate(BufferAddress(buffer, 0) + offset, nodeAddresses))
+                    {
+                        printf("thread %u: buffer %u not found\n", t, buffer);
+                        failed = true;
+                        break;
+                    }
+
+                    for (size_t node = 0; node < kNodeCount; ++node)
+                    {
+                        if (nodeAddresses[node] != BufferAddress(buffer, node) + offset)
+                        {
+                            printf("thread %u: buffer %u offset %llu translated wrongly on node %zu\n", t, buffer,
+                                (unsigned long long)offset, node);
+                            failed = true;
+                            break;
+                        }
+                    }
+                }
+            });
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        done = true;
+        writer.join();
+        numUpdates = updates.load();
+
+        return failed ? -1.0 : numThreads * (double)numTranslationsPerThread / seconds;
+    }
+}
+
+int BenchmarkGPUVirtualAddressTable(uint32_t maxThreads)
+{
+    const uint32_t numTranslations = 8000000;
+    maxThreads = std::max(maxThreads, 1u);
+
+    printf("GPU virtual address translation benchmark (%u buffers, %zu nodes, %u bindings per buffer)\n",
+        kBufferCount, kNodeCount, kBindsPerBuffer);
+    printf("%-12s %16s %8s %16s %8s\n", "", "mutex + map", "updates", "table", "updates");
+
+    for (uint32_t numThreads = 1; ; numThreads = std::min(numThreads * 2, maxThreads))
+    {
+        MutexMapTranslator mutexTranslator;
+        TableTranslator tableTranslator;
+        uint32_t mutexUpdates = 0;
+        uint32_t tableUpdates = 0;
+        double mutexRate = MeasureTranslations(mutexTranslator, numThreads, numTranslations / numThreads, mutexUpdates);
+        double tableRate = MeasureTranslations(tableTranslator, numThreads, numTranslations / numThreads, tableUpdates);
+        if (mutexRate < 0.0 || tableRate < 0.0)
+            return 1;
+
+        char label[32];
+        sprintf_s(label, "%u thread%s", numThreads, numThreads > 1 ? "s" : "");
+        printf("%-12s %12.2f M/s %8u %12.2f M/s %8u\n", label, mutexRate / 1e6, mutexUpdates,
+            tableRate / 1e6, tableUpdates);
+
+        if (numThreads == maxThreads)
+            break;
+    }
+
+    return 0;
+}
@@ -0,0 +1,28 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#pragma once
+
+#include <stdint.h>
+
+//-----------------------------------------------------------------------------
+//  GPU virtual address translation benchmark
+//-----------------------------------------------------------------------------
+//  Simulates the affinity layer binding root CBVs and vertex buffers on two
+//  nodes: threads translate addresses at a few offsets into one buffer, then
+//  move on to another.  Meanwhile a writer thread registers and unregisters
+//  transient buffers in the gaps between them, as resources are created and
+//  destroyed.  The mutex + std::map lookup the affinity device used before,
+//  one per node, is timed against GPUVirtualAddressTable for 1 thread up to
+//  maxThreads.  A wrong translation returns non-zero.
+//-----------------------------------------------------------------------------
+
+int BenchmarkGPUVirtualAddressTable(uint32_t maxThreads);
@@ -0,0 +1,1403 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+/**
+ * Records graphics command list calls once and replays them on each node.
+ *
+ * By default CD3DX12AffinityGraphicsCommandList forwards every call to the
+ * command list of each active node as it is made. With
+ * D3DX12_RECORD_ONCE_REPLAY_PER_NODE it appends the call to this stream
+ * instead. The stream is a linear buffer of fixed-layout records:
+ * - objects are stored as their children on every node;
+ * - GPU virtual addresses and descriptor handles are stored as indices into
+ *   tables of the values the application passed.
+ *
+ * At Close, Translate resolves those tables for all nodes in one pass. Replay
+ * then fills one node's command list, and only reads the stream, so every
+ * node can be replayed on its own thread.
+ *
+ * Replay is a template on the command list type so the encoding can be
+ * checked against a mock command list.
+ */
+
+#pragma once
+
+#include <d3d12.h>
+#include <cstring>
+#include <vector>
+
+template <size_t NodeCount>
+class AffinityCommandStream
+{
+public:
+    // A barrier whose resources are filled in per node when it is replayed
+    struct Barrier
+    {
+        D3D12_RESOURCE_BARRIER Desc;
+        ID3D12Resource* Resources[NodeCount];       // Transition or UAV resource, or the aliasing resource before
+        ID3D12Resource* ResourcesAfter[NodeCount];  // The aliasing resource after
+    };
+
+    AffinityCommandStream()
+        : mNodeMask(0)
+        , mUsedNodeMask(0)
+    {
+    }
+
+    // Forgets every recorded command. Memory is kept for the next recording.
+    void Reset()
+    {
+        mCommands.clear();
+        mAddresses.clear();
+        mCPUDescriptors.clear();
+        mGPUDescriptors.clear();
+        mNodeMask = 0;
+        mUsedNodeMask = 0;
+    }
+
+    // The nodes that at least one command was recorded for
+    UINT GetUsedNodeMask() const
+    {
+        return mUsedNodeMask;
+    }
+
+    // Commands recorded after this are replayed only on the nodes in NodeMask
+    void SetNodeMask(UINT NodeMask)
+    {
+        if (NodeMask != mNodeMask)
+        {
+            Allocate<NodeMaskCommand>(ECommand::SetNodeMask)->NodeMask = NodeMask;
+            mNodeMask = NodeMask;
+        }
+    }
+
+    // Objects are passed as their children on every node, for example
+    // CD3DX12AffinityResource::mResources. Optional objects may be nullptr.
+
+    void ClearState(ID3D12PipelineState* const* PipelineStates)
+    {
+        CopyNodes(Record<PipelineStateCommand>(ECommand::ClearState)->PipelineStates, PipelineStates);
+    }
+
+    void DrawInstanced(UINT VertexCountPerInstance, UINT InstanceCount, UINT StartVertexLocation, UINT StartInstanceLocation)
+    {
+        DrawInstancedCommand* Command = Record<DrawInstancedCommand>(ECommand::DrawInstanced);
+        Command->VertexCountPerInstance = VertexCountPerInstance;
+        Command->InstanceCount = InstanceCount;
+        Command->StartVertexLocation = StartVertexLocation;
+        Command->StartInstanceLocation = StartInstanceLocation;
+    }
+
+    void DrawIndexedInstanced(UINT IndexCountPerInstance, UINT InstanceCount, UINT StartIndexLocation, INT BaseVertexLocation, UINT StartInstanceLocation)
+    {
+        DrawIndexedInstancedCommand* Command = Record<DrawIndexedInstancedCommand>(ECommand::DrawIndexedInstanced);
+        Command->IndexCountPerInstance = IndexCountPerInstance;
+        Command->InstanceCount = InstanceCount;
+        Command->StartIndexLocation = StartIndexLocation;
+        Command->BaseVertexLocation = BaseVertexLocation;
+        Command->StartInstanceLocation = StartInstanceLocation;
+    }
+
+    void Dispatch(UINT ThreadGroupCountX, UINT ThreadGroupCountY, UINT ThreadGroupCountZ)
+    {
+        DispatchCommand* Command = Record<DispatchCommand>(ECommand::Dispatch);
+        Command->ThreadGroupCountX = ThreadGroupCountX;
+        Command->ThreadGroupCountY = ThreadGroupCountY;
+        Command->ThreadGroupCountZ = ThreadGroupCountZ;
+    }
+
+    void CopyBufferRegion(ID3D12Resource* const* DstBuffers, UINT64 DstOffset, ID3D12Resource* const* SrcBuffers, UINT64 SrcOffset, UINT64 NumBytes)
+    {
+        CopyBufferRegionCommand* Command = Record<CopyBufferRegionCommand>(ECommand::CopyBufferRegion);
+        CopyNodes(Command->DstBuffers, DstBuffers);
+        CopyNodes(Command->SrcBuffers, SrcBuffers);
+        Command->DstOffset = DstOffset;
+        Command->SrcOffset = SrcOffset;
+        Command->NumBytes = NumBytes;
+    }
+
+    // The locations' pResource members are ignored
+    void CopyTextureRegion(
+        D3D12_TEXTURE_COPY_LOCATION const& Dst, ID3D12Resource* const* DstResources, UINT DstX, UINT DstY, UINT DstZ,
+        D3D12_TEXTURE_COPY_LOCATION const& Src, ID3D12Resource* const* SrcResources, D3D12_BOX const* pSrcBox)
+    {
+        CopyTextureRegionCommand* Command = Record<CopyTextureRegionCommand>(ECommand::CopyTextureRegion);
+        Command->Dst = Dst;
+        Command->Src = Src;
+        CopyNodes(Command->DstResources, DstResources);
+        CopyNodes(Command->SrcResources, SrcResources);
+        Command->DstX = DstX;
+        Command->DstY = DstY;
+        Command->DstZ = DstZ;
+        Command->HasSrcBox = pSrcBox != nullptr;
+        if (pSrcBox)
+        {
+            Command->SrcBox = *pSrcBox;
+        }
+    }
+
+    void CopyResource(ID3D12Resource* const* DstResources, ID3D12Resource* const* SrcResources)
+    {
+        CopyResourceCommand* Command = Record<CopyResourceCommand>(ECommand::CopyResource);
+        CopyNodes(Command->DstResources, DstResources);
+        CopyNodes(Command->SrcResources, SrcResources);
+    }
+
+    // Replayed on the recording node as a copy from its resource to the resource on TargetNode
+    void CopyResourceToNode(ID3D12Resource* const* Resources, UINT TargetNode)
+    {
+        CopyResourceToNodeCommand* Command = Record<CopyResourceToNodeCommand>(ECommand::CopyResourceToNode);
+        CopyNodes(Command->Resources, Resources);
+        Command->TargetNode = TargetNode;
+    }
+
+    void CopyTiles(
+        ID3D12Resource* const* TiledResources, D3D12_TILED_RESOURCE_COORDINATE const* pTileRegionStartCoordinate, D3D12_TILE_REGION_SIZE const* pTileRegionSize,
+        ID3D12Resource* const* Buffers, UINT64 BufferStartOffsetInBytes, D3D12_TILE_COPY_FLAGS Flags)
+    {
+        CopyTilesCommand* Command = Record<CopyTilesCommand>(ECommand::CopyTiles);
+        CopyNodes(Command->TiledResources, TiledResources);
+        CopyNodes(Command->Buffers, Buffers);
+        Command->TileRegionStartCoordinate = *pTileRegionStartCoordinate;
+        Command->TileRegionSize = *pTileRegionSize;
+        Command->BufferStartOffsetInBytes = BufferStartOffsetInBytes;
+        Command->Flags = Flags;
+    }
+
+    void ResolveSubresource(ID3D12Resource* const* DstResources, UINT DstSubresource, ID3D12Resource* const* SrcResources, UINT SrcSubresource, DXGI_FORMAT Format)
+    {
+        ResolveSubresourceCommand* Command = Record<ResolveSubresourceCommand>(ECommand::ResolveSubresource);
+        CopyNodes(Command->DstResources, DstResources);
+        CopyNodes(Command->SrcResources, SrcResources);
+        Command->DstSubresource = DstSubresource;
+        Command->SrcSubresource = SrcSubresource;
+        Command->Format = Format;
+    }
+
+    void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY PrimitiveTopology)
+    {
+        Record<PrimitiveTopologyCommand>(ECommand::IASetPrimitiveTopology)->PrimitiveTopology = PrimitiveTopology;
+    }
+
+    void RSSetViewports(UINT NumViewports, D3D12_VIEWPORT const* pViewports)
+    {
+        RecordArray(ECommand::RSSetViewports, NumViewports, pViewports);
+    }
+
+    void RSSetScissorRects(UINT NumRects, D3D12_RECT const* pRects)
+    {
+        RecordArray(ECommand::RSSetScissorRects, NumRects, pRects);
+    }
+
+    void OMSetBlendFactor(FLOAT const BlendFactor[4])
+    {
+        BlendFactorCommand* Command = Record<BlendFactorCommand>(ECommand::OMSetBlendFactor);
+        Command->HasBlendFactor = BlendFactor != nullptr;
+        if (BlendFactor)
+        {
+            memcpy(Command->BlendFactor, BlendFactor, sizeof(Command->BlendFactor));
+        }
+    }
+
+    void OMSetStencilRef(UINT StencilRef)
+    {
+        Record<StencilRefCommand>(ECommand::OMSetStencilRef)->StencilRef = StencilRef;
+    }
+
+    void SetPipelineState(ID3D12PipelineState* const* PipelineStates)
+    {
+        CopyNodes(Record<PipelineStateCommand>(ECommand::SetPipelineState)->PipelineStates, PipelineStates);
+    }
+
+    // Returns NumBarriers barriers for the caller to fill in before recording anything else
+    Barrier* ResourceBarrier(UINT NumBarriers)
+    {
+        ArrayCommand* Command = Record<ArrayCommand>(ECommand::ResourceBarrier, NumBarriers * sizeof(Barrier));
+        Command->Count = NumBarriers;
+        return Trailing<Barrier>(Command);
+    }
+
+    void ExecuteBundle(ID3D12GraphicsCommandList* const* Bundles)
+    {
+        CopyNodes(Record<BundleCommand>(ECommand::ExecuteBundle)->Bundles, Bundles);
+    }
+
+    // DescriptorHeaps[h] holds heap h on every node
+    void SetDescriptorHeaps(UINT NumDescriptorHeaps, ID3D12DescriptorHeap* const (*DescriptorHeaps)[NodeCount])
+    {
+        RecordArray(ECommand::SetDescriptorHeaps, NumDescriptorHeaps, reinterpret_cast<NodeObjects<ID3D12DescriptorHeap> const*>(DescriptorHeaps));
+    }
+
+    void SetComputeRootSignature(ID3D12RootSignature* const* RootSignatures)
+    {
+        CopyNodes(Record<RootSignatureCommand>(ECommand::SetComputeRootSignature)->RootSignatures, RootSignatures);
+    }
+
+    void SetGraphicsRootSignature(ID3D12RootSignature* const* RootSignatures)
+    {
+        CopyNodes(Record<RootSignatureCommand>(ECommand::SetGraphicsRootSignature)->RootSignatures, RootSignatures);
+    }
+
+    void SetComputeRootDescriptorTable(UINT RootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE BaseDescriptor)
+    {
+        RecordDescriptorTable(ECommand::SetComputeRootDescriptorTable, RootParameterIndex, BaseDescriptor);
+    }
+
+    void SetGraphicsRootDescriptorTable(UINT RootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE BaseDescriptor)
+    {
+        RecordDescriptorTable(ECommand::SetGraphicsRootDescriptorTable, RootParameterIndex, BaseDescriptor);
+    }
+
+    void SetComputeRoot32BitConstant(UINT RootParameterIndex, UINT SrcData, UINT DestOffsetIn32BitValues)
+    {
+        RecordRootConstants(ECommand::SetComputeRoot32BitConstant, RootParameterIndex, 1, &SrcData, DestOffsetIn32BitValues);
+    }
+
+    void SetGraphicsRoot32BitConstant(UINT RootParameterIndex, UINT SrcData, UINT DestOffsetIn32BitValues)
+    {
+        RecordRootConstants(ECommand::SetGraphicsRoot32BitConstant, RootParameterIndex, 1, &SrcData, DestOffsetIn32BitValues);
+    }
+
+    void SetComputeRoot32BitConstants(UINT RootParameterIndex, UINT Num32BitValuesToSet, void const* pSrcData, UINT DestOffsetIn32BitValues)
+    {
+        RecordRootConstants(ECommand::SetComputeRoot32BitConstants, RootParameterIndex, Num32BitValuesToSet, pSrcData, DestOffsetIn32BitValues);
+    }
+
+    void SetGraphicsRoot32BitConstants(UINT RootParameterIndex, UINT Num32BitValuesToSet, void const* pSrcData, UINT DestOffsetIn32BitValues)
+    {
+        RecordRootConstants(ECommand::SetGraphicsRoot32BitConstants, RootParameterIndex, Num32BitValuesToSet, pSrcData, DestOffsetIn32BitValues);
+    }
+
+    void SetComputeRootConstantBufferView(UINT RootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS BufferLocation)
+    {
+        RecordRootView(ECommand::SetComputeRootConstantBufferView, RootParameterIndex, BufferLocation);
+    }
+
+    void SetGraphicsRootConstantBufferView(UINT RootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS BufferLocation)
+    {
+        RecordRootView(ECommand::SetGraphicsRootConstantBufferView, RootParameterIndex, BufferLocation);
+    }
+
+    void SetComputeRootShaderResourceView(UINT RootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS BufferLocation)
+    {
+        RecordRootView(ECommand::SetComputeRootShaderResourceView, RootParameterIndex, BufferLocation);
+    }
+
+    void SetGraphicsRootShaderResourceView(UINT RootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS BufferLocation)
+    {
+        RecordRootView(ECommand::SetGraphicsRootShaderResourceView, RootParameterIndex, BufferLocation);
+    }
+
+    void SetComputeRootUnorderedAccessView(UINT RootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS BufferLocation)
+    {
+        RecordRootView(ECommand::SetComputeRootUnorderedAccessView, RootParameterIndex, BufferLocation);
+    }
+
+    void SetGraphicsRootUnorderedAccessView(UINT RootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS BufferLocation)
+    {
+        RecordRootView(ECommand::SetGraphicsRootUnorderedAccessView, RootParameterIndex, BufferLocation);
+    }
+
+    void IASetIndexBuffer(D3D12_INDEX_BUFFER_VIEW const* pView)
+    {
+        IndexBufferCommand* Command = Record<IndexBufferCommand>(ECommand::IASetIndexBuffer);
+        Command->HasView = pView != nullptr;
+        if (pView)
+        {
+            Command->View = *pView;
+            Command->BufferLocation = AddAddress(pView->BufferLocation);
+        }
+    }
+
+    void IASetVertexBuffers(UINT StartSlot, UINT NumViews, D3D12_VERTEX_BUFFER_VIEW const* pViews)
+    {
+        // Views are only copied when they are set; their addresses take consecutive entries
+        ViewsCommand* Command = Record<ViewsCommand>(ECommand::IASetVertexBuffers, pViews ? NumViews * sizeof(D3D12_VERTEX_BUFFER_VIEW) : 0);
+        Command->StartSlot = StartSlot;
+        Command->NumViews = NumViews;
+        Command->HasViews = pViews != nullptr;
+        Command->FirstAddress = (UINT)mAddresses.size();
+        if (pViews)
+        {
+            memcpy(Trailing<D3D12_VERTEX_BUFFER_VIEW>(Command), pViews, NumViews * sizeof(D3D12_VERTEX_BUFFER_VIEW));
+            for (UINT v = 0; v < NumViews; ++v)
+            {
+                AddAddress(pViews[v].BufferLocation);
+            }
+        }
+    }
+
+    void SOSetTargets(UINT StartSlot, UINT NumViews, D3D12_STREAM_OUTPUT_BUFFER_VIEW const* pViews)
+    {
+        // Each view takes two consecutive address entries, the buffer then its filled size
+        ViewsCommand* Command = Record<ViewsCommand>(ECommand::SOSetTargets, pViews ? NumViews * sizeof(D3D12_STREAM_OUTPUT_BUFFER_VIEW) : 0);
+        Command->StartSlot = StartSlot;
+        Command->NumViews = NumViews;
+        Command->HasViews = pViews != nullptr;
+        Command->FirstAddress = (UINT)mAddresses.size();
+        if (pViews)
+        {
+            memcpy(Trailing<D3D12_STREAM_OUTPUT_BUFFER_VIEW>(Command), pViews, NumViews * sizeof(D3D12_STREAM_OUTPUT_BUFFER_VIEW));
+            for (UINT v = 0; v < NumViews; ++v)
+            {
+                AddAddress(pViews[v].BufferLocation);
+                AddAddress(pViews[v].BufferFilledSizeLocation);
+            }
+        }
+    }
+
+    void OMSetRenderTargets(
+        UINT NumRenderTargetDescriptors, D3D12_CPU_DESCRIPTOR_HANDLE const* pRenderTargetDescriptors,
+        BOOL RTsSingleHandleToDescriptorRange, D3D12_CPU_DESCRIPTOR_HANDLE const* pDepthStencilDescriptor)
+    {
+        // A single handle to a range is translated once, as the start of the range on each node
+        UINT const NumHandles = RTsSingleHandleToDescriptorRange ? (NumRenderTargetDescriptors > 0 ? 1 : 0) : NumRenderTargetDescriptors;
+
+        RenderTargetsCommand* Command = Record<RenderTargetsCommand>(ECommand::OMSetRenderTargets);
+        Command->NumRenderTargetDescriptors = NumRenderTargetDescriptors;
+        Command->RTsSingleHandleToDescriptorRange = RTsSingleHandleToDescriptorRange;
+        Command->HasDepthStencilDescriptor = pDepthStencilDescriptor != nullptr;
+        Command->FirstDescriptor = (UINT)mCPUDescriptors.size();
+        mCPUDescriptors.insert(mCPUDescriptors.end(), pRenderTargetDescriptors, pRenderTargetDescriptors + NumHandles);
+        if (pDepthStencilDescriptor)
+        {
+            mCPUDescriptors.push_back(*pDepthStencilDescriptor);
+        }
+    }
+
+    void ClearDepthStencilView(
+        D3D12_CPU_DESCRIPTOR_HANDLE DepthStencilView, D3D12_CLEAR_FLAGS ClearFlags, FLOAT Depth, UINT8 Stencil,
+        UINT NumRects, D3D12_RECT const* pRects)
+    {
+        ClearDepthStencilCommand* Command = Record<ClearDepthStencilCommand>(ECommand::ClearDepthStencilView, NumRects * sizeof(D3D12_RECT));
+        Command->DepthStencilView = AddDescriptor(DepthStencilView);
+        Command->ClearFlags = ClearFlags;
+        Command->Depth = Depth;
+        Command->Stencil = Stencil;
+        Command->NumRects = CopyRects(Command, NumRects, pRects);
+    }
+
+    void ClearRenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE RenderTargetView, FLOAT const ColorRGBA[4], UINT NumRects, D3D12_RECT const* pRects)
+    {
+        ClearRenderTargetCommand* Command = Record<ClearRenderTargetCommand>(ECommand::ClearRenderTargetView, NumRects * sizeof(D3D12_RECT));
+        Command->RenderTargetView = AddDescriptor(RenderTargetView);
+        memcpy(Command->ColorRGBA, ColorRGBA, sizeof(Command->ColorRGBA));
+        Command->NumRects = CopyRects(Command, NumRects, pRects);
+    }
+
+    void ClearUnorderedAccessViewUint(
+        D3D12_GPU_DESCRIPTOR_HANDLE ViewGPUHandleInCurrentHeap, D3D12_CPU_DESCRIPTOR_HANDLE ViewCPUHandle, ID3D12Resource* const* Resources,
+        UINT const Values[4], UINT NumRects, D3D12_RECT const* pRects)
+    {
+        RecordClearUnorderedAccessView(ECommand::ClearUnorderedAccessViewUint, ViewGPUHandleInCurrentHeap, ViewCPUHandle, Resources, Values, NumRects, pRects);
+    }
+
+    void ClearUnorderedAccessViewFloat(
+        D3D12_GPU_DESCRIPTOR_HANDLE ViewGPUHandleInCurrentHeap, D3D12_CPU_DESCRIPTOR_HANDLE ViewCPUHandle, ID3D12Resource* const* Resources,
+        FLOAT const Values[4], UINT NumRects, D3D12_RECT const* pRects)
+    {
+        RecordClearUnorderedAccessView(ECommand::ClearUnorderedAccessViewFloat, ViewGPUHandleInCurrentHeap, ViewCPUHandle, Resources, Values, NumRects, pRects);
+    }
+
+    void DiscardResource(ID3D12Resource* const* Resources, D3D12_DISCARD_REGION const* pRegion)
+    {
+        UINT const NumRects = pRegion && pRegion->pRects ? pRegion->NumRects : 0;
+        DiscardResourceCommand* Command = Record<DiscardResourceCommand>(ECommand::DiscardResource, NumRects * sizeof(D3D12_RECT));
+        CopyNodes(Command->Resources, Resources);
+        Command->HasRegion = pRegion != nullptr;
+        if (pRegion)
+        {
+            // pRects is pointed at the copied rectangles when the command is replayed
+            Command->Region = *pRegion;
+            Command->HasRects = pRegion->pRects != nullptr;
+            if (pRegion->pRects)
+            {
+                memcpy(Trailing<D3D12_RECT>(Command), pRegion->pRects, NumRects * sizeof(D3D12_RECT));
+            }
+        }
+    }
+
+    void BeginQuery(ID3D12QueryHeap* const* QueryHeaps, D3D12_QUERY_TYPE Type, UINT Index)
+    {
+        RecordQuery(ECommand::BeginQuery, QueryHeaps, Type, Index);
+    }
+
+    void EndQuery(ID3D12QueryHeap* const* QueryHeaps, D3D12_QUERY_TYPE Type, UINT Index)
+    {
+        RecordQuery(ECommand::EndQuery, QueryHeaps, Type, Index);
+    }
+
+    void ResolveQueryData(
+        ID3D12QueryHeap* const* QueryHeaps, D3D12_QUERY_TYPE Type, UINT StartIndex, UINT NumQueries,
+        ID3D12Resource* const* DestinationBuffers, UINT64 AlignedDestinationBufferOffset)
+    {
+        ResolveQueryDataCommand* Command = Record<ResolveQueryDataCommand>(ECommand::ResolveQueryData);
+        CopyNodes(Command->QueryHeaps, QueryHeaps);
+        CopyNodes(Command->DestinationBuffers, DestinationBuffers);
+        Command->Type = Type;
+        Command->StartIndex = StartIndex;
+        Command->NumQueries = NumQueries;
+        Command->AlignedDestinationBufferOffset = AlignedDestinationBufferOffset;
+    }
+
+    void SetPredication(ID3D12Resource* const* Buffers, UINT64 AlignedBufferOffset, D3D12_PREDICATION_OP Operation)
+    {
+        PredicationCommand* Command = Record<PredicationCommand>(ECommand::SetPredication);
+        CopyNodes(Command->Buffers, Buffers);
+        Command->AlignedBufferOffset = AlignedBufferOffset;
+        Command->Operation = Operation;
+    }
+
+    void SetMarker(UINT Metadata, void const* pData, UINT Size)
+    {
+        RecordEvent(ECommand::SetMarker, Metadata, pData, Size);
+    }
+
+    void BeginEvent(UINT Metadata, void const* pData, UINT Size)
+    {
+        RecordEvent(ECommand::BeginEvent, Metadata, pData, Size);
+    }
+
+    void EndEvent()
+    {
+        Record<EmptyCommand>(ECommand::EndEvent);
+    }
+
+    void ExecuteIndirect(
+        ID3D12CommandSignature* const* CommandSignatures, UINT MaxCommandCount,
+        ID3D12Resource* const* ArgumentBuffers, UINT64 ArgumentBufferOffset,
+        ID3D12Resource* const* CountBuffers, UINT64 CountBufferOffset)
+    {
+        ExecuteIndirectCommand* Command = Record<ExecuteIndirectCommand>(ECommand::ExecuteIndirect);
+        CopyNodes(Command->CommandSignatures, CommandSignatures);
+        CopyNodes(Command->ArgumentBuffers, ArgumentBuffers);
+        CopyNodes(Command->CountBuffers, CountBuffers);
+        Command->MaxCommandCount = MaxCommandCount;
+        Command->ArgumentBufferOffset = ArgumentBufferOffset;
+        Command->CountBufferOffset = CountBufferOffset;
+    }
+
+    // Resolves every recorded address and descriptor handle on every node.
+    // TranslatorType provides
+    //   void TranslateAddress(D3D12_GPU_VIRTUAL_ADDRESS, D3D12_GPU_VIRTUAL_ADDRESS (&NodeAddresses)[NodeCount]);
+    //   void TranslateCPUDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE, D3D12_CPU_DESCRIPTOR_HANDLE (&NodeHandles)[NodeCount]);
+    //   void TranslateGPUDescriptor(D3D12_GPU_DESCRIPTOR_HANDLE, D3D12_GPU_DESCRIPTOR_HANDLE (&NodeHandles)[NodeCount]);
+    template <typename TranslatorType>
+    void Translate(TranslatorType& Translator)
+    {
+        mNodeAddresses.resize(mAddresses.size());
+        for (size_t a = 0; a < mAddresses.size(); ++a)
+        {
+            Translator.TranslateAddress(mAddresses[a], mNodeAddresses[a].Values);
+        }
+
+        mNodeCPUDescriptors.resize(mCPUDescriptors.size());
+        for (size_t d = 0; d < mCPUDescriptors.size(); ++d)
+        {
+            Translator.TranslateCPUDescriptor(mCPUDescriptors[d], mNodeCPUDescriptors[d].Values);
+        }
+
+        mNodeGPUDescriptors.resize(mGPUDescriptors.size());
+        for (size_t d = 0; d < mGPUDescriptors.size(); ++d)
+        {
+            Translator.TranslateGPUDescriptor(mGPUDescriptors[d], mNodeGPUDescriptors[d].Values);
+        }
+    }
+
+    // Makes every call recorded for Node on List, in order. Translate must have been called.
+    template <typename ListType>
+    void Replay(ListType* List, UINT Node) const
+    {
+        // Scratch space for arguments that are rebuilt per node
+        std::vector<D3D12_RESOURCE_BARRIER> Barriers;
+        std::vector<ID3D12DescriptorHeap*> DescriptorHeaps;
+        std::vector<D3D12_VERTEX_BUFFER_VIEW> VertexBufferViews;
+        std::vector<D3D12_STREAM_OUTPUT_BUFFER_VIEW> StreamOutputBufferViews;
+        std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> RenderTargetDescriptors;
+
+        bool Active = false;
+        UINT64 const* Position = mCommands.data();
+        UINT64 const* const End = Position + mCommands.size();
+        while (Position < End)
+        {
+            CommandHeader const* Header = reinterpret_cast<CommandHeader const*>(Position);
+            Position += Header->Size;
+
+            if (Header->Type == ECommand::SetNodeMask)
+            {
+                Active = ((1 << Node) & Payload<NodeMaskCommand>(Header)->NodeMask) != 0;
+                continue;
+            }
+            if (!Active)
+            {
+                continue;
+            }
+
+            switch (Header->Type)
+            {
+            case ECommand::ClearState:
+            {
+                List->ClearState(Payload<PipelineStateCommand>(Header)->PipelineStates[Node]);
+                break;
+            }
+            case ECommand::DrawInstanced:
+            {
+                DrawInstancedCommand const* Command = Payload<DrawInstancedCommand>(Header);
+                List->DrawInstanced(Command->VertexCountPerInstance, Command->InstanceCount, Command->StartVertexLocation, Command->StartInstanceLocation);
+                break;
+            }
+            case ECommand::DrawIndexedInstanced:
+            {
+                DrawIndexedInstancedCommand const* Command = Payload<DrawIndexedInstancedCommand>(Header);
+                List->DrawIndexedInstanced(
+                    Command->IndexCountPerInstance, Command->InstanceCount, Command->StartIndexLocation, Command->BaseVertexLocation, Command->StartInstanceLocation);
+                break;
+            }
+            case ECommand::Dispatch:
+            {
+                DispatchCommand const* Command = Payload<DispatchCommand>(Header);
+                List->Dispatch(Command->ThreadGroupCountX, Command->ThreadGroupCountY, Command->ThreadGroupCountZ);
+                break;
+            }
+            case ECommand::CopyBufferRegion:
+            {
+                CopyBufferRegionCommand const* Command = Payload<CopyBufferRegionCommand>(Header);
+                List->CopyBufferRegion(Command->DstBuffers[Node], Command->DstOffset, Command->SrcBuffers[Node], Command->SrcOffset, Command->NumBytes);
+                break;
+            }
+            case ECommand::CopyTextureRegion:
+            {
+                CopyTextureRegionCommand const* Command = Payload<CopyTextureRegionCommand>(Header);
+                D3D12_TEXTURE_COPY_LOCATION Dst = Command->Dst;
+                D3D12_TEXTURE_COPY_LOCATION Src = Command->Src;
+                Dst.pResource = Command->DstResources[Node];
+                Src.pResource = Command->SrcResources[Node];
+                List->CopyTextureRegion(&Dst, Command->DstX, Command->DstY, Command->DstZ, &Src, Command->HasSrcBox ? &Command->SrcBox : nullptr);
+                break;
+            }
+            case ECommand::CopyResource:
+            {
+                CopyResourceCommand const* Command = Payload<CopyResourceCommand>(Header);
+                List->CopyResource(Command->DstResources[Node], Command->SrcResources[Node]);
+                break;
+            }
+            case ECommand::CopyResourceToNode:
+            {
+                CopyResourceToNodeCommand const* Command = Payload<CopyResourceToNodeCommand>(Header);
+                List->CopyResource(Command->Resources[Command->TargetNode], Command->Resources[Node]);
+                break;
+            }
+            case ECommand::CopyTiles:
+            {
+                CopyTilesCommand const* Command = Payload<CopyTilesCommand>(Header);
+                List->CopyTiles(
+                    Command->TiledResources[Node], &Command->TileRegionStartCoordinate, &Command->TileRegionSize,
+                    Command->Buffers[Node], Command->BufferStartOffsetInBytes, Command->Flags);
+                break;
+            }
+            case ECommand::ResolveSubresource:
+            {
+                ResolveSubresourceCommand const* Command = Payload<ResolveSubresourceCommand>(Header);
+                List->ResolveSubresource(Command->DstResources[Node], Command->DstSubresource, Command->SrcResources[Node], Command->SrcSubresource, Command->Format);
+                break;
+            }
+            case ECommand::IASetPrimitiveTopology:
+            {
+                List->IASetPrimitiveTopology(Payload<PrimitiveTopologyCommand>(Header)->PrimitiveTopology);
+                break;
+            }
+            case ECommand::RSSetViewports:
+            {
+                ArrayCommand const* Command = Payload<ArrayCommand>(Header);
+                List->RSSetViewports(Command->Count, Trailing<D3D12_VIEWPORT>(Command));
+                break;
+            }
+            case ECommand::RSSetScissorRects:
+            {
+                ArrayCommand const* Command = Payload<ArrayCommand>(Header);
+                List->RSSetScissorRects(Command->Count, Trailing<D3D12_RECT>(Command));
+                break;
+            }
+            case ECommand::OMSetBlendFactor:
+            {
+                BlendFactorCommand const* Command = Payload<BlendFactorCommand>(Header);
+                List->OMSetBlendFactor(Command->HasBlendFactor ? Command->BlendFactor : nullptr);
+                break;
+            }
+            case ECommand::OMSetStencilRef:
+            {
+                List->OMSetStencilRef(Payload<StencilRefCommand>(Header)->StencilRef);
+                break;
+            }
+            case ECommand::SetPipelineState:
+            {
+                List->SetPipelineState(Payload<PipelineStateCommand>(Header)->PipelineStates[Node]);
+                break;
+            }
+            case ECommand::ResourceBarrier:
+            {
+                ArrayCommand const* Command = Payload<ArrayCommand>(Header);
+                Barrier const* Recorded = Trailing<Barrier>(Command);
+                Barriers.resize(Command->Count);
+                for (UINT b = 0; b < Command->Count; ++b)
+                {
+                    Barriers[b] = Recorded[b].Desc;
+                    switch (Barriers[b].Type)
+                    {
+                    case D3D12_RESOURCE_BARRIER_TYPE_TRANSITION:
+                        Barriers[b].Transition.pResource = Recorded[b].Resources[Node];
+                        break;
+                    case D3D12_RESOURCE_BARRIER_TYPE_ALIASING:
+                        Barriers[b].Aliasing.pResourceBefore = Recorded[b].Resources[Node];
+                        Barriers[b].Aliasing.pResourceAfter = Recorded[b].ResourcesAfter[Node];
+                        break;
+                    case D3D12_RESOURCE_BARRIER_TYPE_UAV:
+                        Barriers[b].UAV.pResource = Recorded[b].Resources[Node];
+                        break;
+                    }
+                }
+                List->ResourceBarrier(Command->Count, Barriers.data());
+                break;
+            }
+            case ECommand::ExecuteBundle:
+            {
+                List->ExecuteBundle(Payload<BundleCommand>(Header)->Bundles[Node]);
+                break;
+            }
+            case ECommand::SetDescriptorHeaps:
+            {
+                ArrayCommand const* Command = Payload<ArrayCommand>(Header);
+                NodeObjects<ID3D12DescriptorHeap> const* Recorded = Trailing<NodeObjects<ID3D12DescriptorHeap>>(Command);
+                DescriptorHeaps.resize(Command->Count);
+                for (UINT h = 0; h < Command->Count; ++h)
+                {
+                    DescriptorHeaps[h] = Recorded[h].Objects[Node];
+                }
+                List->SetDescriptorHeaps(Command->Count, DescriptorHeaps.data());
+                break;
+            }
+            case ECommand::SetComputeRootSignature:
+            {
+                List->SetComputeRootSignature(Payload<RootSignatureCommand>(Header)->RootSignatures[Node]);
+                break;
+            }
+            case ECommand::SetGraphicsRootSignature:
+            {
+                List->SetGraphicsRootSignature(Payload<RootSignatureCommand>(Header)->RootSignatures[Node]);
+                break;
+            }
+            case ECommand::SetComputeRootDescriptorTable:
+            {
+                DescriptorTableCommand const* Command = Payload<DescriptorTableCommand>(Header);
+                List->SetComputeRootDescriptorTable(Command->RootParameterIndex, mNodeGPUDescriptors[Command->BaseDescriptor].Values[Node]);
+                break;
+            }
+            case ECommand::SetGraphicsRootDescriptorTable:
+            {
+                DescriptorTableCommand const* Command = Payload<DescriptorTableCommand>(Header);
+                List->SetGraphicsRootDescriptorTable(Command->RootParameterIndex, mNodeGPUDescriptors[Command->BaseDescriptor].Values[Node]);
+                break;
+            }
+            case ECommand::SetComputeRoot32BitConstant:
+            {
+                RootConstantsCommand const* Command = Payload<RootConstantsCommand>(Header);
+                List->SetComputeRoot32BitConstant(Command->RootParameterIndex, *Trailing<UINT>(Command), Command->DestOffsetIn32BitValues);
+                break;
+            }
+            case ECommand::SetGraphicsRoot32BitConstant:
+            {
+                RootConstantsCommand const* Command = Payload<RootConstantsCommand>(Header);
+                List->SetGraphicsRoot32BitConstant(Command->RootParameterIndex, *Trailing<UINT>(Command), Command->DestOffsetIn32BitValues);
+                break;
+            }
+            case ECommand::SetComputeRoot32BitConstants:
+            {
+                RootConstantsCommand const* Command = Payload<RootConstantsCommand>(Header);
+                List->SetComputeRoot32BitConstants(Command->RootParameterIndex, Command->Num32BitValuesToSet, Trailing<UINT>(Command), Command->DestOffsetIn32BitValues);
+                break;
+            }
+            case ECommand::SetGraphicsRoot32BitConstants:
+            {
+                RootConstantsCommand const* Command = Payload<RootConstantsCommand>(Header);
+                List->SetGraphicsRoot32BitConstants(Command->RootParameterIndex, Command->Num32BitValuesToSet, Trailing<UINT>(Command), Command->DestOffsetIn32BitValues);
+                break;
+            }
+            case ECommand::SetComputeRootConstantBufferView:
+            {
+                RootViewCommand const* Command = Payload<RootViewCommand>(Header);
+                List->SetComputeRootConstantBufferView(Command->RootParameterIndex, mNodeAddresses[Command->BufferLocation].Values[Node]);
+                break;
+            }
+            case ECommand::SetGraphicsRootConstantBufferView:
+            {
+                RootViewCommand const* Command = Payload<RootViewCommand>(Header);
+                List->SetGraphicsRootConstantBufferView(Command->RootParameterIndex, mNodeAddresses[Command->BufferLocation].Values[Node]);
+                break;
+            }
+            case ECommand::SetComputeRootShaderResourceView:
+            {
+                RootViewCommand const* Command = Payload<RootViewCommand>(Header);
+                List->SetComputeRootShaderResourceView(Command->RootParameterIndex, mNodeAddresses[Command->BufferLocation].Values[Node]);
+                break;
+            }
+            case ECommand::SetGraphicsRootShaderResourceView:
+            {
+                RootViewCommand const* Command = Payload<RootViewCommand>(Header);
+                List->SetGraphicsRootShaderResourceView(Command->RootParameterIndex, mNodeAddresses[Command->BufferLocation].Values[Node]);
+                break;
+            }
+            case ECommand::SetComputeRootUnorderedAccessView:
+            {
+                RootViewCommand const* Command = Payload<RootViewCommand>(Header);
+                List->SetComputeRootUnorderedAccessView(Command->RootParameterIndex, mNodeAddresses[Command->BufferLocation].Values[Node]);
+                break;
+            }
+            case ECommand::SetGraphicsRootUnorderedAccessView:
+            {
+                RootViewCommand const* Command = Payload<RootViewCommand>(Header);
+                List->SetGraphicsRootUnorderedAccessView(Command->RootParameterIndex, mNodeAddresses[Command->BufferLocation].Values[Node]);
+                break;
+            }
+            case ECommand::IASetIndexBuffer:
+            {
+                IndexBufferCommand const* Command = Payload<IndexBufferCommand>(Header);
+                if (Command->HasView)
+                {
+                    D3D12_INDEX_BUFFER_VIEW View = Command->View;
+                    View.BufferLocation = mNodeAddresses[Command->BufferLocation].Values[Node];
+                    List->IASetIndexBuffer(&View);
+                }
+                else
+                {
+                    List->IASetIndexBuffer(nullptr);
+                }
+                break;
+            }
+            case ECommand::IASetVertexBuffers:
+            {
+                ViewsCommand const* Command = Payload<ViewsCommand>(Header);
+                if (Command->HasViews)
+                {
+                    D3D12_VERTEX_BUFFER_VIEW const* Recorded = Trailing<D3D12_VERTEX_BUFFER_VIEW>(Command);
+                    VertexBufferViews.assign(Recorded, Recorded + Command->NumViews);
+                    for (UINT v = 0; v < Command->NumViews; ++v)
+                    {
+                        VertexBufferViews[v].BufferLocation = mNodeAddresses[Command->FirstAddress + v].Values[Node];
+                    }
+                    List->IASetVertexBuffers(Command->StartSlot, Command->NumViews, VertexBufferViews.data());
+                }
+                else
+                {
+                    List->IASetVertexBuffers(Command->StartSlot, Command->NumViews, nullptr);
+                }
+                break;
+            }
+            case ECommand::SOSetTargets:
+            {
+                ViewsCommand const* Command = Payload<ViewsCommand>(Header);
+                if (Command->HasViews)
+                {
+                    D3D12_STREAM_OUTPUT_BUFFER_VIEW const* Recorded = Trailing<D3D12_STREAM_OUTPUT_BUFFER_VIEW>(Command);
+                    StreamOutputBufferViews.assign(Recorded, Recorded + Command->NumViews);
+                    for (UINT v = 0; v < Command->NumViews; ++v)
+                    {
+                        StreamOutputBufferViews[v].BufferLocation = mNodeAddresses[Command->FirstAddress + 2 * v].Values[Node];
+                        StreamOutputBufferViews[v].BufferFilledSizeLocation = mNodeAddresses[Command->FirstAddress + 2 * v + 1].Values[Node];
+                    }
+                    List->SOSetTargets(Command->StartSlot, Command->NumViews, StreamOutputBufferViews.data());
+                }
+                else
+                {
+                    List->SOSetTargets(Command->StartSlot, Command->NumViews, nullptr);
+                }
+                break;
+            }
+            case ECommand::OMSetRenderTargets:
+            {
+                RenderTargetsCommand const* Command = Payload<RenderTargetsCommand>(Header);
+                UINT const NumHandles = Command->RTsSingleHandleToDescriptorRange ?
+                    (Command->NumRenderTargetDescriptors > 0 ? 1 : 0) : Command->NumRenderTargetDescriptors;
+                RenderTargetDescriptors.resize(NumHandles);
+                for (UINT r = 0; r < NumHandles; ++r)
+                {
+                    RenderTargetDescriptors[r] = mNodeCPUDescriptors[Command->FirstDescriptor + r].Values[Node];
+                }
+                D3D12_CPU_DESCRIPTOR_HANDLE DepthStencilDescriptor = {};
+                if (Command->HasDepthStencilDescriptor)
+                {
+                    DepthStencilDescriptor = mNodeCPUDescriptors[Command->FirstDescriptor + NumHandles].Values[Node];
+                }
+                List->OMSetRenderTargets(
+                    Command->NumRenderTargetDescriptors, RenderTargetDescriptors.data(), Command->RTsSingleHandleToDescriptorRange,
+                    Command->HasDepthStencilDescriptor ? &DepthStencilDescriptor : nullptr);
+                break;
+            }
+            case ECommand::ClearDepthStencilView:
+            {
+                ClearDepthStencilCommand const* Command = Payload<ClearDepthStencilCommand>(Header);
+                List->ClearDepthStencilView(
+                    mNodeCPUDescriptors[Command->DepthStencilView].Values[Node], Command->ClearFlags, Command->Depth, Command->Stencil,
+                    Command->NumRects, RectsOrNull(Command));
+                break;
+            }
+            case ECommand::ClearRenderTargetView:
+            {
+                ClearRenderTargetCommand const* Command = Payload<ClearRenderTargetCommand>(Header);
+                List->ClearRenderTargetView(mNodeCPUDescriptors[Command->RenderTargetView].Values[Node], Command->ColorRGBA, Command->NumRects, RectsOrNull(Command));
+                break;
+            }
+            case ECommand::ClearUnorderedAccessViewUint:
+            {
+                ClearUnorderedAccessCommand const* Command = Payload<ClearUnorderedAccessCommand>(Header);
+                List->ClearUnorderedAccessViewUint(
+                    mNodeGPUDescriptors[Command->ViewGPUHandleInCurrentHeap].Values[Node], mNodeCPUDescriptors[Command->ViewCPUHandle].Values[Node],
+                    Command->Resources[Node], Command->UintValues, Command->NumRects, RectsOrNull(Command));
+                break;
+            }
+            case ECommand::ClearUnorderedAccessViewFloat:
+            {
+                ClearUnorderedAccessCommand const* Command = Payload<ClearUnorderedAccessCommand>(Header);
+                List->ClearUnorderedAccessViewFloat(
+                    mNodeGPUDescriptors[Command->ViewGPUHandleInCurrentHeap].Values[Node], mNodeCPUDescriptors[Command->ViewCPUHandle].Values[Node],
+                    Command->Resources[Node], Command->FloatValues, Command->NumRects, RectsOrNull(Command));
+                break;
+            }
+            case ECommand::DiscardResource:
+            {
+                DiscardResourceCommand const* Command = Payload<DiscardResourceCommand>(Header);
+                if (Command->HasRegion)
+                {
+                    D3D12_DISCARD_REGION Region = Command->Region;
+                    Region.pRects = Command->HasRects ? Trailing<D3D12_RECT>(Command) : nullptr;
+                    List->DiscardResource(Command->Resources[Node], &Region);
+                }
+                else
+                {
+                    List->DiscardResource(Command->Resources[Node], nullptr);
+                }
+                break;
+            }
+            case ECommand::BeginQuery:
+            {
+                QueryCommand const* Command = Payload<QueryCommand>(Header);
+                List->BeginQuery(Command->QueryHeaps[Node], Command->Type, Command->Index);
+                break;
+            }
+            case ECommand::EndQuery:
+            {
+                QueryCommand const* Command = Payload<QueryCommand>(Header);
+                List->EndQuery(Command->QueryHeaps[Node], Command->Type, Command->Index);
+                break;
+            }
+            case ECommand::ResolveQueryData:
+            {
+                ResolveQueryDataCommand const* Command = Payload<ResolveQueryDataCommand>(Header);
+                List->ResolveQueryData(
+                    Command->QueryHeaps[Node], Command->Type, Command->StartIndex, Command->NumQueries,
+                    Command->DestinationBuffers[Node], Command->AlignedDestinationBufferOffset);
+                break;
+            }
+            case ECommand::SetPredication:
+            {
+                PredicationCommand const* Command = Payload<PredicationCommand>(Header);
+                List->SetPredication(Command->Buffers[Node], Command->AlignedBufferOffset, Command->Operation);
+                break;
+            }
+            case ECommand::SetMarker:
+            {
+                EventCommand const* Command = Payload<EventCommand>(Header);
+                List->SetMarker(Command->Metadata, Command->HasData ? Trailing<BYTE>(Command) : nullptr, Command->Size);
+                break;
+            }
+            case ECommand::BeginEvent:
+            {
+                EventCommand const* Command = Payload<EventCommand>(Header);
+                List->BeginEvent(Command->Metadata, Command->HasData ? Trailing<BYTE>(Command) : nullptr, Command->Size);
+                break;
+            }
+            case ECommand::EndEvent:
+            {
+                List->EndEvent();
+                break;
+            }
+            case ECommand::ExecuteIndirect:
+            {
+                ExecuteIndirectCommand const* Command = Payload<ExecuteIndirectCommand>(Header);
+                List->ExecuteIndirect(
+                    Command->CommandSignatures[Node], Command->MaxCommandCount,
+                    Command->ArgumentBuffers[Node], Command->ArgumentBufferOffset,
+                    Command->CountBuffers[Node], Command->CountBufferOffset);
+                break;
+            }
+            }
+        }
+    }
+
+private:
+    struct ECommand
+    {
+        enum Type
+        {
+            SetNodeMask,
+            ClearState,
+            DrawInstanced,
+            DrawIndexedInstanced,
+            Dispatch,
+            CopyBufferRegion,
+            CopyTextureRegion,
+            CopyResource,
+            CopyResourceToNode,
+            CopyTiles,
+            ResolveSubresource,
+            IASetPrimitiveTopology,
+            RSSetViewports,
+            RSSetScissorRects,
+            OMSetBlendFactor,
+            OMSetStencilRef,
+            SetPipelineState,
+            ResourceBarrier,
+            ExecuteBundle,
+            SetDescriptorHeaps,
+            SetComputeRootSignature,
+            SetGraphicsRootSignature,
+            SetComputeRootDescriptorTable,
+            SetGraphicsRootDescriptorTable,
+            SetComputeRoot32BitConstant,
+            SetGraphicsRoot32BitConstant,
+            SetComputeRoot32BitConstants,
+            SetGraphicsRoot32BitConstants,
+            SetComputeRootConstantBufferView,
+            SetGraphicsRootConstantBufferView,
+            SetComputeRootShaderResourceView,
+            SetGraphicsRootShaderResourceView,
+            SetComputeRootUnorderedAccessView,
+            SetGraphicsRootUnorderedAccessView,
+            IASetIndexBuffer,
+            IASetVertexBuffers,
+            SOSetTargets,
+            OMSetRenderTargets,
+            ClearDepthStencilView,
+            ClearRenderTargetView,
+            ClearUnorderedAccessViewUint,
+            ClearUnorderedAccessViewFloat,
+            DiscardResource,
+            BeginQuery,
+            EndQuery,
+            ResolveQueryData,
+            SetPredication,
+            SetMarker,
+            BeginEvent,
+            EndEvent,
+            ExecuteIndirect,
+        };
+    };
+
+    // Every record starts with a header and is a whole number of 8 byte words.
+    // Arrays follow their command's payload, at the next 8 byte boundary.
+    struct CommandHeader
+    {
+        UINT Type;
+        UINT Size;  // In words, including the header
+    };
+
+    template <typename T>
+    struct NodeObjects
+    {
+        T* Objects[NodeCount];
+    };
+
+    template <typename T>
+    struct NodeValues
+    {
+        T Values[NodeCount];
+    };
+
+    struct EmptyCommand {};
+    struct NodeMaskCommand { UINT NodeMask; };
+    struct PipelineStateCommand { ID3D12PipelineState* PipelineStates[NodeCount]; };
+    struct RootSignatureCommand { ID3D12RootSignature* RootSignatures[NodeCount]; };
+    struct BundleCommand { ID3D12GraphicsCommandList* Bundles[NodeCount]; };
+    struct PrimitiveTopologyCommand { D3D12_PRIMITIVE_TOPOLOGY PrimitiveTopology; };
+    struct StencilRefCommand { UINT StencilRef; };
+    struct ArrayCommand { UINT Count; };
+
+    struct DrawInstancedCommand
+    {
+        UINT VertexCountPerInstance;
+        UINT InstanceCount;
+        UINT StartVertexLocation;
+        UINT StartInstanceLocation;
+    };
+
+    struct DrawIndexedInstancedCommand
+    {
+        UINT IndexCountPerInstance;
+        UINT InstanceCount;
+        UINT StartIndexLocation;
+        INT BaseVertexLocation;
+        UINT StartInstanceLocation;
+    };
+
+    struct DispatchCommand
+    {
+        UINT ThreadGroupCountX;
+        UINT ThreadGroupCountY;
+        UINT ThreadGroupCountZ;
+    };
+
+    struct CopyBufferRegionCommand
+    {
+        ID3D12Resource* DstBuffers[NodeCount];
+        ID3D12Resource* SrcBuffers[NodeCount];
+        UINT64 DstOffset;
+        UINT64 SrcOffset;
+        UINT64 NumBytes;
+    };
+
+    struct CopyTextureRegionCommand
+    {
+        D3D12_TEXTURE_COPY_LOCATION Dst;
+        D3D12_TEXTURE_COPY_LOCATION Src;
+        ID3D12Resource* DstResources[NodeCount];
+        ID3D12Resource* SrcResources[NodeCount];
+        UINT DstX;
+        UINT DstY;
+        UINT DstZ;
+        BOOL HasSrcBox;
+        D3D12_BOX SrcBox;
+    };
+
+    struct CopyResourceCommand
+    {
+        ID3D12Resource* DstResources[NodeCount];
+        ID3D12Resource* SrcResources[NodeCount];
+    };
+
+    struct CopyResourceToNodeCommand
+    {
+        ID3D12Resource* Resources[NodeCount];
+        UINT TargetNode;
+    };
+
+    struct CopyTilesCommand
+    {
+        ID3D12Resource* TiledResources[NodeCount];
+        ID3D12Resource* Buffers[NodeCount];
+        D3D12_TILED_RESOURCE_COORDINATE TileRegionStartCoordinate;
+        D3D12_TILE_REGION_SIZE TileRegionSize;
+        UINT64 BufferStartOffsetInBytes;
+        D3D12_TILE_COPY_FLAGS Flags;
+    };
+
+    struct ResolveSubresourceCommand
+    {
+        ID3D12Resource* DstResources[NodeCount];
+        ID3D12Resource* SrcResources[NodeCount];
+        UINT DstSubresource;
+        UINT SrcSubresource;
+        DXGI_FORMAT Format;
+    };
+
+    struct BlendFactorCommand
+    {
+        BOOL HasBlendFactor;
+        FLOAT BlendFactor[4];
+    };
+
+    // Addresses and descriptors are indices into the translation tables
+    struct DescriptorTableCommand
+    {
+        UINT RootParameterIndex;
+        UINT BaseDescriptor;
+    };
+
+    struct RootConstantsCommand
+    {
+        UINT RootParameterIndex;
+        UINT Num32BitValuesToSet;
+        UINT DestOffsetIn32BitValues;
+    };
+
+    struct RootViewCommand
+    {
+        UINT RootParameterIndex;
+        UINT BufferLocation;
+    };
+
+    struct IndexBufferCommand
+    {
+        D3D12_INDEX_BUFFER_VIEW View;
+        BOOL HasView;
+        UINT BufferLocation;
+    };
+
+    struct ViewsCommand
+    {
+        UINT StartSlot;
+        UINT NumViews;
+        BOOL HasViews;
+        UINT FirstAddress;
+    };
+
+    struct RenderTargetsCommand
+    {
+        UINT NumRenderTargetDescriptors;
+        BOOL RTsSingleHandleToDescriptorRange;
+        BOOL HasDepthStencilDescriptor;
+        UINT FirstDescriptor;
+    };
+
+    struct ClearDepthStencilCommand
+    {
+        UINT DepthStencilView;
+        D3D12_CLEAR_FLAGS ClearFlags;
+        FLOAT Depth;
+        UINT8 Stencil;
+        UINT NumRects;
+        BOOL HasRects;
+    };
+
+    struct ClearRenderTargetCommand
+    {
+        UINT RenderTargetView;
+        FLOAT ColorRGBA[4];
+        UINT NumRects;
+        BOOL HasRects;
+    };
+
+    struct ClearUnorderedAccessCommand
+    {
+        ID3D12Resource* Resources[NodeCount];
+        UINT ViewGPUHandleInCurrentHeap;
+        UINT ViewCPUHandle;
+        union
+        {
+            UINT UintValues[4];
+            FLOAT FloatValues[4];
+        };
+        UINT NumRects;
+        BOOL HasRects;
+    };
+
+    struct DiscardResourceCommand
+    {
+        ID3D12Resource* Resources[NodeCount];
+        D3D12_DISCARD_REGION Region;
+        BOOL HasRegion;
+        BOOL HasRects;
+    };
+
+    struct QueryCommand
+    {
+        ID3D12QueryHeap* QueryHeaps[NodeCount];
+        D3D12_QUERY_TYPE Type;
+        UINT Index;
+    };
+
+    struct ResolveQueryDataCommand
+    {
+        ID3D12QueryHeap* QueryHeaps[NodeCount];
+        ID3D12Resource* DestinationBuffers[NodeCount];
+        D3D12_QUERY_TYPE Type;
+        UINT StartIndex;
+        UINT NumQueries;
+        UINT64 AlignedDestinationBufferOffset;
+    };
+
+    struct PredicationCommand
+    {
+        ID3D12Resource* Buffers[NodeCount];
+        UINT64 AlignedBufferOffset;
+        D3D12_PREDICATION_OP Operation;
+    };
+
+    struct EventCommand
+    {
+        UINT Metadata;
+        UINT Size;
+        BOOL HasData;
+    };
+
+    struct ExecuteIndirectCommand
+    {
+        ID3D12CommandSignature* CommandSignatures[NodeCount];
+        ID3D12Resource* ArgumentBuffers[NodeCount];
+        ID3D12Resource* CountBuffers[NodeCount];
+        UINT MaxCommandCount;
+        UINT64 ArgumentBufferOffset;
+        UINT64 CountBufferOffset;
+    };
+
+    template <typename T>
+    static size_t PayloadSize()
+    {
+        return (sizeof(T) + 7) & ~size_t(7);
+    }
+
+    template <typename T>
+    static T const* Payload(CommandHeader const* Header)
+    {
+        return reinterpret_cast<T const*>(Header + 1);
+    }
+
+    template <typename U, typename T>
+    static U* Trailing(T* Command)
+    {
+        return reinterpret_cast<U*>(reinterpret_cast<BYTE*>(Command) + PayloadSize<T>());
+    }
+
+    template <typename U, typename T>
+    static U const* Trailing(T const* Command)
+    {
+        return reinterpret_cast<U const*>(reinterpret_cast<BYTE const*>(Command) + PayloadSize<T>());
+    }
+
+    template <typename T>
+    static D3D12_RECT const* RectsOrNull(T const* Command)
+    {
+        return Command->HasRects ? Trailing<D3D12_RECT>(Command) : nullptr;
+    }
+
+    template <typename T>
+    static void CopyNodes(T* (&Destination)[NodeCount], T* const* Source)
+    {
+        for (size_t i = 0; i < NodeCount; ++i)
+        {
+            Destination[i] = Source ? Source[i] : nullptr;
+        }
+    }
+
+    // The returned payload is zeroed, and valid until the next command is allocated
+    template <typename T>
+    T* Allocate(typename ECommand::Type Type, size_t TrailingBytes = 0)
+    {
+        size_t const Words = 1 + (PayloadSize<T>() + TrailingBytes + 7) / 8;
+        size_t const Offset = mCommands.size();
+        mCommands.resize(Offset + Words);
+
+        CommandHeader* Header = reinterpret_cast<CommandHeader*>(&mCommands[Offset]);
+        Header->Type = Type;
+        Header->Size = (UINT)Words;
+        return reinterpret_cast<T*>(Header + 1);
+    }
+
+    template <typename T>
+    T* Record(typename ECommand::Type Type, size_t TrailingBytes = 0)
+    {
+        mUsedNodeMask |= mNodeMask;
+        return Allocate<T>(Type, TrailingBytes);
+    }
+
+    template <typename T>
+    void RecordArray(typename ECommand::Type Type, UINT Count, T const* Elements)
+    {
+        ArrayCommand* Command = Record<ArrayCommand>(Type, Count * sizeof(T));
+        Command->Count = Count;
+        memcpy(Trailing<T>(Command), Elements, Count * sizeof(T));
+    }
+
+    template <typename T>
+    static UINT CopyRects(T* Command, UINT NumRects, D3D12_RECT const* pRects)
+    {
+        Command->HasRects = pRects != nullptr;
+        if (pRects)
+        {
+            memcpy(Trailing<D3D12_RECT>(Command), pRects, NumRects * sizeof(D3D12_RECT));
+        }
+        return NumRects;
+    }
+
+    UINT AddAddress(D3D12_GPU_VIRTUAL_ADDRESS Address)
+    {
+        mAddresses.push_back(Address);
+        return (UINT)mAddresses.size() - 1;
+    }
+
+    UINT AddDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE Handle)
+    {
+        mCPUDescriptors.push_back(Handle);
+        return (UINT)mCPUDescriptors.size() - 1;
+    }
+
+    UINT AddDescriptor(D3D12_GPU_DESCRIPTOR_HANDLE Handle)
+    {
+        mGPUDescriptors.push_back(Handle);
+        return (UINT)mGPUDescriptors.size() - 1;
+    }
+
+    void RecordDescriptorTable(typename ECommand::Type Type, UINT RootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE BaseDescriptor)
+    {
+        DescriptorTableCommand* Command = Record<DescriptorTableCommand>(Type);
+        Command->RootParameterIndex = RootParameterIndex;
+        Command->BaseDescriptor = AddDescriptor(BaseDescriptor);
+    }
+
+    void RecordRootConstants(typename ECommand::Type Type, UINT RootParameterIndex, UINT Num32BitValuesToSet, void const* pSrcData, UINT DestOffsetIn32BitValues)
+    {
+        RootConstantsCommand* Command = Record<RootConstantsCommand>(Type, Num32BitValuesToSet * sizeof(UINT));
+        Command->RootParameterIndex = RootParameterIndex;
+        Command->Num32BitValuesToSet = Num32BitValuesToSet;
+        Command->DestOffsetIn32BitValues = DestOffsetIn32BitValues;
+        memcpy(Trailing<UINT>(Command), pSrcData, Num32BitValuesToSet * sizeof(UINT));
+    }
+
+    void RecordRootView(typename ECommand::Type Type, UINT RootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS BufferLocation)
+    {
+        RootViewCommand* Command = Record<RootViewCommand>(Type);
+        Command->RootParameterIndex = RootParameterIndex;
+        Command->BufferLocation = AddAddress(BufferLocation);
+    }
+
+    template <typename T>
+    void RecordClearUnorderedAccessView(
+        typename ECommand::Type Type, D3D12_GPU_DESCRIPTOR_HANDLE ViewGPUHandleInCurrentHeap, D3D12_CPU_DESCRIPTOR_HANDLE ViewCPUHandle,
+        ID3D12Resource* const* Resources, T const Values[4], UINT NumRects, D3D12_RECT const* pRects)
+    {
+        ClearUnorderedAccessCommand* Command = Record<ClearUnorderedAccessCommand>(Type, NumRects * sizeof(D3D12_RECT));
+        CopyNodes(Command->Resources, Resources);
+        Command->ViewGPUHandleInCurrentHeap = AddDescriptor(ViewGPUHandleInCurrentHeap);
+        Command->ViewCPUHandle = AddDescriptor(ViewCPUHandle);
+        memcpy(Command->UintValues, Values, sizeof(Command->UintValues));
+        Command->NumRects = CopyRects(Command, NumRects, pRects);
+    }
+
+    void RecordQuery(typename ECommand::Type Type, ID3D12QueryHeap* const* QueryHeaps, D3D12_QUERY_TYPE QueryType, UINT Index)
+    {
+        QueryCommand* Command = Record<QueryCommand>(Type);
+        CopyNodes(Command->QueryHeaps, QueryHeaps);
+        Command->Type = QueryType;
+        Command->Index = Index;
+    }
+
+    void RecordEvent(typename ECommand::Type Type, UINT Metadata, void const* pData, UINT Size)
+    {
+        EventCommand* Command = Record<EventCommand>(Type, pData ? Size : 0);
+        Command->Metadata = Metadata;
+        Command->Size = Size;
+        Command->HasData = pData != nullptr;
+        if (pData)
+        {
+            memcpy(Trailing<BYTE>(Command), pData, Size);
+        }
+    }
+
+    std::vector<UINT64> mCommands;
+    UINT mNodeMask;
+    UINT mUsedNodeMask;
+
+    // What the application passed, and what that is on each node once translated
+    std::vector<D3D12_GPU_VIRTUAL_ADDRESS> mAddresses;
+    std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> mCPUDescriptors;
+    std::vector<D3D12_GPU_DESCRIPTOR_HANDLE> mGPUDescriptors;
+    std::vector<NodeValues<D3D12_GPU_VIRTUAL_ADDRESS>> mNodeAddresses;
+    std::vector<NodeValues<D3D12_CPU_DESCRIPTOR_HANDLE>> mNodeCPUDescriptors;
+    std::vector<NodeValues<D3D12_GPU_DESCRIPTOR_HANDLE>> mNodeGPUDescriptors;
+};
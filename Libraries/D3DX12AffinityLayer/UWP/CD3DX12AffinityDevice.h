@@ -14,6 +14,7 @@
 #include "Utils.h"
 #include "d3dx12affinity_structs.h"
 #include "CD3DX12AffinityObject.h"
+#include "GPUVirtualAddressTable.h"
 
 struct D3DX12_CPU_DESCRIPTOR_HANDLE_COMPARATOR
 {
@@ -305,6 +306,7 @@ public:
     D3D12_CPU_DESCRIPTOR_HANDLE GetCPUHeapPointer(D3D12_CPU_DESCRIPTOR_HANDLE const& Original, UINT const NodeIndex);
     D3D12_GPU_DESCRIPTOR_HANDLE GetGPUHeapPointer(D3D12_GPU_DESCRIPTOR_HANDLE const& Original, UINT const NodeIndex);
     D3D12_GPU_VIRTUAL_ADDRESS GetGPUVirtualAddress(D3D12_GPU_VIRTUAL_ADDRESS const& Original, UINT const NodeIndex);
+    void GetGPUVirtualAddresses(D3D12_GPU_VIRTUAL_ADDRESS const& Original, D3D12_GPU_VIRTUAL_ADDRESS (&Addresses)[D3DX12_MAX_ACTIVE_NODES]);
 
 protected:
     virtual bool IsD3D();
@@ -326,8 +328,7 @@ private:
     std::vector<std::pair<SIZE_T, SIZE_T>> CPUHeapPointerRanges;
     std::vector<std::pair<SIZE_T, SIZE_T>> GPUHeapPointerRanges;
 
-    std::map<D3D12_GPU_VIRTUAL_ADDRESS, std::vector<D3D12_GPU_VIRTUAL_ADDRESS>> GPUVirtualAddresses;
-    std::mutex MutexGPUVirtualAddresses;
+    GPUVirtualAddressTable<D3DX12_MAX_ACTIVE_NODES> GPUVirtualAddresses;
 
     std::set<CD3DX12AffinityResource*> StillMappedResources;
     std::mutex MutexStillMappedResources;
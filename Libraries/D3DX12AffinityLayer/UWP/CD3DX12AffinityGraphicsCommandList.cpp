@@ -12,6 +12,8 @@
 #include "d3dx12affinity.h"
 #include "Utils.h"
 
+#include <future>
+
 void STDMETHODCALLTYPE CD3DX12AffinityGraphicsCommandList::SetAffinity(UINT AffinityMask)
 {
     CD3DX12AffinityObject::SetAffinity(AffinityMask);
@@ -25,6 +27,11 @@ D3D12_COMMAND_LIST_TYPE CD3DX12AffinityGraphicsCommandList::GetType()
 
 HRESULT CD3DX12AffinityGraphicsCommandList::Close()
 {
+    if (mCommandStream)
+    {
+        ReplayCommandStream();
+    }
+
 #if ALWAYS_RESET_ALL_COMMAND_LISTS
     for (UINT i = 0; i < GetNodeCount(); ++i)
     {
@@ -61,6 +68,11 @@ HRESULT CD3DX12AffinityGraphicsCommandList::Reset(
         SetAffinity(1 << GetActiveNodeIndex());
     }
 
+    if (mCommandStream)
+    {
+        mCommandStream->Reset();
+    }
+
 #if ALWAYS_RESET_ALL_COMMAND_LISTS
     for (UINT i = 0; i < GetNodeCount(); ++i)
     {
@@ -89,6 +101,12 @@ HRESULT CD3DX12AffinityGraphicsCommandList::Reset(
 void CD3DX12AffinityGraphicsCommandList::ClearState(
     CD3DX12AffinityPipelineState* pPipelineState)
 {
+    if (mCommandStream)
+    {
+        Record().ClearState(pPipelineState ? pPipelineState->mPipelineStates : nullptr);
+        return;
+    }
+
     CD3DX12AffinityPipelineState* PipelineState = static_cast<CD3DX12AffinityPipelineState*>(pPipelineState);
 
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
@@ -107,6 +125,12 @@ void CD3DX12AffinityGraphicsCommandList::DrawInstanced(
     UINT StartVertexLocation,
     UINT StartInstanceLocation)
 {
+    if (mCommandStream)
+    {
+        Record().DrawInstanced(VertexCountPerInstance, InstanceCount, StartVertexLocation, StartInstanceLocation);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -123,6 +147,12 @@ void CD3DX12AffinityGraphicsCommandList::Dispatch(
     UINT ThreadGroupCountY,
     UINT ThreadGroupCountZ)
 {
+    if (mCommandStream)
+    {
+        Record().Dispatch(ThreadGroupCountX, ThreadGroupCountY, ThreadGroupCountZ);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -140,6 +170,12 @@ void CD3DX12AffinityGraphicsCommandList::CopyBufferRegion(
     UINT64 SrcOffset,
     UINT64 NumBytes)
 {
+    if (mCommandStream)
+    {
+        Record().CopyBufferRegion(pDstBuffer->mResources, DstOffset, pSrcBuffer->mResources, SrcOffset, NumBytes);
+        return;
+    }
+
     CD3DX12AffinityResource* DstBuffer = static_cast<CD3DX12AffinityResource*>(pDstBuffer);
     CD3DX12AffinityResource* SrcBuffer = static_cast<CD3DX12AffinityResource*>(pSrcBuffer);
 
@@ -162,6 +198,14 @@ void CD3DX12AffinityGraphicsCommandList::CopyTextureRegion(
     const D3DX12_AFFINITY_TEXTURE_COPY_LOCATION* pSrc,
     const D3D12_BOX* pSrcBox)
 {
+    if (mCommandStream)
+    {
+        Record().CopyTextureRegion(
+            pDst->ToD3D12(), pDst->pResource->mResources, DstX, DstY, DstZ,
+            pSrc->ToD3D12(), pSrc->pResource->mResources, pSrcBox);
+        return;
+    }
+
     CD3DX12AffinityResource* DstTexture = static_cast<CD3DX12AffinityResource*>(pDst->pResource);
     CD3DX12AffinityResource* SrcTexture = static_cast<CD3DX12AffinityResource*>(pSrc->pResource);
 
@@ -185,6 +229,12 @@ void CD3DX12AffinityGraphicsCommandList::CopyResource(
     CD3DX12AffinityResource* pDstResource,
     CD3DX12AffinityResource* pSrcResource)
 {
+    if (mCommandStream)
+    {
+        Record().CopyResource(pDstResource->mResources, pSrcResource->mResources);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -204,6 +254,14 @@ void CD3DX12AffinityGraphicsCommandList::CopyTiles(
     UINT64 BufferStartOffsetInBytes,
     D3D12_TILE_COPY_FLAGS Flags)
 {
+    if (mCommandStream)
+    {
+        Record().CopyTiles(
+            pTiledResource->mResources, pTileRegionStartCoordinate, pTileRegionSize,
+            pBuffer->mResources, BufferStartOffsetInBytes, Flags);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -228,6 +286,11 @@ void CD3DX12AffinityGraphicsCommandList::ResolveSubresource(
     UINT SrcSubresource,
     DXGI_FORMAT Format)
 {
+    if (mCommandStream)
+    {
+        Record().ResolveSubresource(pDstResource->mResources, DstSubresource, pSrcResource->mResources, SrcSubresource, Format);
+        return;
+    }
 
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
@@ -243,6 +306,12 @@ void CD3DX12AffinityGraphicsCommandList::ResolveSubresource(
 void CD3DX12AffinityGraphicsCommandList::IASetPrimitiveTopology(
     D3D12_PRIMITIVE_TOPOLOGY PrimitiveTopology)
 {
+    if (mCommandStream)
+    {
+        Record().IASetPrimitiveTopology(PrimitiveTopology);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -257,6 +326,12 @@ void CD3DX12AffinityGraphicsCommandList::RSSetViewports(
     UINT NumViewports,
     const D3D12_VIEWPORT* pViewports)
 {
+    if (mCommandStream)
+    {
+        Record().RSSetViewports(NumViewports, pViewports);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -271,6 +346,12 @@ void CD3DX12AffinityGraphicsCommandList::RSSetScissorRects(
     UINT NumRects,
     const D3D12_RECT* pRects)
 {
+    if (mCommandStream)
+    {
+        Record().RSSetScissorRects(NumRects, pRects);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -284,6 +365,12 @@ void CD3DX12AffinityGraphicsCommandList::RSSetScissorRects(
 void CD3DX12AffinityGraphicsCommandList::OMSetBlendFactor(
     const FLOAT BlendFactor[4])
 {
+    if (mCommandStream)
+    {
+        Record().OMSetBlendFactor(BlendFactor);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -297,6 +384,12 @@ void CD3DX12AffinityGraphicsCommandList::OMSetBlendFactor(
 void CD3DX12AffinityGraphicsCommandList::OMSetStencilRef(
     UINT StencilRef)
 {
+    if (mCommandStream)
+    {
+        Record().OMSetStencilRef(StencilRef);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -311,6 +404,43 @@ void CD3DX12AffinityGraphicsCommandList::ResourceBarrier(
     UINT NumBarriers,
     const D3DX12_AFFINITY_RESOURCE_BARRIER* pBarriers)
 {
+    if (mCommandStream)
+    {
+        CommandStream::Barrier* Barriers = Record().ResourceBarrier(NumBarriers);
+        for (UINT b = 0; b < NumBarriers; ++b)
+        {
+            CD3DX12AffinityResource* Resource = nullptr;
+            CD3DX12AffinityResource* ResourceAfter = nullptr;
+            switch (pBarriers[b].Type)
+            {
+            case D3D12_RESOURCE_BARRIER_TYPE_TRANSITION:
+            {
+                Resource = pBarriers[b].Transition.pResource;
+                break;
+            }
+            case D3D12_RESOURCE_BARRIER_TYPE_ALIASING:
+            {
+                Resource = pBarriers[b].Aliasing.pResourceBefore;
+                ResourceAfter = pBarriers[b].Aliasing.pResourceAfter;
+                break;
+            }
+            case D3D12_RESOURCE_BARRIER_TYPE_UAV:
+            {
+                Resource = pBarriers[b].UAV.pResource;
+                break;
+            }
+            }
+
+            Barriers[b].Desc = pBarriers[b].ToD3D12();
+            for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES; i++)
+            {
+                Barriers[b].Resources[i] = Resource ? Resource->mResources[i] : nullptr;
+                Barriers[b].ResourcesAfter[i] = ResourceAfter ? ResourceAfter->mResources[i] : nullptr;
+            }
+        }
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -365,6 +495,12 @@ void CD3DX12AffinityGraphicsCommandList::ResourceBarrier(
 void CD3DX12AffinityGraphicsCommandList::ExecuteBundle(
     CD3DX12AffinityGraphicsCommandList* pCommandList)
 {
+    if (mCommandStream)
+    {
+        Record().ExecuteBundle(pCommandList->mGraphicsCommandLists);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -380,6 +516,21 @@ void CD3DX12AffinityGraphicsCommandList::SetDescriptorHeaps(
     UINT NumDescriptorHeaps,
     CD3DX12AffinityDescriptorHeap** ppDescriptorHeaps)
 {
+    if (mCommandStream)
+    {
+        DEBUG_ASSERT(NumDescriptorHeaps <= D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES);
+        ID3D12DescriptorHeap* DescriptorHeaps[D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES][D3DX12_MAX_ACTIVE_NODES];
+        for (UINT h = 0; h < NumDescriptorHeaps; ++h)
+        {
+            for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES; i++)
+            {
+                DescriptorHeaps[h][i] = ppDescriptorHeaps[h]->GetChildObject(i);
+            }
+        }
+        Record().SetDescriptorHeaps(NumDescriptorHeaps, DescriptorHeaps);
+        return;
+    }
+
     mCachedDescriptorHeaps.resize(NumDescriptorHeaps);
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
@@ -400,6 +551,12 @@ void CD3DX12AffinityGraphicsCommandList::SetDescriptorHeaps(
 void CD3DX12AffinityGraphicsCommandList::SetComputeRootSignature(
     CD3DX12AffinityRootSignature* pRootSignature)
 {
+    if (mCommandStream)
+    {
+        Record().SetComputeRootSignature(pRootSignature->mRootSignatures);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -414,6 +571,12 @@ void CD3DX12AffinityGraphicsCommandList::SetComputeRootSignature(
 void CD3DX12AffinityGraphicsCommandList::SetGraphicsRootSignature(
     CD3DX12AffinityRootSignature* pRootSignature)
 {
+    if (mCommandStream)
+    {
+        Record().SetGraphicsRootSignature(pRootSignature->mRootSignatures);
+        return;
+    }
+
     CD3DX12AffinityRootSignature* AffinityRootSignature = static_cast<CD3DX12AffinityRootSignature*>(pRootSignature);
 
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
@@ -432,6 +595,12 @@ void CD3DX12AffinityGraphicsCommandList::SetComputeRoot32BitConstant(
     UINT SrcData,
     UINT DestOffsetIn32BitValues)
 {
+    if (mCommandStream)
+    {
+        Record().SetComputeRoot32BitConstant(RootParameterIndex, SrcData, DestOffsetIn32BitValues);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -448,6 +617,12 @@ void CD3DX12AffinityGraphicsCommandList::SetGraphicsRoot32BitConstant(
     UINT SrcData,
     UINT DestOffsetIn32BitValues)
 {
+    if (mCommandStream)
+    {
+        Record().SetGraphicsRoot32BitConstant(RootParameterIndex, SrcData, DestOffsetIn32BitValues);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -465,6 +640,12 @@ void CD3DX12AffinityGraphicsCommandList::SetComputeRoot32BitConstants(
     const void* pSrcData,
     UINT DestOffsetIn32BitValues)
 {
+    if (mCommandStream)
+    {
+        Record().SetComputeRoot32BitConstants(RootParameterIndex, Num32BitValuesToSet, pSrcData, DestOffsetIn32BitValues);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -482,6 +663,12 @@ void CD3DX12AffinityGraphicsCommandList::SetGraphicsRoot32BitConstants(
     const void* pSrcData,
     UINT DestOffsetIn32BitValues)
 {
+    if (mCommandStream)
+    {
+        Record().SetGraphicsRoot32BitConstants(RootParameterIndex, Num32BitValuesToSet, pSrcData, DestOffsetIn32BitValues);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -497,13 +684,22 @@ void CD3DX12AffinityGraphicsCommandList::SetComputeRootConstantBufferView(
     UINT RootParameterIndex,
     D3D12_GPU_VIRTUAL_ADDRESS BufferLocation)
 {
+    if (mCommandStream)
+    {
+        Record().SetComputeRootConstantBufferView(RootParameterIndex, BufferLocation);
+        return;
+    }
+
+    D3D12_GPU_VIRTUAL_ADDRESS BufferLocations[D3DX12_MAX_ACTIVE_NODES];
+    GetParentDevice()->GetGPUVirtualAddresses(BufferLocation, BufferLocations);
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
         {
             ID3D12GraphicsCommandList* List = mGraphicsCommandLists[i];
             
-            List->SetComputeRootConstantBufferView(RootParameterIndex, GetParentDevice()->GetGPUVirtualAddress(BufferLocation, i));
+            List->SetComputeRootConstantBufferView(RootParameterIndex, BufferLocations[i]);
         }
     }
 }
@@ -512,13 +708,22 @@ void CD3DX12AffinityGraphicsCommandList::SetGraphicsRootConstantBufferView(
     UINT RootParameterIndex,
     D3D12_GPU_VIRTUAL_ADDRESS BufferLocation)
 {
+    if (mCommandStream)
+    {
+        Record().SetGraphicsRootConstantBufferView(RootParameterIndex, BufferLocation);
+        return;
+    }
+
+    D3D12_GPU_VIRTUAL_ADDRESS BufferLocations[D3DX12_MAX_ACTIVE_NODES];
+    GetParentDevice()->GetGPUVirtualAddresses(BufferLocation, BufferLocations);
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
         {
             ID3D12GraphicsCommandList* List = mGraphicsCommandLists[i];
             
-            List->SetGraphicsRootConstantBufferView(RootParameterIndex, GetParentDevice()->GetGPUVirtualAddress(BufferLocation, i));
+            List->SetGraphicsRootConstantBufferView(RootParameterIndex, BufferLocations[i]);
         }
     }
 }
@@ -527,13 +732,22 @@ void CD3DX12AffinityGraphicsCommandList::SetComputeRootShaderResourceView(
     UINT RootParameterIndex,
     D3D12_GPU_VIRTUAL_ADDRESS BufferLocation)
 {
+    if (mCommandStream)
+    {
+        Record().SetComputeRootShaderResourceView(RootParameterIndex, BufferLocation);
+        return;
+    }
+
+    D3D12_GPU_VIRTUAL_ADDRESS BufferLocations[D3DX12_MAX_ACTIVE_NODES];
+    GetParentDevice()->GetGPUVirtualAddresses(BufferLocation, BufferLocations);
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
         {
             ID3D12GraphicsCommandList* List = mGraphicsCommandLists[i];
             
-            List->SetComputeRootShaderResourceView(RootParameterIndex, GetParentDevice()->GetGPUVirtualAddress(BufferLocation, i));
+            List->SetComputeRootShaderResourceView(RootParameterIndex, BufferLocations[i]);
         }
     }
 }
@@ -542,13 +756,22 @@ void CD3DX12AffinityGraphicsCommandList::SetGraphicsRootShaderResourceView(
     UINT RootParameterIndex,
     D3D12_GPU_VIRTUAL_ADDRESS BufferLocation)
 {
+    if (mCommandStream)
+    {
+        Record().SetGraphicsRootShaderResourceView(RootParameterIndex, BufferLocation);
+        return;
+    }
+
+    D3D12_GPU_VIRTUAL_ADDRESS BufferLocations[D3DX12_MAX_ACTIVE_NODES];
+    GetParentDevice()->GetGPUVirtualAddresses(BufferLocation, BufferLocations);
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
         {
             ID3D12GraphicsCommandList* List = mGraphicsCommandLists[i];
             
-            List->SetGraphicsRootShaderResourceView(RootParameterIndex, GetParentDevice()->GetGPUVirtualAddress(BufferLocation, i));
+            List->SetGraphicsRootShaderResourceView(RootParameterIndex, BufferLocations[i]);
         }
     }
 }
@@ -557,13 +780,22 @@ void CD3DX12AffinityGraphicsCommandList::SetComputeRootUnorderedAccessView(
     UINT RootParameterIndex,
     D3D12_GPU_VIRTUAL_ADDRESS BufferLocation)
 {
+    if (mCommandStream)
+    {
+        Record().SetComputeRootUnorderedAccessView(RootParameterIndex, BufferLocation);
+        return;
+    }
+
+    D3D12_GPU_VIRTUAL_ADDRESS BufferLocations[D3DX12_MAX_ACTIVE_NODES];
+    GetParentDevice()->GetGPUVirtualAddresses(BufferLocation, BufferLocations);
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
         {
             ID3D12GraphicsCommandList* List = mGraphicsCommandLists[i];
             
-            List->SetComputeRootUnorderedAccessView(RootParameterIndex, GetParentDevice()->GetGPUVirtualAddress(BufferLocation, i));
+            List->SetComputeRootUnorderedAccessView(RootParameterIndex, BufferLocations[i]);
         }
     }
 }
@@ -572,13 +804,22 @@ void CD3DX12AffinityGraphicsCommandList::SetGraphicsRootUnorderedAccessView(
     UINT RootParameterIndex,
     D3D12_GPU_VIRTUAL_ADDRESS BufferLocation)
 {
+    if (mCommandStream)
+    {
+        Record().SetGraphicsRootUnorderedAccessView(RootParameterIndex, BufferLocation);
+        return;
+    }
+
+    D3D12_GPU_VIRTUAL_ADDRESS BufferLocations[D3DX12_MAX_ACTIVE_NODES];
+    GetParentDevice()->GetGPUVirtualAddresses(BufferLocation, BufferLocations);
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
         {
             ID3D12GraphicsCommandList* List = mGraphicsCommandLists[i];
             
-            List->SetGraphicsRootUnorderedAccessView(RootParameterIndex, GetParentDevice()->GetGPUVirtualAddress(BufferLocation, i));
+            List->SetGraphicsRootUnorderedAccessView(RootParameterIndex, BufferLocations[i]);
         }
     }
 }
@@ -588,8 +829,20 @@ void CD3DX12AffinityGraphicsCommandList::IASetVertexBuffers(
     UINT NumViews,
     const D3D12_VERTEX_BUFFER_VIEW* pViews)
 {
+    if (mCommandStream)
+    {
+        Record().IASetVertexBuffers(StartSlot, NumViews, pViews);
+        return;
+    }
+
     mCachedBufferViews.resize(NumViews);
 
+    D3D12_GPU_VIRTUAL_ADDRESS BufferLocations[D3D12_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT][D3DX12_MAX_ACTIVE_NODES];
+    for (UINT v = 0; v < NumViews; ++v)
+    {
+        GetParentDevice()->GetGPUVirtualAddresses(pViews[v].BufferLocation, BufferLocations[v]);
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -599,7 +852,7 @@ void CD3DX12AffinityGraphicsCommandList::IASetVertexBuffers(
             for (UINT v = 0; v < NumViews; ++v)
             {
                 mCachedBufferViews[v] = pViews[v];
-                mCachedBufferViews[v].BufferLocation = GetParentDevice()->GetGPUVirtualAddress(pViews[v].BufferLocation, i);
+                mCachedBufferViews[v].BufferLocation = BufferLocations[v][i];
             }
 
             List->IASetVertexBuffers(StartSlot, NumViews, mCachedBufferViews.data());
@@ -612,8 +865,22 @@ void CD3DX12AffinityGraphicsCommandList::SOSetTargets(
     UINT NumViews,
     const D3D12_STREAM_OUTPUT_BUFFER_VIEW* pViews)
 {
+    if (mCommandStream)
+    {
+        Record().SOSetTargets(StartSlot, NumViews, pViews);
+        return;
+    }
+
     mCachedStreamOutBufferViews.resize(NumViews);
 
+    D3D12_GPU_VIRTUAL_ADDRESS BufferLocations[D3D12_SO_BUFFER_SLOT_COUNT][D3DX12_MAX_ACTIVE_NODES];
+    D3D12_GPU_VIRTUAL_ADDRESS BufferFilledSizeLocations[D3D12_SO_BUFFER_SLOT_COUNT][D3DX12_MAX_ACTIVE_NODES];
+    for (UINT v = 0; v < NumViews; ++v)
+    {
+        GetParentDevice()->GetGPUVirtualAddresses(pViews[v].BufferLocation, BufferLocations[v]);
+        GetParentDevice()->GetGPUVirtualAddresses(pViews[v].BufferFilledSizeLocation, BufferFilledSizeLocations[v]);
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -623,8 +890,8 @@ void CD3DX12AffinityGraphicsCommandList::SOSetTargets(
             for (UINT v = 0; v < NumViews; ++v)
             {
                 mCachedStreamOutBufferViews[v] = pViews[v];
-                mCachedStreamOutBufferViews[v].BufferLocation = GetParentDevice()->GetGPUVirtualAddress(pViews[v].BufferLocation, i);
-                mCachedStreamOutBufferViews[v].BufferFilledSizeLocation = GetParentDevice()->GetGPUVirtualAddress(pViews[v].BufferFilledSizeLocation, i);
+                mCachedStreamOutBufferViews[v].BufferLocation = BufferLocations[v][i];
+                mCachedStreamOutBufferViews[v].BufferFilledSizeLocation = BufferFilledSizeLocations[v][i];
             }
 
             List->SOSetTargets(StartSlot, NumViews, mCachedStreamOutBufferViews.data());
@@ -638,6 +905,12 @@ void CD3DX12AffinityGraphicsCommandList::OMSetRenderTargets(
     BOOL RTsSingleHandleToDescriptorRange,
     const D3D12_CPU_DESCRIPTOR_HANDLE* pDepthStencilDescriptor)
 {
+    if (mCommandStream)
+    {
+        Record().OMSetRenderTargets(NumRenderTargetDescriptors, pRenderTargetDescriptors, RTsSingleHandleToDescriptorRange, pDepthStencilDescriptor);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -671,6 +944,12 @@ void CD3DX12AffinityGraphicsCommandList::ClearDepthStencilView(
     UINT NumRects,
     const D3D12_RECT* pRects)
 {
+    if (mCommandStream)
+    {
+        Record().ClearDepthStencilView(DepthStencilView, ClearFlags, Depth, Stencil, NumRects, pRects);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -689,6 +968,17 @@ void CD3DX12AffinityGraphicsCommandList::ClearRenderTargetView(
     UINT NumRects,
     const D3D12_RECT* pRects)
 {
+    if (mCommandStream)
+    {
+#ifdef D3DX12_DEBUG_CLEAR_WHITE
+        FLOAT White[4] = { 1, 1, 1, 1 };
+        Record().ClearRenderTargetView(RenderTargetView, White, NumRects, pRects);
+#else
+        Record().ClearRenderTargetView(RenderTargetView, ColorRGBA, NumRects, pRects);
+#endif
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -713,6 +1003,12 @@ void CD3DX12AffinityGraphicsCommandList::ClearUnorderedAccessViewUint(
     UINT NumRects,
     const D3D12_RECT* pRects)
 {
+    if (mCommandStream)
+    {
+        Record().ClearUnorderedAccessViewUint(ViewGPUHandleInCurrentHeap, ViewCPUHandle, pResource->mResources, Values, NumRects, pRects);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -735,6 +1031,12 @@ void CD3DX12AffinityGraphicsCommandList::ClearUnorderedAccessViewFloat(
     UINT NumRects,
     const D3D12_RECT* pRects)
 {
+    if (mCommandStream)
+    {
+        Record().ClearUnorderedAccessViewFloat(ViewGPUHandleInCurrentHeap, ViewCPUHandle, pResource->mResources, Values, NumRects, pRects);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -753,6 +1055,12 @@ void CD3DX12AffinityGraphicsCommandList::DiscardResource(
     CD3DX12AffinityResource* pResource,
     const D3D12_DISCARD_REGION* pRegion)
 {
+    if (mCommandStream)
+    {
+        Record().DiscardResource(pResource->mResources, pRegion);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -771,6 +1079,12 @@ void CD3DX12AffinityGraphicsCommandList::BeginQuery(
     D3D12_QUERY_TYPE Type,
     UINT Index)
 {
+    if (mCommandStream)
+    {
+        Record().BeginQuery(pQueryHeap->mQueryHeaps, Type, Index);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -791,6 +1105,12 @@ void CD3DX12AffinityGraphicsCommandList::EndQuery(
     D3D12_QUERY_TYPE Type,
     UINT Index)
 {
+    if (mCommandStream)
+    {
+        Record().EndQuery(pQueryHeap->mQueryHeaps, Type, Index);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -814,6 +1134,12 @@ void CD3DX12AffinityGraphicsCommandList::ResolveQueryData(
     CD3DX12AffinityResource* pDestinationBuffer,
     UINT64 AlignedDestinationBufferOffset)
 {
+    if (mCommandStream)
+    {
+        Record().ResolveQueryData(pQueryHeap->mQueryHeaps, Type, StartIndex, NumQueries, pDestinationBuffer->mResources, AlignedDestinationBufferOffset);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -838,6 +1164,12 @@ void CD3DX12AffinityGraphicsCommandList::SetPredication(
     UINT64 AlignedBufferOffset,
     D3D12_PREDICATION_OP Operation)
 {
+    if (mCommandStream)
+    {
+        Record().SetPredication(pBuffer ? pBuffer->mResources : nullptr, AlignedBufferOffset, Operation);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -857,6 +1189,12 @@ void CD3DX12AffinityGraphicsCommandList::SetMarker(
     const void* pData,
     UINT Size)
 {
+    if (mCommandStream)
+    {
+        Record().SetMarker(Metadata, pData, Size);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -876,6 +1214,12 @@ void CD3DX12AffinityGraphicsCommandList::BeginEvent(
     const void* pData,
     UINT Size)
 {
+    if (mCommandStream)
+    {
+        Record().BeginEvent(Metadata, pData, Size);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -892,6 +1236,12 @@ void CD3DX12AffinityGraphicsCommandList::BeginEvent(
 
 void CD3DX12AffinityGraphicsCommandList::EndEvent(void)
 {
+    if (mCommandStream)
+    {
+        Record().EndEvent();
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -911,6 +1261,20 @@ void CD3DX12AffinityGraphicsCommandList::ExecuteIndirect(
     CD3DX12AffinityResource* pCountBuffer,
     UINT64 CountBufferOffset)
 {
+    if (mCommandStream)
+    {
+        ID3D12CommandSignature* CommandSignatures[D3DX12_MAX_ACTIVE_NODES];
+        for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES; i++)
+        {
+            CommandSignatures[i] = pCommandSignature->GetChildObject(i);
+        }
+        Record().ExecuteIndirect(
+            CommandSignatures, MaxCommandCount,
+            pArgumentBuffer->mResources, ArgumentBufferOffset,
+            pCountBuffer ? pCountBuffer->mResources : nullptr, CountBufferOffset);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -954,11 +1318,24 @@ CD3DX12AffinityGraphicsCommandList::CD3DX12AffinityGraphicsCommandList(CD3DX12Af
     {
         mAccumulatedAffinityMask = GetNodeMask();
     }
+
+#ifdef D3DX12_RECORD_ONCE_REPLAY_PER_NODE
+    if (GetNodeCount() > 1)
+    {
+        mCommandStream.reset(new CommandStream);
+    }
+#endif
 }
 
 void CD3DX12AffinityGraphicsCommandList::SetPipelineState(
     CD3DX12AffinityPipelineState* pPipelineState)
 {
+    if (mCommandStream)
+    {
+        Record().SetPipelineState(pPipelineState->mPipelineStates);
+        return;
+    }
+
     CD3DX12AffinityPipelineState* PipelineState = static_cast<CD3DX12AffinityPipelineState*>(pPipelineState);
 
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
@@ -976,6 +1353,12 @@ void CD3DX12AffinityGraphicsCommandList::SetComputeRootDescriptorTable(
     UINT RootParameterIndex,
     D3D12_GPU_DESCRIPTOR_HANDLE BaseDescriptor)
 {
+    if (mCommandStream)
+    {
+        Record().SetComputeRootDescriptorTable(RootParameterIndex, BaseDescriptor);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -991,6 +1374,12 @@ void CD3DX12AffinityGraphicsCommandList::SetGraphicsRootDescriptorTable(
     UINT RootParameterIndex,
     D3D12_GPU_DESCRIPTOR_HANDLE BaseDescriptor)
 {
+    if (mCommandStream)
+    {
+        Record().SetGraphicsRootDescriptorTable(RootParameterIndex, BaseDescriptor);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -1005,9 +1394,17 @@ void CD3DX12AffinityGraphicsCommandList::SetGraphicsRootDescriptorTable(
 void CD3DX12AffinityGraphicsCommandList::IASetIndexBuffer(
     const D3D12_INDEX_BUFFER_VIEW* pView)
 {
+    if (mCommandStream)
+    {
+        Record().IASetIndexBuffer(pView);
+        return;
+    }
+
     if (pView)
     {
         D3D12_INDEX_BUFFER_VIEW View = *pView;
+        D3D12_GPU_VIRTUAL_ADDRESS BufferLocations[D3DX12_MAX_ACTIVE_NODES];
+        GetParentDevice()->GetGPUVirtualAddresses(pView->BufferLocation, BufferLocations);
 
         for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
         {
@@ -1015,7 +1412,7 @@ void CD3DX12AffinityGraphicsCommandList::IASetIndexBuffer(
             {
                 ID3D12GraphicsCommandList* List = mGraphicsCommandLists[i];
                 
-                View.BufferLocation = GetParentDevice()->GetGPUVirtualAddress(pView->BufferLocation, i);
+                View.BufferLocation = BufferLocations[i];
                 List->IASetIndexBuffer(&View);
             }
         }
@@ -1040,6 +1437,12 @@ void CD3DX12AffinityGraphicsCommandList::DrawIndexedInstanced(
     INT BaseVertexLocation,
     UINT StartInstanceLocation)
 {
+    if (mCommandStream)
+    {
+        Record().DrawIndexedInstanced(IndexCountPerInstance, InstanceCount, StartIndexLocation, BaseVertexLocation, StartInstanceLocation);
+        return;
+    }
+
     for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
     {
         if (((1 << i) & mAffinityMask) != 0)
@@ -1061,15 +1464,102 @@ void CD3DX12AffinityGraphicsCommandList::BroadcastResource(CD3DX12AffinityResour
         {
             if (NodeIndex != i)
             {
-                mGraphicsCommandLists[NodeIndex]->CopyResource(
-                    pResource->GetChildObject(i),
-                    pResource->GetChildObject(NodeIndex)
-                    );
+                if (mCommandStream)
+                {
+                    Record().CopyResourceToNode(pResource->mResources, i);
+                }
+                else
+                {
+                    mGraphicsCommandLists[NodeIndex]->CopyResource(
+                        pResource->GetChildObject(i),
+                        pResource->GetChildObject(NodeIndex)
+                        );
+                }
             }
         }
     }
 }
 
+CD3DX12AffinityGraphicsCommandList::CommandStream& CD3DX12AffinityGraphicsCommandList::Record()
+{
+    // Each command replays on the nodes that were active when it was recorded
+    mCommandStream->SetNodeMask(mAffinityMask);
+    return *mCommandStream;
+}
+
+namespace
+{
+    struct NodeTranslator
+    {
+        CD3DX12AffinityDevice* Device;
+        UINT NodeCount;
+
+        void TranslateAddress(D3D12_GPU_VIRTUAL_ADDRESS Address, D3D12_GPU_VIRTUAL_ADDRESS (&NodeAddresses)[D3DX12_MAX_ACTIVE_NODES])
+        {
+            Device->GetGPUVirtualAddresses(Address, NodeAddresses);
+        }
+
+        void TranslateCPUDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE Handle, D3D12_CPU_DESCRIPTOR_HANDLE (&NodeHandles)[D3DX12_MAX_ACTIVE_NODES])
+        {
+            for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES; i++)
+            {
+                NodeHandles[i] = i < NodeCount ? Device->GetCPUHeapPointer(Handle, i) : Handle;
+            }
+        }
+
+        void TranslateGPUDescriptor(D3D12_GPU_DESCRIPTOR_HANDLE Handle, D3D12_GPU_DESCRIPTOR_HANDLE (&NodeHandles)[D3DX12_MAX_ACTIVE_NODES])
+        {
+            for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES; i++)
+            {
+                NodeHandles[i] = i < NodeCount ? Device->GetGPUHeapPointer(Handle, i) : Handle;
+            }
+        }
+    };
+}
+
+void CD3DX12AffinityGraphicsCommandList::ReplayCommandStream()
+{
+    // Everything is translated up front, so the replays below only read the stream
+    NodeTranslator Translator = { GetParentDevice(), GetNodeCount() };
+    mCommandStream->Translate(Translator);
+
+    // The first node is replayed on this thread and the others on worker threads
+    UINT const NodeMask = mCommandStream->GetUsedNodeMask();
+    CommandStream const* Stream = mCommandStream.get();
+    std::future<void> Replays[D3DX12_MAX_ACTIVE_NODES];
+    UINT FirstNode = D3DX12_MAX_ACTIVE_NODES;
+    for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES; i++)
+    {
+        if (((1 << i) & NodeMask) != 0)
+        {
+            if (FirstNode == D3DX12_MAX_ACTIVE_NODES)
+            {
+                FirstNode = i;
+            }
+            else
+            {
+                ID3D12GraphicsCommandList* List = mGraphicsCommandLists[i];
+                Replays[i] = std::async(std::launch::async, [Stream, List, i]() { Stream->Replay(List, i); });
+            }
+        }
+    }
+
+    if (FirstNode < D3DX12_MAX_ACTIVE_NODES)
+    {
+        Stream->Replay(mGraphicsCommandLists[FirstNode], FirstNode);
+    }
+
+    for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES; i++)
+    {
+        if (Replays[i].valid())
+        {
+            Replays[i].wait();
+        }
+    }
+
+    mCommandStream->Reset();
+}
+
 ID3D12GraphicsCommandList* CD3DX12AffinityGraphicsCommandList::GetChildObject(UINT AffinityIndex)
 {
     return mGraphicsCommandLists[AffinityIndex];
@@ -123,7 +123,7 @@ D3D12_GPU_VIRTUAL_ADDRESS STDMETHODCALLTYPE CD3DX12AffinityResource::GetGPUVirtu
     }
     if (0 == mVirtualAddress)
     {
-        std::vector<D3D12_GPU_VIRTUAL_ADDRESS> Addresses(GetNodeCount());
+        D3D12_GPU_VIRTUAL_ADDRESS Addresses[D3DX12_MAX_ACTIVE_NODES] = {};
         for (UINT i = 0; i < D3DX12_MAX_ACTIVE_NODES;i++)
         {
             if (((1 << i) & mAffinityMask) != 0)
@@ -133,9 +133,7 @@ D3D12_GPU_VIRTUAL_ADDRESS STDMETHODCALLTYPE CD3DX12AffinityResource::GetGPUVirtu
         }
         mVirtualAddress = Addresses[0];
 
-        GetParentDevice()->MutexGPUVirtualAddresses.lock();
-        GetParentDevice()->GPUVirtualAddresses[mVirtualAddress] = std::move(Addresses);
-        GetParentDevice()->MutexGPUVirtualAddresses.unlock();
+        GetParentDevice()->GPUVirtualAddresses.Register(Addresses);
     }
 
     return mVirtualAddress;
@@ -223,7 +221,7 @@ CD3DX12AffinityResource::~CD3DX12AffinityResource()
 
     if (0 != mVirtualAddress)
     {
-        GetParentDevice()->GPUVirtualAddresses.erase(mVirtualAddress);
+        GetParentDevice()->GPUVirtualAddresses.Unregister(mVirtualAddress);
     }
 
     for (UINT i = 0; i < GetNodeCount(); i++)
@@ -0,0 +1,429 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// Replays reference traces through the residency library's LRU cache under a simulated budget, once per eviction
+// policy, and reports bytes paged in, page-ins, evictions and the submissions that had to wait for the GPU to get
+// back under budget, per frame. Builds without the Windows SDK:
+//
+//   g++ -std=c++17 -O2 EvictionPolicyBenchmark.cpp -o EvictionPolicyBenchmark
+//   EvictionPolicyBenchmark [trace_file]
+//
+// The built-in traces are two render targets used on alternate frames next to streamed textures used once, a loop
+// over more than the budget, a skewed mix of sizes, and an atlas re-rendered less often than the grace period. A
+// trace file can be given instead, as text lines:
+//
+//   b <bytes>            budget
+//   o <id> <bytes>       object, ids counting up from 0
+//   s <id> <id> ...      a submission referencing those objects
+//   f                    end of frame
+//
+// Returns non-zero if the trace can't be read, or if an object was evicted while its own submission was being
+// paged in.
+
+#define RESIDENCY_SINGLE_THREADED 1
+#include "../ResidencyReplay/Win32Shim.h"
+#include "../../d3dx12Residency.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using namespace D3DX12Residency;
+
+    const uint64_t kMB = 1024 * 1024;
+
+    // Time is counted in frames; at 60 Hz this is the library's minimum grace period of one second,
+    // which is what it uses under full memory pressure
+    const uint64_t kGracePeriodFrames = 60;
+
+    typedef std::vector<uint32_t> Submission;
+
+    struct Trace
+    {
+        std::string name;
+        uint64_t budget;
+        std::vector<uint64_t> objectSizes;
+        std::vector<std::vector<Submission>> frames;
+    };
+
+    struct Result
+    {
+        uint64_t bytesPagedIn;
+        uint64_t pageIns;
+        uint64_t evictions;
+        uint64_t stalls;
+    };
+
+    uint32_t AddObject(Trace& trace, uint64_t size)
+    {
+        trace.objectSizes.push_back(size);
+        return (uint32_t)trace.objectSizes.size() - 1;
+    }
+
+    // Picks from count items, the first ones most often
+    class Zipf
+    {
+    public:
+        Zipf(uint32_t count, double exponent)
+        {
+            double sum = 0.0;
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                sum += 1.0 / pow(i + 1.0, exponent);
+                m_cdf.push_back(sum);
+            }
+        }
+
+        uint32_t operator()(std::mt19937& rng)
+        {
+            double u = std::uniform_real_distribution<double>(0.0, m_cdf.back())(rng);
+            return (uint32_t)std::min<size_t>(std::upper_bound(m_cdf.begin(), m_cdf.end(), u) - m_cdf.begin(), m_cdf.size() - 1);
+        }
+
+    private:
+        std::vector<double> m_cdf;
+    };
+
+    // Draws distinct objects from the given ones, popular ones first
+    Submission DrawSubmission(std::mt19937& rng, Zipf& zipf, const std::vector<uint32_t>& objects, uint32_t count)
+    {
+        Submission submission;
+        while (submission.size() < count)
+        {
+            uint32_t object = objects[zipf(rng)];
+            if (std::find(submission.begin(), submission.end(), object) == submission.end())
+                submission.push_back(object);
+        }
+        return submission;
+    }
+
+    // Two 32 MB render targets, each used every other frame, next to 40 textures used every frame
+    // and 48 MB of textures streamed in for a single frame.  Between its uses a target is older than
+    // the streamed textures, so LRU pages it out every time.
+    Trace AlternatingTargetsTrace()
+    {
+        Trace trace;
+        trace.name = "alternating targets";
+
+        std::mt19937 rng(1);
+        Submission frameTextures;
+        for (uint32_t i = 0; i < 40; ++i)
+            frameTextures.push_back(AddObject(trace, (1 + rng() % 4) * kMB));
+
+        uint32_t targets[2] = { AddObject(trace, 32 * kMB), AddObject(trace, 32 * kMB) };
+
+        std::vector<uint32_t> streamed;
+        for (uint32_t i = 0; i < 2000; ++i)
+            streamed.push_back(AddObject(trace, 2 * kMB));
+
+        size_t nextStreamed = 0;
+        for (uint32_t frame = 0; frame < 600; ++frame)
+        {
+            std::vector<Submission> submissions;
+            submissions.push_back(frameTextures);
+            submissions.back().push_back(targets[frame & 1]);
+
+            Submission streaming;
+            for (uint32_t i = 0; i < 24; ++i)
+                streaming.push_back(streamed[nextStreamed++ % streamed.size()]);
+            submissions.push_back(streaming);
+
+            trace.frames.push_back(submissions);
+        }
+
+        trace.budget = 240 * kMB;
+        return trace;
+    }
+
+    // Cycles through 100 4 MB objects, 30 per frame, with room for 75 of them
+    Trace LoopTrace()
+    {
+        Trace trace;
+        trace.name = "loop over budget";
+
+        for (uint32_t i = 0; i < 100; ++i)
+            AddObject(trace, 4 * kMB);
+
+        uint32_t next = 0;
+        for (uint32_t frame = 0; frame < 600; ++frame)
+        {
+            Submission submission;
+            for (uint32_t i = 0; i < 30; ++i)
+                submission.push_back(next++ % 100);
+            trace.frames.push_back(std::vector<Submission>(1, submission));
+        }
+
+        trace.budget = 300 * kMB;
+        return trace;
+    }
+
+    // 2000 objects from 64 KB to 16 MB, three submissions a frame drawn with a skew that
+    // doesn't depend on size
+    Trace SkewedMixTrace()
+    {
+        Trace trace;
+        trace.name = "skewed mix";
+
+        std::mt19937 rng(2);
+        std::vector<uint32_t> objects;
+        uint64_t totalSize = 0;
+        for (uint32_t i = 0; i < 2000; ++i)
+        {
+            uint64_t size = (64 * 1024ull) << (rng() % 9);
+            objects.push_back(AddObject(trace, size));
+            totalSize += size;
+        }
+
+        Zipf zipf((uint32_t)objects.size(), 0.9);
+        for (uint32_t frame = 0; frame < 600; ++frame)
+        {
+            std::vector<Submission> submissions;
+            for (uint32_t i = 0; i < 3; ++i)
+                submissions.push_back(DrawSubmission(rng, zipf, objects, 50));
+            trace.frames.push_back(submissions);
+        }
+
+        trace.budget = totalSize / 10;
+        return trace;
+    }
+
+    // A 48 MB probe atlas re-rendered every 90 frames, one submission per cube face, next to 40
+    // textures used every frame, all well under the budget. The atlas is older than the grace period
+    // between its uses, so it ages out under LRU and is paged back in for every re-render.
+    Trace PeriodicPassTrace()
+    {
+        Trace trace;
+        trace.name = "periodic pass";
+
+        std::mt19937 rng(3);
+        Submission frameTextures;
+        for (uint32_t i = 0; i < 40; ++i)
+            frameTextures.push_back(AddObject(trace, (1 + rng() % 4) * kMB));
+
+        uint32_t atlas = AddObject(trace, 48 * kMB);
+
+        for (uint32_t frame = 0; frame < 600; ++frame)
+        {
+            std::vector<Submission> submissions(1, frameTextures);
+            if (frame % 90 == 0)
+            {
+                for (uint32_t face = 0; face < 6; ++face)
+                    submissions.push_back(Submission(1, atlas));
+            }
+            trace.frames.push_back(submissions);
+        }
+
+        trace.budget = 512 * kMB;
+        return trace;
+    }
+
+    bool ReadTrace(const char* fileName, Trace& trace)
+    {
+        std::ifstream file(fileName);
+        if (!file)
+        {
+            printf("failed to open %s\n", fileName);
+            return false;
+        }
+
+        trace.name = fileName;
+        trace.budget = 0;
+        trace.frames.push_back(std::vector<Submission>());
+
+        std::string line;
+        for (uint32_t lineNumber = 1; std::getline(file, line); ++lineNumber)
+        {
+            std::istringstream tokens(line);
+            std::string op;
+            if (!(tokens >> op))
+                continue;
+
+            bool valid = true;
+            if (op == "b")
+            {
+                valid = !!(tokens >> trace.budget);
+            }
+            else if (op == "o")
+            {
+                uint32_t id = 0;
+                uint64_t size = 0;
+                valid = (tokens >> id >> size) && id == trace.objectSizes.size();
+                if (valid)
+                    AddObject(trace, size);
+            }
+            else if (op == "s")
+            {
+                Submission submission;
+                uint32_t id = 0;
+                while (valid && tokens >> id)
+                {
+                    valid = id < trace.objectSizes.size();
+                    submission.push_back(id);
+                }
+                valid = valid && tokens.eof();
+                trace.frames.back().push_back(submission);
+            }
+            else if (op == "f")
+            {
+                trace.frames.push_back(std::vector<Submission>());
+            }
+            else
+            {
+                valid = false;
+            }
+
+            if (!valid)
+            {
+                printf("%s(%u): can't parse \"%s\"\n", fileName, lineNumber, line.c_str());
+                return false;
+            }
+        }
+
+        if (trace.frames.back().empty())
+            trace.frames.pop_back();
+
+        if (trace.budget == 0 || trace.frames.empty())
+        {
+            printf("%s: needs a budget and at least one submission\n", fileName);
+            return false;
+        }
+        return true;
+    }
+
+    // Does what ResidencyManagerInternal::ProcessPagingWork does to the cache for each submission, with the
+    // GPU finishing each submission before the next one is paged in.  Objects start out evicted.
+    bool Replay(const Trace& trace, EvictionPolicy* policy, Result& result)
+    {
+        result = Result();
+
+        // The cache never dereferences the underlying objects, it only hands them back for Evict
+        std::vector<ManagedObject> objects(trace.objectSizes.size());
+        Internal::LRUCache lru;
+        lru.pPolicy = policy;
+        for (size_t i = 0; i < objects.size(); ++i)
+        {
+            objects[i].Initialize(nullptr, trace.objectSizes[i]);
+            objects[i].ResidencyStatus = ManagedObject::RESIDENCY_STATUS::EVICTED;
+            lru.Insert(&objects[i]);
+        }
+
+        std::vector<ID3D12Pageable*> evictionList(objects.size());
+        uint64_t generation = 0;
+        for (size_t frame = 0; frame < trace.frames.size(); ++frame)
+        {
+            for (const Submission& submission : trace.frames[frame])
+            {
+                ++generation;
+                for (uint32_t id : submission)
+                {
+                    ManagedObject* object = &objects[id];
+                    if (object->LastGPUSyncPoint == generation)
+                        continue;
+
+                    if (object->ResidencyStatus == ManagedObject::RESIDENCY_STATUS::EVICTED)
+                    {
+                        lru.MakeResident(object);
+                        result.bytesPagedIn += object->Size;
+                        result.pageIns++;
+                    }
+
+                    object->LastGPUSyncPoint = generation;
+                    object->LastUsedTimestamp = frame;
+                    lru.ObjectReferenced(object);
+                }
+
+                UINT32 numEvicted = 0;
+                lru.TrimAgedAllocations(nullptr, evictionList.data(), numEvicted, frame, kGracePeriodFrames);
+                result.evictions += numEvicted;
+
+                if (lru.ResidentSize > trace.budget)
+                {
+                    result.stalls++;
+                    lru.TrimToSyncPointInclusive(INT64(lru.ResidentSize), INT64(trace.budget), evictionList.data(), numEvicted, generation - 1);
+                    result.evictions += numEvicted;
+                }
+
+                for (uint32_t id : submission)
+                {
+                    if (objects[id].ResidencyStatus != ManagedObject::RESIDENCY_STATUS::RESIDENT)
+                    {
+                        printf("%s: object %u was evicted by the submission that uses it\n", trace.name.c_str(), id);
+                        return false;
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* traceFile = argc > 1 ? argv[1] : nullptr;
+
+    std::vector<Trace> traces;
+    if (traceFile)
+    {
+        traces.push_back(Trace());
+        if (!ReadTrace(traceFile, traces.back()))
+            return 1;
+    }
+    else
+    {
+        traces.push_back(AlternatingTargetsTrace());
+        traces.push_back(LoopTrace());
+        traces.push_back(SkewedMixTrace());
+        traces.push_back(PeriodicPassTrace());
+    }
+
+    // A null policy is the library's default, least recently used first
+    struct
+    {
+        const char* name;
+        bool useGdsf;
+        uint64_t makeResidentOverhead;
+    } policies[] =
+    {
+        { "LRU", false, 0 },
+        { "GDSF 64 KB", true, 64 * 1024 },
+        { "GDSF 4 MB", true, 4 * kMB },
+    };
+
+    printf("residency eviction policy benchmark (per frame)\n");
+    printf("%-20s %-12s %12s %10s %10s %8s\n", "trace", "policy", "MB paged in", "page-ins", "evictions", "stalls");
+
+    for (const Trace& trace : traces)
+    {
+        for (auto& entry : policies)
+        {
+            GreedyDualSizeEvictionPolicy gdsf(entry.makeResidentOverhead);
+
+            Result result;
+            if (!Replay(trace, entry.useGdsf ? &gdsf : nullptr, result))
+                return 1;
+
+            double frames = (double)trace.frames.size();
+            printf("%-20s %-12s %12.2f %10.2f %10.2f %8.2f\n", trace.name.c_str(), entry.name,
+                result.bytesPagedIn / (double)kMB / frames, result.pageIns / frames, result.evictions / frames,
+                result.stalls / frames);
+        }
+    }
+
+    return 0;
+}
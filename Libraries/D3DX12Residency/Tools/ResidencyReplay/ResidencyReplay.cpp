@@ -0,0 +1,696 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// Replays a trace recorded with ResidencyManager::StartTrace through the residency library, against a mock device
+// whose budget and GPU progress follow the trace, and reports the paging per frame. Builds without the Windows SDK:
+//
+//   g++ -std=c++17 -O2 ResidencyReplay.cpp -o ResidencyReplay
+//   ResidencyReplay trace.bin [-gdsf] [-budget_scale <scale>] [-summary]
+//
+// -gdsf replays with the GreedyDualSizeEvictionPolicy instead of LRU, and -budget_scale multiplies every recorded
+// budget, to see how the same workload would page with other settings.
+
+#define RESIDENCY_SINGLE_THREADED 1
+#include "Win32Shim.h"
+#include "../../d3dx12Residency.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+using namespace D3DX12Residency;
+
+namespace
+{
+    struct FrameStats
+    {
+        UINT64 Executes;
+        UINT64 BytesMadeResident;
+        UINT64 ObjectsMadeResident;
+        UINT64 MakeResidentCalls;
+        UINT64 BytesEvicted;
+        UINT64 ObjectsEvicted;
+        UINT64 GPUWaits;
+    };
+
+    const double cMB = 1024.0 * 1024.0;
+
+    // Counts the paging of the frame being replayed, and anything the library does that a real device would reject
+    struct ReplayState
+    {
+        FrameStats Frame;
+        UINT64 ResidentBytes;
+        UINT64 Errors;
+    };
+
+    class MockPageable : public ID3D12Pageable
+    {
+    public:
+        MockPageable(UINT64 SizeIn, bool ResidentIn) : Size(SizeIn), Resident(ResidentIn) {}
+
+        UINT64 Size;
+        bool Resident;
+    };
+
+    // Only completes when the CPU signals it, when the trace says the GPU got there, or when the library waits on it
+    class MockFence : public ID3D12Fence
+    {
+    public:
+        MockFence(ReplayState* pStateIn) : pState(pStateIn), CompletedValue(0) {}
+
+        UINT64 GetCompletedValue() { return CompletedValue; }
+
+        HRESULT SetEventOnCompletion(UINT64 Value, HANDLE Event)
+        {
+            if (CompletedValue < Value)
+            {
+                pState->Frame.GPUWaits++;
+                CompletedValue = Value;
+            }
+            SetEvent(Event);
+            return S_OK;
+        }
+
+        HRESULT Signal(UINT64 Value)
+        {
+            CompletedValue = RESIDENCY_MAX(CompletedValue, Value);
+            return S_OK;
+        }
+
+        ULONG Release()
+        {
+            delete this;
+            return 0;
+        }
+
+        ReplayState* pState;
+        UINT64 CompletedValue;
+    };
+
+    class MockQueue : public ID3D12CommandQueue
+    {
+    public:
+        MockQueue() : pSignaledFence(nullptr), LastSignaledValue(0) {}
+
+        HRESULT GetPrivateData(const GUID&, UINT* pDataSize, void* pData)
+        {
+            if (PrivateData.empty() || *pDataSize < PrivateData.size())
+            {
+                return E_FAIL;
+            }
+            memcpy(pData, PrivateData.data(), PrivateData.size());
+            return S_OK;
+        }
+
+        HRESULT SetPrivateData(const GUID&, UINT DataSize, const void* pData)
+        {
+            PrivateData.assign(static_cast<const BYTE*>(pData), static_cast<const BYTE*>(pData) + DataSize);
+            return S_OK;
+        }
+
+        HRESULT Wait(ID3D12Fence*, UINT64) { return S_OK; }
+
+        // The GPU gets to it when the trace says so
+        HRESULT Signal(ID3D12Fence* pFence, UINT64 Value)
+        {
+            pSignaledFence = static_cast<MockFence*>(pFence);
+            LastSignaledValue = Value;
+            return S_OK;
+        }
+
+        void ExecuteCommandLists(UINT, ID3D12CommandList* const*) {}
+
+        // The trace's fence values line up with the replay's, as both count signals from the start
+        void Complete(UINT64 Value)
+        {
+            if (pSignaledFence)
+            {
+                pSignaledFence->Signal(RESIDENCY_MIN(Value, LastSignaledValue));
+            }
+        }
+
+    private:
+        std::vector<BYTE> PrivateData;
+        MockFence* pSignaledFence;
+        UINT64 LastSignaledValue;
+    };
+
+    class MockDevice : public ID3D12Device
+    {
+    public:
+        MockDevice(ReplayState* pStateIn) : pState(pStateIn) {}
+
+        HRESULT CreateFence(UINT64 InitialValue, D3D12_FENCE_FLAGS, const GUID&, void** ppFence)
+        {
+            MockFence* pFence = new MockFence(pState);
+            pFence->CompletedValue = InitialValue;
+            *ppFence = static_cast<ID3D12Fence*>(pFence);
+            return S_OK;
+        }
+
+        HRESULT MakeResident(UINT NumObjects, ID3D12Pageable* const* ppObjects)
+        {
+            pState->Frame.MakeResidentCalls++;
+            for (UINT i = 0; i < NumObjects; i++)
+            {
+                MockPageable* pObject = static_cast<MockPageable*>(ppObjects[i]);
+                if (pObject->Resident)
+                {
+                    pState->Errors++;
+                    continue;
+                }
+
+                pObject->Resident = true;
+                pState->ResidentBytes += pObject->Size;
+                pState->Frame.BytesMadeResident += pObject->Size;
+                pState->Frame.ObjectsMadeResident++;
+            }
+            return S_OK;
+        }
+
+        HRESULT Evict(UINT NumObjects, ID3D12Pageable* const* ppObjects)
+        {
+            for (UINT i = 0; i < NumObjects; i++)
+            {
+                MockPageable* pObject = static_cast<MockPageable*>(ppObjects[i]);
+                if (pObject->Resident == false)
+                {
+                    pState->Errors++;
+                    continue;
+                }
+
+                pObject->Resident = false;
+                pState->ResidentBytes -= pObject->Size;
+                pState->Frame.BytesEvicted += pObject->Size;
+                pState->Frame.ObjectsEvicted++;
+            }
+            return S_OK;
+        }
+
+    private:
+        ReplayState* pState;
+    };
+
+    // Budgets come from the trace. The usage is what the trace saw from outside the manager's objects, plus the
+    // replay's own resident objects, which are all counted as local.
+    class MockAdapter : public IDXGIAdapter3
+    {
+    public:
+        MockAdapter(ReplayState* pStateIn, double BudgetScaleIn) : pState(pStateIn), BudgetScale(BudgetScaleIn)
+        {
+            for (UINT i = 0; i < 2; i++)
+            {
+                Budget[i] = UINT64(1) << 48;
+                ExternalUsage[i] = 0;
+            }
+        }
+
+        HRESULT QueryVideoMemoryInfo(UINT, DXGI_MEMORY_SEGMENT_GROUP Segment, DXGI_QUERY_VIDEO_MEMORY_INFO* pInfo)
+        {
+            ZeroMemory(pInfo, sizeof(*pInfo));
+            pInfo->Budget = UINT64(Budget[Segment] * BudgetScale);
+            pInfo->CurrentUsage = ExternalUsage[Segment] + (Segment == DXGI_MEMORY_SEGMENT_GROUP_LOCAL ? pState->ResidentBytes : 0);
+            return S_OK;
+        }
+
+        void SetBudget(UINT64 Segment, UINT64 BudgetIn, UINT64 CurrentUsage, UINT64 ResidentSize)
+        {
+            if (Segment > 1)
+            {
+                return;
+            }
+
+            Budget[Segment] = BudgetIn;
+            ExternalUsage[Segment] = (Segment == DXGI_MEMORY_SEGMENT_GROUP_LOCAL) ?
+                CurrentUsage - RESIDENCY_MIN(CurrentUsage, ResidentSize) : CurrentUsage;
+        }
+
+    private:
+        ReplayState* pState;
+        double BudgetScale;
+        UINT64 Budget[2];
+        UINT64 ExternalUsage[2];
+    };
+
+    class TraceReader
+    {
+    public:
+        bool Load(const char* FileName)
+        {
+            FILE* pFile = fopen(FileName, "rb");
+            if (pFile == nullptr)
+            {
+                fprintf(stderr, "failed to open %s\n", FileName);
+                return false;
+            }
+
+            BYTE Chunk[64 * 1024];
+            size_t Read = 0;
+            while ((Read = fread(Chunk, 1, sizeof(Chunk), pFile)) > 0)
+            {
+                Data.insert(Data.end(), Chunk, Chunk + Read);
+            }
+            fclose(pFile);
+
+            Position = 0;
+            UINT32 Magic = 0;
+            for (UINT32 i = 0; i < 4 && Position < Data.size(); i++)
+            {
+                Magic |= UINT32(Data[Position++]) << (i * 8);
+            }
+
+            if (Magic != Internal::TraceWriter::TRACE_MAGIC || ReadUInt() != Internal::TraceWriter::TRACE_VERSION)
+            {
+                fprintf(stderr, "%s is not a residency trace this replay can read\n", FileName);
+                return false;
+            }
+
+            Frequency = ReadUInt();
+            return Valid && Frequency != 0;
+        }
+
+        inline bool AtEnd() const { return Position >= Data.size(); }
+        inline bool IsValid() const { return Valid; }
+        inline size_t GetPosition() const { return Position; }
+        inline void SetPosition(size_t PositionIn) { Position = PositionIn; }
+        inline BYTE PeekByte() const { return Data[Position]; }
+        inline BYTE ReadByte() { return Data[Position++]; }
+
+        UINT64 ReadUInt()
+        {
+            UINT64 Value = 0;
+            for (UINT32 Shift = 0; Shift < 64; Shift += 7)
+            {
+                if (AtEnd())
+                {
+                    break;
+                }
+
+                BYTE Byte = Data[Position++];
+                Value |= UINT64(Byte & 0x7F) << Shift;
+                if ((Byte & 0x80) == 0)
+                {
+                    return Value;
+                }
+            }
+
+            Valid = false;
+            return 0;
+        }
+
+        UINT64 Frequency;
+
+    private:
+        std::vector<BYTE> Data;
+        size_t Position = 0;
+        bool Valid = true;
+    };
+
+    class Replay
+    {
+    public:
+        Replay(double BudgetScale) :
+            Device(&State),
+            Adapter(&State, BudgetScale),
+            Time(0)
+        {
+            State = ReplayState();
+        }
+
+        ~Replay()
+        {
+            for (ResidencySet* pSet : Sets)
+            {
+                Manager.DestroyResidencySet(pSet);
+            }
+            Manager.Destroy();
+        }
+
+        bool Run(TraceReader& Reader, EvictionPolicy* pPolicy)
+        {
+            Win32Shim::PerformanceFrequency = INT64(Reader.Frequency);
+            Win32Shim::PerformanceCounter = 0;
+
+            if (FAILED(Manager.Initialize(&Device, 0, &Adapter, 3)))
+            {
+                return false;
+            }
+            Manager.SetEvictionPolicy(pPolicy);
+
+            // Fence and budget records written while the paging work ran are applied before the work they follow,
+            // as that's what the live manager saw when it paged
+            size_t ObservedUpTo = 0;
+            while (Reader.AtEnd() == false && Reader.IsValid())
+            {
+                size_t RecordStart = Reader.GetPosition();
+                BYTE Type = Reader.ReadByte();
+
+                if (IsObservation(Type))
+                {
+                    bool Apply = RecordStart >= ObservedUpTo;
+                    ReadObservation(Reader, Type, Apply);
+                    continue;
+                }
+
+                if (Type == Internal::TRACE_RECORD_EXECUTE || Type == Internal::TRACE_RECORD_SYNC_POINT)
+                {
+                    AdvanceTime(Reader.ReadUInt());
+                    MockQueue* pQueue = GetQueue(Reader.ReadUInt());
+
+                    size_t Resume = Reader.GetPosition();
+                    if (Type == Internal::TRACE_RECORD_EXECUTE)
+                    {
+                        SkipExecute(Reader);
+                    }
+                    Reader.SetPosition(RESIDENCY_MAX(Reader.GetPosition(), ObservedUpTo));
+                    while (Reader.AtEnd() == false && IsObservation(Reader.PeekByte()))
+                    {
+                        ReadObservation(Reader, Reader.ReadByte(), true);
+                    }
+                    ObservedUpTo = RESIDENCY_MAX(ObservedUpTo, Reader.GetPosition());
+                    Reader.SetPosition(Resume);
+
+                    if (Type == Internal::TRACE_RECORD_EXECUTE)
+                    {
+                        Execute(Reader, pQueue);
+                    }
+                    else
+                    {
+                        UINT64 SyncPoint = 0;
+                        Manager.GetCurrentGPUSyncPoint(pQueue, &SyncPoint);
+                    }
+                }
+                else if (Type == Internal::TRACE_RECORD_TRACK_OBJECT)
+                {
+                    UINT64 ID = Reader.ReadUInt();
+                    UINT64 Size = Reader.ReadUInt();
+                    bool Evicted = Reader.ReadUInt() != 0;
+                    TrackObject(ID, Size, Evicted);
+                }
+                else if (Type == Internal::TRACE_RECORD_UNTRACK_OBJECT)
+                {
+                    UINT64 ID = Reader.ReadUInt();
+                    if (ID < Objects.size() && Objects[ID])
+                    {
+                        Manager.EndTrackingObject(&Objects[ID]->Object);
+                        Objects[ID].reset();
+                    }
+                }
+                else if (Type == Internal::TRACE_RECORD_FRAME)
+                {
+                    AdvanceTime(Reader.ReadUInt());
+                    EndFrame();
+                }
+                else
+                {
+                    fprintf(stderr, "unknown record %u at offset %zu\n", Type, RecordStart);
+                    return false;
+                }
+            }
+
+            if (Reader.IsValid() == false)
+            {
+                fprintf(stderr, "the trace is truncated\n");
+                return false;
+            }
+
+            if (State.Frame.Executes > 0)
+            {
+                EndFrame();
+            }
+            return true;
+        }
+
+        std::vector<FrameStats> Frames;
+        UINT64 NonResidentExecutions = 0;
+
+        UINT64 GetErrors() const { return State.Errors; }
+
+    private:
+        struct TrackedObject
+        {
+            TrackedObject(UINT64 Size, bool Evicted) : Pageable(Size, !Evicted) {}
+
+            MockPageable Pageable;
+            ManagedObject Object;
+        };
+
+        static bool IsObservation(BYTE Type)
+        {
+            return Type == Internal::TRACE_RECORD_BUDGET || Type == Internal::TRACE_RECORD_FENCE_COMPLETED;
+        }
+
+        void ReadObservation(TraceReader& Reader, BYTE Type, bool Apply)
+        {
+            if (Type == Internal::TRACE_RECORD_BUDGET)
+            {
+                UINT64 Segment = Reader.ReadUInt();
+                UINT64 Budget = Reader.ReadUInt();
+                UINT64 CurrentUsage = Reader.ReadUInt();
+                UINT64 ResidentSize = Reader.ReadUInt();
+                if (Apply)
+                {
+                    Adapter.SetBudget(Segment, Budget, CurrentUsage, ResidentSize);
+                }
+            }
+            else
+            {
+                UINT64 QueueIndex = Reader.ReadUInt();
+                UINT64 CompletedValue = Reader.ReadUInt();
+                if (Apply)
+                {
+                    GetQueue(QueueIndex)->Complete(CompletedValue);
+                }
+            }
+        }
+
+        void AdvanceTime(UINT64 Delta)
+        {
+            Time += Delta;
+            Win32Shim::PerformanceCounter = INT64(Time);
+        }
+
+        MockQueue* GetQueue(UINT64 Index)
+        {
+            while (Queues.size() <= Index)
+            {
+                Queues.emplace_back(new MockQueue());
+            }
+            return Queues[size_t(Index)].get();
+        }
+
+        void TrackObject(UINT64 ID, UINT64 Size, bool Evicted)
+        {
+            if (Objects.size() <= ID)
+            {
+                Objects.resize(size_t(ID) + 1);
+            }
+
+            TrackedObject* pTracked = new TrackedObject(Size, Evicted);
+            Objects[size_t(ID)].reset(pTracked);
+
+            pTracked->Object.Initialize(&pTracked->Pageable, Size);
+            if (Evicted)
+            {
+                pTracked->Object.ResidencyStatus = ManagedObject::RESIDENCY_STATUS::EVICTED;
+            }
+            else
+            {
+                State.ResidentBytes += Size;
+            }
+            Manager.BeginTrackingObject(&pTracked->Object);
+        }
+
+        ManagedObject* GetObject(UINT64 ID)
+        {
+            return (ID < Objects.size() && Objects[size_t(ID)]) ? &Objects[size_t(ID)]->Object : nullptr;
+        }
+
+        void SkipExecute(TraceReader& Reader)
+        {
+            UINT64 NumSets = Reader.ReadUInt();
+            for (UINT64 i = 0; i < NumSets && Reader.IsValid(); i++)
+            {
+                UINT64 NumObjects = Reader.ReadUInt();
+                for (UINT64 j = 0; j < NumObjects && Reader.IsValid(); j++)
+                {
+                    Reader.ReadUInt();
+                }
+            }
+        }
+
+        void Execute(TraceReader& Reader, MockQueue* pQueue)
+        {
+            UINT32 NumSets = UINT32(Reader.ReadUInt());
+            while (Sets.size() < NumSets)
+            {
+                Sets.push_back(Manager.CreateResidencySet());
+            }
+            CommandLists.resize(RESIDENCY_MAX(CommandLists.size(), size_t(NumSets)), nullptr);
+
+            Referenced.clear();
+            for (UINT32 i = 0; i < NumSets && Reader.IsValid(); i++)
+            {
+                Sets[i]->Open();
+                UINT64 NumObjects = Reader.ReadUInt();
+                for (UINT64 j = 0; j < NumObjects && Reader.IsValid(); j++)
+                {
+                    ManagedObject* pObject = GetObject(Reader.ReadUInt());
+                    if (pObject)
+                    {
+                        Sets[i]->Insert(pObject);
+                        Referenced.push_back(pObject);
+                    }
+                }
+                Sets[i]->Close();
+            }
+
+            Manager.ExecuteCommandLists(pQueue, CommandLists.data(), Sets.data(), NumSets);
+            State.Frame.Executes++;
+
+            // The paging work ran inline, so everything these sets use must be resident by now
+            for (ManagedObject* pObject : Referenced)
+            {
+                if (static_cast<MockPageable*>(pObject->pUnderlying)->Resident == false)
+                {
+                    NonResidentExecutions++;
+                    break;
+                }
+            }
+        }
+
+        void EndFrame()
+        {
+            Frames.push_back(State.Frame);
+            State.Frame = FrameStats();
+        }
+
+        ReplayState State;
+        MockDevice Device;
+        MockAdapter Adapter;
+        ResidencyManager Manager;
+        UINT64 Time;
+
+        std::vector<std::unique_ptr<TrackedObject>> Objects;
+        std::vector<std::unique_ptr<MockQueue>> Queues;
+        std::vector<ResidencySet*> Sets;
+        std::vector<ID3D12CommandList*> CommandLists;
+        std::vector<ManagedObject*> Referenced;
+    };
+
+    void PrintFrame(const char* Label, const FrameStats& Frame, double Scale)
+    {
+        printf("%-8s %9.1f %12.2f %10.1f %14.1f %11.2f %10.1f %9.2f\n", Label, Frame.Executes * Scale,
+            Frame.BytesMadeResident * Scale / cMB, Frame.ObjectsMadeResident * Scale, Frame.MakeResidentCalls * Scale,
+            Frame.BytesEvicted * Scale / cMB, Frame.ObjectsEvicted * Scale, Frame.GPUWaits * Scale);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* FileName = nullptr;
+    bool UseGDSF = false;
+    bool SummaryOnly = false;
+    double BudgetScale = 1.0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-gdsf") == 0)
+        {
+            UseGDSF = true;
+        }
+        else if (strcmp(argv[i], "-summary") == 0)
+        {
+            SummaryOnly = true;
+        }
+        else if (strcmp(argv[i], "-budget_scale") == 0 && i + 1 < argc)
+        {
+            BudgetScale = atof(argv[++i]);
+        }
+        else if (FileName == nullptr && argv[i][0] != '-')
+        {
+            FileName = argv[i];
+        }
+        else
+        {
+            FileName = nullptr;
+            break;
+        }
+    }
+
+    if (FileName == nullptr || BudgetScale <= 0.0)
+    {
+        printf("usage: ResidencyReplay trace.bin [-gdsf] [-budget_scale <scale>] [-summary]\n");
+        return 1;
+    }
+
+    TraceReader Reader;
+    if (Reader.Load(FileName) == false)
+    {
+        return 1;
+    }
+
+    GreedyDualSizeEvictionPolicy GDSF;
+    Replay Replayer(BudgetScale);
+    if (Replayer.Run(Reader, UseGDSF ? &GDSF : nullptr) == false)
+    {
+        return 1;
+    }
+
+    printf("%s: %zu frames, %s eviction, budget x%.2f\n", FileName, Replayer.Frames.size(), UseGDSF ? "GDSF" : "LRU", BudgetScale);
+    printf("%-8s %9s %12s %10s %14s %11s %10s %9s\n", "frame", "executes", "MB paged in", "page-ins",
+        "MakeResident()", "MB evicted", "evictions", "GPU waits");
+
+    FrameStats Total = FrameStats();
+    FrameStats Worst = FrameStats();
+    for (size_t i = 0; i < Replayer.Frames.size(); i++)
+    {
+        const FrameStats& Frame = Replayer.Frames[i];
+        if (SummaryOnly == false)
+        {
+            char Label[32];
+            snprintf(Label, sizeof(Label), "%zu", i);
+            PrintFrame(Label, Frame, 1.0);
+        }
+
+        Total.Executes += Frame.Executes;
+        Total.BytesMadeResident += Frame.BytesMadeResident;
+        Total.ObjectsMadeResident += Frame.ObjectsMadeResident;
+        Total.MakeResidentCalls += Frame.MakeResidentCalls;
+        Total.BytesEvicted += Frame.BytesEvicted;
+        Total.ObjectsEvicted += Frame.ObjectsEvicted;
+        Total.GPUWaits += Frame.GPUWaits;
+
+        Worst.Executes = RESIDENCY_MAX(Worst.Executes, Frame.Executes);
+        Worst.BytesMadeResident = RESIDENCY_MAX(Worst.BytesMadeResident, Frame.BytesMadeResident);
+        Worst.ObjectsMadeResident = RESIDENCY_MAX(Worst.ObjectsMadeResident, Frame.ObjectsMadeResident);
+        Worst.MakeResidentCalls = RESIDENCY_MAX(Worst.MakeResidentCalls, Frame.MakeResidentCalls);
+        Worst.BytesEvicted = RESIDENCY_MAX(Worst.BytesEvicted, Frame.BytesEvicted);
+        Worst.ObjectsEvicted = RESIDENCY_MAX(Worst.ObjectsEvicted, Frame.ObjectsEvicted);
+        Worst.GPUWaits = RESIDENCY_MAX(Worst.GPUWaits, Frame.GPUWaits);
+    }
+
+    if (Replayer.Frames.empty() == false)
+    {
+        PrintFrame("average", Total, 1.0 / Replayer.Frames.size());
+        PrintFrame("worst", Worst, 1.0);
+    }
+
+    // A real device would have failed these
+    if (Replayer.GetErrors() > 0 || Replayer.NonResidentExecutions > 0)
+    {
+        printf("%llu redundant MakeResident or Evict calls, %llu executions with evicted objects\n",
+            (unsigned long long)Replayer.GetErrors(), (unsigned long long)Replayer.NonResidentExecutions);
+        return 1;
+    }
+
+    return 0;
+}
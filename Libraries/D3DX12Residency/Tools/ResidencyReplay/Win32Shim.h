@@ -0,0 +1,244 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+// Just enough of Win32, D3D12 and DXGI for d3dx12Residency.h to build without the Windows SDK, so that
+// ResidencyReplay and EvictionPolicyBenchmark can run the library on any platform. The D3D12 and DXGI interfaces are left abstract for
+// the replay to mock, and the library must be built with RESIDENCY_SINGLE_THREADED, as events can't block.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mutex>
+
+typedef unsigned char BYTE;
+typedef unsigned int UINT;
+typedef uint32_t UINT32;
+typedef int32_t INT32;
+typedef int64_t INT64;
+typedef uint64_t UINT64;
+typedef int64_t LONG64;
+typedef unsigned long ULONG;
+typedef unsigned long DWORD;
+typedef size_t SIZE_T;
+typedef int BOOL;
+typedef int32_t HRESULT;
+typedef void* HANDLE;
+
+#define S_OK                    ((HRESULT)0)
+#define E_FAIL                  ((HRESULT)0x80004005L)
+#define E_INVALIDARG            ((HRESULT)0x80070057L)
+#define E_OUTOFMEMORY           ((HRESULT)0x8007000EL)
+#define E_ILLEGAL_METHOD_CALL   ((HRESULT)0x8000000EL)
+#define SUCCEEDED(hr)           (((HRESULT)(hr)) >= 0)
+#define FAILED(hr)              (((HRESULT)(hr)) < 0)
+#define HRESULT_FROM_WIN32(x)   E_FAIL
+
+#define INVALID_HANDLE_VALUE    ((HANDLE)(intptr_t)-1)
+#define INFINITE                0xFFFFFFFF
+#define WAIT_OBJECT_0           0
+#define GENERIC_WRITE           0x40000000
+#define CREATE_ALWAYS           2
+#define FILE_ATTRIBUTE_NORMAL   0x80
+
+#define MAXUINT32               UINT32_MAX
+#define MAXUINT64               UINT64_MAX
+
+#define WINAPI
+#define FORCEINLINE inline
+#define __declspec(x) inline
+#define UNREFERENCED_PARAMETER(x) (void)(x)
+#define ZeroMemory(p, n) memset((p), 0, (n))
+#define CONTAINING_RECORD(address, type, field) ((type*)((char*)(address) - offsetof(type, field)))
+
+struct GUID
+{
+    uint32_t Data1;
+    uint16_t Data2;
+    uint16_t Data3;
+    uint8_t Data4[8];
+};
+
+#define IID_PPV_ARGS(ppType) GUID(), reinterpret_cast<void**>(ppType)
+
+struct LIST_ENTRY
+{
+    LIST_ENTRY* Flink;
+    LIST_ENTRY* Blink;
+};
+
+struct LARGE_INTEGER
+{
+    INT64 QuadPart;
+};
+
+// The replay drives the performance counter from the trace's timestamps
+namespace Win32Shim
+{
+    inline INT64 PerformanceFrequency = 1;
+    inline INT64 PerformanceCounter = 0;
+}
+
+inline BOOL QueryPerformanceFrequency(LARGE_INTEGER* pFrequency)
+{
+    pFrequency->QuadPart = Win32Shim::PerformanceFrequency;
+    return 1;
+}
+
+inline BOOL QueryPerformanceCounter(LARGE_INTEGER* pCounter)
+{
+    pCounter->QuadPart = Win32Shim::PerformanceCounter;
+    return 1;
+}
+
+inline DWORD GetLastError()
+{
+    return 0;
+}
+
+struct CRITICAL_SECTION
+{
+    std::recursive_mutex Mutex;
+};
+
+inline BOOL InitializeCriticalSectionAndSpinCount(CRITICAL_SECTION*, DWORD) { return 1; }
+inline void DeleteCriticalSection(CRITICAL_SECTION*) {}
+inline void EnterCriticalSection(CRITICAL_SECTION* pCS) { pCS->Mutex.lock(); }
+inline void LeaveCriticalSection(CRITICAL_SECTION* pCS) { pCS->Mutex.unlock(); }
+
+inline LONG64 InterlockedIncrement64(volatile LONG64* pValue)
+{
+    return __atomic_add_fetch(pValue, 1, __ATOMIC_SEQ_CST);
+}
+
+inline UINT32 InterlockedIncrement(volatile UINT32* pValue)
+{
+    return __atomic_add_fetch(pValue, 1, __ATOMIC_SEQ_CST);
+}
+
+// Events are flags; waiting on one that isn't set would never return in a single threaded replay
+struct Win32ShimEvent
+{
+    bool ManualReset;
+    bool Signaled;
+};
+
+inline HANDLE CreateEvent(void*, BOOL ManualReset, BOOL InitialState, const char*)
+{
+    return new Win32ShimEvent{ ManualReset != 0, InitialState != 0 };
+}
+
+inline BOOL SetEvent(HANDLE Event)
+{
+    static_cast<Win32ShimEvent*>(Event)->Signaled = true;
+    return 1;
+}
+
+inline BOOL ResetEvent(HANDLE Event)
+{
+    static_cast<Win32ShimEvent*>(Event)->Signaled = false;
+    return 1;
+}
+
+inline DWORD WaitForSingleObject(HANDLE Event, DWORD)
+{
+    Win32ShimEvent* pEvent = static_cast<Win32ShimEvent*>(Event);
+    if (pEvent->Signaled == false)
+    {
+        fprintf(stderr, "WaitForSingleObject on an event that is not set\n");
+        abort();
+    }
+    if (pEvent->ManualReset == false)
+    {
+        pEvent->Signaled = false;
+    }
+    return WAIT_OBJECT_0;
+}
+
+inline BOOL CloseHandle(HANDLE Event)
+{
+    delete static_cast<Win32ShimEvent*>(Event);
+    return 1;
+}
+
+// The replay doesn't write traces
+inline HANDLE CreateFileW(const wchar_t*, DWORD, DWORD, void*, DWORD, DWORD, HANDLE)
+{
+    return INVALID_HANDLE_VALUE;
+}
+
+inline BOOL WriteFile(HANDLE, const void*, DWORD, DWORD*, void*)
+{
+    return 0;
+}
+
+enum D3D12_FENCE_FLAGS
+{
+    D3D12_FENCE_FLAG_NONE = 0
+};
+
+enum DXGI_MEMORY_SEGMENT_GROUP
+{
+    DXGI_MEMORY_SEGMENT_GROUP_LOCAL = 0,
+    DXGI_MEMORY_SEGMENT_GROUP_NON_LOCAL = 1
+};
+
+struct DXGI_QUERY_VIDEO_MEMORY_INFO
+{
+    UINT64 Budget;
+    UINT64 CurrentUsage;
+    UINT64 AvailableForReservation;
+    UINT64 CurrentReservation;
+};
+
+struct ID3D12Pageable
+{
+    virtual ~ID3D12Pageable() {}
+};
+
+struct ID3D12CommandList
+{
+    virtual ~ID3D12CommandList() {}
+};
+
+struct ID3D12Fence : public ID3D12Pageable
+{
+    virtual UINT64 GetCompletedValue() = 0;
+    virtual HRESULT SetEventOnCompletion(UINT64 Value, HANDLE Event) = 0;
+    virtual HRESULT Signal(UINT64 Value) = 0;
+    virtual ULONG Release() = 0;
+};
+
+struct ID3D12CommandQueue : public ID3D12Pageable
+{
+    virtual HRESULT GetPrivateData(const GUID& Guid, UINT* pDataSize, void* pData) = 0;
+    virtual HRESULT SetPrivateData(const GUID& Guid, UINT DataSize, const void* pData) = 0;
+    virtual HRESULT Wait(ID3D12Fence* pFence, UINT64 Value) = 0;
+    virtual HRESULT Signal(ID3D12Fence* pFence, UINT64 Value) = 0;
+    virtual void ExecuteCommandLists(UINT NumCommandLists, ID3D12CommandList* const* ppCommandLists) = 0;
+};
+
+struct ID3D12Device
+{
+    virtual ~ID3D12Device() {}
+    virtual HRESULT CreateFence(UINT64 InitialValue, D3D12_FENCE_FLAGS Flags, const GUID& Riid, void** ppFence) = 0;
+    virtual HRESULT MakeResident(UINT NumObjects, ID3D12Pageable* const* ppObjects) = 0;
+    virtual HRESULT Evict(UINT NumObjects, ID3D12Pageable* const* ppObjects) = 0;
+};
+
+struct IDXGIAdapter3
+{
+    virtual ~IDXGIAdapter3() {}
+    virtual HRESULT QueryVideoMemoryInfo(UINT NodeIndex, DXGI_MEMORY_SEGMENT_GROUP MemorySegmentGroup, DXGI_QUERY_VIDEO_MEMORY_INFO* pVideoMemoryInfo) = 0;
+};
@@ -10,6 +10,9 @@
 //*********************************************************
 
 #pragma once
+
+#include <atomic>
+
 namespace D3DX12Residency
 {
     __declspec(selectany) INT64 g_ResidencyManagerUniqueID = 0;
@@ -25,13 +28,17 @@ namespace D3DX12Residency
 #define RESIDENCY_CHECK_RESULT(x) x
 #endif
 
+#ifndef RESIDENCY_SINGLE_THREADED
 #define RESIDENCY_SINGLE_THREADED 0
+#endif
 
 #define RESIDENCY_MIN(x,y) ((x) < (y) ? (x) : (y))
 #define RESIDENCY_MAX(x,y) ((x) > (y) ? (x) : (y))
 
-    // This size can be tuned to your app in order to save space
-#define MAX_NUM_CONCURRENT_CMD_LISTS 32
+    // Each object remembers the last set it was inserted into for this many sets at once, picked by the set's
+    // epoch, so that sets recorded in parallel don't hold duplicates. Any number of sets can be open; past this
+    // many a set may hold an object twice, which costs a little space. This size can be tuned to your app.
+#define RESIDENCY_SET_EPOCH_WAYS 8
 
     namespace Internal
     {
@@ -83,19 +90,17 @@ namespace D3DX12Residency
         class SyncManager
         {
         public:
-            SyncManager()
+            SyncManager() : LastSetEpoch(0) {}
+
+            // Every residency set gets a new epoch each time it is opened, so any number of sets
+            // can be open at once
+            inline UINT64 NextSetEpoch()
             {
-                for (UINT32 i = 0; i < ARRAYSIZE(AvailableCommandLists); i++)
-                {
-                    AvailableCommandLists[i] = false;
-                }
+                return UINT64(InterlockedIncrement64(&LastSetEpoch));
             }
 
-            Internal::CriticalSection MaskCriticalSection;
-
-            static const UINT32 sUnsetValue = UINT32(-1);
-            // Represents which command lists are currently open for recording
-            bool AvailableCommandLists[MAX_NUM_CONCURRENT_CMD_LISTS];
+        private:
+            volatile LONG64 LastSetEpoch;
         };
 
         //Forward Declaration
@@ -118,9 +123,13 @@ namespace D3DX12Residency
             Size(0),
             ResidencyStatus(RESIDENCY_STATUS::RESIDENT),
             LastGPUSyncPoint(0),
-            LastUsedTimestamp(0)
+            LastUsedTimestamp(0),
+            MasterSetEpoch(0),
+            EvictionCredit(0.0),
+            NumReferences(0),
+            TraceID(0)
         {
-            memset(CommandListsUsedOn, 0, sizeof(CommandListsUsedOn));
+            memset(SetEpochs, 0, sizeof(SetEpochs));
         }
 
         void Initialize(ID3D12Pageable* pUnderlyingIn, UINT64 ObjectSize, UINT64 InitialGPUSyncPoint = 0)
@@ -144,13 +153,127 @@ namespace D3DX12Residency
         UINT64 LastGPUSyncPoint;
         UINT64 LastUsedTimestamp;
 
-        // This is used to track which open command lists this resource is currently used on.
-        bool CommandListsUsedOn[MAX_NUM_CONCURRENT_CMD_LISTS];
+        // The epochs of the last residency sets this object was inserted into, and of the last master set
+        // it was merged into at execution. An object is already in a set if the epochs match, so closing
+        // a set doesn't have to visit its objects.
+        UINT64 SetEpochs[RESIDENCY_SET_EPOCH_WAYS];
+        UINT64 MasterSetEpoch;
+
+        // Belong to the residency manager's EvictionPolicy, for the ones that rank objects by more than recency
+        double EvictionCredit;
+        UINT32 NumReferences;
+
+        // Identifies the object in a residency trace, see ResidencyManager::StartTrace
+        UINT32 TraceID;
 
         // Linked list entry
         LIST_ENTRY ListEntry;
     };
 
+    // Decides which resident objects go first when the residency manager has to evict. Without one the manager
+    // evicts the least recently used objects. Every call is made from the paging work with the manager's lock held.
+    class EvictionPolicy
+    {
+    public:
+        virtual ~EvictionPolicy() {}
+
+        // The object is used by a submission that is about to be paged in; it is resident
+        virtual void ObjectReferenced(ManagedObject* pObject)
+        {
+            UNREFERENCED_PARAMETER(pObject);
+        }
+
+        // The object was evicted, either to get back under budget or because it aged out
+        virtual void ObjectEvicted(ManagedObject* pObject, bool OverBudget)
+        {
+            UNREFERENCED_PARAMETER(pObject);
+            UNREFERENCED_PARAMETER(OverBudget);
+        }
+
+        // When over budget, the objects the GPU is done with are evicted in increasing order of priority,
+        // least recently used first among equals, until the budget is met
+        virtual double EvictionPriority(const ManagedObject* pObject) = 0;
+
+        // Called for an object the GPU is done with that hasn't been used for longer than the grace period,
+        // which shrinks with memory pressure. Returning true keeps it resident for now; it is offered again
+        // on the next trim.
+        virtual bool RetainAged(const ManagedObject* pObject, UINT64 Age, UINT64 GracePeriod)
+        {
+            UNREFERENCED_PARAMETER(pObject);
+            UNREFERENCED_PARAMETER(Age);
+            UNREFERENCED_PARAMETER(GracePeriod);
+            return false;
+        }
+    };
+
+    // GreedyDual-Size-Frequency. Each use credits an object with its re-page cost per byte times the number
+    // of times it has been used, on top of an inflation value that rises to the credit of every object
+    // evicted over budget. Objects that are cheap to page back in for the memory they
+    // free, and that are used rarely, go first, while old credit is aged out by inflation. A large render
+    // target used every other frame is kept over textures that were used once. Objects whose credit is still
+    // above the inflation value also outlive the grace period in proportion to how often they have been used.
+    class GreedyDualSizeEvictionPolicy : public EvictionPolicy
+    {
+    public:
+        // MakeResidentOverhead is the fixed cost of paging an object in, as the number of bytes that could be
+        // paged in the same time. Larger values protect small objects more. MaxAgedGracePeriods bounds how
+        // many grace periods a frequently used object is kept for after its last use; 1 ages objects out as LRU does.
+        GreedyDualSizeEvictionPolicy(UINT64 MakeResidentOverhead = 64 * 1024, UINT32 MaxAgedGracePeriods = 4) :
+            Inflation(0.0),
+            Overhead(double(MakeResidentOverhead)),
+            MaxGracePeriods(RESIDENCY_MAX(MaxAgedGracePeriods, 1u))
+        {
+        }
+
+        void ObjectReferenced(ManagedObject* pObject)
+        {
+            if (pObject->NumReferences < MAXUINT32)
+            {
+                pObject->NumReferences++;
+            }
+
+            double Size = double(RESIDENCY_MAX(pObject->Size, 1ull));
+            pObject->EvictionCredit = Inflation + pObject->NumReferences * (Size + Overhead) / Size;
+        }
+
+        void ObjectEvicted(ManagedObject* pObject, bool OverBudget)
+        {
+            // An object evicted to get under budget keeps its count, so one that pressure keeps paging out
+            // builds up credit; one that aged out starts over.
+            if (OverBudget)
+            {
+                Inflation = RESIDENCY_MAX(Inflation, pObject->EvictionCredit);
+            }
+            else
+            {
+                pObject->NumReferences = 0;
+            }
+        }
+
+        double EvictionPriority(const ManagedObject* pObject)
+        {
+            return pObject->EvictionCredit;
+        }
+
+        // Credit at or below the inflation value is worth no more than what has already been evicted under
+        // pressure, so those objects age out on time
+        bool RetainAged(const ManagedObject* pObject, UINT64 Age, UINT64 GracePeriod)
+        {
+            if (pObject->EvictionCredit <= Inflation)
+            {
+                return false;
+            }
+
+            UINT64 GracePeriods = RESIDENCY_MIN(pObject->NumReferences, MaxGracePeriods);
+            return Age <= GracePeriod * GracePeriods;
+        }
+
+    private:
+        double Inflation;
+        const double Overhead;
+        const UINT32 MaxGracePeriods;
+    };
+
     // This represents a set of objects which are referenced by a command list i.e. every time a resource
     // is bound for rendering, clearing, copy etc. the set must be updated to ensure the it is resident 
     // for execution.
@@ -160,10 +283,8 @@ namespace D3DX12Residency
         friend class Internal::ResidencyManagerInternal;
     public:
 
-        static const UINT32 InvalidIndex = (UINT32)-1;
-
         ResidencySet() :
-            CommandListIndex(InvalidIndex),
+            Epoch(0),
             MaxResidencySetSize(0),
             CurrentSetSize(0),
             ppSet(nullptr),
@@ -182,12 +303,13 @@ namespace D3DX12Residency
         inline bool Insert(ManagedObject* pObject)
         {
             RESIDENCY_CHECK(IsOpen);
-            RESIDENCY_CHECK(CommandListIndex != InvalidIndex);
 
-            // If we haven't seen this object on this command list mark it
-            if (pObject->CommandListsUsedOn[CommandListIndex] == false)
+            // If we haven't seen this object in this set mark it. Another open set sharing the same way may
+            // mark it in between, which at worst inserts it again; the master set built at execution removes duplicates.
+            UINT64& ObjectEpoch = pObject->SetEpochs[Epoch % RESIDENCY_SET_EPOCH_WAYS];
+            if (ObjectEpoch != Epoch)
             {
-                pObject->CommandListsUsedOn[CommandListIndex] = true;
+                ObjectEpoch = Epoch;
                 if (ppSet == nullptr || CurrentSetSize >= MaxResidencySetSize)
                 {
                     Realloc();
@@ -210,36 +332,13 @@ namespace D3DX12Residency
 
         HRESULT Open()
         {
-            Internal::ScopedLock Lock(&pSyncManager->MaskCriticalSection);
-
             // It's invalid to open a set that is already open
             if (IsOpen)
             {
                 return E_INVALIDARG;
             }
 
-            RESIDENCY_CHECK(CommandListIndex == InvalidIndex);
-
-            bool CommandlistAvailable = false;
-            // Find the first available command list by bitscanning
-            for (UINT32 i = 0; i < ARRAYSIZE(pSyncManager->AvailableCommandLists); i++)
-            {
-                if (pSyncManager->AvailableCommandLists[i] == false)
-                {
-                    CommandListIndex = i;
-                    pSyncManager->AvailableCommandLists[i] = true;
-                    CommandlistAvailable = true;
-                    break;
-                }
-            }
-
-            if (CommandlistAvailable == false)
-            {
-                // There are too many open residency sets, consider using less or increasing the value of MAX_NUM_CONCURRENT_CMD_LISTS
-                RESIDENCY_CHECK(false);
-                return E_OUTOFMEMORY;
-            }
-
+            Epoch = pSyncManager->NextSetEpoch();
             CurrentSetSize = 0;
 
             IsOpen = true;
@@ -259,13 +358,6 @@ namespace D3DX12Residency
                 return E_OUTOFMEMORY;
             }
 
-            for (INT32 i = 0; i < CurrentSetSize; i++)
-            {
-                Remove(ppSet[i]);
-            }
-
-            ReturnCommandListReservation();
-
             IsOpen = false;
 
             return S_OK;
@@ -273,35 +365,43 @@ namespace D3DX12Residency
 
     private:
 
-        inline void Remove(ManagedObject* pObject)
+        void Initialize(Internal::SyncManager* pSyncManagerIn)
         {
-            pObject->CommandListsUsedOn[CommandListIndex] = false;
+            pSyncManager = pSyncManagerIn;
         }
 
-        inline void ReturnCommandListReservation()
+        // Empties the set and makes room for at least Size objects. The allocation is kept if it's big enough,
+        // so a recycled master set stops allocating once it has grown to the largest submission.
+        bool Reserve(INT32 Size)
         {
-            Internal::ScopedLock Lock(&pSyncManager->MaskCriticalSection);
-
-            pSyncManager->AvailableCommandLists[CommandListIndex] = false;
-
-            CommandListIndex = ResidencySet::InvalidIndex;
-
-            IsOpen = false;
-        }
+            CurrentSetSize = 0;
+            if (ppSet == nullptr || MaxResidencySetSize < Size)
+            {
+                delete[](ppSet);
+                MaxResidencySetSize = RESIDENCY_MAX(Size, MaxResidencySetSize + MaxResidencySetSize / 2);
+                ppSet = new ManagedObject*[MaxResidencySetSize];
+            }
 
-        void Initialize(Internal::SyncManager* pSyncManagerIn)
-        {
-            pSyncManager = pSyncManagerIn;
+            return ppSet != nullptr;
         }
 
-        bool Initialize(Internal::SyncManager* pSyncManagerIn, UINT32 MaxSize)
+        // Adds the objects of pSet that aren't in this master set yet and returns their total size.
+        // Only one master set can be merged into at a time, as they all share MasterSetEpoch.
+        UINT64 Merge(const ResidencySet* pSet)
         {
-            pSyncManager = pSyncManagerIn;
-            MaxResidencySetSize = MaxSize;
-
-            ppSet = new ManagedObject*[MaxResidencySetSize];
+            UINT64 SizeAdded = 0;
+            for (INT32 i = 0; i < pSet->CurrentSetSize; i++)
+            {
+                ManagedObject* pObject = pSet->ppSet[i];
+                if (pObject->MasterSetEpoch != Epoch)
+                {
+                    pObject->MasterSetEpoch = Epoch;
+                    ppSet[CurrentSetSize++] = pObject;
+                    SizeAdded += pObject->Size;
+                }
+            }
 
-            return ppSet != nullptr;
+            return SizeAdded;
         }
 
         inline void Realloc()
@@ -318,7 +418,7 @@ namespace D3DX12Residency
             ppSet = ppNewAlloc;
         }
 
-        UINT32 CommandListIndex;
+        UINT64 Epoch;
 
         ManagedObject** ppSet;
         INT32 MaxResidencySetSize;
@@ -328,6 +428,9 @@ namespace D3DX12Residency
         bool OutOfMemory;
 
         Internal::SyncManager* pSyncManager;
+
+        // Links recycled master sets
+        LIST_ENTRY PoolEntry;
     };
 
     namespace Internal
@@ -381,9 +484,23 @@ namespace D3DX12Residency
             return pEntry->Flink == pEntry;
         }
 
+        // Scratch lists only grow, so paging work stops allocating once they fit the largest workload
+        template <typename T>
+        inline T* ReserveScratch(T*& pScratch, UINT32& ScratchSize, UINT32 Size)
+        {
+            if (pScratch == nullptr || ScratchSize < Size)
+            {
+                delete[](pScratch);
+                ScratchSize = RESIDENCY_MAX(Size, ScratchSize + ScratchSize / 2);
+                pScratch = new T[ScratchSize];
+            }
+
+            return pScratch;
+        }
+
         struct Fence
         {
-            Fence(UINT64 StartingValue) : pFence(nullptr), FenceValue(StartingValue)
+            Fence(UINT64 StartingValue) : pFence(nullptr), FenceValue(StartingValue), QueueIndex(0), TracedCompletedValue(0)
             {
                 Internal::InitializeListHead(&ListEntry);
             };
@@ -427,6 +544,10 @@ namespace D3DX12Residency
             ID3D12Fence* pFence;
             UINT64 FenceValue;
             LIST_ENTRY ListEntry;
+
+            // The order in which the manager first saw the queue, which identifies it in a residency trace
+            UINT32 QueueIndex;
+            UINT64 TracedCompletedValue;
         };
 
         // Represents a time on a particular queue that a resource was used
@@ -449,7 +570,7 @@ namespace D3DX12Residency
         struct DeviceWideSyncPoint
         {
             DeviceWideSyncPoint(UINT32 NumQueues, UINT64 Generation) :
-                GenerationID(Generation), NumQueueSyncPoints(NumQueues) {};
+                GenerationID(Generation), NumQueueSyncPoints(NumQueues), MaxQueueSyncPoints(NumQueues) {};
 
             // Create the whole structure in one allocation for locality
             static DeviceWideSyncPoint* CreateSyncPoint(UINT32 NumQueues, UINT64 Generation)
@@ -466,6 +587,24 @@ namespace D3DX12Residency
                 return pSyncPoint;
             }
 
+            static void DestroySyncPoint(DeviceWideSyncPoint* pSyncPoint)
+            {
+                delete[](reinterpret_cast<BYTE*>(pSyncPoint));
+            }
+
+            // Reuses a completed sync point for a new generation, if it has room for every queue
+            bool Recycle(UINT32 NumQueues, UINT64 Generation)
+            {
+                if (NumQueues > MaxQueueSyncPoints)
+                {
+                    return false;
+                }
+
+                GenerationID = Generation;
+                NumQueueSyncPoints = NumQueues;
+                return true;
+            }
+
             // A device wide fence is completed if all of the queues that were active at that point are completed
             inline bool IsCompleted()
             {
@@ -490,27 +629,79 @@ namespace D3DX12Residency
                 }
             }
 
-            const UINT64 GenerationID;
-            const UINT32 NumQueueSyncPoints;
+            UINT64 GenerationID;
+            UINT32 NumQueueSyncPoints;
+            UINT32 MaxQueueSyncPoints;
             LIST_ENTRY ListEntry;
             // NumQueueSyncPoints QueueSyncPoints will be placed below here
             QueueSyncPoint pQueueSyncPoints[1];
         };
 
+        // A resident object the GPU is done with, while trimming to the budget through an EvictionPolicy
+        struct EvictionCandidate
+        {
+            double Priority;
+            UINT32 LRUOrder;
+            ManagedObject* pObject;
+
+            inline bool EvictBefore(const EvictionCandidate& Other) const
+            {
+                return Priority < Other.Priority || (Priority == Other.Priority && LRUOrder < Other.LRUOrder);
+            }
+        };
+
+        // Restores the min-heap below Index, the candidate to evict first being at the top
+        inline void SiftDownCandidate(EvictionCandidate* pHeap, UINT32 Count, UINT32 Index)
+        {
+            while (true)
+            {
+                UINT32 First = Index;
+                UINT32 Left = 2 * Index + 1;
+                UINT32 Right = Left + 1;
+
+                if (Left < Count && pHeap[Left].EvictBefore(pHeap[First]))
+                {
+                    First = Left;
+                }
+                if (Right < Count && pHeap[Right].EvictBefore(pHeap[First]))
+                {
+                    First = Right;
+                }
+                if (First == Index)
+                {
+                    return;
+                }
+
+                EvictionCandidate Temp = pHeap[Index];
+                pHeap[Index] = pHeap[First];
+                pHeap[First] = Temp;
+                Index = First;
+            }
+        }
+
         // A Least Recently Used Cache. Tracks all of the objects requested by the app so that objects
-        // that aren't used freqently can get evicted to help the app stay under buget.
+        // that aren't used freqently can get evicted to help the app stay under buget. An EvictionPolicy
+        // can reorder which of the stale objects are evicted first.
         class LRUCache
         {
         public:
             LRUCache() :
                 NumResidentObjects(0),
                 NumEvictedObjects(0),
-                ResidentSize(0)
+                ResidentSize(0),
+                pPolicy(nullptr),
+                pCandidates(nullptr),
+                CandidatesSize(0)
             {
                 Internal::InitializeListHead(&ResidentObjectListHead);
                 Internal::InitializeListHead(&EvictedObjectListHead);
             };
 
+            ~LRUCache()
+            {
+                delete[](pCandidates);
+            }
+
             void Insert(ManagedObject* pObject)
             {
                 if (pObject->ResidencyStatus == ManagedObject::RESIDENCY_STATUS::RESIDENT)
@@ -549,6 +740,11 @@ namespace D3DX12Residency
 
                 Internal::RemoveEntryList(&pObject->ListEntry);
                 Internal::InsertTailList(&ResidentObjectListHead, &pObject->ListEntry);
+
+                if (pPolicy)
+                {
+                    pPolicy->ObjectReferenced(pObject);
+                }
             }
 
             void MakeResident(ManagedObject* pObject)
@@ -564,7 +760,7 @@ namespace D3DX12Residency
                 ResidentSize += pObject->Size;
             }
 
-            void Evict(ManagedObject* pObject)
+            void Evict(ManagedObject* pObject, bool OverBudget)
             {
                 RESIDENCY_CHECK(pObject->ResidencyStatus == ManagedObject::RESIDENCY_STATUS::RESIDENT);
 
@@ -575,13 +771,25 @@ namespace D3DX12Residency
                 NumResidentObjects--;
                 ResidentSize -= pObject->Size;
                 NumEvictedObjects++;
+
+                if (pPolicy)
+                {
+                    pPolicy->ObjectEvicted(pObject, OverBudget);
+                }
             }
 
-            // Evict all of the resident objects used in sync points up to the specficied one (inclusive)
+            // Evict resident objects used in sync points up to the specficied one (inclusive) until usage is under budget
             void TrimToSyncPointInclusive(INT64 CurrentUsage, INT64 CurrentBudget, ID3D12Pageable** EvictionList, UINT32& NumObjectsToEvict, UINT64 SyncPoint)
             {
                 NumObjectsToEvict = 0;
 
+                if (pPolicy && CurrentUsage >= CurrentBudget &&
+                    ReserveScratch(pCandidates, CandidatesSize, NumResidentObjects) != nullptr)
+                {
+                    TrimToSyncPointByPriority(CurrentUsage, CurrentBudget, EvictionList, NumObjectsToEvict, SyncPoint);
+                    return;
+                }
+
                 LIST_ENTRY* pResourceEntry = ResidentObjectListHead.Flink;
                 while (pResourceEntry != &ResidentObjectListHead)
                 {
@@ -595,7 +803,7 @@ namespace D3DX12Residency
                     RESIDENCY_CHECK(pObject->ResidencyStatus == ManagedObject::RESIDENCY_STATUS::RESIDENT);
 
                     EvictionList[NumObjectsToEvict++] = pObject->pUnderlying;
-                    Evict(pObject);
+                    Evict(pObject, true);
 
                     CurrentUsage -= pObject->Size;
 
@@ -603,6 +811,47 @@ namespace D3DX12Residency
                 }
             }
 
+            // The objects the GPU is done with lead the resident list. Heap them by the policy's priority
+            // and evict from the top, so only the objects that are evicted pay for ordering.
+            void TrimToSyncPointByPriority(INT64 CurrentUsage, INT64 CurrentBudget, ID3D12Pageable** EvictionList, UINT32& NumObjectsToEvict, UINT64 SyncPoint)
+            {
+                UINT32 NumCandidates = 0;
+
+                LIST_ENTRY* pResourceEntry = ResidentObjectListHead.Flink;
+                while (pResourceEntry != &ResidentObjectListHead)
+                {
+                    ManagedObject* pObject = CONTAINING_RECORD(pResourceEntry, ManagedObject, ListEntry);
+                    if (pObject->LastGPUSyncPoint > SyncPoint)
+                    {
+                        break;
+                    }
+
+                    pCandidates[NumCandidates].Priority = pPolicy->EvictionPriority(pObject);
+                    pCandidates[NumCandidates].LRUOrder = NumCandidates;
+                    pCandidates[NumCandidates].pObject = pObject;
+                    NumCandidates++;
+
+                    pResourceEntry = pResourceEntry->Flink;
+                }
+
+                for (UINT32 i = NumCandidates / 2; i > 0; i--)
+                {
+                    SiftDownCandidate(pCandidates, NumCandidates, i - 1);
+                }
+
+                while (NumCandidates > 0 && CurrentUsage >= CurrentBudget)
+                {
+                    ManagedObject* pObject = pCandidates[0].pObject;
+                    pCandidates[0] = pCandidates[--NumCandidates];
+                    SiftDownCandidate(pCandidates, NumCandidates, 0);
+
+                    EvictionList[NumObjectsToEvict++] = pObject->pUnderlying;
+                    Evict(pObject, true);
+
+                    CurrentUsage -= pObject->Size;
+                }
+            }
+
             // Trim all objects which are older than the specified time
             void TrimAgedAllocations(DeviceWideSyncPoint* MaxSyncPoint, ID3D12Pageable** EvictionList, UINT32& NumObjectsToEvict, UINT64 CurrentTimeStamp, UINT64 MinDelta)
             {
@@ -610,18 +859,25 @@ namespace D3DX12Residency
                 while (pResourceEntry != &ResidentObjectListHead)
                 {
                     ManagedObject* pObject = CONTAINING_RECORD(pResourceEntry, ManagedObject, ListEntry);
+                    UINT64 Age = CurrentTimeStamp - pObject->LastUsedTimestamp;
 
                     if ((MaxSyncPoint && pObject->LastGPUSyncPoint >= MaxSyncPoint->GenerationID) || // Only trim allocations done on the GPU
-                        CurrentTimeStamp - pObject->LastUsedTimestamp <= MinDelta) // Don't evict things which have been used recently
+                        Age <= MinDelta) // Don't evict things which have been used recently
                     {
                         break;
                     }
 
+                    pResourceEntry = pResourceEntry->Flink;
+
+                    // Objects the policy keeps stay at the head of the list and are offered again next time
+                    if (pPolicy && pPolicy->RetainAged(pObject, Age, MinDelta))
+                    {
+                        continue;
+                    }
+
                     RESIDENCY_CHECK(pObject->ResidencyStatus == ManagedObject::RESIDENCY_STATUS::RESIDENT);
                     EvictionList[NumObjectsToEvict++] = pObject->pUnderlying;
-                    Evict(pObject);
-
-                    pResourceEntry = ResidentObjectListHead.Flink;
+                    Evict(pObject, false);
                 }
             }
 
@@ -641,6 +897,181 @@ namespace D3DX12Residency
             UINT32 NumEvictedObjects;
 
             UINT64 ResidentSize;
+
+            // Owned by the app; nullptr evicts in LRU order
+            EvictionPolicy* pPolicy;
+
+        private:
+            EvictionCandidate* pCandidates;
+            UINT32 CandidatesSize;
+        };
+
+        // A residency trace records what the manager is asked to do and what it sees of the GPU and of the budget, so
+        // its paging can be replayed offline against a mock device. It starts with TRACE_MAGIC, the version and the
+        // QPC frequency. Each record is a TRACE_RECORD byte followed by unsigned LEB128 integers; timestamps are QPC
+        // ticks since the previous timestamp.
+        enum TRACE_RECORD
+        {
+            TRACE_RECORD_TRACK_OBJECT = 1,      // ObjectID, Size, Evicted
+            TRACE_RECORD_UNTRACK_OBJECT = 2,    // ObjectID
+            TRACE_RECORD_EXECUTE = 3,           // Timestamp, QueueIndex, NumSets, then per set NumObjects and their ObjectIDs
+            TRACE_RECORD_SYNC_POINT = 4,        // Timestamp, QueueIndex
+            TRACE_RECORD_BUDGET = 5,            // Segment, Budget, CurrentUsage, ResidentSize of the tracked objects
+            TRACE_RECORD_FENCE_COMPLETED = 6,   // QueueIndex, CompletedValue
+            TRACE_RECORD_FRAME = 7,             // Timestamp
+        };
+
+        class TraceWriter
+        {
+        public:
+            static const UINT32 TRACE_MAGIC = 0x43525852; // "RXRC"
+            static const UINT32 TRACE_VERSION = 1;
+
+            TraceWriter() :
+                File(INVALID_HANDLE_VALUE),
+                pBuffer(nullptr),
+                BufferSize(0),
+                LastTimestamp(0),
+                NextObjectID(1)
+            {
+            }
+
+            ~TraceWriter()
+            {
+                Close();
+            }
+
+            HRESULT Open(const wchar_t* FileName)
+            {
+                pBuffer = new BYTE[cBufferCapacity];
+                if (pBuffer == nullptr)
+                {
+                    return E_OUTOFMEMORY;
+                }
+
+                File = CreateFileW(FileName, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+                if (File == INVALID_HANDLE_VALUE)
+                {
+                    delete[](pBuffer);
+                    pBuffer = nullptr;
+                    return HRESULT_FROM_WIN32(GetLastError());
+                }
+
+                LARGE_INTEGER Frequency;
+                LARGE_INTEGER Now;
+                QueryPerformanceFrequency(&Frequency);
+                QueryPerformanceCounter(&Now);
+
+                BufferSize = 0;
+                LastTimestamp = UINT64(Now.QuadPart);
+                NextObjectID = 1;
+                for (UINT32 i = 0; i < 2; i++)
+                {
+                    TracedBudget[i] = MAXUINT64;
+                    TracedExternalUsage[i] = MAXUINT64;
+                }
+
+                for (UINT32 i = 0; i < 4; i++)
+                {
+                    WriteByte(BYTE(TRACE_MAGIC >> (i * 8)));
+                }
+                WriteUInt(TRACE_VERSION);
+                WriteUInt(UINT64(Frequency.QuadPart));
+
+                return S_OK;
+            }
+
+            void Close()
+            {
+                if (pBuffer)
+                {
+                    Flush();
+                    CloseHandle(File);
+                    File = INVALID_HANDLE_VALUE;
+
+                    delete[](pBuffer);
+                    pBuffer = nullptr;
+                }
+            }
+
+            inline bool IsOpen() const { return pBuffer != nullptr; }
+
+            inline void WriteByte(BYTE Value)
+            {
+                if (BufferSize == cBufferCapacity)
+                {
+                    Flush();
+                }
+                pBuffer[BufferSize++] = Value;
+            }
+
+            inline void WriteUInt(UINT64 Value)
+            {
+                while (Value >= 0x80)
+                {
+                    WriteByte(BYTE(Value | 0x80));
+                    Value >>= 7;
+                }
+                WriteByte(BYTE(Value));
+            }
+
+            void WriteTimestamp()
+            {
+                LARGE_INTEGER Now;
+                QueryPerformanceCounter(&Now);
+
+                UINT64 Timestamp = RESIDENCY_MAX(UINT64(Now.QuadPart), LastTimestamp);
+                WriteUInt(Timestamp - LastTimestamp);
+                LastTimestamp = Timestamp;
+            }
+
+            inline UINT32 AssignObjectID(ManagedObject* pObject)
+            {
+                pObject->TraceID = NextObjectID++;
+                return pObject->TraceID;
+            }
+
+            // A budget is only recorded when it, or the usage that isn't the manager's objects, changes
+            bool BudgetChanged(DXGI_MEMORY_SEGMENT_GROUP Segment, UINT64 Budget, UINT64 ExternalUsage)
+            {
+                UINT32 i = (Segment == DXGI_MEMORY_SEGMENT_GROUP_LOCAL) ? 0 : 1;
+                if (TracedBudget[i] == Budget && TracedExternalUsage[i] == ExternalUsage)
+                {
+                    return false;
+                }
+
+                TracedBudget[i] = Budget;
+                TracedExternalUsage[i] = ExternalUsage;
+                return true;
+            }
+
+            // Held while writing a record
+            CriticalSection CS;
+
+        private:
+            // A failed write drops the rest of the trace; the app keeps running
+            void Flush()
+            {
+                DWORD Written = 0;
+                if (File != INVALID_HANDLE_VALUE && BufferSize > 0 &&
+                    (WriteFile(File, pBuffer, BufferSize, &Written, nullptr) == false || Written != BufferSize))
+                {
+                    CloseHandle(File);
+                    File = INVALID_HANDLE_VALUE;
+                }
+                BufferSize = 0;
+            }
+
+            static const UINT32 cBufferCapacity = 64 * 1024;
+
+            HANDLE File;
+            BYTE* pBuffer;
+            UINT32 BufferSize;
+            UINT64 LastTimestamp;
+            UINT32 NextObjectID;
+
+            UINT64 TracedBudget[2];
+            UINT64 TracedExternalUsage[2];
         };
 
         class ResidencyManagerInternal
@@ -667,10 +1098,17 @@ namespace D3DX12Residency
                 AsyncWorkQueue(nullptr),
                 MaxSoftwareQueueLatency(6),
                 AsyncWorkQueueSize(7),
-                pSyncManager(pSyncManagerIn)
+                pSyncManager(pSyncManagerIn),
+                pMakeResidentScratch(nullptr),
+                MakeResidentScratchSize(0),
+                pEvictionScratch(nullptr),
+                EvictionScratchSize(0),
+                Tracing(false)
             {
                 Internal::InitializeListHead(&QueueFencesListHead);
                 Internal::InitializeListHead(&InFlightSyncPointsHead);
+                Internal::InitializeListHead(&FreeSyncPointsHead);
+                Internal::InitializeListHead(&MasterSetPoolHead);
 
                 ResidencyManagerUniqueID = InterlockedIncrement64(&g_ResidencyManagerUniqueID);
             };
@@ -745,6 +1183,8 @@ namespace D3DX12Residency
 
             void Destroy()
             {
+                StopTrace();
+
                 AsyncThreadFence.Destroy();
 
                 if (CompletionEvent != INVALID_HANDLE_VALUE)
@@ -798,6 +1238,25 @@ namespace D3DX12Residency
                     Internal::RemoveHeadList(&QueueFencesListHead);
                     delete(pObject);
                 }
+
+                while (Internal::IsListEmpty(&FreeSyncPointsHead) == false)
+                {
+                    Internal::DeviceWideSyncPoint::DestroySyncPoint(
+                        CONTAINING_RECORD(Internal::RemoveHeadList(&FreeSyncPointsHead), Internal::DeviceWideSyncPoint, ListEntry));
+                }
+
+                while (Internal::IsListEmpty(&MasterSetPoolHead) == false)
+                {
+                    delete(CONTAINING_RECORD(Internal::RemoveHeadList(&MasterSetPoolHead), ResidencySet, PoolEntry));
+                }
+
+                delete[](pMakeResidentScratch);
+                pMakeResidentScratch = nullptr;
+                MakeResidentScratchSize = 0;
+
+                delete[](pEvictionScratch);
+                pEvictionScratch = nullptr;
+                EvictionScratchSize = 0;
             }
 
             void BeginTrackingObject(ManagedObject* pObject)
@@ -814,6 +1273,12 @@ namespace D3DX12Residency
                     }
 
                     LRU.Insert(pObject);
+
+                    if (Tracing)
+                    {
+                        Internal::ScopedLock TraceLock(&Trace.CS);
+                        TraceTrackObject(pObject);
+                    }
                 }
             }
 
@@ -822,14 +1287,96 @@ namespace D3DX12Residency
                 Internal::ScopedLock Lock(&Mutex);
 
                 LRU.Remove(pObject);
+
+                if (Tracing)
+                {
+                    Internal::ScopedLock TraceLock(&Trace.CS);
+                    if (Trace.IsOpen() && pObject->TraceID != 0)
+                    {
+                        Trace.WriteByte(TRACE_RECORD_UNTRACK_OBJECT);
+                        Trace.WriteUInt(pObject->TraceID);
+                    }
+                }
+            }
+
+            void SetEvictionPolicy(EvictionPolicy* pPolicy)
+            {
+                Internal::ScopedLock Lock(&Mutex);
+
+                LRU.pPolicy = pPolicy;
             }
 
             // One residency set per command-list
             HRESULT ExecuteCommandLists(ID3D12CommandQueue* Queue, ID3D12CommandList** CommandLists, ResidencySet** ResidencySets, UINT32 Count)
             {
+                for (UINT32 i = 0; i < Count; i++)
+                {
+                    if (ResidencySets[i] && ResidencySets[i]->IsOpen)
+                    {
+                        // Residency Sets must be closed before execution just like Command Lists
+                        return E_INVALIDARG;
+                    }
+                }
+
+                // Only calls that get past validation are recorded, so the replay doesn't execute rejected sets
+                if (Tracing)
+                {
+                    TraceExecute(Queue, ResidencySets, Count);
+                }
+
                 return ExecuteSubset(Queue, CommandLists, ResidencySets, Count);
             }
 
+            // Objects tracked so far are recorded first. The replay's fences count from the start, so a trace can only
+            // be started before the first call that takes a queue.
+            HRESULT StartTrace(const wchar_t* FileName)
+            {
+                Internal::ScopedLock Lock(&Mutex);
+                Internal::ScopedLock TraceLock(&Trace.CS);
+
+                if (Trace.IsOpen() || NumQueuesSeen > 0)
+                {
+                    return E_ILLEGAL_METHOD_CALL;
+                }
+
+                HRESULT hr = Trace.Open(FileName);
+                if (SUCCEEDED(hr))
+                {
+                    LIST_ENTRY* pLists[] = { &LRU.ResidentObjectListHead, &LRU.EvictedObjectListHead };
+                    for (UINT32 i = 0; i < 2; i++)
+                    {
+                        for (LIST_ENTRY* pEntry = pLists[i]->Flink; pEntry != pLists[i]; pEntry = pEntry->Flink)
+                        {
+                            TraceTrackObject(CONTAINING_RECORD(pEntry, ManagedObject, ListEntry));
+                        }
+                    }
+
+                    Tracing = true;
+                }
+                return hr;
+            }
+
+            void StopTrace()
+            {
+                Internal::ScopedLock TraceLock(&Trace.CS);
+
+                Tracing = false;
+                Trace.Close();
+            }
+
+            void TraceFrameBoundary()
+            {
+                if (Tracing)
+                {
+                    Internal::ScopedLock TraceLock(&Trace.CS);
+                    if (Trace.IsOpen())
+                    {
+                        Trace.WriteByte(TRACE_RECORD_FRAME);
+                        Trace.WriteTimestamp();
+                    }
+                }
+            }
+
             HRESULT GetCurrentGPUSyncPoint(ID3D12CommandQueue* Queue, UINT64 *pGPUSyncPoint)
             {
                 Internal::Fence* QueueFence = nullptr;
@@ -841,11 +1388,95 @@ namespace D3DX12Residency
                     Internal::ScopedLock Lock(&ExecutionCS);
                     *pGPUSyncPoint = QueueFence->FenceValue;
                     hr = SignalFence(Queue, QueueFence);
+
+                    if (Tracing)
+                    {
+                        Internal::ScopedLock TraceLock(&Trace.CS);
+                        if (Trace.IsOpen())
+                        {
+                            Trace.WriteByte(TRACE_RECORD_SYNC_POINT);
+                            Trace.WriteTimestamp();
+                            Trace.WriteUInt(QueueFence->QueueIndex);
+                        }
+                    }
                 }
                 return hr;
             }
 
         private:
+            // Must be called with Trace.CS held
+            void TraceTrackObject(ManagedObject* pObject)
+            {
+                if (Trace.IsOpen())
+                {
+                    Trace.WriteByte(TRACE_RECORD_TRACK_OBJECT);
+                    Trace.WriteUInt(Trace.AssignObjectID(pObject));
+                    Trace.WriteUInt(pObject->Size);
+                    Trace.WriteUInt(pObject->ResidencyStatus == ManagedObject::RESIDENCY_STATUS::EVICTED ? 1 : 0);
+                }
+            }
+
+            // The sets are recorded as they are executed rather than insert by insert, which keeps the app's
+            // recording threads off the trace lock and gives the replay the same master sets
+            void TraceExecute(ID3D12CommandQueue* Queue, ResidencySet** ResidencySets, UINT32 Count)
+            {
+                Internal::Fence* QueueFence = nullptr;
+                if (FAILED(GetFence(Queue, QueueFence)))
+                {
+                    return;
+                }
+
+                Internal::ScopedLock TraceLock(&Trace.CS);
+                if (Trace.IsOpen())
+                {
+                    Trace.WriteByte(TRACE_RECORD_EXECUTE);
+                    Trace.WriteTimestamp();
+                    Trace.WriteUInt(QueueFence->QueueIndex);
+                    Trace.WriteUInt(Count);
+                    for (UINT32 i = 0; i < Count; i++)
+                    {
+                        ResidencySet* pSet = ResidencySets[i];
+                        Trace.WriteUInt(pSet ? pSet->CurrentSetSize : 0);
+                        for (INT32 j = 0; pSet && j < pSet->CurrentSetSize; j++)
+                        {
+                            Trace.WriteUInt(pSet->ppSet[j]->TraceID);
+                        }
+                    }
+                }
+            }
+
+            // Records how far each queue's fence has got, as seen by the paging work
+            void TraceFenceProgress()
+            {
+                // GetFence adds queues from the app's threads
+                Internal::ScopedLock Lock(&AsyncWorkMutex);
+                Internal::ScopedLock TraceLock(&Trace.CS);
+                if (Trace.IsOpen() == false)
+                {
+                    return;
+                }
+
+                for (LIST_ENTRY* pEntry = QueueFencesListHead.Flink; pEntry != &QueueFencesListHead; pEntry = pEntry->Flink)
+                {
+                    Internal::Fence* pFence = CONTAINING_RECORD(pEntry, Internal::Fence, ListEntry);
+
+                    // A fence that failed to initialize stays in the list without an underlying fence
+                    if (pFence->pFence == nullptr)
+                    {
+                        continue;
+                    }
+
+                    UINT64 CompletedValue = pFence->pFence->GetCompletedValue();
+                    if (CompletedValue != pFence->TracedCompletedValue)
+                    {
+                        pFence->TracedCompletedValue = CompletedValue;
+                        Trace.WriteByte(TRACE_RECORD_FENCE_COMPLETED);
+                        Trace.WriteUInt(pFence->QueueIndex);
+                        Trace.WriteUInt(CompletedValue);
+                    }
+                }
+            }
+
             HRESULT GetFence(ID3D12CommandQueue *Queue, Internal::Fence *&QueueFence)
             {
                 // We have to track each object on each queue so we know when it is safe to evict them. Therefore, for every queue that we
@@ -872,9 +1503,13 @@ namespace D3DX12Residency
                     {
                         QueueFence = new Internal::Fence(1);
                         hr = QueueFence->Initialize(Device);
-                        Internal::InsertTailList(&QueueFencesListHead, &QueueFence->ListEntry);
 
-                        InterlockedIncrement(&NumQueuesSeen);
+                        {
+                            Internal::ScopedLock Lock(&AsyncWorkMutex);
+                            Internal::InsertTailList(&QueueFencesListHead, &QueueFence->ListEntry);
+
+                            QueueFence->QueueIndex = InterlockedIncrement(&NumQueuesSeen) - 1;
+                        }
 
                         if (SUCCEEDED(hr))
                         {
@@ -925,55 +1560,42 @@ namespace D3DX12Residency
                 {
                     if (ResidencySets[i])
                     {
-                        if (ResidencySets[i]->IsOpen)
-                        {
-                            // Residency Sets must be closed before execution just like Command Lists
-                            return E_INVALIDARG;
-                        }
                         MaxObjectsReferenced += ResidencySets[i]->CurrentSetSize;
                     }
                 }
 
-                // Create a set to gather up all unique resources required by this call
-                ResidencySet* pMasterSet = new ResidencySet();
-                if (pMasterSet == nullptr || pMasterSet->Initialize(pSyncManager, MaxObjectsReferenced) == false)
+                // Gather up all unique resources required by this call into a recycled master set
+                ResidencySet* pMasterSet = nullptr;
                 {
-                    return E_OUTOFMEMORY;
-                }
+                    Internal::ScopedLock Lock(&MasterSetCS);
 
-                hr = pMasterSet->Open();
-                if (FAILED(hr))
-                {
-                    return hr;
-                }
+                    pMasterSet = AcquireMasterSet();
+                    if (pMasterSet == nullptr)
+                    {
+                        return E_OUTOFMEMORY;
+                    }
 
-                // For each residency set
-                for (UINT32 i = 0; i < Count; i++)
-                {
-                    if (ResidencySets[i])
+                    if (pMasterSet->Reserve(MaxObjectsReferenced) == false)
+                    {
+                        Internal::InsertHeadList(&MasterSetPoolHead, &pMasterSet->PoolEntry);
+                        return E_OUTOFMEMORY;
+                    }
+
+                    pMasterSet->Epoch = pSyncManager->NextSetEpoch();
+                    for (UINT32 i = 0; i < Count; i++)
                     {
-                        // For each object in this set
-                        for (INT32 x = 0; x < ResidencySets[i]->CurrentSetSize; x++)
+                        if (ResidencySets[i])
                         {
-                            if (pMasterSet->Insert(ResidencySets[i]->ppSet[x]))
-                            {
-                                TotalSizeNeeded += ResidencySets[i]->ppSet[x]->Size;
-                            }
+                            TotalSizeNeeded += pMasterSet->Merge(ResidencySets[i]);
                         }
                     }
                 }
-                // Close this set to free it's slot up for the app
-                hr = pMasterSet->Close();
-                if (FAILED(hr))
-                {
-                    return hr;
-                }
 
                 // This set of commandlists can't possibly fit within the budget, they need to be split up. If the number of command lists is 1 there is
                 // nothing we can do
                 if (Count > 1 && TotalSizeNeeded > LocalMemory.Budget + NonLocalMemory.Budget)
                 {
-                    delete(pMasterSet);
+                    ReleaseMasterSet(pMasterSet);
 
                     // Recursively try to find a small enough set to fit in memory
                     const UINT32 Half = Count / 2;
@@ -1015,9 +1637,35 @@ namespace D3DX12Residency
                         hr = SignalFence(Queue, QueueFence);
                     }
                 }
+                else
+                {
+                    ReleaseMasterSet(pMasterSet);
+                }
                 return hr;
             }
 
+            // Must be called with MasterSetCS held
+            ResidencySet* AcquireMasterSet()
+            {
+                if (Internal::IsListEmpty(&MasterSetPoolHead))
+                {
+                    ResidencySet* pSet = new ResidencySet();
+                    if (pSet)
+                    {
+                        pSet->Initialize(pSyncManager);
+                    }
+                    return pSet;
+                }
+
+                return CONTAINING_RECORD(Internal::RemoveHeadList(&MasterSetPoolHead), ResidencySet, PoolEntry);
+            }
+
+            void ReleaseMasterSet(ResidencySet* pSet)
+            {
+                Internal::ScopedLock Lock(&MasterSetCS);
+                Internal::InsertHeadList(&MasterSetPoolHead, &pSet->PoolEntry);
+            }
+
             struct AsyncWorkload
             {
                 AsyncWorkload() :
@@ -1087,13 +1735,10 @@ namespace D3DX12Residency
             void ProcessPagingWork(AsyncWorkload* pWork)
             {
                 Internal::DeviceWideSyncPoint* FirstUncompletedSyncPoint = DequeueCompletedSyncPoints();
-
-                // Use a union so that we only need 1 allocation
-                union ResidentScratchSpace
+                if (Tracing)
                 {
-                    ManagedObject* pManagedObject;
-                    ID3D12Pageable* pUnderlying;
-                };
+                    TraceFenceProgress();
+                }
 
                 ResidentScratchSpace* pMakeResidentList = nullptr;
                 UINT32 NumObjectsToMakeResident = 0;
@@ -1111,8 +1756,8 @@ namespace D3DX12Residency
                     // A lock must be taken here as the state of the objects will be altered
                     Internal::ScopedLock Lock(&Mutex);
 
-                    pMakeResidentList = new ResidentScratchSpace[pWork->pMasterSet->CurrentSetSize];
-                    pEvictionList = new ID3D12Pageable*[LRU.NumResidentObjects];
+                    pMakeResidentList = ReserveScratch(pMakeResidentScratch, MakeResidentScratchSize, UINT32(pWork->pMasterSet->CurrentSetSize));
+                    pEvictionList = ReserveScratch(pEvictionScratch, EvictionScratchSize, LRU.NumResidentObjects);
 
                     // Mark the objects used by this command list to be made resident
                     for (INT32 i = 0; i < pWork->pMasterSet->CurrentSetSize; i++)
@@ -1204,6 +1849,10 @@ namespace D3DX12Residency
 
                                 // Get the next sync point to wait for
                                 FirstUncompletedSyncPoint = DequeueCompletedSyncPoints();
+                                if (Tracing)
+                                {
+                                    TraceFenceProgress();
+                                }
 
                                 // If there is nothing to trim OR the only objects 'Resident' are the ones about to be used by this execute.
                                 if (pResidentHead == nullptr ||
@@ -1251,17 +1900,22 @@ namespace D3DX12Residency
                             }
                         }
                     }
-
-                    delete[](pMakeResidentList);
-                    delete[](pEvictionList);
                 }
 
                 // Tell the GPU that it's safe to execute since we made things resident
                 RESIDENCY_CHECK_RESULT(AsyncThreadFence.pFence->Signal(pWork->FenceValueToSignal));
 
-                delete(pWork->pMasterSet);
+                ReleaseMasterSet(pWork->pMasterSet);
                 pWork->pMasterSet = nullptr;
             }
+
+            // Use a union so that we only need 1 allocation
+            union ResidentScratchSpace
+            {
+                ManagedObject* pManagedObject;
+                ID3D12Pageable* pUnderlying;
+            };
+
             // The Enqueue and Dequeue Async Work functions are threadsafe as there is only 1 producer and 1 consumer, if that changes
             // Synchronisation will be required
             HRESULT EnqueueAsyncWork(ResidencySet* pMasterSet, UINT64 FenceValueToSignal, UINT64 SyncPointGeneration)
@@ -1305,13 +1959,29 @@ namespace D3DX12Residency
             void GetCurrentBudget(DXGI_QUERY_VIDEO_MEMORY_INFO* InfoOut, DXGI_MEMORY_SEGMENT_GROUP Segment)
             {
                 RESIDENCY_CHECK_RESULT(Adapter->QueryVideoMemoryInfo(NodeIndex, Segment, InfoOut));
+
+                if (Tracing)
+                {
+                    // The resident size is read without Mutex when executing; it is only used to split the usage
+                    UINT64 ResidentSize = LRU.ResidentSize;
+
+                    Internal::ScopedLock TraceLock(&Trace.CS);
+                    if (Trace.IsOpen() && Trace.BudgetChanged(Segment, InfoOut->Budget, InfoOut->CurrentUsage - ResidentSize))
+                    {
+                        Trace.WriteByte(TRACE_RECORD_BUDGET);
+                        Trace.WriteUInt(Segment);
+                        Trace.WriteUInt(InfoOut->Budget);
+                        Trace.WriteUInt(InfoOut->CurrentUsage);
+                        Trace.WriteUInt(ResidentSize);
+                    }
+                }
             }
 
             HRESULT EnqueueSyncPoint()
             {
                 Internal::ScopedLock Lock(&AsyncWorkMutex);
 
-                Internal::DeviceWideSyncPoint* pPoint = Internal::DeviceWideSyncPoint::CreateSyncPoint(NumQueuesSeen, CurrentSyncPointGeneration);
+                Internal::DeviceWideSyncPoint* pPoint = AllocateSyncPoint(NumQueuesSeen, CurrentSyncPointGeneration);
                 if (pPoint == nullptr)
                 {
                     return E_OUTOFMEMORY;
@@ -1349,7 +2019,7 @@ namespace D3DX12Residency
                     if (pPoint->IsCompleted())
                     {
                         Internal::RemoveHeadList(&InFlightSyncPointsHead);
-                        delete pPoint;
+                        FreeSyncPoint(pPoint);
                     }
                     else
                     {
@@ -1360,6 +2030,31 @@ namespace D3DX12Residency
                 return nullptr;
             }
 
+            // Completed sync points are kept for reuse; one that is too small for the number of queues seen is freed.
+            // Must be called with AsyncWorkMutex held.
+            Internal::DeviceWideSyncPoint* AllocateSyncPoint(UINT32 NumQueues, UINT64 Generation)
+            {
+                while (Internal::IsListEmpty(&FreeSyncPointsHead) == false)
+                {
+                    Internal::DeviceWideSyncPoint* pPoint =
+                        CONTAINING_RECORD(Internal::RemoveHeadList(&FreeSyncPointsHead), Internal::DeviceWideSyncPoint, ListEntry);
+
+                    if (pPoint->Recycle(NumQueues, Generation))
+                    {
+                        return pPoint;
+                    }
+                    Internal::DeviceWideSyncPoint::DestroySyncPoint(pPoint);
+                }
+
+                return Internal::DeviceWideSyncPoint::CreateSyncPoint(NumQueues, Generation);
+            }
+
+            // Must be called with AsyncWorkMutex held
+            void FreeSyncPoint(Internal::DeviceWideSyncPoint* pPoint)
+            {
+                Internal::InsertHeadList(&FreeSyncPointsHead, &pPoint->ListEntry);
+            }
+
             void WaitForSyncPoint(UINT64 SyncPointID)
             {
                 Internal::ScopedLock Lock(&AsyncWorkMutex);
@@ -1379,13 +2074,13 @@ namespace D3DX12Residency
                     {
                         // Keep popping off until we find the one to wait on
                         Internal::RemoveHeadList(&InFlightSyncPointsHead);
-                        delete(pPoint);
+                        FreeSyncPoint(pPoint);
                     }
                     else
                     {
                         pPoint->WaitForCompletion(CompletionEvent);
                         Internal::RemoveHeadList(&InFlightSyncPointsHead);
-                        delete(pPoint);
+                        FreeSyncPoint(pPoint);
                         return;
                     }
                 }
@@ -1415,11 +2110,13 @@ namespace D3DX12Residency
                 }
             }
 
+            // Both only change with AsyncWorkMutex held
             LIST_ENTRY QueueFencesListHead;
             UINT32 NumQueuesSeen;
             Internal::Fence AsyncThreadFence;
 
             LIST_ENTRY InFlightSyncPointsHead;
+            LIST_ENTRY FreeSyncPointsHead;
             UINT64 CurrentSyncPointGeneration;
 
             HANDLE CompletionEvent;
@@ -1449,6 +2146,20 @@ namespace D3DX12Residency
             INT64 ResidencyManagerUniqueID;
 
             SyncManager* pSyncManager;
+
+            // Recycled master sets. Also held while merging, as merges share ManagedObject::MasterSetEpoch.
+            Internal::CriticalSection MasterSetCS;
+            LIST_ENTRY MasterSetPoolHead;
+
+            // Only used by ProcessPagingWork, with Mutex held
+            ResidentScratchSpace* pMakeResidentScratch;
+            UINT32 MakeResidentScratchSize;
+            ID3D12Pageable** pEvictionScratch;
+            UINT32 EvictionScratchSize;
+
+            // Checked without the trace lock, so tracing costs a branch when it is off
+            Internal::TraceWriter Trace;
+            std::atomic<bool> Tracing;
         };
     }
 
@@ -1481,6 +2192,13 @@ namespace D3DX12Residency
             Manager.EndTrackingObject(pObject);
         }
 
+        // Chooses which objects are evicted first when over budget. The policy must outlive the manager or be
+        // replaced first; nullptr, the default, evicts the least recently used objects.
+        FORCEINLINE void SetEvictionPolicy(EvictionPolicy* pPolicy)
+        {
+            Manager.SetEvictionPolicy(pPolicy);
+        }
+
         HRESULT GetCurrentGPUSyncPoint(ID3D12CommandQueue* Queue, UINT64 *pCurrentGPUSyncPoint)
         {
             return Manager.GetCurrentGPUSyncPoint(Queue, pCurrentGPUSyncPoint);
@@ -1492,6 +2210,24 @@ namespace D3DX12Residency
             return Manager.ExecuteCommandLists(Queue, CommandLists, ResidencySets, Count);
         }
 
+        // Records the manager's work to FileName until StopTrace or Destroy, for replaying offline with
+        // Tools/ResidencyReplay. Must be called before the first ExecuteCommandLists or GetCurrentGPUSyncPoint.
+        FORCEINLINE HRESULT StartTrace(const wchar_t* FileName)
+        {
+            return Manager.StartTrace(FileName);
+        }
+
+        FORCEINLINE void StopTrace()
+        {
+            Manager.StopTrace();
+        }
+
+        // Marks the end of a frame in the trace, so the replay can report per frame. Does nothing when not tracing.
+        FORCEINLINE void TraceFrameBoundary()
+        {
+            Manager.TraceFrameBoundary();
+        }
+
         FORCEINLINE ResidencySet* CreateResidencySet()
         {
             ResidencySet* pSet = new ResidencySet();
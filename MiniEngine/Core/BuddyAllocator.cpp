@@ -60,6 +60,8 @@ BuddyAllocator::BuddyAllocator(kBuddyAllocationStrategy allocationStrategy, D3D1
     , m_baseOffset(baseOffset)
     , m_maxBlockSize(maxBlockSize)
     , m_minBlockSize(MinBlockSize)
+    , m_maxOrder(UnitSizeToOrder(SizeToUnitSize(maxBlockSize)))
+    , m_freeBlocks(m_maxOrder, 0)
     , m_pBackingHeap(nullptr)
 #if defined(PROFILE) || defined(_DEBUG)
     , m_SpaceUsed(0)
@@ -68,10 +70,6 @@ BuddyAllocator::BuddyAllocator(kBuddyAllocationStrategy allocationStrategy, D3D1
 {
     ASSERT(Math::IsDivisible(maxBlockSize, m_minBlockSize));
     ASSERT(Math::IsPowerOfTwo(maxBlockSize / m_minBlockSize));
-
-    m_maxOrder = UnitSizeToOrder(SizeToUnitSize(maxBlockSize));
-
-    Reset();
 }
 
 void BuddyAllocator::Initialize()
@@ -106,65 +104,6 @@ void BuddyAllocator::Destroy()
     }
 }
 
-size_t BuddyAllocator::AllocateBlock(UINT order)
-{
-    size_t offset;
-
-    if (order > m_maxOrder)
-    {
-        throw(std::bad_alloc()); // Can't allocate a block that large  
-    }
-
-    auto it = m_freeBlocks[order].begin();
-
-    if (it == m_freeBlocks[order].end())
-    {
-        // No free nodes in the requested pool.  Try to find a higher-order block and split it.  
-        size_t left = AllocateBlock(order + 1);
-
-        size_t size = OrderToUnitSize(order);
-
-        size_t right = left + size;
-
-        m_freeBlocks[order].insert(right); // Add the right block to the free pool  
-
-        offset = left; // Return the left block  
-    }
-
-    else
-    {
-        offset = *it;
-
-        // Remove the block from the free list  
-        m_freeBlocks[order].erase(it);
-    }
-
-    return offset;
-}
-
-void BuddyAllocator::DeallocateBlock(size_t offset, UINT order)
-{
-    // See if the buddy block is free  
-    size_t size = OrderToUnitSize(order);
-
-    size_t buddy = GetBuddyOffset(offset, size);
-
-    auto it = m_freeBlocks[order].find(buddy);
-
-    if (it != m_freeBlocks[order].end())
-    {
-        // Deallocate merged blocks  
-        DeallocateBlock(min(offset, buddy), order + 1);
-        // Remove the buddy from the free list  
-        m_freeBlocks[order].erase(it);
-    }
-    else
-    {
-        // Add the block to the free list  
-        m_freeBlocks[order].insert(offset); // throw(std::bad_alloc) 
-    }
-}
-
 BuddyBlock* BuddyAllocator::Allocate(uint32_t numElements, uint32_t elementSize, const void* initialData)
 {
     size_t size = numElements * elementSize;
@@ -173,7 +112,12 @@ BuddyBlock* BuddyAllocator::Allocate(uint32_t numElements, uint32_t elementSize,
 
     try
     {
-        size_t offset = AllocateBlock(order);
+        size_t offset = m_freeBlocks.Allocate(order);
+        if (offset == BuddyAllocatorCore::kInvalidOffset)
+        {
+            throw(std::bad_alloc()); // Can't allocate a block that large
+        }
+
         uint32_t paddedSize = uint32_t(OrderToUnitSize(order) * m_minBlockSize);
 
         uint32_t blockOffset = uint32_t(m_baseOffset + (offset * m_minBlockSize));
@@ -226,28 +170,18 @@ void BuddyAllocator::DeallocateInternal(BuddyBlock* pBlock)
 
     UINT order = UnitSizeToOrder(size);
 
-    try
-    {
-        DeallocateBlock(offset, order); // throw(std::bad_alloc)
+    // Freeing only flips bits in preallocated bitmaps, so it can't fail
+    m_freeBlocks.Deallocate(offset, order);
 
-        DECREASE_BUDDY_COUNTER(m_SpaceUsed, size);
-        DECREASE_BUDDY_COUNTER(m_InternalFragmentation, (size - pBlock->m_unpaddedSize));
-        
-        if (m_allocationStrategy == kBuddyAllocationStrategy::kPlacedResourceStrategy)
-        {
-            // Release the resource
-            pBlock->Destroy();
-        }
-        delete(pBlock);
-    }
+    DECREASE_BUDDY_COUNTER(m_SpaceUsed, size);
+    DECREASE_BUDDY_COUNTER(m_InternalFragmentation, (size - pBlock->m_unpaddedSize));
 
-    catch (std::bad_alloc&)
+    if (m_allocationStrategy == kBuddyAllocationStrategy::kPlacedResourceStrategy)
     {
-        // Deallocate failed trying to add the free block to the pool  
-        // resulting in a leak.  Unfortunately there is not much we can do.  
-        // Fortunately this is expected to be extremely rare as the storage  
-        // needed for each deallocate is very small.  
+        // Release the resource
+        pBlock->Destroy();
     }
+    delete(pBlock);
 };
 
 /*
@@ -0,0 +1,343 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "BuddyAllocatorCore.h"
+
+using namespace std;
+
+namespace
+{
+    const uint32_t kBitsPerWord = 64;
+    const uint32_t kWordShift = 6;
+
+    inline size_t WordCount(size_t numBits)
+    {
+        return (numBits + kBitsPerWord - 1) >> kWordShift;
+    }
+
+    inline uint32_t FirstSetBit(uint64_t value)
+    {
+        unsigned long index;
+        _BitScanForward64(&index, value);
+        return (uint32_t)index;
+    }
+
+    inline uint32_t CountSetBits(uint64_t value)
+    {
+        uint32_t count = 0;
+        for (; value != 0; value &= value - 1)
+            ++count;
+        return count;
+    }
+}
+
+BuddyAllocatorCore::BuddyAllocatorCore(uint32_t maxOrder, uint32_t fastOrder, uint32_t fastOrderCacheSize)
+    : m_maxOrder(maxOrder)
+    , m_nonEmptyOrders(0)
+    , m_fastOrder(fastOrder <= maxOrder ? fastOrder : kNoFastOrder)
+    , m_fastOrderCacheSize(fastOrderCacheSize)
+    , m_cacheWordCount(0)
+    , m_cachedBlockCount(0)
+    , m_cacheSearchStart(0)
+{
+    ASSERT(maxOrder < 48, "Buddy allocator bitmaps would not fit in memory");
+
+    // Lay out every level of every order back to back.  Level 0 has a bit per block
+    // and each level above has a bit per word of the one below, up to a single word.
+    m_orders.resize(m_maxOrder + 1);
+    size_t totalWords = 0;
+    for (uint32_t order = 0; order <= m_maxOrder; ++order)
+    {
+        OrderBitmap& bitmap = m_orders[order];
+        bitmap.m_numLevels = 0;
+        bitmap.m_freeCount = 0;
+
+        size_t numBits = ((size_t)1) << (m_maxOrder - order);
+        do
+        {
+            ASSERT(bitmap.m_numLevels < _countof(bitmap.m_levelOffset));
+            bitmap.m_levelOffset[bitmap.m_numLevels++] = (uint32_t)totalWords;
+            numBits = WordCount(numBits);
+            totalWords += numBits;
+        } while (numBits > 1);
+    }
+    m_bitmapWords.resize(totalWords);
+
+    if (m_fastOrder != kNoFastOrder)
+    {
+        m_cacheWordCount = WordCount(((size_t)1) << (m_maxOrder - m_fastOrder));
+        m_cacheWords.reset(new atomic<uint64_t>[m_cacheWordCount]);
+    }
+
+    Reset();
+}
+
+size_t BuddyAllocatorCore::Allocate(uint32_t order)
+{
+    if (order > m_maxOrder)
+        return kInvalidOffset;
+
+    size_t offset;
+    if (order == m_fastOrder && TryAllocateCached(offset))
+        return offset;
+
+    lock_guard<mutex> LockGuard(m_Mutex);
+
+    offset = AllocateLocked(order);
+    if (offset == kInvalidOffset && m_cachedBlockCount.load(memory_order_relaxed) != 0)
+    {
+        // Parked blocks may merge into one large enough for the request
+        FlushCacheLocked();
+        offset = AllocateLocked(order);
+    }
+    return offset;
+}
+
+void BuddyAllocatorCore::Deallocate(size_t offset, uint32_t order)
+{
+    ASSERT(order <= m_maxOrder && (offset & ((((size_t)1) << order) - 1)) == 0);
+
+    if (order == m_fastOrder && TryDeallocateCached(offset))
+        return;
+
+    lock_guard<mutex> LockGuard(m_Mutex);
+    DeallocateLocked(offset, order);
+}
+
+void BuddyAllocatorCore::Reset()
+{
+    lock_guard<mutex> LockGuard(m_Mutex);
+
+    fill(m_bitmapWords.begin(), m_bitmapWords.end(), 0ull);
+    for (OrderBitmap& bitmap : m_orders)
+        bitmap.m_freeCount = 0;
+    m_nonEmptyOrders = 0;
+
+    for (size_t i = 0; i < m_cacheWordCount; ++i)
+        m_cacheWords[i].store(0, memory_order_relaxed);
+    m_cachedBlockCount.store(0, memory_order_relaxed);
+    m_cacheSearchStart.store(0, memory_order_relaxed);
+
+    SetFree(m_maxOrder, 0);
+}
+
+void BuddyAllocatorCore::FlushCache()
+{
+    lock_guard<mutex> LockGuard(m_Mutex);
+    FlushCacheLocked();
+}
+
+size_t BuddyAllocatorCore::GetFreeUnitCount()
+{
+    lock_guard<mutex> LockGuard(m_Mutex);
+
+    size_t freeUnits = 0;
+    for (uint32_t order = 0; order <= m_maxOrder; ++order)
+        freeUnits += m_orders[order].m_freeCount << order;
+
+    if (m_fastOrder != kNoFastOrder)
+    {
+        for (size_t i = 0; i < m_cacheWordCount; ++i)
+            freeUnits += (size_t)CountSetBits(m_cacheWords[i].load(memory_order_relaxed)) << m_fastOrder;
+    }
+    return freeUnits;
+}
+
+bool BuddyAllocatorCore::Validate()
+{
+    lock_guard<mutex> LockGuard(m_Mutex);
+
+    for (uint32_t order = 0; order <= m_maxOrder; ++order)
+    {
+        const OrderBitmap& bitmap = m_orders[order];
+        const size_t numBlocks = ((size_t)1) << (m_maxOrder - order);
+
+        size_t freeCount = 0;
+        for (size_t block = 0; block < numBlocks; ++block)
+        {
+            if (!IsFree(order, block))
+                continue;
+
+            ++freeCount;
+            if (order < m_maxOrder && IsFree(order, block ^ 1))
+                return false;
+        }
+
+        if (freeCount != bitmap.m_freeCount || (freeCount != 0) != ((m_nonEmptyOrders >> order) & 1))
+            return false;
+
+        // A summary bit must be set exactly when the word it stands for is non-zero
+        size_t numWords = WordCount(numBlocks);
+        for (uint32_t level = 0; level + 1 < bitmap.m_numLevels; ++level)
+        {
+            const uint64_t* words = &m_bitmapWords[bitmap.m_levelOffset[level]];
+            const uint64_t* summary = &m_bitmapWords[bitmap.m_levelOffset[level + 1]];
+            for (size_t word = 0; word < numWords; ++word)
+            {
+                const bool summaryBit = ((summary[word >> kWordShift] >> (word & (kBitsPerWord - 1))) & 1) != 0;
+                if (summaryBit != (words[word] != 0))
+                    return false;
+            }
+            numWords = WordCount(numWords);
+        }
+    }
+
+    return true;
+}
+
+size_t BuddyAllocatorCore::AllocateLocked(uint32_t order)
+{
+    // Smallest order at or above the request that has a free block
+    const uint64_t candidates = m_nonEmptyOrders & (~0ull << order);
+    if (candidates == 0)
+        return kInvalidOffset;
+
+    uint32_t foundOrder = FirstSetBit(candidates);
+    const size_t block = FindFree(foundOrder);
+    ClearFree(foundOrder, block);
+
+    // Split down to the requested order, returning the upper halves to the free bitmaps
+    const size_t offset = block << foundOrder;
+    while (foundOrder > order)
+    {
+        --foundOrder;
+        SetFree(foundOrder, (offset >> foundOrder) + 1);
+    }
+    return offset;
+}
+
+void BuddyAllocatorCore::DeallocateLocked(size_t offset, uint32_t order)
+{
+    // Merge with the buddy for as long as it is free
+    size_t block = offset >> order;
+    while (order < m_maxOrder && IsFree(order, block ^ 1))
+    {
+        ClearFree(order, block ^ 1);
+        block >>= 1;
+        ++order;
+    }
+    SetFree(order, block);
+}
+
+void BuddyAllocatorCore::FlushCacheLocked()
+{
+    for (size_t i = 0; i < m_cacheWordCount; ++i)
+    {
+        uint64_t bits = m_cacheWords[i].exchange(0, memory_order_acquire);
+        while (bits != 0)
+        {
+            const uint32_t bit = FirstSetBit(bits);
+            bits &= bits - 1;
+            m_cachedBlockCount.fetch_sub(1, memory_order_relaxed);
+            DeallocateLocked(((i << kWordShift) + bit) << m_fastOrder, m_fastOrder);
+        }
+    }
+}
+
+void BuddyAllocatorCore::SetFree(uint32_t order, size_t block)
+{
+    OrderBitmap& bitmap = m_orders[order];
+    if (bitmap.m_freeCount++ == 0)
+        m_nonEmptyOrders |= 1ull << order;
+
+    // Propagate up while a word goes from empty to non-empty
+    for (uint32_t level = 0; level < bitmap.m_numLevels; ++level)
+    {
+        uint64_t& word = m_bitmapWords[bitmap.m_levelOffset[level] + (block >> kWordShift)];
+        const bool wasEmpty = word == 0;
+        word |= 1ull << (block & (kBitsPerWord - 1));
+        if (!wasEmpty)
+            break;
+        block >>= kWordShift;
+    }
+}
+
+void BuddyAllocatorCore::ClearFree(uint32_t order, size_t block)
+{
+    OrderBitmap& bitmap = m_orders[order];
+    if (--bitmap.m_freeCount == 0)
+        m_nonEmptyOrders &= ~(1ull << order);
+
+    // Propagate up while a word becomes empty
+    for (uint32_t level = 0; level < bitmap.m_numLevels; ++level)
+    {
+        uint64_t& word = m_bitmapWords[bitmap.m_levelOffset[level] + (block >> kWordShift)];
+        word &= ~(1ull << (block & (kBitsPerWord - 1)));
+        if (word != 0)
+            break;
+        block >>= kWordShift;
+    }
+}
+
+bool BuddyAllocatorCore::IsFree(uint32_t order, size_t block) const
+{
+    const uint64_t word = m_bitmapWords[m_orders[order].m_levelOffset[0] + (block >> kWordShift)];
+    return ((word >> (block & (kBitsPerWord - 1))) & 1) != 0;
+}
+
+size_t BuddyAllocatorCore::FindFree(uint32_t order) const
+{
+    const OrderBitmap& bitmap = m_orders[order];
+    ASSERT(bitmap.m_freeCount != 0);
+
+    // Walk down from the single top word, following the first non-empty word at each level
+    size_t index = 0;
+    for (uint32_t level = bitmap.m_numLevels; level-- > 0; )
+    {
+        const uint64_t word = m_bitmapWords[bitmap.m_levelOffset[level] + index];
+        index = (index << kWordShift) + FirstSetBit(word);
+    }
+    return index;
+}
+
+bool BuddyAllocatorCore::TryAllocateCached(size_t& offset)
+{
+    if (m_cachedBlockCount.load(memory_order_relaxed) == 0)
+        return false;
+
+    // Start where the last block was parked or claimed, since neighbouring words are likely populated
+    const size_t start = m_cacheSearchStart.load(memory_order_relaxed);
+    for (size_t n = 0; n < m_cacheWordCount; ++n)
+    {
+        const size_t i = (start + n) % m_cacheWordCount;
+        uint64_t bits = m_cacheWords[i].load(memory_order_relaxed);
+        while (bits != 0)
+        {
+            const uint64_t mask = 1ull << FirstSetBit(bits);
+            bits = m_cacheWords[i].fetch_and(~mask, memory_order_acquire);
+            if (bits & mask)
+            {
+                m_cachedBlockCount.fetch_sub(1, memory_order_relaxed);
+                m_cacheSearchStart.store(i, memory_order_relaxed);
+                offset = ((i << kWordShift) + FirstSetBit(mask)) << m_fastOrder;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool BuddyAllocatorCore::TryDeallocateCached(size_t offset)
+{
+    // Reserve a slot first so the cache never grows past its limit
+    uint32_t count = m_cachedBlockCount.load(memory_order_relaxed);
+    do
+    {
+        if (count >= m_fastOrderCacheSize)
+            return false;
+    } while (!m_cachedBlockCount.compare_exchange_weak(count, count + 1, memory_order_relaxed));
+
+    const size_t block = offset >> m_fastOrder;
+    m_cacheWords[block >> kWordShift].fetch_or(1ull << (block & (kBitsPerWord - 1)), memory_order_release);
+    m_cacheSearchStart.store(block >> kWordShift, memory_order_relaxed);
+    return true;
+}
@@ -0,0 +1,97 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Offset management for a buddy allocator, with no dependency on a graphics API.
+// Offsets are measured in units of the smallest block.  A block of order k spans
+// 2^k units and starts at a multiple of its size.
+//
+// The free blocks of each order are tracked in a hierarchical bitmap: one bit per
+// block, plus one summary bit per non-empty 64-bit word of the level below.  Finding
+// a free block costs one bit scan per level, splitting and merging cost one bitmap
+// update per order, and nothing is allocated after construction.
+//
+// Blocks of one order (the "fast order") can additionally be parked in a lock-free
+// cache when they are freed and claimed from it without taking the lock.  Cached
+// blocks are not merged with their buddies until the cache is flushed, which happens
+// automatically when an allocation would otherwise fail.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+
+class BuddyAllocatorCore
+{
+public:
+    static const size_t kInvalidOffset = (size_t)-1;
+    static const uint32_t kNoFastOrder = (uint32_t)-1;
+
+    // Bitmap storage is about a quarter of a byte per unit of the largest block
+    BuddyAllocatorCore(uint32_t maxOrder, uint32_t fastOrder = kNoFastOrder, uint32_t fastOrderCacheSize = 64);
+
+    // Returns the unit offset of a free block of 2^order units, or kInvalidOffset
+    size_t Allocate(uint32_t order);
+
+    void Deallocate(size_t offset, uint32_t order);
+
+    // Frees every block.  No other thread may use the allocator during the call.
+    void Reset();
+
+    // Returns cached fast-order blocks to the bitmaps so they can merge with their buddies
+    void FlushCache();
+
+    uint32_t GetMaxOrder() const { return m_maxOrder; }
+
+    // Number of free units, including blocks parked in the fast-order cache
+    size_t GetFreeUnitCount();
+
+    // Checks that the summary bits agree with the block bits and that no two free
+    // buddies were left unmerged.  Meant for tests; the cost is linear in the bitmap size.
+    bool Validate();
+
+private:
+    struct OrderBitmap
+    {
+        uint32_t m_numLevels;
+        uint32_t m_levelOffset[8];
+        size_t m_freeCount;
+    };
+
+    size_t AllocateLocked(uint32_t order);
+    void DeallocateLocked(size_t offset, uint32_t order);
+    void FlushCacheLocked();
+
+    void SetFree(uint32_t order, size_t block);
+    void ClearFree(uint32_t order, size_t block);
+    bool IsFree(uint32_t order, size_t block) const;
+    size_t FindFree(uint32_t order) const;
+
+    bool TryAllocateCached(size_t& offset);
+    bool TryDeallocateCached(size_t offset);
+
+    const uint32_t m_maxOrder;
+    std::mutex m_Mutex;
+
+    // All levels of all orders share one array; m_nonEmptyOrders has bit k set while order k has a free block
+    std::vector<uint64_t> m_bitmapWords;
+    std::vector<OrderBitmap> m_orders;
+    uint64_t m_nonEmptyOrders;
+
+    const uint32_t m_fastOrder;
+    const uint32_t m_fastOrderCacheSize;
+    size_t m_cacheWordCount;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_cacheWords;
+    std::atomic<uint32_t> m_cachedBlockCount;
+    std::atomic<size_t> m_cacheSearchStart;
+};
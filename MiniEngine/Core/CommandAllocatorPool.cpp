@@ -40,39 +40,29 @@ void CommandAllocatorPool::Shutdown()
 
 ID3D12CommandAllocator * CommandAllocatorPool::RequestAllocator(uint64_t CompletedFenceValue)
 {
-    std::lock_guard<std::mutex> LockGuard(m_AllocatorMutex);
-
-    ID3D12CommandAllocator* pAllocator = nullptr;
+    ID3D12CommandAllocator* pAllocator = m_ReadyAllocators.Pop(
+        [CompletedFenceValue](uint64_t FenceValue) { return FenceValue <= CompletedFenceValue; });
 
-    if (!m_ReadyAllocators.empty())
+    if (pAllocator != nullptr)
     {
-        std::pair<uint64_t, ID3D12CommandAllocator*>& AllocatorPair = m_ReadyAllocators.front();
-
-        if (AllocatorPair.first <= CompletedFenceValue)
-        {
-            pAllocator = AllocatorPair.second;
-            ASSERT_SUCCEEDED(pAllocator->Reset());
-            m_ReadyAllocators.pop();
-        }
+        ASSERT_SUCCEEDED(pAllocator->Reset());
+        return pAllocator;
     }
 
     // If no allocator's were ready to be reused, create a new one
-    if (pAllocator == nullptr)
-    {
-        ASSERT_SUCCEEDED(m_Device->CreateCommandAllocator(m_cCommandListType, MY_IID_PPV_ARGS(&pAllocator)));
-        wchar_t AllocatorName[32];
-        swprintf(AllocatorName, 32, L"CommandAllocator %zu", m_AllocatorPool.size());
-        pAllocator->SetName(AllocatorName);
-        m_AllocatorPool.push_back(pAllocator);
-    }
+    std::lock_guard<std::mutex> LockGuard(m_AllocatorMutex);
+
+    ASSERT_SUCCEEDED(m_Device->CreateCommandAllocator(m_cCommandListType, MY_IID_PPV_ARGS(&pAllocator)));
+    wchar_t AllocatorName[32];
+    swprintf(AllocatorName, 32, L"CommandAllocator %zu", m_AllocatorPool.size());
+    pAllocator->SetName(AllocatorName);
+    m_AllocatorPool.push_back(pAllocator);
 
     return pAllocator;
 }
 
 void CommandAllocatorPool::DiscardAllocator(uint64_t FenceValue, ID3D12CommandAllocator * Allocator)
 {
-    std::lock_guard<std::mutex> LockGuard(m_AllocatorMutex);
-
     // That fence value indicates we are free to reset the allocator
-    m_ReadyAllocators.push(std::make_pair(FenceValue, Allocator));
+    m_ReadyAllocators.Push(FenceValue, Allocator);
 }
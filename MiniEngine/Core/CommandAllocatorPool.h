@@ -14,9 +14,9 @@
 #pragma once
 
 #include <vector>
-#include <queue>
 #include <mutex>
 #include <stdint.h>
+#include "RecycleQueue.h"
 
 class CommandAllocatorPool
 {
@@ -33,10 +33,15 @@ public:
     inline size_t Size() { return m_AllocatorPool.size(); }
 
 private:
+    static const size_t kMaxAllocators = 1024;
+
     const D3D12_COMMAND_LIST_TYPE m_cCommandListType;
 
     ID3D12Device* m_Device;
+
+    // Only creating an allocator takes the lock
     std::vector<ID3D12CommandAllocator*> m_AllocatorPool;
-    std::queue<std::pair<uint64_t, ID3D12CommandAllocator*>> m_ReadyAllocators;
     std::mutex m_AllocatorMutex;
+
+    RecycleQueue<ID3D12CommandAllocator, kMaxAllocators> m_ReadyAllocators;
 };
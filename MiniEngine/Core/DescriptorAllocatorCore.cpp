@@ -0,0 +1,269 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "DescriptorAllocatorCore.h"
+
+#include <unordered_map>
+
+using namespace std;
+
+namespace
+{
+    const uint32_t kThreadCacheSlots = 8;
+
+    struct ThreadCache
+    {
+        uint64_t ownerId;
+        uint32_t count;
+        uint32_t indices[DescriptorAllocatorCore::kThreadCacheSize];
+    };
+
+    // Plain data, so nothing runs at thread exit that could outlive the allocators
+    thread_local ThreadCache t_threadCaches[kThreadCacheSlots];
+
+    atomic<uint64_t> s_nextAllocatorId(1);
+
+    // Live allocators by id, so a cache slot taken over by another allocator can be emptied into its
+    // owner.  Never destroyed, since static allocators elsewhere may be destroyed after this file's statics.
+    struct AllocatorRegistry
+    {
+        mutex Mutex;
+        unordered_map<uint64_t, DescriptorAllocatorCore*> Allocators;
+    };
+
+    AllocatorRegistry& GetAllocatorRegistry()
+    {
+        static AllocatorRegistry* s_registry = new AllocatorRegistry();
+        return *s_registry;
+    }
+
+    // Smallest c with 2^c >= count
+    inline uint32_t SizeClass(uint32_t count)
+    {
+        uint32_t sizeClass = 0;
+        while ((1u << sizeClass) < count)
+            ++sizeClass;
+        return sizeClass;
+    }
+
+    // Largest c with 2^c <= count
+    inline uint32_t FloorLog2(uint32_t count)
+    {
+        uint32_t log2 = 0;
+        while ((2u << log2) <= count && log2 < 31)
+            ++log2;
+        return log2;
+    }
+}
+
+DescriptorAllocatorCore::DescriptorAllocatorCore(uint32_t descriptorsPerHeap, uint32_t maxHeapCount,
+    FenceTest isFenceComplete, HeapCallback onNewHeap)
+    : m_descriptorsPerHeap(descriptorsPerHeap), m_maxHeapCount(maxHeapCount), m_numSizeClasses(SizeClass(descriptorsPerHeap) + 1),
+    m_isFenceComplete(move(isFenceComplete)), m_onNewHeap(move(onNewHeap)), m_freeLists(m_numSizeClasses),
+    m_heapCount(0), m_nextIndex(0), m_heapEnd(0), m_pendingCount(0), m_freeListedCount(0),
+    m_id(s_nextAllocatorId++), m_cacheSlot((uint32_t)(m_id % kThreadCacheSlots)), m_allocatedCount(0), m_threadCachedCount(0)
+{
+    ASSERT(descriptorsPerHeap > 0 && (descriptorsPerHeap & (descriptorsPerHeap - 1)) == 0, "Heap size must be a power of two");
+    ASSERT((uint64_t)descriptorsPerHeap * maxHeapCount < kInvalidIndex, "Too many descriptors to index with 32 bits");
+
+    AllocatorRegistry& registry = GetAllocatorRegistry();
+    lock_guard<mutex> registryGuard(registry.Mutex);
+    registry.Allocators[m_id] = this;
+}
+
+DescriptorAllocatorCore::~DescriptorAllocatorCore()
+{
+    AllocatorRegistry& registry = GetAllocatorRegistry();
+    lock_guard<mutex> registryGuard(registry.Mutex);
+    registry.Allocators.erase(m_id);
+}
+
+uint32_t DescriptorAllocatorCore::Allocate(uint32_t count)
+{
+    if (count == 0 || count > m_descriptorsPerHeap)
+        return kInvalidIndex;
+
+    if (count == 1)
+    {
+        ThreadCache& cache = t_threadCaches[m_cacheSlot];
+        if (cache.ownerId != m_id)
+        {
+            if (cache.count > 0)
+            {
+                // The registry lock keeps the owner alive while its descriptors go back
+                AllocatorRegistry& registry = GetAllocatorRegistry();
+                lock_guard<mutex> registryGuard(registry.Mutex);
+                auto owner = registry.Allocators.find(cache.ownerId);
+                if (owner != registry.Allocators.end())
+                    owner->second->ReturnThreadCache(cache.indices, cache.count);
+            }
+            cache.ownerId = m_id;
+            cache.count = 0;
+        }
+
+        if (cache.count == 0)
+            cache.count = RefillThreadCache(cache.indices, kThreadCacheSize);
+        if (cache.count == 0)
+            return kInvalidIndex;
+
+        --m_threadCachedCount;
+        ++m_allocatedCount;
+        return cache.indices[--cache.count];
+    }
+
+    const uint32_t sizeClass = SizeClass(count);
+
+    lock_guard<mutex> lockGuard(m_Mutex);
+    ReleaseCompletedLocked();
+
+    uint32_t index = AllocateLocked(sizeClass, true);
+    if (index != kInvalidIndex)
+        m_allocatedCount += 1u << sizeClass;
+    return index;
+}
+
+void DescriptorAllocatorCore::Free(uint32_t index, uint32_t count, uint64_t fenceValue)
+{
+    const uint32_t sizeClass = SizeClass(count);
+
+    lock_guard<mutex> lockGuard(m_Mutex);
+
+    PendingRange range = { fenceValue, index, sizeClass };
+    m_pendingRanges.push_back(range);
+    m_pendingCount += 1u << sizeClass;
+    m_allocatedCount -= 1u << sizeClass;
+}
+
+DescriptorAllocatorCore::Stats DescriptorAllocatorCore::GetStats()
+{
+    lock_guard<mutex> lockGuard(m_Mutex);
+
+    Stats stats;
+    stats.heapCount = m_heapCount;
+    stats.capacity = m_heapCount * m_descriptorsPerHeap;
+    stats.allocated = m_allocatedCount;
+    stats.pendingRelease = m_pendingCount;
+    stats.freeListed = m_freeListedCount;
+    stats.threadCached = m_threadCachedCount;
+    stats.untouched = m_heapEnd - m_nextIndex;
+    return stats;
+}
+
+uint32_t DescriptorAllocatorCore::AllocateLocked(uint32_t sizeClass, bool allowNewHeap)
+{
+    const uint32_t size = 1u << sizeClass;
+
+    std::vector<uint32_t>& freeList = m_freeLists[sizeClass];
+    if (!freeList.empty())
+    {
+        uint32_t index = freeList.back();
+        freeList.pop_back();
+        m_freeListedCount -= size;
+        return index;
+    }
+
+    if (m_heapEnd - m_nextIndex >= size)
+    {
+        uint32_t index = m_nextIndex;
+        m_nextIndex += size;
+        return index;
+    }
+
+    // Split a larger free range rather than growing
+    for (uint32_t largerClass = sizeClass + 1; largerClass < m_numSizeClasses; ++largerClass)
+    {
+        std::vector<uint32_t>& largerList = m_freeLists[largerClass];
+        if (largerList.empty())
+            continue;
+
+        uint32_t index = largerList.back();
+        largerList.pop_back();
+        m_freeListedCount -= 1u << largerClass;
+        AddFreeRangeLocked(index + size, (1u << largerClass) - size);
+        return index;
+    }
+
+    if (!allowNewHeap || !StartHeapLocked())
+        return kInvalidIndex;
+
+    uint32_t index = m_nextIndex;
+    m_nextIndex += size;
+    return index;
+}
+
+uint32_t DescriptorAllocatorCore::RefillThreadCache(uint32_t* indices, uint32_t count)
+{
+    lock_guard<mutex> lockGuard(m_Mutex);
+    ReleaseCompletedLocked();
+
+    // Only an empty cache is worth a new heap
+    uint32_t filled = 0;
+    while (filled < count)
+    {
+        uint32_t index = AllocateLocked(0, filled == 0);
+        if (index == kInvalidIndex)
+            break;
+        indices[filled++] = index;
+    }
+
+    m_threadCachedCount += filled;
+    return filled;
+}
+
+// The descriptors were never handed out, so they skip the fence and go straight to the free list
+void DescriptorAllocatorCore::ReturnThreadCache(const uint32_t* indices, uint32_t count)
+{
+    lock_guard<mutex> lockGuard(m_Mutex);
+
+    m_freeLists[0].insert(m_freeLists[0].end(), indices, indices + count);
+    m_freeListedCount += count;
+    m_threadCachedCount -= count;
+}
+
+void DescriptorAllocatorCore::ReleaseCompletedLocked()
+{
+    while (!m_pendingRanges.empty() && m_isFenceComplete(m_pendingRanges.front().fenceValue))
+    {
+        const PendingRange& range = m_pendingRanges.front();
+        m_freeLists[range.sizeClass].push_back(range.index);
+        m_pendingCount -= 1u << range.sizeClass;
+        m_freeListedCount += 1u << range.sizeClass;
+        m_pendingRanges.pop_front();
+    }
+}
+
+void DescriptorAllocatorCore::AddFreeRangeLocked(uint32_t index, uint32_t count)
+{
+    while (count > 0)
+    {
+        uint32_t sizeClass = min(FloorLog2(count), m_numSizeClasses - 1);
+        m_freeLists[sizeClass].push_back(index);
+        m_freeListedCount += 1u << sizeClass;
+        index += 1u << sizeClass;
+        count -= 1u << sizeClass;
+    }
+}
+
+bool DescriptorAllocatorCore::StartHeapLocked()
+{
+    if (m_heapCount == m_maxHeapCount)
+        return false;
+
+    // The tail of the old heap is still usable by smaller requests
+    AddFreeRangeLocked(m_nextIndex, m_heapEnd - m_nextIndex);
+
+    m_onNewHeap(m_heapCount);
+    m_nextIndex = m_heapCount * m_descriptorsPerHeap;
+    m_heapEnd = m_nextIndex + m_descriptorsPerHeap;
+    ++m_heapCount;
+    return true;
+}
@@ -0,0 +1,109 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Index management for DescriptorAllocator, with no dependency on a graphics API.
+// Descriptors live in a growing list of equally sized heaps and are identified by
+// heapIndex * descriptorsPerHeap + offset.  A range never spans two heaps.
+//
+// Requests are rounded up to a power of two and recycled through one free list per
+// size class.  Freed ranges wait in a queue until the fence value they were freed
+// with has completed, since command lists recorded before the free may still copy
+// from them.  Ranges are otherwise carved from the end of the newest heap, and a new
+// heap is requested through a callback when that runs out.  Free ranges are split but
+// never merged, which suits the mostly single descriptors the engine allocates.
+//
+// Single descriptors, by far the most common request, are handed out from a small
+// per-thread cache that takes the lock only to refill.  A thread has a few cache slots
+// shared by all allocators; an allocator taking over a slot hands the descriptors left
+// in it back to their owner.  Descriptors left in the cache of a thread that exits are
+// not recovered.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <functional>
+
+class DescriptorAllocatorCore
+{
+public:
+    static const uint32_t kInvalidIndex = (uint32_t)-1;
+    static const uint32_t kThreadCacheSize = 16;
+
+    typedef std::function<bool (uint64_t fenceValue)> FenceTest;
+    typedef std::function<void (uint32_t heapIndex)> HeapCallback;
+
+    struct Stats
+    {
+        uint32_t heapCount;
+        uint32_t capacity;          // heapCount * descriptors per heap
+        uint32_t allocated;         // Handed out, counting ranges at their rounded-up size
+        uint32_t pendingRelease;    // Freed, waiting for their fence
+        uint32_t freeListed;        // Ready for reuse
+        uint32_t threadCached;      // Single descriptors waiting in per-thread caches
+        uint32_t untouched;         // Never handed out, at the end of the newest heap
+    };
+
+    // onNewHeap runs under the allocator's lock before any index in the new heap is returned
+    DescriptorAllocatorCore(uint32_t descriptorsPerHeap, uint32_t maxHeapCount, FenceTest isFenceComplete, HeapCallback onNewHeap);
+    ~DescriptorAllocatorCore();
+
+    // Returns the first index of count contiguous descriptors, or kInvalidIndex when count exceeds a
+    // heap or all maxHeapCount heaps are in use
+    uint32_t Allocate(uint32_t count);
+
+    // The range becomes available again once fenceValue has completed
+    void Free(uint32_t index, uint32_t count, uint64_t fenceValue);
+
+    Stats GetStats();
+
+    uint32_t GetDescriptorsPerHeap() const { return m_descriptorsPerHeap; }
+
+private:
+    uint32_t AllocateLocked(uint32_t sizeClass, bool allowNewHeap);
+    uint32_t RefillThreadCache(uint32_t* indices, uint32_t count);
+    void ReturnThreadCache(const uint32_t* indices, uint32_t count);
+    void ReleaseCompletedLocked();
+    void AddFreeRangeLocked(uint32_t index, uint32_t count);
+    bool StartHeapLocked();
+
+    struct PendingRange
+    {
+        uint64_t fenceValue;
+        uint32_t index;
+        uint32_t sizeClass;
+    };
+
+    const uint32_t m_descriptorsPerHeap;
+    const uint32_t m_maxHeapCount;
+    const uint32_t m_numSizeClasses;
+    FenceTest m_isFenceComplete;
+    HeapCallback m_onNewHeap;
+
+    std::mutex m_Mutex;
+    std::vector<std::vector<uint32_t>> m_freeLists;
+    std::deque<PendingRange> m_pendingRanges;
+    uint32_t m_heapCount;
+    uint32_t m_nextIndex;           // Next untouched index in the newest heap
+    uint32_t m_heapEnd;
+    uint32_t m_pendingCount;
+    uint32_t m_freeListedCount;
+
+    // Per-thread caches are matched to their allocator by id, so a slot reused by another
+    // allocator is recognized and its descriptors returned to the allocator with that id
+    const uint64_t m_id;
+    const uint32_t m_cacheSlot;
+    std::atomic<uint32_t> m_allocatedCount;
+    std::atomic<uint32_t> m_threadCachedCount;
+};
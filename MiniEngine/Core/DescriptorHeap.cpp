@@ -45,22 +45,53 @@ ID3D12DescriptorHeap* DescriptorAllocator::RequestNewHeap(D3D12_DESCRIPTOR_HEAP_
     return pHeap.Get();
 }
 
+DescriptorAllocator::DescriptorAllocator(D3D12_DESCRIPTOR_HEAP_TYPE Type) :
+    m_Type(Type),
+    m_DescriptorSize(0),
+    m_Core(sm_NumDescriptorsPerHeap, sm_MaxHeapCount,
+        []( uint64_t FenceValue ) { return g_CommandManager.IsFenceComplete(FenceValue); },
+        [this]( uint32_t HeapIndex ) { CreateHeap(HeapIndex); }),
+    m_HeapStarts(new SIZE_T[sm_MaxHeapCount])
+{
+}
+
+void DescriptorAllocator::CreateHeap( uint32_t HeapIndex )
+{
+    ID3D12DescriptorHeap* Heap = RequestNewHeap(m_Type);
+    if (m_DescriptorSize == 0)
+        m_DescriptorSize = Graphics::g_Device->GetDescriptorHandleIncrementSize(m_Type);
+
+    m_HeapStarts[HeapIndex] = Heap->GetCPUDescriptorHandleForHeapStart().ptr;
+
+    std::lock_guard<std::mutex> LockGuard(m_HeapMapMutex);
+    m_HeapIndexByStart[m_HeapStarts[HeapIndex]] = HeapIndex;
+}
+
 D3D12_CPU_DESCRIPTOR_HANDLE DescriptorAllocator::Allocate( uint32_t Count )
 {
-    if (m_CurrentHeap == nullptr || m_RemainingFreeHandles < Count)
+    uint32_t Index = m_Core.Allocate(Count);
+    ASSERT(Index != DescriptorAllocatorCore::kInvalidIndex, "Out of descriptor heap space");
+
+    D3D12_CPU_DESCRIPTOR_HANDLE ret;
+    ret.ptr = m_HeapStarts[Index / sm_NumDescriptorsPerHeap] + (Index % sm_NumDescriptorsPerHeap) * m_DescriptorSize;
+    return ret;
+}
+
+void DescriptorAllocator::Free( D3D12_CPU_DESCRIPTOR_HANDLE Handle, uint32_t Count )
+{
+    uint32_t HeapIndex;
     {
-        m_CurrentHeap = RequestNewHeap(m_Type);
-        m_CurrentHandle = m_CurrentHeap->GetCPUDescriptorHandleForHeapStart();
-        m_RemainingFreeHandles = sm_NumDescriptorsPerHeap;
+        std::lock_guard<std::mutex> LockGuard(m_HeapMapMutex);
 
-        if (m_DescriptorSize == 0)
-            m_DescriptorSize = Graphics::g_Device->GetDescriptorHandleIncrementSize(m_Type);
+        auto iter = m_HeapIndexByStart.upper_bound(Handle.ptr);
+        ASSERT(iter != m_HeapIndexByStart.begin(), "Descriptor was not allocated here");
+        --iter;
+        ASSERT(Handle.ptr < iter->first + sm_NumDescriptorsPerHeap * m_DescriptorSize, "Descriptor was not allocated here");
+        HeapIndex = iter->second;
     }
 
-    D3D12_CPU_DESCRIPTOR_HANDLE ret = m_CurrentHandle;
-    m_CurrentHandle.ptr += Count * m_DescriptorSize;
-    m_RemainingFreeHandles -= Count;
-    return ret;
+    uint32_t Offset = (uint32_t)((Handle.ptr - m_HeapStarts[HeapIndex]) / m_DescriptorSize);
+    m_Core.Free(HeapIndex * sm_NumDescriptorsPerHeap + Offset, Count, g_CommandManager.GetGraphicsQueue().GetNextFenceValue());
 }
 
 //
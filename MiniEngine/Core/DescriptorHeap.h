@@ -16,7 +16,9 @@
 #include <mutex>
 #include <vector>
 #include <queue>
+#include <map>
 #include <string>
+#include "DescriptorAllocatorCore.h"
 
 
 // This is an unbounded resource descriptor allocator.  It is intended to provide space for CPU-visible resource descriptors
@@ -25,24 +27,38 @@
 class DescriptorAllocator
 {
 public:
-    DescriptorAllocator(D3D12_DESCRIPTOR_HEAP_TYPE Type) : m_Type(Type), m_CurrentHeap(nullptr) {}
+    DescriptorAllocator(D3D12_DESCRIPTOR_HEAP_TYPE Type);
 
     D3D12_CPU_DESCRIPTOR_HANDLE Allocate( uint32_t Count );
 
+    // The descriptors are reused once the graphics queue has finished the work submitted so far, because a context
+    // may still hold the handles for a descriptor table it has not yet copied.
+    void Free( D3D12_CPU_DESCRIPTOR_HANDLE Handle, uint32_t Count );
+
+    DescriptorAllocatorCore::Stats GetStats(void) { return m_Core.GetStats(); }
+
     static void DestroyAll(void);
 
 protected:
 
     static const uint32_t sm_NumDescriptorsPerHeap = 256;
+    static const uint32_t sm_MaxHeapCount = 4096;
     static std::mutex sm_AllocationMutex;
     static std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> sm_DescriptorHeapPool;
     static ID3D12DescriptorHeap* RequestNewHeap( D3D12_DESCRIPTOR_HEAP_TYPE Type );
 
+    void CreateHeap( uint32_t HeapIndex );
+
     D3D12_DESCRIPTOR_HEAP_TYPE m_Type;
-    ID3D12DescriptorHeap* m_CurrentHeap;
-    D3D12_CPU_DESCRIPTOR_HANDLE m_CurrentHandle;
     uint32_t m_DescriptorSize;
-    uint32_t m_RemainingFreeHandles;
+    DescriptorAllocatorCore m_Core;
+
+    // Written once per heap while the core holds its lock, before any index in the heap is handed out
+    std::unique_ptr<SIZE_T[]> m_HeapStarts;
+
+    // For Free(), which only has the handle
+    std::mutex m_HeapMapMutex;
+    std::map<SIZE_T, uint32_t> m_HeapIndexByStart;
 };
 
 
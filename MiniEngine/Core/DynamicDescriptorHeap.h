@@ -15,8 +15,8 @@
 
 #include "DescriptorHeap.h"
 #include "RootSignature.h"
+#include "RecycleQueue.h"
 #include <vector>
-#include <queue>
 
 namespace Graphics
 {
@@ -82,10 +82,10 @@ private:
 
     // Static members
     static const uint32_t kNumDescriptorsPerHeap = 1024;
-    static std::mutex sm_Mutex;
+    static const size_t kMaxDescriptorHeaps = 1024;
+    static std::mutex sm_Mutex;     // Only taken to create a heap
     static std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> sm_DescriptorHeapPool[2];
-    static std::queue<std::pair<uint64_t, ID3D12DescriptorHeap*>> sm_RetiredDescriptorHeaps[2];
-    static std::queue<ID3D12DescriptorHeap*> sm_AvailableDescriptorHeaps[2];
+    static RecycleQueue<ID3D12DescriptorHeap, kMaxDescriptorHeaps> sm_RetiredDescriptorHeaps[2];
 
     // Static methods
     static ID3D12DescriptorHeap* RequestDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE HeapType);
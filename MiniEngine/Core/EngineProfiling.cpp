@@ -425,6 +425,9 @@ namespace EngineProfiling
     BoolVar DrawProfiler("Display Profiler", false);
     //BoolVar DrawPerfGraph("Display Performance Graph", false);
     const bool DrawPerfGraph = false;
+
+    // In the order they were first set
+    vector<pair<wstring, uint32_t>> s_Counters;
     
     void Update( void )
     {
@@ -446,6 +449,19 @@ namespace EngineProfiling
         NestedTimingTree::PopProfilingMarker(Context);
     }
 
+    void SetCounter(const wstring& name, uint32_t value)
+    {
+        for (auto& Counter : s_Counters)
+        {
+            if (Counter.first == name)
+            {
+                Counter.second = value;
+                return;
+            }
+        }
+        s_Counters.emplace_back(name, value);
+    }
+
     bool IsPaused()
     {
         return Paused;
@@ -491,6 +507,22 @@ namespace EngineProfiling
             Text.SetColor( Color(1.0f, 1.0f, 1.0f) );
 
             NestedTimingTree::Display( Text, x );
+
+            if (!s_Counters.empty())
+            {
+                Text.SetLeftMargin(x);
+                Text.SetCursorX(x);
+                Text.SetColor( Color(0.5f, 1.0f, 1.0f) );
+                Text.DrawString("Counters\n");
+                Text.SetColor( Color(1.0f, 1.0f, 1.0f) );
+                for (auto& Counter : s_Counters)
+                {
+                    Text.DrawString("  ");
+                    Text.DrawString(Counter.first);
+                    Text.SetCursorX(x + 300.0f);
+                    Text.DrawFormattedString("%6u\n", Counter.second);
+                }
+            }
         }
 
         Text.GetCommandContext().SetScissor(0, 0, g_DisplayWidth, g_DisplayHeight);
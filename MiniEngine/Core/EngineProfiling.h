@@ -25,6 +25,9 @@ namespace EngineProfiling
     void BeginBlock(const std::wstring& name, CommandContext* Context = nullptr);
     void EndBlock(CommandContext* Context = nullptr);
 
+    // Shows a per-frame count (draws, culled objects, ...) under the timers in the profiler display
+    void SetCounter(const std::wstring& name, uint32_t value);
+
     void DisplayFrameRate(TextContext& Text);
     void DisplayPerfGraph(GraphicsContext& Text);
     void Display(TextContext& Text, float x, float y, float w, float h);
@@ -13,9 +13,9 @@
 
 #include "pch.h"
 #include "FileUtility.h"
+#include "GzipFileReader.h"
 #include <fstream>
 #include <mutex>
-#include <zlib.h> // From NuGet package 
 
 using namespace std;
 using namespace Utility;
@@ -57,67 +57,16 @@ ByteArray ReadFileHelperEx( shared_ptr<wstring> fileName)
     return ReadFileHelper(*fileName);
 }
 
-ByteArray Inflate(ByteArray CompressedSource, int& err, uint32_t ChunkSize = 0x100000 ) 
-{
-    // Create a dynamic buffer to hold compressed blocks
-    vector<unique_ptr<byte> > blocks;
-
-    z_stream strm  = {};
-    strm.data_type = Z_BINARY;
-    strm.total_in  = strm.avail_in  = (uInt)CompressedSource->size();
-    strm.next_in   = CompressedSource->data();
-
-    err = inflateInit2(&strm, (15 + 32)); //15 window bits, and the +32 tells zlib to to detect if using gzip or zlib
-
-    while (err == Z_OK || err == Z_BUF_ERROR)
-    {
-        strm.avail_out = ChunkSize;
-        strm.next_out = (byte*)malloc(ChunkSize);
-        blocks.emplace_back(strm.next_out);
-        err = inflate(&strm, Z_NO_FLUSH);
-    }
-
-    if (err != Z_STREAM_END) 
-    {
-        inflateEnd(&strm);
-        return NullFile;
-    }
-
-    ASSERT(strm.total_out > 0, "Nothing to decompress");
-
-    Utility::ByteArray byteArray = make_shared<vector<byte> >( strm.total_out );
-
-    // Allocate actual memory for this.
-    // copy the bits into that RAM.
-    // Free everything else up!!
-    void* curDest = byteArray->data();
-    size_t remaining = byteArray->size();
-
-    for (size_t i = 0; i < blocks.size(); ++i)
-    {
-        ASSERT(remaining > 0);
-
-        size_t CopySize = min(remaining, (size_t)ChunkSize);
-
-        memcpy(curDest, blocks[i].get(), CopySize);
-        curDest = (byte*)curDest + CopySize;
-        remaining -= CopySize;
-    }
-
-    inflateEnd(&strm);
-
-    return byteArray;
-}
-
 ByteArray DecompressZippedFile( wstring& fileName )
 {
-    ByteArray CompressedFile = ReadFileHelper(fileName);
-    if (CompressedFile == NullFile)
+    // Most files are not compressed, which is not worth reporting
+    struct _stat64 fileStat;
+    if (_wstat64(fileName.c_str(), &fileStat) == -1)
         return NullFile;
 
     int error;
-    ByteArray DecompressedFile = Inflate(CompressedFile, error);
-    if (DecompressedFile->size() == 0)
+    ByteArray DecompressedFile = make_shared<vector<byte> >();
+    if (!InflateGzipFile(fileName.c_str(), *DecompressedFile, error))
     {
         Utility::Printf(L"Couldn't unzip file %s:  Error = %d\n", fileName.c_str(), error);
         return NullFile;
@@ -126,6 +75,16 @@ ByteArray DecompressZippedFile( wstring& fileName )
     return DecompressedFile;
 }
 
+size_t Utility::GetInflatedFileSize( const wstring& fileName )
+{
+    return GetGzipFileSizeHint((fileName + L".gz").c_str());
+}
+
+size_t Utility::InflateFileInto( const wstring& fileName, void* Dest, size_t DestSize )
+{
+    return InflateGzipFileInto((fileName + L".gz").c_str(), Dest, DestSize);
+}
+
 ByteArray Utility::ReadFileSync( const wstring& fileName)
 {
     return ReadFileHelperEx(make_shared<wstring>(fileName));
@@ -34,4 +34,13 @@ namespace Utility
     // Same as previous except that it does not block but instead returns a task.
     task<ByteArray> ReadFileAsync(const wstring& fileName);
 
+    // Uncompressed size of the file with an additional ".gz" suffix, read from its gzip trailer.  Returns 0 if
+    // there is no such file.
+    size_t GetInflatedFileSize(const wstring& fileName);
+
+    // Decompresses the file with an additional ".gz" suffix straight into Dest, such as a mapped upload heap,
+    // reading it in fixed-size blocks.  Returns the number of bytes written, or 0 if the file is missing,
+    // corrupt or does not fit in DestSize.
+    size_t InflateFileInto(const wstring& fileName, void* Dest, size_t DestSize);
+
 } // namespace Utility
@@ -19,6 +19,7 @@
 #include "BufferManager.h"
 #include "CommandContext.h"
 #include "PostEffects.h"
+#include "TextureManager.h"
 
 #if WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP)
     #pragma comment(lib, "runtimeobject.lib")
@@ -68,6 +69,7 @@ namespace GameCore
     
         GameInput::Update(DeltaTime);
         EngineTuning::Update(DeltaTime);
+        TextureManager::Update();
         
         game.Update(DeltaTime);
         game.RenderScene();
@@ -30,6 +30,7 @@
 #include "ParticleEffectManager.h"
 #include "GraphRenderer.h"
 #include "TemporalEffects.h"
+#include "PSODiskCache.h"
 
 // This macro determines whether to detect if there is an HDR display and enable HDR10 output.
 // Currently, with HDR display enabled, the pixel magnfication functionality is broken.
@@ -461,6 +462,8 @@ void Graphics::Initialize(void)
 
     g_CommandManager.Create(g_Device);
 
+    PSODiskCache::Initialize(L"PipelineStateCache.bin");
+
     DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
     swapChainDesc.Width = g_DisplayWidth;
     swapChainDesc.Height = g_DisplayHeight;
@@ -595,6 +598,7 @@ void Graphics::Initialize(void)
 
 void Graphics::Terminate( void )
 {
+    TextureManager::StopIOThreads();
     g_CommandManager.IdleGPU();
 #if WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP)
     s_SwapChain1->SetFullscreenState(FALSE, nullptr);
@@ -607,6 +611,7 @@ void Graphics::Shutdown( void )
     g_CommandManager.Shutdown();
     GpuTimeManager::Shutdown();
     s_SwapChain1->Release();
+    PSODiskCache::BeginSave();
     PSO::DestroyAll();
     RootSignature::DestroyAll();
     DescriptorAllocator::DestroyAll();
@@ -626,6 +631,8 @@ void Graphics::Shutdown( void )
 
     g_PreDisplayBuffer.Destroy();
 
+    PSODiskCache::Shutdown();
+
 #if defined(_DEBUG)
     ID3D12DebugDevice* debugInterface;
     if (SUCCEEDED(g_Device->QueryInterface(&debugInterface)))
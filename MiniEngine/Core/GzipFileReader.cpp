@@ -0,0 +1,165 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "GzipFileReader.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace
+{
+    // Deflate cannot compress by more than about 1032:1
+    const uint64_t kMaxDeflateRatio = 1032;
+
+    // Reads ISIZE from the last four bytes of a gzip file and rewinds it
+    size_t ReadSizeHint(FILE* file)
+    {
+        unsigned char header[2];
+        unsigned char trailer[4];
+        size_t sizeHint = 0;
+
+        if (fread(header, 1, 2, file) == 2 && header[0] == 0x1f && header[1] == 0x8b &&
+            _fseeki64(file, -4, SEEK_END) == 0 && fread(trailer, 1, 4, file) == 4)
+        {
+            sizeHint = (size_t)trailer[0] | (size_t)trailer[1] << 8 | (size_t)trailer[2] << 16 | (size_t)trailer[3] << 24;
+
+            // A truncated file ends in compressed data, which must not turn into a huge allocation
+            if (sizeHint > (uint64_t)_ftelli64(file) * kMaxDeflateRatio)
+                sizeHint = 0;
+        }
+
+        _fseeki64(file, 0, SEEK_SET);
+        return sizeHint;
+    }
+}
+
+GzipFileReader::GzipFileReader(const wchar_t* fileName, size_t blockSize)
+    : m_File(nullptr), m_Stream(), m_InputBlock(blockSize > 0 ? blockSize : kDefaultBlockSize),
+    m_SizeHint(0), m_Error(Z_STREAM_ERROR)
+{
+    if (_wfopen_s(&m_File, fileName, L"rb") != 0)
+    {
+        m_File = nullptr;
+        return;
+    }
+
+    m_SizeHint = ReadSizeHint(m_File);
+
+    m_Stream.data_type = Z_BINARY;
+    m_Error = inflateInit2(&m_Stream, (15 + 32)); //15 window bits, and the +32 tells zlib to to detect if using gzip or zlib
+    if (m_Error != Z_OK)
+    {
+        fclose(m_File);
+        m_File = nullptr;
+    }
+}
+
+GzipFileReader::~GzipFileReader()
+{
+    if (m_File != nullptr)
+    {
+        inflateEnd(&m_Stream);
+        fclose(m_File);
+    }
+}
+
+size_t GzipFileReader::Read(void* dest, size_t destSize)
+{
+    size_t written = 0;
+
+    while (written < destSize && m_Error == Z_OK)
+    {
+        if (m_Stream.avail_in == 0)
+        {
+            m_Stream.next_in = m_InputBlock.data();
+            m_Stream.avail_in = (uInt)fread(m_InputBlock.data(), 1, m_InputBlock.size(), m_File);
+
+            // Truncated
+            if (m_Stream.avail_in == 0)
+            {
+                m_Error = Z_DATA_ERROR;
+                break;
+            }
+        }
+
+        // avail_out is 32 bits wide
+        const uInt outSize = (uInt)min(destSize - written, (size_t)UINT32_MAX);
+        m_Stream.next_out = (Bytef*)dest + written;
+        m_Stream.avail_out = outSize;
+
+        m_Error = inflate(&m_Stream, Z_NO_FLUSH);
+        written += outSize - m_Stream.avail_out;
+
+        // No progress was possible without more input, which the next iteration reads
+        if (m_Error == Z_BUF_ERROR)
+            m_Error = Z_OK;
+    }
+
+    return written;
+}
+
+bool InflateGzipFile(const wchar_t* fileName, vector<unsigned char>& output, int& error)
+{
+    GzipFileReader reader(fileName);
+    if (!reader.IsOpen())
+    {
+        output.clear();
+        error = reader.GetError();
+        return false;
+    }
+
+    output.resize(reader.GetSizeHint());
+    size_t size = reader.Read(output.data(), output.size());
+
+    while (!reader.IsFinished() && !reader.HasFailed())
+    {
+        // The stream may end exactly at the hint, so probe for more before growing the output
+        unsigned char next;
+        if (reader.Read(&next, 1) == 0)
+            continue;
+
+        output.resize(max(output.size() * 2, size + GzipFileReader::kDefaultBlockSize));
+        output[size++] = next;
+        size += reader.Read(output.data() + size, output.size() - size);
+    }
+
+    output.resize(size);
+    error = reader.GetError();
+    return reader.IsFinished() && size > 0;
+}
+
+size_t InflateGzipFileInto(const wchar_t* fileName, void* dest, size_t destSize)
+{
+    GzipFileReader reader(fileName);
+    size_t size = reader.Read(dest, destSize);
+
+    if (!reader.IsFinished())
+    {
+        unsigned char next;
+        if (reader.Read(&next, 1) != 0 || !reader.IsFinished())
+            return 0;
+    }
+
+    return size;
+}
+
+size_t GetGzipFileSizeHint(const wchar_t* fileName)
+{
+    FILE* file = nullptr;
+    if (_wfopen_s(&file, fileName, L"rb") != 0)
+        return 0;
+
+    size_t sizeHint = ReadSizeHint(file);
+    fclose(file);
+    return sizeHint;
+}
@@ -0,0 +1,69 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Streaming decompression of gzip (or zlib) files, with no dependency on the engine.
+// The compressed file is read in fixed-size blocks and inflated straight into the
+// caller's memory, so loading a file costs one input block plus the output.
+//
+// A gzip file ends with its uncompressed size modulo 2^32 (ISIZE), which lets the
+// output be allocated once up front.  It is only a hint: zlib streams have no trailer,
+// files over 4 GB wrap around, and a corrupt file may lie, so InflateGzipFile() grows
+// the output when the stream turns out to be longer.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <zlib.h>
+
+class GzipFileReader
+{
+public:
+    static const size_t kDefaultBlockSize = 256 * 1024;
+
+    explicit GzipFileReader(const wchar_t* fileName, size_t blockSize = kDefaultBlockSize);
+    ~GzipFileReader();
+
+    bool IsOpen() const { return m_File != nullptr; }
+
+    // Uncompressed size from the gzip trailer, or 0 for a zlib stream
+    size_t GetSizeHint() const { return m_SizeHint; }
+
+    // Inflates up to destSize bytes into dest and returns the number written.  Fewer bytes are
+    // returned only when the stream ends or fails.
+    size_t Read(void* dest, size_t destSize);
+
+    bool IsFinished() const { return m_Error == Z_STREAM_END; }
+    bool HasFailed() const { return m_Error != Z_OK && m_Error != Z_STREAM_END; }
+    int GetError() const { return m_Error; }
+
+private:
+    GzipFileReader(const GzipFileReader&);
+    GzipFileReader& operator=(const GzipFileReader&);
+
+    FILE* m_File;
+    z_stream m_Stream;
+    std::vector<unsigned char> m_InputBlock;
+    size_t m_SizeHint;
+    int m_Error;
+};
+
+// Inflates a whole file into output, which is sized from the trailer.  Returns false, with the
+// zlib error in error, if the file is missing, corrupt or empty.
+bool InflateGzipFile(const wchar_t* fileName, std::vector<unsigned char>& output, int& error);
+
+// Inflates a whole file into caller-provided memory such as a mapped upload heap.  Returns the
+// number of bytes written, or 0 if the file is missing, corrupt or longer than destSize.
+size_t InflateGzipFileInto(const wchar_t* fileName, void* dest, size_t destSize);
+
+// Uncompressed size from the trailer of a gzip file, or 0 if it is missing or not gzip
+size_t GetGzipFileSizeHint(const wchar_t* fileName);
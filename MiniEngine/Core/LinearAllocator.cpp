@@ -34,23 +34,12 @@ LinearAllocatorPageManager LinearAllocator::sm_PageManager[2];
 
 LinearAllocationPage* LinearAllocatorPageManager::RequestPage()
 {
-    lock_guard<mutex> LockGuard(m_Mutex);
-
-    while (!m_RetiredPages.empty() && g_CommandManager.IsFenceComplete(m_RetiredPages.front().first))
-    {
-        m_AvailablePages.push(m_RetiredPages.front().second);
-        m_RetiredPages.pop();
-    }
-
-    LinearAllocationPage* PagePtr = nullptr;
+    LinearAllocationPage* PagePtr = m_RetiredPages.Pop(
+        []( uint64_t FenceValue ) { return g_CommandManager.IsFenceComplete(FenceValue); });
 
-    if (!m_AvailablePages.empty())
-    {
-        PagePtr = m_AvailablePages.front();
-        m_AvailablePages.pop();
-    }
-    else
+    if (PagePtr == nullptr)
     {
+        lock_guard<mutex> LockGuard(m_Mutex);
         PagePtr = CreateNewPage();
         m_PagePool.emplace_back(PagePtr);
     }
@@ -60,9 +49,8 @@ LinearAllocationPage* LinearAllocatorPageManager::RequestPage()
 
 void LinearAllocatorPageManager::DiscardPages( uint64_t FenceValue, const vector<LinearAllocationPage*>& UsedPages )
 {
-    lock_guard<mutex> LockGuard(m_Mutex);
     for (auto iter = UsedPages.begin(); iter != UsedPages.end(); ++iter)
-        m_RetiredPages.push(make_pair(FenceValue, *iter));
+        m_RetiredPages.Push(FenceValue, *iter);
 }
 
 void LinearAllocatorPageManager::FreeLargePages( uint64_t FenceValue, const vector<LinearAllocationPage*>& LargePages )
@@ -13,8 +13,8 @@
 // Description:  This is a dynamic graphics memory allocator for DX12.  It's designed to work in concert
 // with the CommandContext class and to do so in a thread-safe manner.  There may be many command contexts,
 // each with its own linear allocators.  They act as windows into a global memory pool by reserving a
-// context-local memory page.  Requesting a new page is done in a thread-safe manner by guarding accesses
-// with a mutex lock.
+// context-local memory page.  Recycled pages are handed out through a lock-free queue, and only creating
+// a new page takes a mutex lock.
 //
 // When a command context is finished, it will receive a fence ID that indicates when it's safe to reclaim
 // used resources.  The CleanupUsedPages() method must be invoked at this time so that the used pages can be
@@ -23,6 +23,7 @@
 #pragma once
 
 #include "GpuResource.h"
+#include "RecycleQueue.h"
 #include <vector>
 #include <queue>
 #include <mutex>
@@ -115,14 +116,18 @@ public:
 
 private:
 
+    static const size_t kMaxPages = 4096;
+
     static LinearAllocatorType sm_AutoType;
 
     LinearAllocatorType m_AllocationType;
+
+    // Guards the page pool, which only grows, and the deletion queue for large pages
     std::vector<std::unique_ptr<LinearAllocationPage> > m_PagePool;
-    std::queue<std::pair<uint64_t, LinearAllocationPage*> > m_RetiredPages;
     std::queue<std::pair<uint64_t, LinearAllocationPage*> > m_DeletionQueue;
-    std::queue<LinearAllocationPage*> m_AvailablePages;
     std::mutex m_Mutex;
+
+    RecycleQueue<LinearAllocationPage, kMaxPages> m_RetiredPages;
 };
 
 class LinearAllocator
@@ -114,3 +114,91 @@ Frustum::Frustum( const Matrix4& ProjMat )
         ConstructPerspectiveFrustum( RcpXX, RcpYY, NearClip, FarClip );
     }
 }
+
+Frustum Frustum::MakeFromViewProjection( const Matrix4& ViewProjMat )
+{
+    // The columns of the transpose are the rows that produce clip-space x, y, z and w.  A point is inside the
+    // clip volume when -w <= x <= w, -w <= y <= w and 0 <= z <= w.
+    Matrix4 Rows = Transpose(ViewProjMat);
+    Vector4 RowX = Rows.GetX(), RowY = Rows.GetY(), RowZ = Rows.GetZ(), RowW = Rows.GetW();
+
+    Vector4 Planes[6];
+    Planes[kNearPlane]   = RowZ;
+    Planes[kFarPlane]    = RowW - RowZ;
+    Planes[kLeftPlane]   = RowW + RowX;
+    Planes[kRightPlane]  = RowW - RowX;
+    Planes[kTopPlane]    = RowW - RowY;
+    Planes[kBottomPlane] = RowW + RowY;
+
+    Frustum result;
+
+    for (int i = 0; i < 6; ++i)
+    {
+        // An infinite far plane has no normal and passes everything, so leave it as it is
+        float NormalLength = Length(Vector3(Planes[i]));
+        result.m_FrustumPlanes[i] = BoundingPlane(NormalLength > 0.0f ? Planes[i] / NormalLength : Planes[i]);
+    }
+
+    Matrix4 ClipToWorld = Invert(ViewProjMat);
+    const float CornerX[8] = { -1.0f, -1.0f,  1.0f,  1.0f, -1.0f, -1.0f,  1.0f,  1.0f };
+    const float CornerY[8] = { -1.0f,  1.0f, -1.0f,  1.0f, -1.0f,  1.0f, -1.0f,  1.0f };
+
+    for (int i = 0; i < 8; ++i)
+    {
+        Vector4 Corner = ClipToWorld * Vector4(CornerX[i], CornerY[i], i < 4 ? 0.0f : 1.0f, 1.0f);
+        result.m_FrustumCorners[i] = Vector3(Corner) / Corner.GetW();
+    }
+
+    return result;
+}
+
+void Frustum::IntersectBoundingBoxes( const Frustum* Frusta, uint32_t FrustumCount,
+    const float* const MinBound[3], const float* const MaxBound[3], uint32_t BoxCount, uint32_t* VisibleMasks )
+{
+    ASSERT(FrustumCount <= 32, "Visibility masks hold at most 32 frusta");
+
+    for (uint32_t i = 0; i < BoxCount; ++i)
+        VisibleMasks[i] = 0;
+
+    for (uint32_t f = 0; f < FrustumCount; ++f)
+    {
+        // Splat each plane once, and pick which bound gives the box corner furthest along its normal, per axis
+        XMVECTOR PlaneX[6], PlaneY[6], PlaneZ[6], PlaneW[6];
+        const float* FarX[6];
+        const float* FarY[6];
+        const float* FarZ[6];
+
+        for (int p = 0; p < 6; ++p)
+        {
+            XMVECTOR Plane = Vector4(Frusta[f].m_FrustumPlanes[p]);
+            PlaneX[p] = XMVectorSplatX(Plane);
+            PlaneY[p] = XMVectorSplatY(Plane);
+            PlaneZ[p] = XMVectorSplatZ(Plane);
+            PlaneW[p] = XMVectorSplatW(Plane);
+            FarX[p] = XMVectorGetX(Plane) > 0.0f ? MaxBound[0] : MinBound[0];
+            FarY[p] = XMVectorGetY(Plane) > 0.0f ? MaxBound[1] : MinBound[1];
+            FarZ[p] = XMVectorGetZ(Plane) > 0.0f ? MaxBound[2] : MinBound[2];
+        }
+
+        const uint32_t FrustumBit = 1u << f;
+
+        for (uint32_t i = 0; i < BoxCount; i += 4)
+        {
+            XMVECTOR Inside = XMVectorTrueInt();
+            for (int p = 0; p < 6; ++p)
+            {
+                XMVECTOR Distance = XMVectorMultiplyAdd(XMLoadFloat4((const XMFLOAT4*)(FarX[p] + i)), PlaneX[p], PlaneW[p]);
+                Distance = XMVectorMultiplyAdd(XMLoadFloat4((const XMFLOAT4*)(FarY[p] + i)), PlaneY[p], Distance);
+                Distance = XMVectorMultiplyAdd(XMLoadFloat4((const XMFLOAT4*)(FarZ[p] + i)), PlaneZ[p], Distance);
+                Inside = XMVectorAndInt(Inside, XMVectorGreaterOrEqual(Distance, XMVectorZero()));
+            }
+
+            int InsideLanes = _mm_movemask_ps(Inside);
+            for (uint32_t Lane = 0; Lane < 4 && i + Lane < BoxCount; ++Lane)
+            {
+                if (InsideLanes & (1 << Lane))
+                    VisibleMasks[i + Lane] |= FrustumBit;
+            }
+        }
+    }
+}
@@ -25,6 +25,11 @@ namespace Math
 
         Frustum( const Matrix4& ProjectionMatrix );
 
+        // Builds a world-space frustum from the clip planes of a view-projection matrix, whatever kind of
+        // projection it holds.  The "near" corners lie on the z = 0 clip plane, which is the far plane when the
+        // projection reverses Z.
+        static Frustum MakeFromViewProjection( const Matrix4& ViewProjMatrix );
+
         enum CornerID
         {
             kNearLowerLeft, kNearUpperLeft, kNearLowerRight, kNearUpperRight,
@@ -47,6 +52,13 @@ namespace Math
         // simple struct in the Model project.)
         bool IntersectBoundingBox(const Vector3 minBound, const Vector3 maxBound) const;
 
+        // The same test as IntersectBoundingBox() for many boxes and up to 32 frusta at once, four boxes at a time.
+        // The boxes are laid out as structure-of-arrays:  MinBound[0..2] point to the x, y and z of every box's
+        // minimum corner, and MaxBound[0..2] to those of the maximum corner.  Each array must be padded to a
+        // multiple of four floats.  Bit f of VisibleMasks[i] is set if box i intersects Frusta[f].
+        static void IntersectBoundingBoxes( const Frustum* Frusta, uint32_t FrustumCount,
+            const float* const MinBound[3], const float* const MaxBound[3], uint32_t BoxCount, uint32_t* VisibleMasks );
+
         friend Frustum  operator* ( const OrthogonalTransform& xform, const Frustum& frustum );    // Fast
         friend Frustum  operator* ( const AffineTransform& xform, const Frustum& frustum );        // Slow
         friend Frustum  operator* ( const Matrix4& xform, const Frustum& frustum );                // Slowest (and most general)
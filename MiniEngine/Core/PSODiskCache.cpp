@@ -0,0 +1,271 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "PSODiskCache.h"
+#include "GraphicsCore.h"
+#include "FileUtility.h"
+#include "Hash.h"
+#include <dxgi1_4.h>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+using namespace std;
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    // Bump kVersion whenever the layout below or the key computation in PipelineState.cpp changes
+    const uint32_t kMagic = 'MPSO';
+    const uint32_t kVersion = 2;
+
+    struct FileHeader
+    {
+        uint32_t Magic;
+        uint32_t Version;
+        uint32_t VendorId;
+        uint32_t DeviceId;
+        uint32_t SubSysId;
+        uint32_t Revision;
+        uint64_t DriverVersion;
+        uint32_t NumEntries;
+        uint32_t TableChecksum;
+    };
+
+    // Blobs follow the table, each padded to a multiple of four bytes
+    struct FileEntry
+    {
+        uint64_t Key;
+        uint64_t Offset;
+        uint32_t Size;
+        uint32_t Checksum;
+    };
+
+    wstring s_FileName;
+    FileHeader s_ExpectedHeader;
+
+    // Filled in by Initialize and read-only afterwards, so lookups need no lock
+    Utility::ByteArray s_FileData;
+    unordered_map<size_t, D3D12_CACHED_PIPELINE_STATE> s_StoredBlobs;
+
+    mutex s_Mutex;
+    map<size_t, ComPtr<ID3D12PipelineState>> s_CompiledPSOs;
+
+    bool s_SaveStarted = false;
+    concurrency::task<void> s_SaveTask;
+
+    uint32_t BlobChecksum( const void* Data, size_t Size )
+    {
+        const uint32_t* Words = (const uint32_t*)Data;
+        return (uint32_t)Utility::HashRange(Words, Words + Math::DivideByMultiple(Size, 4), 2166136261U);
+    }
+
+    void InitExpectedHeader( void )
+    {
+        ZeroMemory(&s_ExpectedHeader, sizeof(s_ExpectedHeader));
+        s_ExpectedHeader.Magic = kMagic;
+        s_ExpectedHeader.Version = kVersion;
+
+        // Blobs are only valid for the adapter and driver that produced them
+        ComPtr<IDXGIFactory4> Factory;
+        ComPtr<IDXGIAdapter1> Adapter;
+        if (FAILED(CreateDXGIFactory2(0, MY_IID_PPV_ARGS(&Factory))) ||
+            FAILED(Factory->EnumAdapterByLuid(Graphics::g_Device->GetAdapterLuid(), MY_IID_PPV_ARGS(&Adapter))))
+        {
+            return;
+        }
+
+        DXGI_ADAPTER_DESC1 Desc;
+        Adapter->GetDesc1(&Desc);
+        s_ExpectedHeader.VendorId = Desc.VendorId;
+        s_ExpectedHeader.DeviceId = Desc.DeviceId;
+        s_ExpectedHeader.SubSysId = Desc.SubSysId;
+        s_ExpectedHeader.Revision = Desc.Revision;
+
+        LARGE_INTEGER UmdVersion;
+        if (SUCCEEDED(Adapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &UmdVersion)))
+            s_ExpectedHeader.DriverVersion = (uint64_t)UmdVersion.QuadPart;
+    }
+
+    void WriteCacheFile( const wstring& FileName, const FileHeader& Identity,
+        const unordered_map<size_t, D3D12_CACHED_PIPELINE_STATE>& OldBlobs,
+        const map<size_t, ComPtr<ID3D12PipelineState>>& NewPSOs )
+    {
+        // Newly compiled blobs replace stored ones with the same key
+        vector<ComPtr<ID3DBlob>> NewBlobs;
+        map<size_t, D3D12_CACHED_PIPELINE_STATE> Blobs;
+        for (auto& Iter : OldBlobs)
+            Blobs[Iter.first] = Iter.second;
+        for (auto& Iter : NewPSOs)
+        {
+            ComPtr<ID3DBlob> Blob;
+            if (FAILED(Iter.second->GetCachedBlob(&Blob)) || Blob->GetBufferSize() > UINT32_MAX)
+            {
+                Blobs.erase(Iter.first);
+                continue;
+            }
+            Blobs[Iter.first] = { Blob->GetBufferPointer(), Blob->GetBufferSize() };
+            NewBlobs.push_back(Blob);
+        }
+
+        vector<FileEntry> Table;
+        Table.reserve(Blobs.size());
+        uint64_t Offset = sizeof(FileHeader) + Blobs.size() * sizeof(FileEntry);
+        vector<byte> Padded;
+        for (auto& Iter : Blobs)
+        {
+            const D3D12_CACHED_PIPELINE_STATE& Blob = Iter.second;
+            Padded.assign((const byte*)Blob.pCachedBlob, (const byte*)Blob.pCachedBlob + Blob.CachedBlobSizeInBytes);
+            Padded.resize(Math::AlignUp(Blob.CachedBlobSizeInBytes, 4), 0);
+
+            FileEntry Entry = { Iter.first, Offset, (uint32_t)Blob.CachedBlobSizeInBytes, BlobChecksum(Padded.data(), Padded.size()) };
+            Table.push_back(Entry);
+            Offset += Padded.size();
+        }
+
+        FileHeader Header = Identity;
+        Header.NumEntries = (uint32_t)Table.size();
+        Header.TableChecksum = (uint32_t)Utility::HashState(Table.data(), Table.size());
+
+        // Write next to the old file and swap it in, so a crash mid-write leaves the old cache intact
+        const wstring TempFileName = FileName + L".tmp";
+        {
+            ofstream File(TempFileName, ios::out | ios::binary | ios::trunc);
+            if (!File)
+                return;
+
+            const byte Zeros[4] = {};
+            File.write((const char*)&Header, sizeof(Header));
+            File.write((const char*)Table.data(), Table.size() * sizeof(FileEntry));
+            for (auto& Iter : Blobs)
+            {
+                const D3D12_CACHED_PIPELINE_STATE& Blob = Iter.second;
+                File.write((const char*)Blob.pCachedBlob, Blob.CachedBlobSizeInBytes);
+                File.write((const char*)Zeros, Math::AlignUp(Blob.CachedBlobSizeInBytes, 4) - Blob.CachedBlobSizeInBytes);
+            }
+
+            if (!File)
+            {
+                File.close();
+                _wremove(TempFileName.c_str());
+                return;
+            }
+        }
+
+        _wremove(FileName.c_str());
+        _wrename(TempFileName.c_str(), FileName.c_str());
+    }
+}
+
+void PSODiskCache::Initialize( const wstring& FileName )
+{
+    s_FileName = FileName;
+    InitExpectedHeader();
+
+    Utility::ByteArray File = Utility::ReadFileSync(FileName);
+    if (File->size() < sizeof(FileHeader))
+        return;
+
+    const FileHeader& Header = *(const FileHeader*)File->data();
+    if (memcmp(&Header, &s_ExpectedHeader, offsetof(FileHeader, NumEntries)) != 0)
+    {
+        Utility::Printf(L"Ignoring %s:  written by another version, adapter or driver\n", FileName.c_str());
+        return;
+    }
+
+    const FileEntry* Table = (const FileEntry*)(File->data() + sizeof(FileHeader));
+    const uint64_t TableEnd = sizeof(FileHeader) + (uint64_t)Header.NumEntries * sizeof(FileEntry);
+    if (TableEnd > File->size() || Header.TableChecksum != (uint32_t)Utility::HashState(Table, Header.NumEntries))
+    {
+        Utility::Printf(L"Ignoring %s:  entry table is corrupt\n", FileName.c_str());
+        return;
+    }
+
+    uint32_t NumCorrupt = 0;
+    for (uint32_t i = 0; i < Header.NumEntries; ++i)
+    {
+        const FileEntry& Entry = Table[i];
+        const uint64_t PaddedSize = Math::AlignUp((uint64_t)Entry.Size, 4);
+        if (Entry.Offset < TableEnd || (Entry.Offset & 3) != 0 || Entry.Offset + PaddedSize > File->size() ||
+            Entry.Checksum != BlobChecksum(File->data() + Entry.Offset, (size_t)PaddedSize))
+        {
+            ++NumCorrupt;
+            continue;
+        }
+        s_StoredBlobs[(size_t)Entry.Key] = { File->data() + Entry.Offset, Entry.Size };
+    }
+
+    s_FileData = File;
+
+    Utility::Printf(L"Loaded %u pipeline states from %s", (uint32_t)s_StoredBlobs.size(), FileName.c_str());
+    if (NumCorrupt > 0)
+        Utility::Printf(L" (%u corrupt entries dropped)", NumCorrupt);
+    Utility::Print("\n");
+}
+
+void PSODiskCache::BeginSave( void )
+{
+    lock_guard<mutex> LockGuard(s_Mutex);
+
+    if (s_SaveStarted || s_CompiledPSOs.empty() || s_FileName.empty())
+        return;
+
+    // The task owns everything it reads, so the rest of shutdown can proceed in parallel.
+    // OldFile is captured because the stored blobs point into it.
+    auto NewPSOs = make_shared<map<size_t, ComPtr<ID3D12PipelineState>>>(move(s_CompiledPSOs));
+    auto OldBlobs = make_shared<unordered_map<size_t, D3D12_CACHED_PIPELINE_STATE>>(move(s_StoredBlobs));
+    wstring FileName = s_FileName;
+    FileHeader Identity = s_ExpectedHeader;
+    Utility::ByteArray OldFile = s_FileData;
+
+    s_CompiledPSOs.clear();
+    s_StoredBlobs.clear();
+    s_FileData = nullptr;
+
+    s_SaveTask = concurrency::create_task([FileName, Identity, OldFile, OldBlobs, NewPSOs]
+    {
+        WriteCacheFile(FileName, Identity, *OldBlobs, *NewPSOs);
+    });
+    s_SaveStarted = true;
+}
+
+void PSODiskCache::Shutdown( void )
+{
+    if (s_SaveStarted)
+    {
+        s_SaveTask.wait();
+        s_SaveTask = concurrency::task<void>();
+        s_SaveStarted = false;
+    }
+
+    s_CompiledPSOs.clear();
+    s_StoredBlobs.clear();
+    s_FileData = nullptr;
+}
+
+D3D12_CACHED_PIPELINE_STATE PSODiskCache::Find( size_t Key )
+{
+    auto Iter = s_StoredBlobs.find(Key);
+    if (Iter == s_StoredBlobs.end())
+    {
+        D3D12_CACHED_PIPELINE_STATE Empty = {};
+        return Empty;
+    }
+    return Iter->second;
+}
+
+void PSODiskCache::Store( size_t Key, ID3D12PipelineState* PSO )
+{
+    lock_guard<mutex> LockGuard(s_Mutex);
+    s_CompiledPSOs[Key] = PSO;
+}
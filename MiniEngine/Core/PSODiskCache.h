@@ -0,0 +1,43 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Persists driver-compiled pipeline state blobs (ID3D12PipelineState::GetCachedBlob)
+// between runs so that PSO::Finalize can skip shader compilation on a warm start.
+//
+// Entries are keyed by a hash of the pipeline description's contents: shader bytecode,
+// input layout semantics and the root signature's own hash, never pointer values, so the
+// key is stable from one launch to the next.  The file records the adapter and driver
+// version it was written for and a checksum per blob; a file from another GPU or driver
+// is ignored as a whole, and a blob that fails its checksum is dropped on its own.
+//
+
+#pragma once
+
+#include <string>
+
+namespace PSODiskCache
+{
+    // Loads the cache file, if there is a valid one.  Call after the device is created.
+    void Initialize( const std::wstring& FileName );
+
+    // Starts writing the file on a background thread if any PSOs were compiled this run.
+    // PSOs may be destroyed once this returns.
+    void BeginSave( void );
+
+    // Waits for the write started by BeginSave and frees the cached blobs
+    void Shutdown( void );
+
+    // Returns the stored blob for a key, or an empty one.  Safe to call from any thread.
+    D3D12_CACHED_PIPELINE_STATE Find( size_t Key );
+
+    // Records a freshly compiled PSO so its blob is written out at shutdown.  This replaces
+    // any stored blob for the key, which is how a stale one gets overwritten.
+    void Store( size_t Key, ID3D12PipelineState* PSO );
+}
@@ -15,24 +15,148 @@
 #include "PipelineState.h"
 #include "RootSignature.h"
 #include "Hash.h"
-#include <map>
-#include <thread>
-#include <mutex>
+#include "StateObjectCache.h"
+#include "PSODiskCache.h"
 
 using Math::IsAligned;
 using namespace Graphics;
 using Microsoft::WRL::ComPtr;
 using namespace std;
 
-static map< size_t, ComPtr<ID3D12PipelineState> > s_GraphicsPSOHashMap;
-static map< size_t, ComPtr<ID3D12PipelineState> > s_ComputePSOHashMap;
+static StateObjectCache<ID3D12PipelineState> s_GraphicsPSOHashMap;
+static StateObjectCache<ID3D12PipelineState> s_ComputePSOHashMap;
 
 void PSO::DestroyAll(void)
 {
-    s_GraphicsPSOHashMap.clear();
-    s_ComputePSOHashMap.clear();
+    s_GraphicsPSOHashMap.Clear();
+    s_ComputePSOHashMap.Clear();
 }
 
+// The in-memory hash includes pointers to shader bytecode and semantic names, which move from
+// one run to the next.  The disk cache key hashes what they point to instead.
+static size_t HashShaderBytecode( const D3D12_SHADER_BYTECODE& Shader, size_t Hash )
+{
+    const uint32_t* Words = (const uint32_t*)Shader.pShaderBytecode;
+    return Utility::HashRange(Words, Words + Shader.BytecodeLength / 4, Hash);
+}
+
+static size_t HashString( const char* String, size_t Hash )
+{
+    uint32_t Word = 0;
+    for (size_t i = 0; String[i] != '\0'; ++i)
+    {
+        Word = (Word << 8) | (uint8_t)String[i];
+        if ((i & 3) == 3)
+            Hash = Utility::HashState(&Word, 1, Hash);
+    }
+    return Utility::HashState(&Word, 1, Hash);
+}
+
+// A struct copy carries whatever bytes the source left in its padding (a blend desc built on the
+// stack has three after every RenderTargetWriteMask), so the descs are rebuilt field by field over
+// zeroed memory.  Pointers are left null.
+static void CopyBlendDesc( D3D12_BLEND_DESC& Dest, const D3D12_BLEND_DESC& Src )
+{
+    Dest.AlphaToCoverageEnable = Src.AlphaToCoverageEnable;
+    Dest.IndependentBlendEnable = Src.IndependentBlendEnable;
+    for (UINT i = 0; i < D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT; ++i)
+    {
+        D3D12_RENDER_TARGET_BLEND_DESC& RT = Dest.RenderTarget[i];
+        const D3D12_RENDER_TARGET_BLEND_DESC& SrcRT = Src.RenderTarget[i];
+        RT.BlendEnable = SrcRT.BlendEnable;
+        RT.LogicOpEnable = SrcRT.LogicOpEnable;
+        RT.SrcBlend = SrcRT.SrcBlend;
+        RT.DestBlend = SrcRT.DestBlend;
+        RT.BlendOp = SrcRT.BlendOp;
+        RT.SrcBlendAlpha = SrcRT.SrcBlendAlpha;
+        RT.DestBlendAlpha = SrcRT.DestBlendAlpha;
+        RT.BlendOpAlpha = SrcRT.BlendOpAlpha;
+        RT.LogicOp = SrcRT.LogicOp;
+        RT.RenderTargetWriteMask = SrcRT.RenderTargetWriteMask;
+    }
+}
+
+static void CopyDepthStencilDesc( D3D12_DEPTH_STENCIL_DESC& Dest, const D3D12_DEPTH_STENCIL_DESC& Src )
+{
+    Dest.DepthEnable = Src.DepthEnable;
+    Dest.DepthWriteMask = Src.DepthWriteMask;
+    Dest.DepthFunc = Src.DepthFunc;
+    Dest.StencilEnable = Src.StencilEnable;
+    Dest.StencilReadMask = Src.StencilReadMask;
+    Dest.StencilWriteMask = Src.StencilWriteMask;
+    Dest.FrontFace = Src.FrontFace;
+    Dest.BackFace = Src.BackFace;
+}
+
+static size_t ComputeDiskCacheKey( const D3D12_GRAPHICS_PIPELINE_STATE_DESC& Desc, size_t RootSignatureHash )
+{
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC Scrubbed;
+    ZeroMemory(&Scrubbed, sizeof(Scrubbed));
+    Scrubbed.VS.BytecodeLength = Desc.VS.BytecodeLength;
+    Scrubbed.PS.BytecodeLength = Desc.PS.BytecodeLength;
+    Scrubbed.DS.BytecodeLength = Desc.DS.BytecodeLength;
+    Scrubbed.HS.BytecodeLength = Desc.HS.BytecodeLength;
+    Scrubbed.GS.BytecodeLength = Desc.GS.BytecodeLength;
+    Scrubbed.StreamOutput.NumEntries = Desc.StreamOutput.NumEntries;
+    Scrubbed.StreamOutput.NumStrides = Desc.StreamOutput.NumStrides;
+    Scrubbed.StreamOutput.RasterizedStream = Desc.StreamOutput.RasterizedStream;
+    CopyBlendDesc(Scrubbed.BlendState, Desc.BlendState);
+    Scrubbed.SampleMask = Desc.SampleMask;
+    Scrubbed.RasterizerState = Desc.RasterizerState;
+    CopyDepthStencilDesc(Scrubbed.DepthStencilState, Desc.DepthStencilState);
+    Scrubbed.InputLayout.NumElements = Desc.InputLayout.NumElements;
+    Scrubbed.IBStripCutValue = Desc.IBStripCutValue;
+    Scrubbed.PrimitiveTopologyType = Desc.PrimitiveTopologyType;
+    Scrubbed.NumRenderTargets = Desc.NumRenderTargets;
+    for (UINT i = 0; i < D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT; ++i)
+        Scrubbed.RTVFormats[i] = Desc.RTVFormats[i];
+    Scrubbed.DSVFormat = Desc.DSVFormat;
+    Scrubbed.SampleDesc = Desc.SampleDesc;
+    Scrubbed.NodeMask = Desc.NodeMask;
+    Scrubbed.Flags = Desc.Flags;
+
+    size_t HashCode = Utility::HashState(&Scrubbed, 1, RootSignatureHash);
+    HashCode = HashShaderBytecode(Desc.VS, HashCode);
+    HashCode = HashShaderBytecode(Desc.PS, HashCode);
+    HashCode = HashShaderBytecode(Desc.DS, HashCode);
+    HashCode = HashShaderBytecode(Desc.HS, HashCode);
+    HashCode = HashShaderBytecode(Desc.GS, HashCode);
+
+    // GraphicsPSO has no stream output setter, but a desc that has one must not share a key
+    // with one that doesn't
+    for (UINT i = 0; i < Desc.StreamOutput.NumEntries; ++i)
+    {
+        const D3D12_SO_DECLARATION_ENTRY& Entry = Desc.StreamOutput.pSODeclaration[i];
+        const UINT Fields[] = { Entry.Stream, Entry.SemanticIndex, Entry.StartComponent, Entry.ComponentCount, Entry.OutputSlot };
+        if (Entry.SemanticName != nullptr)
+            HashCode = HashString(Entry.SemanticName, HashCode);
+        HashCode = Utility::HashState(Fields, _countof(Fields), HashCode);
+    }
+    if (Desc.StreamOutput.NumStrides > 0)
+        HashCode = Utility::HashState(Desc.StreamOutput.pBufferStrides, Desc.StreamOutput.NumStrides, HashCode);
+
+    for (UINT i = 0; i < Desc.InputLayout.NumElements; ++i)
+    {
+        D3D12_INPUT_ELEMENT_DESC Element = Desc.InputLayout.pInputElementDescs[i];
+        HashCode = HashString(Element.SemanticName, HashCode);
+        Element.SemanticName = nullptr;
+        HashCode = Utility::HashState(&Element, 1, HashCode);
+    }
+
+    return HashCode;
+}
+
+static size_t ComputeDiskCacheKey( const D3D12_COMPUTE_PIPELINE_STATE_DESC& Desc, size_t RootSignatureHash )
+{
+    D3D12_COMPUTE_PIPELINE_STATE_DESC Scrubbed;
+    ZeroMemory(&Scrubbed, sizeof(Scrubbed));
+    Scrubbed.CS.BytecodeLength = Desc.CS.BytecodeLength;
+    Scrubbed.NodeMask = Desc.NodeMask;
+    Scrubbed.Flags = Desc.Flags;
+
+    size_t HashCode = Utility::HashState(&Scrubbed, 1, RootSignatureHash);
+    return HashShaderBytecode(Desc.CS, HashCode);
+}
 
 GraphicsPSO::GraphicsPSO()
 {
@@ -117,34 +241,22 @@ void GraphicsPSO::Finalize()
     HashCode = Utility::HashState(m_InputLayouts.get(), m_PSODesc.InputLayout.NumElements, HashCode);
     m_PSODesc.InputLayout.pInputElementDescs = m_InputLayouts.get();
 
-    ID3D12PipelineState** PSORef = nullptr;
-    bool firstCompile = false;
+    // Only the first thread to ask for this hash compiles; the others wait for its result.
+    m_PSO = s_GraphicsPSOHashMap.GetOrCreate(HashCode, [this]()
     {
-        static mutex s_HashMapMutex;
-        lock_guard<mutex> CS(s_HashMapMutex);
-        auto iter = s_GraphicsPSOHashMap.find(HashCode);
-
-        // Reserve space so the next inquiry will find that someone got here first.
-        if (iter == s_GraphicsPSOHashMap.end())
-        {
-            firstCompile = true;
-            PSORef = s_GraphicsPSOHashMap[HashCode].GetAddressOf();
-        }
-        else
-            PSORef = iter->second.GetAddressOf();
-    }
+        ID3D12PipelineState* PSO = nullptr;
 
-    if (firstCompile)
-    {
-        ASSERT_SUCCEEDED( g_Device->CreateGraphicsPipelineState(&m_PSODesc, MY_IID_PPV_ARGS(&m_PSO)) );
-        s_GraphicsPSOHashMap[HashCode].Attach(m_PSO);
-    }
-    else
-    {
-        while (*PSORef == nullptr)
-            this_thread::yield();
-        m_PSO = *PSORef;
-    }
+        // A blob from an older driver is rejected by the runtime; recompile and replace it.
+        size_t DiskCacheKey = ComputeDiskCacheKey(m_PSODesc, m_RootSignature->GetHashCode());
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC Desc = m_PSODesc;
+        Desc.CachedPSO = PSODiskCache::Find(DiskCacheKey);
+        if (Desc.CachedPSO.CachedBlobSizeInBytes > 0 && SUCCEEDED(g_Device->CreateGraphicsPipelineState(&Desc, MY_IID_PPV_ARGS(&PSO))))
+            return PSO;
+
+        ASSERT_SUCCEEDED( g_Device->CreateGraphicsPipelineState(&m_PSODesc, MY_IID_PPV_ARGS(&PSO)) );
+        PSODiskCache::Store(DiskCacheKey, PSO);
+        return PSO;
+    });
 }
 
 void ComputePSO::Finalize()
@@ -155,34 +267,22 @@ void ComputePSO::Finalize()
 
     size_t HashCode = Utility::HashState(&m_PSODesc);
 
-    ID3D12PipelineState** PSORef = nullptr;
-    bool firstCompile = false;
+    // Only the first thread to ask for this hash compiles; the others wait for its result.
+    m_PSO = s_ComputePSOHashMap.GetOrCreate(HashCode, [this]()
     {
-        static mutex s_HashMapMutex;
-        lock_guard<mutex> CS(s_HashMapMutex);
-        auto iter = s_ComputePSOHashMap.find(HashCode);
-
-        // Reserve space so the next inquiry will find that someone got here first.
-        if (iter == s_ComputePSOHashMap.end())
-        {
-            firstCompile = true;
-            PSORef = s_ComputePSOHashMap[HashCode].GetAddressOf();
-        }
-        else
-            PSORef = iter->second.GetAddressOf();
-    }
+        ID3D12PipelineState* PSO = nullptr;
 
-    if (firstCompile)
-    {
-        ASSERT_SUCCEEDED( g_Device->CreateComputePipelineState(&m_PSODesc, MY_IID_PPV_ARGS(&m_PSO)) );
-        s_ComputePSOHashMap[HashCode].Attach(m_PSO);
-    }
-    else
-    {
-        while (*PSORef == nullptr)
-            this_thread::yield();
-        m_PSO = *PSORef;
-    }
+        // A blob from an older driver is rejected by the runtime; recompile and replace it.
+        size_t DiskCacheKey = ComputeDiskCacheKey(m_PSODesc, m_RootSignature->GetHashCode());
+        D3D12_COMPUTE_PIPELINE_STATE_DESC Desc = m_PSODesc;
+        Desc.CachedPSO = PSODiskCache::Find(DiskCacheKey);
+        if (Desc.CachedPSO.CachedBlobSizeInBytes > 0 && SUCCEEDED(g_Device->CreateComputePipelineState(&Desc, MY_IID_PPV_ARGS(&PSO))))
+            return PSO;
+
+        ASSERT_SUCCEEDED( g_Device->CreateComputePipelineState(&m_PSODesc, MY_IID_PPV_ARGS(&PSO)) );
+        PSODiskCache::Store(DiskCacheKey, PSO);
+        return PSO;
+    });
 }
 
 ComputePSO::ComputePSO()
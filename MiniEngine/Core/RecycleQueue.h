@@ -0,0 +1,177 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// A lock-free queue of objects waiting for a fence before they can be reused, such as
+// command allocators, upload pages and shader-visible descriptor heaps.  Any thread may
+// push or pop.  Pop only takes the oldest entry, and only once its fence has completed,
+// which is the same first-in first-out reuse the mutex-protected std::queue gave.
+//
+// The queue is a bounded ring of sequence-numbered cells (Vyukov's MPMC queue).  Pools
+// that own every object they hand out never fill it as long as they create no more than
+// Capacity objects.  Pushes past that spill into a mutex-protected overflow list, which
+// Pop only looks at when the ring has nothing ready, so nothing is dropped.  An entry
+// pushed while an older push is still being written is not visible until that push
+// completes, in which case Pop reports nothing ready and the caller creates a new
+// object, as it would with an empty queue.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+template <typename T, size_t Capacity>
+class RecycleQueue
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    RecycleQueue() : m_PushPosition(0), m_PopPosition(0), m_OverflowSize(0)
+    {
+        for (size_t i = 0; i < Capacity; ++i)
+            m_Cells[i].m_Sequence.store(i, std::memory_order_relaxed);
+    }
+
+    void Push(uint64_t FenceValue, T* Object)
+    {
+        if (PushRing(FenceValue, Object))
+            return;
+
+        std::lock_guard<std::mutex> LockGuard(m_OverflowMutex);
+        m_Overflow.push_back(std::make_pair(FenceValue, Object));
+        m_OverflowSize.store(m_Overflow.size(), std::memory_order_release);
+    }
+
+    // Removes and returns the oldest object if IsFenceComplete(its fence value) is true,
+    // otherwise returns nullptr
+    template <typename FenceTest>
+    T* Pop(FenceTest&& IsFenceComplete)
+    {
+        T* Object = PopRing(IsFenceComplete);
+        if (Object != nullptr || m_OverflowSize.load(std::memory_order_acquire) == 0)
+            return Object;
+
+        std::lock_guard<std::mutex> LockGuard(m_OverflowMutex);
+        if (m_Overflow.empty() || !IsFenceComplete(m_Overflow.front().first))
+            return nullptr;
+
+        Object = m_Overflow.front().second;
+        m_Overflow.pop_front();
+        m_OverflowSize.store(m_Overflow.size(), std::memory_order_release);
+        return Object;
+    }
+
+    // Approximate while other threads are pushing or popping
+    size_t Size() const
+    {
+        size_t popPosition = m_PopPosition.load(std::memory_order_relaxed);
+        size_t pushPosition = m_PushPosition.load(std::memory_order_relaxed);
+        size_t ringSize = pushPosition > popPosition ? pushPosition - popPosition : 0;
+        return ringSize + m_OverflowSize.load(std::memory_order_relaxed);
+    }
+
+private:
+    // Returns false if the ring is full
+    bool PushRing(uint64_t FenceValue, T* Object)
+    {
+        size_t position = m_PushPosition.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = m_Cells[position & (Capacity - 1)];
+            size_t sequence = cell.m_Sequence.load(std::memory_order_acquire);
+            intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+
+            if (difference == 0)
+            {
+                if (m_PushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    cell.m_FenceValue.store(FenceValue, std::memory_order_relaxed);
+                    cell.m_Object.store(Object, std::memory_order_relaxed);
+                    cell.m_Sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0)
+            {
+                // Unless the queue really is full, a pop has claimed the cell and is about to release it
+                if ((intptr_t)(position - m_PopPosition.load(std::memory_order_acquire)) >= (intptr_t)Capacity)
+                    return false;
+                position = m_PushPosition.load(std::memory_order_relaxed);
+            }
+            else
+            {
+                position = m_PushPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    template <typename FenceTest>
+    T* PopRing(FenceTest& IsFenceComplete)
+    {
+        size_t position = m_PopPosition.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = m_Cells[position & (Capacity - 1)];
+            size_t sequence = cell.m_Sequence.load(std::memory_order_acquire);
+            intptr_t difference = (intptr_t)sequence - (intptr_t)(position + 1);
+
+            if (difference == 0)
+            {
+                // The cell can't be rewritten until the position moves past it, and then the
+                // exchange below fails, so a stale read here is harmless
+                if (!IsFenceComplete(cell.m_FenceValue.load(std::memory_order_relaxed)))
+                {
+                    size_t current = m_PopPosition.load(std::memory_order_relaxed);
+                    if (current == position)
+                        return nullptr;
+                    position = current;
+                    continue;
+                }
+
+                T* Object = cell.m_Object.load(std::memory_order_relaxed);
+                if (m_PopPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    cell.m_Sequence.store(position + Capacity, std::memory_order_release);
+                    return Object;
+                }
+            }
+            else if (difference < 0)
+            {
+                return nullptr;
+            }
+            else
+            {
+                position = m_PopPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    struct Cell
+    {
+        std::atomic<size_t> m_Sequence;
+        std::atomic<uint64_t> m_FenceValue;
+        std::atomic<T*> m_Object;
+    };
+
+    Cell m_Cells[Capacity];
+
+    // On separate cache lines so that pushing and popping threads don't contend
+    alignas(64) std::atomic<size_t> m_PushPosition;
+    alignas(64) std::atomic<size_t> m_PopPosition;
+
+    // Only touched once the ring has filled
+    std::mutex m_OverflowMutex;
+    std::deque<std::pair<uint64_t, T*>> m_Overflow;
+    std::atomic<size_t> m_OverflowSize;
+};
@@ -15,19 +15,17 @@
 #include "RootSignature.h"
 #include "GraphicsCore.h"
 #include "Hash.h"
-#include <map>
-#include <thread>
-#include <mutex>
+#include "StateObjectCache.h"
 
 using namespace Graphics;
 using namespace std;
 using Microsoft::WRL::ComPtr;
 
-static std::map< size_t, ComPtr<ID3D12RootSignature> > s_RootSignatureHashMap;
+static StateObjectCache<ID3D12RootSignature> s_RootSignatureHashMap;
 
 void RootSignature::DestroyAll(void)
 {
-    s_RootSignatureHashMap.clear();
+    s_RootSignatureHashMap.Clear();
 }
 
 void RootSignature::InitStaticSampler(
@@ -86,6 +84,32 @@ void RootSignature::InitStaticSampler(
     }
 }
 
+size_t RootSignature::ComputeHashCode( D3D12_ROOT_SIGNATURE_FLAGS Flags ) const
+{
+    size_t HashCode = Utility::HashState(&Flags);
+    HashCode = Utility::HashState( m_SamplerArray.get(), m_NumSamplers, HashCode );
+
+    for (UINT Param = 0; Param < m_NumParameters; ++Param)
+    {
+        const D3D12_ROOT_PARAMETER& RootParam = m_ParamArray[Param]();
+
+        HashCode = Utility::HashState( &RootParam.ParameterType, 1, HashCode );
+        HashCode = Utility::HashState( &RootParam.ShaderVisibility, 1, HashCode );
+
+        if (RootParam.ParameterType == D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE)
+        {
+            HashCode = Utility::HashState( RootParam.DescriptorTable.pDescriptorRanges,
+                RootParam.DescriptorTable.NumDescriptorRanges, HashCode );
+        }
+        else if (RootParam.ParameterType == D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS)
+            HashCode = Utility::HashState( &RootParam.Constants, 1, HashCode );
+        else
+            HashCode = Utility::HashState( &RootParam.Descriptor, 1, HashCode );
+    }
+
+    return HashCode;
+}
+
 void RootSignature::Finalize(const std::wstring& name, D3D12_ROOT_SIGNATURE_FLAGS Flags)
 {
     if (m_Finalized)
@@ -103,9 +127,6 @@ void RootSignature::Finalize(const std::wstring& name, D3D12_ROOT_SIGNATURE_FLAG
     m_DescriptorTableBitMap = 0;
     m_SamplerTableBitMap = 0;
 
-    size_t HashCode = Utility::HashState(&RootDesc.Flags);
-    HashCode = Utility::HashState( RootDesc.pStaticSamplers, m_NumSamplers, HashCode );
-
     for (UINT Param = 0; Param < m_NumParameters; ++Param)
     {
         const D3D12_ROOT_PARAMETER& RootParam = RootDesc.pParameters[Param];
@@ -115,9 +136,6 @@ void RootSignature::Finalize(const std::wstring& name, D3D12_ROOT_SIGNATURE_FLAG
         {
             ASSERT(RootParam.DescriptorTable.pDescriptorRanges != nullptr);
 
-            HashCode = Utility::HashState( RootParam.DescriptorTable.pDescriptorRanges,
-                RootParam.DescriptorTable.NumDescriptorRanges, HashCode );
-
             // We keep track of sampler descriptor tables separately from CBV_SRV_UAV descriptor tables
             if (RootParam.DescriptorTable.pDescriptorRanges->RangeType == D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER)
                 m_SamplerTableBitMap |= (1 << Param);
@@ -127,48 +145,26 @@ void RootSignature::Finalize(const std::wstring& name, D3D12_ROOT_SIGNATURE_FLAG
             for (UINT TableRange = 0; TableRange < RootParam.DescriptorTable.NumDescriptorRanges; ++TableRange)
                 m_DescriptorTableSize[Param] += RootParam.DescriptorTable.pDescriptorRanges[TableRange].NumDescriptors;
         }
-        else
-            HashCode = Utility::HashState( &RootParam, 1, HashCode );
     }
 
-    ID3D12RootSignature** RSRef = nullptr;
-    bool firstCompile = false;
-    {
-        static mutex s_HashMapMutex;
-        lock_guard<mutex> CS(s_HashMapMutex);
-        auto iter = s_RootSignatureHashMap.find(HashCode);
+    size_t HashCode = ComputeHashCode(Flags);
+    m_HashCode = HashCode;
 
-        // Reserve space so the next inquiry will find that someone got here first.
-        if (iter == s_RootSignatureHashMap.end())
-        {
-            RSRef = s_RootSignatureHashMap[HashCode].GetAddressOf();
-            firstCompile = true;
-        }
-        else
-            RSRef = iter->second.GetAddressOf();
-    }
-
-    if (firstCompile)
+    // Only the first thread to ask for this hash creates the signature; the others wait for its result.
+    m_Signature = s_RootSignatureHashMap.GetOrCreate(HashCode, [&]()
     {
         ComPtr<ID3DBlob> pOutBlob, pErrorBlob;
 
         ASSERT_SUCCEEDED( D3D12SerializeRootSignature(&RootDesc, D3D_ROOT_SIGNATURE_VERSION_1,
             pOutBlob.GetAddressOf(), pErrorBlob.GetAddressOf()));
 
+        ID3D12RootSignature* Signature = nullptr;
         ASSERT_SUCCEEDED( g_Device->CreateRootSignature(1, pOutBlob->GetBufferPointer(), pOutBlob->GetBufferSize(),
-            MY_IID_PPV_ARGS(&m_Signature)) );
-
-        m_Signature->SetName(name.c_str());
+            MY_IID_PPV_ARGS(&Signature)) );
 
-        s_RootSignatureHashMap[HashCode].Attach(m_Signature);
-        ASSERT(*RSRef == m_Signature);
-    }
-    else
-    {
-        while (*RSRef == nullptr)
-            this_thread::yield();
-        m_Signature = *RSRef;
-    }
+        Signature->SetName(name.c_str());
+        return Signature;
+    });
 
     m_Finalized = TRUE;
 }
@@ -24,6 +24,7 @@ public:
 
     RootParameter() 
     {
+        ZeroMemory(&m_RootParam, sizeof(m_RootParam));
         m_RootParam.ParameterType = (D3D12_ROOT_PARAMETER_TYPE)0xFFFFFFFF;
     }
 
@@ -37,6 +38,7 @@ public:
         if (m_RootParam.ParameterType == D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE)
             delete [] m_RootParam.DescriptorTable.pDescriptorRanges;
 
+        ZeroMemory(&m_RootParam, sizeof(m_RootParam));
         m_RootParam.ParameterType = (D3D12_ROOT_PARAMETER_TYPE)0xFFFFFFFF;
     }
 
@@ -162,6 +164,13 @@ public:
 
     ID3D12RootSignature* GetSignature() const { return m_Signature; }
 
+    // Hash of the signature's contents, stable across runs
+    size_t GetHashCode() const { return m_HashCode; }
+
+    // The hash Finalize() will use.  Only the fields each parameter type defines are hashed, so
+    // padding and the unused tail of the parameter union never change it.
+    size_t ComputeHashCode( D3D12_ROOT_SIGNATURE_FLAGS Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE ) const;
+
 protected:
 
     BOOL m_Finalized;
@@ -174,4 +183,5 @@ protected:
     std::unique_ptr<RootParameter[]> m_ParamArray;
     std::unique_ptr<D3D12_STATIC_SAMPLER_DESC[]> m_SamplerArray;
     ID3D12RootSignature* m_Signature;
+    size_t m_HashCode;
 };
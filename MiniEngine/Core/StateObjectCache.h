@@ -0,0 +1,222 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// A concurrent cache of reference counted state objects (PSOs, root signatures)
+// keyed on a Utility::HashState value.  The first thread to ask for a hash creates
+// the object; any other thread asking for the same hash sleeps on that entry alone
+// until it is published.  Lookups and insertions never take a lock.
+//
+// Entries are spread over shards by the low bits of the hash.  Each shard is a chain
+// of open addressing tables, each twice the size of the last.  Keys never move once
+// placed, so a full table is closed rather than rehashed: a probe that reaches an
+// empty slot of a full table marks it closed, and every thread that probes the same
+// key then agrees to continue in the next table.  That keeps "first to ask creates"
+// exact without a lock.
+//
+
+#pragma once
+
+#ifndef WIN32_LEAN_AND_MEAN
+    #define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+    #define NOMINMAX
+#endif
+#include <windows.h>
+
+#include <cstdint>
+#include <atomic>
+
+#pragma comment(lib, "Synchronization.lib")
+
+template <typename T>
+class StateObjectCache
+{
+public:
+    StateObjectCache()
+    {
+        for (uint32_t i = 0; i < kNumShards; ++i)
+            m_Shards[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~StateObjectCache() { Clear(); }
+
+    // Returns the object cached for HashCode, calling Create() to make it if this is the
+    // first request.  Create must return a new reference, which the cache takes over, or
+    // nullptr on failure.  A failure wakes the waiters and the first of them to see it
+    // tries again, so each caller either gets the object or has seen its own Create fail.
+    // Callers borrow the returned pointer for as long as the cache holds it.
+    template <typename CreateFn>
+    T* GetOrCreate(size_t HashCode, CreateFn&& Create)
+    {
+        bool firstCompile = false;
+        Entry& entry = FindOrInsert(HashCode, firstCompile);
+
+        if (firstCompile)
+            return CreateAndPublish(entry, Create);
+
+        T* Object = entry.m_Object.load(std::memory_order_acquire);
+        for (;;)
+        {
+            if (Object == FailedObject())
+            {
+                // Take over the retry; if another waiter got there first, wait on its attempt
+                if (entry.m_Object.compare_exchange_strong(Object, nullptr, std::memory_order_acquire))
+                    return CreateAndPublish(entry, Create);
+                continue;
+            }
+
+            if (Object != nullptr)
+                return Object;
+
+            T* Pending = nullptr;
+            WaitOnAddress(&entry.m_Object, &Pending, sizeof(Pending), INFINITE);
+            Object = entry.m_Object.load(std::memory_order_acquire);
+        }
+    }
+
+    // Releases every cached object.  No other thread may use the cache during the call.
+    void Clear()
+    {
+        for (uint32_t i = 0; i < kNumShards; ++i)
+        {
+            Table* table = m_Shards[i].exchange(nullptr, std::memory_order_acquire);
+            while (table != nullptr)
+            {
+                for (uint32_t slot = 0; slot < table->m_Capacity; ++slot)
+                {
+                    T* Object = table->m_Entries[slot].m_Object.load(std::memory_order_relaxed);
+                    if (Object != nullptr && Object != FailedObject())
+                        Object->Release();
+                }
+                Table* next = table->m_Next.load(std::memory_order_relaxed);
+                delete table;
+                table = next;
+            }
+        }
+    }
+
+private:
+    static const uint32_t kNumShards = 16;
+    static const uint32_t kShardBits = 4;
+    static const uint32_t kInitialCapacity = 64;
+
+    // Reserved keys; real hashes that collide with them are nudged out of the way
+    static const size_t kEmptyKey = 0;
+    static const size_t kClosedKey = 1;
+
+    // m_Object is nullptr while the object is being created and FailedObject() after a
+    // Create that returned nullptr, until the next caller claims the retry
+    struct Entry
+    {
+        std::atomic<size_t> m_Key;
+        std::atomic<T*> m_Object;
+    };
+
+    static T* FailedObject() { return reinterpret_cast<T*>(uintptr_t(1)); }
+
+    template <typename CreateFn>
+    T* CreateAndPublish(Entry& entry, CreateFn& Create)
+    {
+        T* Object = Create();
+        entry.m_Object.store(Object != nullptr ? Object : FailedObject(), std::memory_order_release);
+        WakeByAddressAll(&entry.m_Object);
+        return Object;
+    }
+
+    struct Table
+    {
+        explicit Table(uint32_t Capacity) : m_Capacity(Capacity), m_Entries(new Entry[Capacity]), m_Reserved(0), m_Next(nullptr)
+        {
+            for (uint32_t i = 0; i < Capacity; ++i)
+            {
+                m_Entries[i].m_Key.store(kEmptyKey, std::memory_order_relaxed);
+                m_Entries[i].m_Object.store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        ~Table() { delete[] m_Entries; }
+
+        const uint32_t m_Capacity;
+        Entry* const m_Entries;
+        std::atomic<uint32_t> m_Reserved;
+        std::atomic<Table*> m_Next;
+    };
+
+    Table* GetOrCreateNext(std::atomic<Table*>& Link, uint32_t Capacity)
+    {
+        Table* table = Link.load(std::memory_order_acquire);
+        if (table != nullptr)
+            return table;
+
+        Table* created = new Table(Capacity);
+        if (Link.compare_exchange_strong(table, created, std::memory_order_acq_rel, std::memory_order_acquire))
+            return created;
+
+        // Another thread linked its table first
+        delete created;
+        return table;
+    }
+
+    Entry& FindOrInsert(size_t HashCode, bool& Inserted)
+    {
+        const size_t Key = HashCode > kClosedKey ? HashCode : HashCode + 2;
+        const size_t Probe = HashCode >> kShardBits;
+
+        Table* table = GetOrCreateNext(m_Shards[HashCode & (kNumShards - 1)], kInitialCapacity);
+        for (;;)
+        {
+            const uint32_t Mask = table->m_Capacity - 1;
+            for (uint32_t n = 0; n < table->m_Capacity; ++n)
+            {
+                Entry& entry = table->m_Entries[(Probe + n) & Mask];
+                size_t Found = entry.m_Key.load(std::memory_order_acquire);
+
+                if (Found == kEmptyKey)
+                {
+                    // Keep tables at most half full so probe sequences stay short
+                    size_t Claim = kClosedKey;
+                    if (table->m_Reserved.fetch_add(1, std::memory_order_relaxed) < table->m_Capacity / 2)
+                        Claim = Key;
+                    else
+                        table->m_Reserved.fetch_sub(1, std::memory_order_relaxed);
+
+                    if (entry.m_Key.compare_exchange_strong(Found, Claim, std::memory_order_acq_rel, std::memory_order_acquire))
+                    {
+                        if (Claim == Key)
+                        {
+                            Inserted = true;
+                            return entry;
+                        }
+                        Found = kClosedKey;
+                    }
+                    else if (Claim == Key)
+                    {
+                        table->m_Reserved.fetch_sub(1, std::memory_order_relaxed);
+                    }
+                }
+
+                if (Found == Key)
+                {
+                    Inserted = false;
+                    return entry;
+                }
+
+                if (Found == kClosedKey)
+                    break;
+            }
+
+            // Not in this table and it takes no more entries for this key
+            table = GetOrCreateNext(table->m_Next, table->m_Capacity * 2);
+        }
+    }
+
+    std::atomic<Table*> m_Shards[kNumShards];
+};
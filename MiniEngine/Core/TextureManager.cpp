@@ -20,6 +20,11 @@
 #include "CommandContext.h"
 #include <map>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include <algorithm>
+#include <iterator>
 
 using namespace std;
 using namespace Graphics;
@@ -65,7 +70,10 @@ void Texture::Create( size_t Pitch, size_t Width, size_t Height, DXGI_FORMAT For
     CommandContext::InitializeTexture(*this, 1, &texResource);
 
     if (m_hCpuDescriptorHandle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
+    {
         m_hCpuDescriptorHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+        m_OwnsDescriptor = true;
+    }
     g_Device->CreateShaderResourceView(m_pResource.Get(), nullptr, m_hCpuDescriptorHandle);
 }
 
@@ -124,7 +132,10 @@ void Texture::CreateTGAFromMemory( const void* _filePtr, size_t, bool sRGB )
 bool Texture::CreateDDSFromMemory( const void* filePtr, size_t fileSize, bool sRGB )
 {
     if (m_hCpuDescriptorHandle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
+    {
         m_hCpuDescriptorHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+        m_OwnsDescriptor = true;
+    }
 
     HRESULT hr = CreateDDSTextureFromMemory( Graphics::g_Device,
         (const uint8_t*)filePtr, fileSize, 0, sRGB, &m_pResource, m_hCpuDescriptorHandle );
@@ -132,6 +143,15 @@ bool Texture::CreateDDSFromMemory( const void* filePtr, size_t fileSize, bool sR
     return SUCCEEDED(hr);
 }
 
+void Texture::Destroy()
+{
+    GpuResource::Destroy();
+    if (m_OwnsDescriptor)
+        FreeDescriptor(m_hCpuDescriptorHandle, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    m_OwnsDescriptor = false;
+    m_hCpuDescriptorHandle.ptr = 0;
+}
+
 void Texture::CreatePIXImageFromMemory( const void* memBuffer, size_t fileSize )
 {
     struct Header
@@ -154,17 +174,213 @@ namespace TextureManager
     wstring s_RootPath = L"";
     map< wstring, unique_ptr<ManagedTexture> > s_TextureCache;
 
-    void Initialize( const std::wstring& TextureLibRoot )
+    struct AsyncLoad
+    {
+        AsyncLoad( const wstring& FileName ) : Target(nullptr), Staging(FileName) {}
+
+        ManagedTexture* Target;
+        ManagedTexture Staging;     // Created on an I/O thread, then copied into Target when published
+        wstring DDSFile;            // Either may be empty.  The DDS file is tried first.
+        wstring TGAFile;
+        bool sRGB;
+        bool KeepPlaceholderOnFailure;
+        bool Succeeded;
+        LoadPriority Priority;
+        uint64_t Sequence;
+        size_t ReservedBytes;
+    };
+
+    // std::priority_queue pops the greatest element, so this orders loads that should start later first
+    struct LoadsLater
+    {
+        bool operator()( const AsyncLoad* A, const AsyncLoad* B ) const
+        {
+            if (A->Priority != B->Priority)
+                return A->Priority > B->Priority;
+            return A->Sequence > B->Sequence;
+        }
+    };
+
+    uint32_t s_NumIOThreads = 2;
+    size_t s_MaxBytesInFlight = 64 * 1024 * 1024;
+
+    mutex s_AsyncMutex;
+    condition_variable s_WorkAvailable;
+    condition_variable s_LoadFinished;
+    priority_queue<AsyncLoad*, vector<AsyncLoad*>, LoadsLater> s_QueuedLoads;
+    vector<AsyncLoad*> s_CompletedLoads;
+    vector< pair<const ManagedTexture*, LoadCallback> > s_PendingCallbacks;
+    vector<thread> s_IOThreads;
+    uint64_t s_NextSequence = 0;
+    size_t s_BytesInFlight = 0;
+    bool s_StopIOThreads = false;
+
+    const Texture& GetMagentaTex2D(void);
+
+    void Initialize( const std::wstring& TextureLibRoot, uint32_t NumIOThreads, size_t MaxBytesInFlight )
     {
         s_RootPath = TextureLibRoot;
+        s_NumIOThreads = NumIOThreads > 0 ? NumIOThreads : 1;
+        s_MaxBytesInFlight = MaxBytesInFlight;
+    }
+
+    void StopIOThreads( void )
+    {
+        {
+            lock_guard<mutex> Lock(s_AsyncMutex);
+            s_StopIOThreads = true;
+        }
+        s_WorkAvailable.notify_all();
+
+        for (auto& IOThread : s_IOThreads)
+            IOThread.join();
+        s_IOThreads.clear();
     }
 
     void Shutdown( void )
     {
+        StopIOThreads();
+
+        // Queued loads are dropped along with the textures
+        while (!s_QueuedLoads.empty())
+        {
+            delete s_QueuedLoads.top();
+            s_QueuedLoads.pop();
+        }
+        for (AsyncLoad* Load : s_CompletedLoads)
+            delete Load;
+        s_CompletedLoads.clear();
+        s_PendingCallbacks.clear();
+        s_BytesInFlight = 0;
+
         s_TextureCache.clear();
     }
 
-    pair<ManagedTexture*, bool> FindOrLoadTexture( const wstring& fileName )
+    // Compressed files are charged at their size on disk
+    size_t FileSizeOnDisk( const wstring& fileName )
+    {
+        struct _stat64 fileStat;
+        if (_wstat64((fileName + L".gz").c_str(), &fileStat) == 0 || _wstat64(fileName.c_str(), &fileStat) == 0)
+            return (size_t)fileStat.st_size;
+        return 0;
+    }
+
+    bool ExecuteLoad( AsyncLoad& Load )
+    {
+        if (!Load.DDSFile.empty())
+        {
+            Utility::ByteArray ba = Utility::ReadFileSync( s_RootPath + Load.DDSFile );
+            if (ba->size() > 0 && Load.Staging.CreateDDSFromMemory( ba->data(), ba->size(), Load.sRGB ))
+            {
+                Load.Staging.GetResource()->SetName(Load.DDSFile.c_str());
+                return true;
+            }
+        }
+
+        if (!Load.TGAFile.empty())
+        {
+            Utility::ByteArray ba = Utility::ReadFileSync( s_RootPath + Load.TGAFile );
+            if (ba->size() > 0)
+            {
+                Load.Staging.CreateTGAFromMemory( ba->data(), ba->size(), Load.sRGB );
+                Load.Staging.GetResource()->SetName(Load.TGAFile.c_str());
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void IOThreadMain( void )
+    {
+        while (true)
+        {
+            AsyncLoad* Load;
+            {
+                unique_lock<mutex> Lock(s_AsyncMutex);
+                s_WorkAvailable.wait(Lock, []
+                {
+                    if (s_StopIOThreads)
+                        return true;
+                    if (s_QueuedLoads.empty())
+                        return false;
+                    return s_BytesInFlight == 0 || s_BytesInFlight + s_QueuedLoads.top()->ReservedBytes <= s_MaxBytesInFlight;
+                });
+
+                if (s_StopIOThreads)
+                    return;
+
+                Load = s_QueuedLoads.top();
+                s_QueuedLoads.pop();
+                s_BytesInFlight += Load->ReservedBytes;
+            }
+
+            Load->Succeeded = ExecuteLoad(*Load);
+
+            {
+                lock_guard<mutex> Lock(s_AsyncMutex);
+                s_BytesInFlight -= Load->ReservedBytes;
+                s_CompletedLoads.push_back(Load);
+            }
+            s_WorkAvailable.notify_all();
+            s_LoadFinished.notify_all();
+        }
+    }
+
+    // Publishes an asynchronous load ahead of Update() so that WaitForLoad() can return a loaded texture
+    void FinishAsyncLoad( const ManagedTexture& ManTex )
+    {
+        unique_lock<mutex> Lock(s_AsyncMutex);
+
+        while (!ManTex.IsLoaded())
+        {
+            auto iter = find_if(s_CompletedLoads.begin(), s_CompletedLoads.end(),
+                [&ManTex]( const AsyncLoad* Load ) { return Load->Target == &ManTex; });
+
+            if (iter == s_CompletedLoads.end())
+            {
+                s_LoadFinished.wait(Lock);
+                continue;
+            }
+
+            AsyncLoad* Load = *iter;
+            s_CompletedLoads.erase(iter);
+            Load->Target->CompleteAsyncLoad(Load->Staging, Load->Succeeded, Load->KeepPlaceholderOnFailure);
+            delete Load;
+        }
+    }
+
+    void Update( void )
+    {
+        vector< pair<const ManagedTexture*, LoadCallback> > ReadyCallbacks;
+
+        {
+            lock_guard<mutex> Lock(s_AsyncMutex);
+
+            if (!s_CompletedLoads.empty())
+            {
+                for (AsyncLoad* Load : s_CompletedLoads)
+                {
+                    Load->Target->CompleteAsyncLoad(Load->Staging, Load->Succeeded, Load->KeepPlaceholderOnFailure);
+                    delete Load;
+                }
+                s_CompletedLoads.clear();
+                s_LoadFinished.notify_all();
+            }
+
+            auto FirstReady = stable_partition(s_PendingCallbacks.begin(), s_PendingCallbacks.end(),
+                []( const pair<const ManagedTexture*, LoadCallback>& Callback ) { return !Callback.first->IsLoaded(); });
+            move(FirstReady, s_PendingCallbacks.end(), back_inserter(ReadyCallbacks));
+            s_PendingCallbacks.erase(FirstReady, s_PendingCallbacks.end());
+        }
+
+        // Run without the lock so that callbacks may request more textures
+        for (auto& Callback : ReadyCallbacks)
+            Callback.second(*Callback.first);
+    }
+
+    pair<ManagedTexture*, bool> FindOrLoadTexture( const wstring& fileName,
+        const Texture* AsyncPlaceholder = nullptr, ManagedTexture* AsyncStaging = nullptr )
     {
         static mutex s_Mutex;
         lock_guard<mutex> Guard(s_Mutex);
@@ -178,6 +394,10 @@ namespace TextureManager
         ManagedTexture* NewTexture = new ManagedTexture(fileName);
         s_TextureCache[fileName].reset( NewTexture );
 
+        // An asynchronous load shows its placeholder before any other thread can find the texture
+        if (AsyncPlaceholder != nullptr)
+            NewTexture->BeginAsyncLoad(*AsyncPlaceholder, *AsyncStaging);
+
         // This was the first time it was requested, so indicate that the caller must read the file
         return make_pair(NewTexture, true);
     }
@@ -200,6 +420,63 @@ namespace TextureManager
         return *ManTex;
     }
 
+    const ManagedTexture* RequestAsyncLoad( const wstring& fileName, const wstring& DDSFile, const wstring& TGAFile,
+        bool sRGB, LoadPriority Priority, const Texture* Placeholder, LoadCallback Callback )
+    {
+        AsyncLoad* Load = new AsyncLoad(fileName);
+
+        auto ManagedTex = FindOrLoadTexture(fileName, Placeholder != nullptr ? Placeholder : &GetBlackTex2D(), &Load->Staging);
+
+        ManagedTexture* ManTex = ManagedTex.first;
+        const bool RequestsLoad = ManagedTex.second;
+
+        if (!RequestsLoad)
+        {
+            delete Load;
+            Load = nullptr;
+
+            // Another thread may still be loading it synchronously
+            if (ManTex->IsLoaded())
+                ManTex->WaitForLoad();
+        }
+        else
+        {
+            Load->Target = ManTex;
+            Load->DDSFile = DDSFile;
+            Load->TGAFile = TGAFile;
+            Load->sRGB = sRGB;
+            Load->KeepPlaceholderOnFailure = Placeholder != nullptr;
+            Load->Succeeded = false;
+            Load->Priority = Priority;
+            Load->ReservedBytes = DDSFile.empty() ? 0 : FileSizeOnDisk(s_RootPath + DDSFile);
+            if (Load->ReservedBytes == 0 && !TGAFile.empty())
+                Load->ReservedBytes = FileSizeOnDisk(s_RootPath + TGAFile);
+        }
+
+        {
+            lock_guard<mutex> Lock(s_AsyncMutex);
+
+            if (Callback)
+                s_PendingCallbacks.emplace_back(ManTex, move(Callback));
+
+            if (Load != nullptr)
+            {
+                Load->Sequence = s_NextSequence++;
+                s_QueuedLoads.push(Load);
+
+                if (s_IOThreads.empty())
+                {
+                    s_StopIOThreads = false;
+                    for (uint32_t i = 0; i < s_NumIOThreads; ++i)
+                        s_IOThreads.emplace_back(IOThreadMain);
+                }
+            }
+        }
+        s_WorkAvailable.notify_one();
+
+        return ManTex;
+    }
+
     const Texture& GetWhiteTex2D(void)
     {
         auto ManagedTex = FindOrLoadTexture(L"DefaultWhiteTexture");
@@ -244,10 +521,53 @@ void ManagedTexture::WaitForLoad( void ) const
     volatile bool& VolValid = (volatile bool&)m_IsValid;
     while (VolHandle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN && VolValid)
         this_thread::yield();
+
+    if (!IsLoaded())
+        TextureManager::FinishAsyncLoad(*this);
+}
+
+void ManagedTexture::BeginAsyncLoad( const Texture& Placeholder, ManagedTexture& Staging )
+{
+    m_AsyncLoadPending = true;
+
+    m_hCpuDescriptorHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    m_OwnsDescriptor = true;
+    g_Device->CopyDescriptorsSimple(1, m_hCpuDescriptorHandle, Placeholder.GetSRV(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+    // Allocated here rather than on the I/O thread, and freed once the load is published
+    Staging.m_hCpuDescriptorHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    Staging.m_OwnsDescriptor = true;
+}
+
+void ManagedTexture::CompleteAsyncLoad( ManagedTexture& Staging, bool Succeeded, bool KeepPlaceholderOnFailure )
+{
+    if (Succeeded)
+    {
+        m_pResource = Staging.m_pResource;
+        m_UsageState = Staging.m_UsageState;
+        g_Device->CopyDescriptorsSimple(1, m_hCpuDescriptorHandle, Staging.m_hCpuDescriptorHandle, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    }
+    else
+    {
+        if (!KeepPlaceholderOnFailure)
+        {
+            g_Device->CopyDescriptorsSimple(1, m_hCpuDescriptorHandle, TextureManager::GetMagentaTex2D().GetSRV(),
+                D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+        }
+        m_IsValid = false;
+    }
+
+    // The resource is shared with this texture now, and only the staging descriptor is released
+    Staging.Destroy();
+
+    m_AsyncLoadPending = false;
 }
 
 void ManagedTexture::SetToInvalidTexture( void )
 {
+    if (m_OwnsDescriptor)
+        FreeDescriptor(m_hCpuDescriptorHandle, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    m_OwnsDescriptor = false;
     m_hCpuDescriptorHandle = TextureManager::GetMagentaTex2D().GetSRV();
     m_IsValid = false;
 }
@@ -263,6 +583,25 @@ const ManagedTexture* TextureManager::LoadFromFile( const std::wstring& fileName
     return Tex;
 }
 
+const ManagedTexture* TextureManager::LoadFromFileAsync( const std::wstring& fileName, bool sRGB,
+    LoadPriority Priority, const Texture* Placeholder, LoadCallback Callback )
+{
+    // Cached under the DDS name, as LoadFromFile() would find it, even when the TGA file is the one loaded
+    return RequestAsyncLoad( fileName + L".dds", fileName + L".dds", fileName + L".tga", sRGB, Priority, Placeholder, Callback );
+}
+
+const ManagedTexture* TextureManager::LoadDDSFromFileAsync( const std::wstring& fileName, bool sRGB,
+    LoadPriority Priority, const Texture* Placeholder, LoadCallback Callback )
+{
+    return RequestAsyncLoad( fileName, fileName, L"", sRGB, Priority, Placeholder, Callback );
+}
+
+const ManagedTexture* TextureManager::LoadTGAFromFileAsync( const std::wstring& fileName, bool sRGB,
+    LoadPriority Priority, const Texture* Placeholder, LoadCallback Callback )
+{
+    return RequestAsyncLoad( fileName, L"", fileName, sRGB, Priority, Placeholder, Callback );
+}
+
 const ManagedTexture* TextureManager::LoadDDSFromFile( const std::wstring& fileName, bool sRGB )
 {
     auto ManagedTex = FindOrLoadTexture(fileName);
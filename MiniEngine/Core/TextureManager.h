@@ -17,6 +17,8 @@
 #include "pch.h"
 #include "GpuResource.h"
 #include "Utility.h"
+#include <atomic>
+#include <functional>
 
 class Texture : public GpuResource
 {
@@ -24,8 +26,8 @@ class Texture : public GpuResource
 
 public:
 
-    Texture() { m_hCpuDescriptorHandle.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN; }
-    Texture(D3D12_CPU_DESCRIPTOR_HANDLE Handle) : m_hCpuDescriptorHandle(Handle) {}
+    Texture() : m_OwnsDescriptor(false) { m_hCpuDescriptorHandle.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN; }
+    Texture(D3D12_CPU_DESCRIPTOR_HANDLE Handle) : m_hCpuDescriptorHandle(Handle), m_OwnsDescriptor(false) {}
 
     // Create a 1-level 2D texture
     void Create(size_t Pitch, size_t Width, size_t Height, DXGI_FORMAT Format, const void* InitData );
@@ -38,12 +40,8 @@ public:
     bool CreateDDSFromMemory( const void* memBuffer, size_t fileSize, bool sRGB );
     void CreatePIXImageFromMemory( const void* memBuffer, size_t fileSize );
 
-    virtual void Destroy() override
-    {
-        GpuResource::Destroy();
-        // This leaks descriptor handles.  We should really give it back to be reused.
-        m_hCpuDescriptorHandle.ptr = 0;
-    }
+    // Returns the SRV to the descriptor allocator unless it was handed in by the caller
+    virtual void Destroy() override;
 
     const D3D12_CPU_DESCRIPTOR_HANDLE& GetSRV() const { return m_hCpuDescriptorHandle; }
 
@@ -52,12 +50,13 @@ public:
 protected:
 
     D3D12_CPU_DESCRIPTOR_HANDLE m_hCpuDescriptorHandle;
+    bool m_OwnsDescriptor;
 };
 
 class ManagedTexture : public Texture
 {
 public:
-    ManagedTexture( const std::wstring& FileName ) : m_MapKey(FileName), m_IsValid(true) {}
+    ManagedTexture( const std::wstring& FileName ) : m_MapKey(FileName), m_IsValid(true), m_AsyncLoadPending(false) {}
 
     void operator= ( const Texture& Texture );
 
@@ -67,16 +66,36 @@ public:
     void SetToInvalidTexture(void);
     bool IsValid(void) const { return m_IsValid; }
 
+    // Does not block.  False while an asynchronous load is queued or has not yet been published by
+    // TextureManager::Update().  Until then the SRV shows the placeholder texture.
+    bool IsLoaded(void) const { return !m_AsyncLoadPending; }
+
+    // Used by the asynchronous loader.  The SRV descriptor is allocated up front and keeps its address, so
+    // handles copied while the load is pending pick up the real texture once it is published.
+    void BeginAsyncLoad( const Texture& Placeholder, ManagedTexture& Staging );
+    void CompleteAsyncLoad( ManagedTexture& Staging, bool Succeeded, bool KeepPlaceholderOnFailure );
+
 private:
     std::wstring m_MapKey;        // For deleting from the map later
     bool m_IsValid;
+    std::atomic<bool> m_AsyncLoadPending;
 };
 
 namespace TextureManager
 {
-    void Initialize( const std::wstring& TextureLibRoot );
+    // The I/O threads are started on the first asynchronous request.  MaxBytesInFlight bounds the file data
+    // being read, decoded and uploaded at once; a single larger file is still loaded when nothing else is.
+    void Initialize( const std::wstring& TextureLibRoot, uint32_t NumIOThreads = 2, size_t MaxBytesInFlight = 64 * 1024 * 1024 );
     void Shutdown(void);
 
+    // Waits for the loads in flight and stops the I/O threads, which must not submit GPU work once the device
+    // is idled for shutdown.  Loads still queued are dropped by Shutdown().
+    void StopIOThreads(void);
+
+    // Publishes finished asynchronous loads and runs their callbacks.  Called once per frame by GameCore
+    // before the application's Update().
+    void Update(void);
+
     const ManagedTexture* LoadFromFile( const std::wstring& fileName, bool sRGB = false );
     const ManagedTexture* LoadDDSFromFile( const std::wstring& fileName, bool sRGB = false );
     const ManagedTexture* LoadTGAFromFile( const std::wstring& fileName, bool sRGB = false );
@@ -102,6 +121,40 @@ namespace TextureManager
         return LoadPIXImageFromFile(MakeWStr(fileName));
     }
 
+    enum LoadPriority { kLoadPriorityHigh, kLoadPriorityNormal, kLoadPriorityLow };
+
+    typedef std::function<void (const ManagedTexture&)> LoadCallback;
+
+    // These return immediately.  Reading, decompressing and parsing happen on the I/O threads in priority
+    // order (first come, first served within a priority).  The texture shows Placeholder (black when null)
+    // until the load is published; if it fails, it keeps showing Placeholder, or magenta when none was given,
+    // and IsValid() returns false.  Callback runs on the thread calling Update() once IsLoaded() is true,
+    // including when the file was already loaded or requested.
+    const ManagedTexture* LoadFromFileAsync( const std::wstring& fileName, bool sRGB = false,
+        LoadPriority Priority = kLoadPriorityNormal, const Texture* Placeholder = nullptr, LoadCallback Callback = nullptr );
+    const ManagedTexture* LoadDDSFromFileAsync( const std::wstring& fileName, bool sRGB = false,
+        LoadPriority Priority = kLoadPriorityNormal, const Texture* Placeholder = nullptr, LoadCallback Callback = nullptr );
+    const ManagedTexture* LoadTGAFromFileAsync( const std::wstring& fileName, bool sRGB = false,
+        LoadPriority Priority = kLoadPriorityNormal, const Texture* Placeholder = nullptr, LoadCallback Callback = nullptr );
+
+    inline const ManagedTexture* LoadFromFileAsync( const std::string& fileName, bool sRGB = false,
+        LoadPriority Priority = kLoadPriorityNormal, const Texture* Placeholder = nullptr, LoadCallback Callback = nullptr )
+    {
+        return LoadFromFileAsync(MakeWStr(fileName), sRGB, Priority, Placeholder, Callback);
+    }
+
+    inline const ManagedTexture* LoadDDSFromFileAsync( const std::string& fileName, bool sRGB = false,
+        LoadPriority Priority = kLoadPriorityNormal, const Texture* Placeholder = nullptr, LoadCallback Callback = nullptr )
+    {
+        return LoadDDSFromFileAsync(MakeWStr(fileName), sRGB, Priority, Placeholder, Callback);
+    }
+
+    inline const ManagedTexture* LoadTGAFromFileAsync( const std::string& fileName, bool sRGB = false,
+        LoadPriority Priority = kLoadPriorityNormal, const Texture* Placeholder = nullptr, LoadCallback Callback = nullptr )
+    {
+        return LoadTGAFromFileAsync(MakeWStr(fileName), sRGB, Priority, Placeholder, Callback);
+    }
+
     const Texture& GetBlackTex2D(void);
     const Texture& GetWhiteTex2D(void);
 }
@@ -0,0 +1,350 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "BuddyAllocatorTest.h"
+#include "BuddyAllocatorCore.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // The std::set based free lists BuddyAllocator used before BuddyAllocatorCore
+    class SetBuddyAllocator
+    {
+    public:
+        SetBuddyAllocator(uint32_t maxOrder) : m_maxOrder(maxOrder), m_freeBlocks(maxOrder + 1)
+        {
+            m_freeBlocks[m_maxOrder].insert((size_t)0);
+        }
+
+        size_t Allocate(uint32_t order)
+        {
+            if (order > m_maxOrder)
+                return BuddyAllocatorCore::kInvalidOffset;
+
+            auto it = m_freeBlocks[order].begin();
+            if (it == m_freeBlocks[order].end())
+            {
+                size_t left = Allocate(order + 1);
+                if (left != BuddyAllocatorCore::kInvalidOffset)
+                    m_freeBlocks[order].insert(left + ((size_t)1 << order));
+                return left;
+            }
+
+            size_t offset = *it;
+            m_freeBlocks[order].erase(it);
+            return offset;
+        }
+
+        void Deallocate(size_t offset, uint32_t order)
+        {
+            size_t buddy = offset ^ ((size_t)1 << order);
+            auto it = order < m_maxOrder ? m_freeBlocks[order].find(buddy) : m_freeBlocks[order].end();
+            if (it != m_freeBlocks[order].end())
+            {
+                m_freeBlocks[order].erase(it);
+                Deallocate(std::min(offset, buddy), order + 1);
+            }
+            else
+            {
+                m_freeBlocks[order].insert(offset);
+            }
+        }
+
+    private:
+        uint32_t m_maxOrder;
+        std::vector<std::set<size_t>> m_freeBlocks;
+    };
+
+    struct LiveBlock
+    {
+        size_t offset;
+        uint32_t order;
+    };
+
+    // Mostly minimum size blocks, like the placed buffers BuddyAllocator serves
+    uint32_t RandomOrder(std::mt19937& rng, uint32_t maxOrder)
+    {
+        uint32_t roll = rng() % 16;
+        if (roll < 10)
+            return 0;
+        if (roll < 15)
+            return std::min(1 + roll % 4, maxOrder);
+        return rng() % (maxOrder + 1);
+    }
+
+    bool CheckFullyMerged(BuddyAllocatorCore& allocator)
+    {
+        allocator.FlushCache();
+        if (!allocator.Validate())
+            return false;
+
+        size_t offset = allocator.Allocate(allocator.GetMaxOrder());
+        if (offset != 0)
+            return false;
+        allocator.Deallocate(offset, allocator.GetMaxOrder());
+        return true;
+    }
+
+    int CompareWithSetAllocator(uint32_t seed)
+    {
+        const uint32_t maxOrder = 12;
+        BuddyAllocatorCore allocator(maxOrder);
+        SetBuddyAllocator reference(maxOrder);
+        std::mt19937 rng(seed);
+        std::vector<LiveBlock> live;
+
+        for (uint32_t i = 0; i < 200000; ++i)
+        {
+            if (!live.empty() && (rng() % 2) == 0)
+            {
+                size_t index = rng() % live.size();
+                allocator.Deallocate(live[index].offset, live[index].order);
+                reference.Deallocate(live[index].offset, live[index].order);
+                live[index] = live.back();
+                live.pop_back();
+            }
+            else
+            {
+                uint32_t order = RandomOrder(rng, maxOrder);
+                size_t offset = allocator.Allocate(order);
+                if (offset != reference.Allocate(order))
+                {
+                    printf("operation %u: order %u allocation differs from the std::set allocator\n", i, order);
+                    return -1;
+                }
+                if (offset != BuddyAllocatorCore::kInvalidOffset)
+                    live.push_back({ offset, order });
+            }
+
+            if ((i % 4096) == 0 && !allocator.Validate())
+            {
+                printf("operation %u: bitmaps are inconsistent\n", i);
+                return -1;
+            }
+        }
+
+        for (const LiveBlock& block : live)
+            allocator.Deallocate(block.offset, block.order);
+
+        return CheckFullyMerged(allocator) ? 0 : -1;
+    }
+
+    int FuzzConcurrent(uint32_t seed, uint32_t numThreads)
+    {
+        const uint32_t maxOrder = 14;
+        const size_t numUnits = (size_t)1 << maxOrder;
+        BuddyAllocatorCore allocator(maxOrder, 0, 32);
+        std::vector<std::atomic<uint32_t>> owners(numUnits);
+        std::atomic<bool> failed(false);
+
+        auto worker = [&](uint32_t threadIndex)
+        {
+            std::mt19937 rng(seed + threadIndex);
+            std::vector<LiveBlock> live;
+
+            for (uint32_t i = 0; i < 100000 && !failed; ++i)
+            {
+                if (!live.empty() && (rng() % 2) == 0)
+                {
+                    size_t index = rng() % live.size();
+                    const LiveBlock block = live[index];
+                    for (size_t unit = block.offset; unit < block.offset + ((size_t)1 << block.order); ++unit)
+                        owners[unit].store(0, std::memory_order_relaxed);
+                    allocator.Deallocate(block.offset, block.order);
+                    live[index] = live.back();
+                    live.pop_back();
+                    continue;
+                }
+
+                uint32_t order = RandomOrder(rng, maxOrder);
+                size_t offset = allocator.Allocate(order);
+                if (offset == BuddyAllocatorCore::kInvalidOffset)
+                    continue;
+
+                if ((offset & (((size_t)1 << order) - 1)) != 0 || offset + ((size_t)1 << order) > numUnits)
+                {
+                    printf("thread %u: misaligned or out of range block\n", threadIndex);
+                    failed = true;
+                    break;
+                }
+
+                for (size_t unit = offset; unit < offset + ((size_t)1 << order); ++unit)
+                {
+                    if (owners[unit].exchange(threadIndex + 1, std::memory_order_relaxed) != 0)
+                    {
+                        printf("thread %u: unit %zu handed out twice\n", threadIndex, unit);
+                        failed = true;
+                        break;
+                    }
+                }
+                live.push_back({ offset, order });
+            }
+
+            for (const LiveBlock& block : live)
+            {
+                for (size_t unit = block.offset; unit < block.offset + ((size_t)1 << block.order); ++unit)
+                    owners[unit].store(0, std::memory_order_relaxed);
+                allocator.Deallocate(block.offset, block.order);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < numThreads; ++t)
+            threads.emplace_back(worker, t);
+        for (std::thread& thread : threads)
+            thread.join();
+
+        if (failed)
+            return -1;
+        if (allocator.GetFreeUnitCount() != numUnits || !CheckFullyMerged(allocator))
+        {
+            printf("blocks were lost after concurrent use\n");
+            return -1;
+        }
+        return 0;
+    }
+
+    // Steady state churn: keep about 'liveTarget' blocks allocated, freeing a random one
+    // for every allocation.  Returns allocations per second.
+    template <typename Allocator, typename Lock>
+    double MeasureChurn(Allocator& allocator, Lock& lock, uint32_t seed, uint32_t maxOrder, uint32_t liveTarget, uint32_t numAllocations)
+    {
+        typedef std::chrono::high_resolution_clock Clock;
+        std::mt19937 rng(seed);
+        std::vector<uint32_t> orders(numAllocations);
+        for (uint32_t& order : orders)
+            order = RandomOrder(rng, maxOrder / 2);
+
+        std::vector<LiveBlock> live;
+        live.reserve(liveTarget + 1);
+
+        Clock::time_point start = Clock::now();
+        for (uint32_t i = 0; i < numAllocations; ++i)
+        {
+            if (live.size() >= liveTarget)
+            {
+                size_t index = rng() % live.size();
+                {
+                    std::lock_guard<Lock> guard(lock);
+                    allocator.Deallocate(live[index].offset, live[index].order);
+                }
+                live[index] = live.back();
+                live.pop_back();
+            }
+
+            size_t offset;
+            {
+                std::lock_guard<Lock> guard(lock);
+                offset = allocator.Allocate(orders[i]);
+            }
+            if (offset != BuddyAllocatorCore::kInvalidOffset)
+                live.push_back({ offset, orders[i] });
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        for (const LiveBlock& block : live)
+        {
+            std::lock_guard<Lock> guard(lock);
+            allocator.Deallocate(block.offset, block.order);
+        }
+        return numAllocations / seconds;
+    }
+
+    // BuddyAllocatorCore locks internally, so callers don't need to
+    struct NoLock
+    {
+        void lock() {}
+        void unlock() {}
+    };
+
+    template <typename Allocator, typename Lock>
+    double MeasureContendedChurn(Allocator& allocator, Lock& lock, uint32_t numThreads, uint32_t maxOrder, uint32_t numAllocationsPerThread)
+    {
+        std::vector<double> rates(numThreads);
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < numThreads; ++t)
+        {
+            threads.emplace_back([&, t]()
+            {
+                rates[t] = MeasureChurn(allocator, lock, 100 + t, maxOrder, 256, numAllocationsPerThread);
+            });
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+
+        double total = 0.0;
+        for (double rate : rates)
+            total += rate;
+        return total;
+    }
+}
+
+int TestBuddyAllocator(uint32_t seed)
+{
+    printf("buddy allocator test (seed %u)\n", seed);
+
+    if (CompareWithSetAllocator(seed) != 0)
+        return -1;
+    printf("  matches std::set allocator: ok\n");
+
+    uint32_t numThreads = std::max(std::thread::hardware_concurrency(), 4u);
+    if (FuzzConcurrent(seed, numThreads) != 0)
+        return -1;
+    printf("  concurrent fuzz on %u threads: ok\n", numThreads);
+
+    return 0;
+}
+
+int BenchmarkBuddyAllocator()
+{
+    const uint32_t maxOrder = 16;
+    const uint32_t numAllocations = 2000000;
+    const uint32_t numThreads = std::max(std::thread::hardware_concurrency(), 2u);
+
+    printf("buddy allocator benchmark (2^%u units, mostly minimum size blocks)\n", maxOrder);
+    printf("%-28s %16s %16s\n", "", "std::set", "bitmap");
+
+    std::mutex mutex;
+    NoLock noLock;
+
+    {
+        SetBuddyAllocator reference(maxOrder);
+        BuddyAllocatorCore allocator(maxOrder);
+        BuddyAllocatorCore fastAllocator(maxOrder, 0);
+        double setRate = MeasureChurn(reference, mutex, 1, maxOrder, 4096, numAllocations);
+        double bitmapRate = MeasureChurn(allocator, noLock, 1, maxOrder, 4096, numAllocations);
+        double fastRate = MeasureChurn(fastAllocator, noLock, 1, maxOrder, 4096, numAllocations);
+        printf("%-28s %13.2f M/s %13.2f M/s\n", "1 thread", setRate / 1e6, bitmapRate / 1e6);
+        printf("%-28s %16s %13.2f M/s\n", "1 thread, order 0 cache", "", fastRate / 1e6);
+    }
+
+    {
+        SetBuddyAllocator reference(maxOrder);
+        BuddyAllocatorCore fastAllocator(maxOrder, 0);
+        double setRate = MeasureContendedChurn(reference, mutex, numThreads, maxOrder, numAllocations / numThreads);
+        double fastRate = MeasureContendedChurn(fastAllocator, noLock, numThreads, maxOrder, numAllocations / numThreads);
+
+        char label[64];
+        sprintf_s(label, "%u threads, order 0 cache", numThreads);
+        printf("%-28s %13.2f M/s %13.2f M/s\n", label, setRate / 1e6, fastRate / 1e6);
+    }
+
+    return 0;
+}
@@ -0,0 +1,31 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#pragma once
+
+#include <stdint.h>
+
+//-----------------------------------------------------------------------------
+//  BuddyAllocatorCore checks
+//-----------------------------------------------------------------------------
+//  TestBuddyAllocator runs random allocate/free sequences against the bitmap
+//  allocator.  Without a fast order it must hand out exactly the offsets the
+//  std::set implementation it replaced would; with one, a shadow ownership
+//  map catches overlapping blocks, including from several threads at once.
+//  Returns 0 on success.
+//
+//  BenchmarkBuddyAllocator prints allocations per second for the std::set
+//  implementation and the bitmap allocator, single threaded and contended.
+//-----------------------------------------------------------------------------
+
+int TestBuddyAllocator(uint32_t seed);
+
+int BenchmarkBuddyAllocator();
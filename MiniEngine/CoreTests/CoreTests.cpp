@@ -0,0 +1,88 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// Checks and benchmarks for the parts of Core that don't need a device or a
+// window.  Each one links against Core_VS15 and prints its own report.
+
+#include "BuddyAllocatorTest.h"
+#include "DescriptorAllocatorTest.h"
+#include "InflateBenchmark.h"
+#include "RecycleQueueBenchmark.h"
+#include "RootSignatureHashTest.h"
+#include "StateObjectCacheBenchmark.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+void PrintHelp()
+{
+    printf("usage:\n");
+    printf("CoreTests -test_buddy_allocator [seed]\n");
+    printf("CoreTests -benchmark_buddy_allocator\n");
+    printf("CoreTests -test_descriptor_allocator [seed]\n");
+    printf("CoreTests -benchmark_descriptor_allocator\n");
+    printf("CoreTests -test_root_signature_hash\n");
+    printf("CoreTests -benchmark_state_cache [compile_microseconds]\n");
+    printf("CoreTests -benchmark_inflate file.gz [iterations]\n");
+    printf("CoreTests -benchmark_recycle_queue [threads]\n");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        PrintHelp();
+        return -1;
+    }
+
+    if (0 == strcmp(argv[1], "-test_buddy_allocator"))
+    {
+        return TestBuddyAllocator(argc > 2 ? (uint32_t)atoi(argv[2]) : 1);
+    }
+    else if (0 == strcmp(argv[1], "-benchmark_buddy_allocator"))
+    {
+        return BenchmarkBuddyAllocator();
+    }
+    else if (0 == strcmp(argv[1], "-test_descriptor_allocator"))
+    {
+        return TestDescriptorAllocator(argc > 2 ? (uint32_t)atoi(argv[2]) : 1);
+    }
+    else if (0 == strcmp(argv[1], "-benchmark_descriptor_allocator"))
+    {
+        return BenchmarkDescriptorAllocator();
+    }
+    else if (0 == strcmp(argv[1], "-test_root_signature_hash"))
+    {
+        return TestRootSignatureHash();
+    }
+    else if (0 == strcmp(argv[1], "-benchmark_state_cache"))
+    {
+        return BenchmarkStateObjectCache(argc > 2 ? (uint32_t)atoi(argv[2]) : 100);
+    }
+    else if (0 == strcmp(argv[1], "-benchmark_inflate") && argc > 2)
+    {
+        return BenchmarkInflate(argv[2], argc > 3 ? (uint32_t)atoi(argv[3]) : 10);
+    }
+    else if (0 == strcmp(argv[1], "-benchmark_inflate_pass") && argc > 4)
+    {
+        // Re-entry point of the child processes BenchmarkInflate starts; not listed in the help
+        return RunInflateBenchmarkPass(argv[2], (uint32_t)atoi(argv[3]), argv[4]);
+    }
+    else if (0 == strcmp(argv[1], "-benchmark_recycle_queue"))
+    {
+        return BenchmarkRecycleQueue(argc > 2 ? (uint32_t)atoi(argv[2]) : std::thread::hardware_concurrency());
+    }
+
+    PrintHelp();
+    return -1;
+}
@@ -0,0 +1,396 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "DescriptorAllocatorTest.h"
+#include "DescriptorAllocatorCore.h"
+#include "FakeFence.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const uint32_t kDescriptorsPerHeap = 256;
+
+    struct LiveRange
+    {
+        uint32_t index;
+        uint32_t count;
+    };
+
+    uint32_t RoundedSize(uint32_t count)
+    {
+        uint32_t size = 1;
+        while (size < count)
+            size <<= 1;
+        return size;
+    }
+
+    // Mostly single SRVs, with the occasional descriptor table
+    uint32_t RandomCount(std::mt19937& rng)
+    {
+        uint32_t roll = rng() % 16;
+        if (roll < 11)
+            return 1;
+        if (roll < 15)
+            return 2 + rng() % 15;
+        return 1 + rng() % kDescriptorsPerHeap;
+    }
+
+    bool CheckStats(DescriptorAllocatorCore& allocator, uint32_t expectedAllocated, uint32_t operation)
+    {
+        DescriptorAllocatorCore::Stats stats = allocator.GetStats();
+        uint32_t accounted = stats.allocated + stats.pendingRelease + stats.freeListed + stats.threadCached + stats.untouched;
+        if (stats.capacity != stats.heapCount * kDescriptorsPerHeap || accounted != stats.capacity)
+        {
+            printf("operation %u: statistics account for %u of %u descriptors\n", operation, accounted, stats.capacity);
+            return false;
+        }
+        if (stats.allocated != expectedAllocated)
+        {
+            printf("operation %u: %u descriptors reported allocated, expected %u\n", operation, stats.allocated, expectedAllocated);
+            return false;
+        }
+        return true;
+    }
+
+    int FuzzSingleThreaded(uint32_t seed)
+    {
+        const uint32_t maxHeapCount = 256;
+        const uint64_t kFree = 0;
+        const uint64_t kAllocated = ~0ull;
+
+        FakeFence fence;
+        uint32_t heapsCreated = 0;
+        bool heapOrderBroken = false;
+        DescriptorAllocatorCore allocator(kDescriptorsPerHeap, maxHeapCount,
+            [&](uint64_t fenceValue) { return fence.IsComplete(fenceValue); },
+            [&](uint32_t heapIndex) { heapOrderBroken |= heapIndex != heapsCreated++; });
+
+        // Per index: kFree, kAllocated, or the fence value it was freed with
+        std::vector<uint64_t> state(maxHeapCount * kDescriptorsPerHeap, kFree);
+        std::vector<LiveRange> live;
+        uint32_t allocatedCount = 0;
+        std::mt19937 rng(seed);
+
+        for (uint32_t i = 0; i < 200000; ++i)
+        {
+            uint32_t roll = rng() % 64;
+            if (roll == 0)
+            {
+                fence.CompleteAll();
+            }
+            else if (!live.empty() && (roll % 2 == 0 || live.size() > 2000))
+            {
+                size_t liveIndex = rng() % live.size();
+                const LiveRange range = live[liveIndex];
+                uint64_t fenceValue = fence.Signal();
+                for (uint32_t d = range.index; d < range.index + RoundedSize(range.count); ++d)
+                    state[d] = fenceValue;
+
+                allocator.Free(range.index, range.count, fenceValue);
+                allocatedCount -= RoundedSize(range.count);
+                live[liveIndex] = live.back();
+                live.pop_back();
+            }
+            else
+            {
+                uint32_t count = RandomCount(rng);
+                uint32_t index = allocator.Allocate(count);
+                if (index == DescriptorAllocatorCore::kInvalidIndex)
+                {
+                    printf("operation %u: out of space with %u descriptors live\n", i, allocatedCount);
+                    return -1;
+                }
+
+                uint32_t size = RoundedSize(count);
+                if (index / kDescriptorsPerHeap != (index + size - 1) / kDescriptorsPerHeap || index + size > heapsCreated * kDescriptorsPerHeap)
+                {
+                    printf("operation %u: range [%u, %u) is not inside one created heap\n", i, index, index + size);
+                    return -1;
+                }
+
+                for (uint32_t d = index; d < index + size; ++d)
+                {
+                    if (state[d] == kAllocated)
+                    {
+                        printf("operation %u: descriptor %u handed out twice\n", i, d);
+                        return -1;
+                    }
+                    if (state[d] != kFree && !fence.IsComplete(state[d]))
+                    {
+                        printf("operation %u: descriptor %u reused before fence %llu\n", i, d, (unsigned long long)state[d]);
+                        return -1;
+                    }
+                    state[d] = kAllocated;
+                }
+
+                live.push_back({ index, count });
+                allocatedCount += size;
+            }
+
+            if ((i % 1024) == 0 && !CheckStats(allocator, allocatedCount, i))
+                return -1;
+        }
+
+        if (heapOrderBroken)
+        {
+            printf("heaps were not requested in order\n");
+            return -1;
+        }
+
+        for (const LiveRange& range : live)
+            allocator.Free(range.index, range.count, fence.Signal());
+        fence.CompleteAll();
+        if (!CheckStats(allocator, 0, 200000))
+            return -1;
+
+        // Everything is free, so singles must be split from what is already there
+        uint32_t heapCount = allocator.GetStats().heapCount;
+        for (uint32_t i = 0; i < heapCount * kDescriptorsPerHeap; ++i)
+        {
+            if (allocator.Allocate(1) == DescriptorAllocatorCore::kInvalidIndex || allocator.GetStats().heapCount != heapCount)
+            {
+                printf("a new heap was created with %u free descriptors left\n", heapCount * kDescriptorsPerHeap - i);
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    int FuzzConcurrent(uint32_t seed, uint32_t numThreads)
+    {
+        const uint32_t maxHeapCount = 1024;
+
+        FakeFence fence;
+        DescriptorAllocatorCore allocator(kDescriptorsPerHeap, maxHeapCount,
+            [&](uint64_t fenceValue) { return fence.IsComplete(fenceValue); },
+            [](uint32_t) {});
+
+        std::vector<std::atomic<uint32_t>> owners(maxHeapCount * kDescriptorsPerHeap);
+        std::atomic<bool> failed(false);
+
+        auto worker = [&](uint32_t threadIndex)
+        {
+            std::mt19937 rng(seed + threadIndex);
+            std::vector<LiveRange> live;
+
+            for (uint32_t i = 0; i < 100000 && !failed; ++i)
+            {
+                if (threadIndex == 0 && (i % 32) == 0)
+                    fence.CompleteAll();
+
+                if (!live.empty() && (rng() % 2) == 0)
+                {
+                    size_t liveIndex = rng() % live.size();
+                    const LiveRange range = live[liveIndex];
+                    for (uint32_t d = range.index; d < range.index + RoundedSize(range.count); ++d)
+                        owners[d].store(0, std::memory_order_relaxed);
+                    allocator.Free(range.index, range.count, fence.Signal());
+                    live[liveIndex] = live.back();
+                    live.pop_back();
+                    continue;
+                }
+
+                uint32_t count = (rng() % 8) == 0 ? 2 + rng() % 7 : 1;
+                uint32_t index = allocator.Allocate(count);
+                if (index == DescriptorAllocatorCore::kInvalidIndex)
+                {
+                    printf("thread %u: out of space\n", threadIndex);
+                    failed = true;
+                    break;
+                }
+
+                for (uint32_t d = index; d < index + RoundedSize(count); ++d)
+                {
+                    if (owners[d].exchange(threadIndex + 1, std::memory_order_relaxed) != 0)
+                    {
+                        printf("thread %u: descriptor %u handed out twice\n", threadIndex, d);
+                        failed = true;
+                        break;
+                    }
+                }
+                live.push_back({ index, count });
+            }
+
+            for (const LiveRange& range : live)
+            {
+                for (uint32_t d = range.index; d < range.index + RoundedSize(range.count); ++d)
+                    owners[d].store(0, std::memory_order_relaxed);
+                allocator.Free(range.index, range.count, fence.Signal());
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < numThreads; ++t)
+            threads.emplace_back(worker, t);
+        for (std::thread& thread : threads)
+            thread.join();
+
+        if (failed)
+            return -1;
+        return CheckStats(allocator, 0, 0) ? 0 : -1;
+    }
+
+    // More allocators than a thread has cache slots, so every one of them shares a slot with another.  Taking
+    // a slot over must return the descriptors cached in it to their owner instead of dropping them.
+    int CheckSharedCacheSlots()
+    {
+        const uint32_t numAllocators = 24;
+
+        FakeFence fence;
+        std::vector<std::unique_ptr<DescriptorAllocatorCore>> allocators;
+        for (uint32_t i = 0; i < numAllocators; ++i)
+        {
+            allocators.emplace_back(new DescriptorAllocatorCore(kDescriptorsPerHeap, 1,
+                [&](uint64_t fenceValue) { return fence.IsComplete(fenceValue); }, [](uint32_t) {}));
+        }
+
+        // Each allocator's single heap only lasts if nothing is lost to the other allocators' turns
+        for (uint32_t round = 0; round < kDescriptorsPerHeap; ++round)
+        {
+            for (uint32_t a = 0; a < numAllocators; ++a)
+            {
+                if (allocators[a]->Allocate(1) == DescriptorAllocatorCore::kInvalidIndex)
+                {
+                    printf("allocator %u: out of space after %u of %u descriptors\n", a, round, kDescriptorsPerHeap);
+                    return -1;
+                }
+                if (!CheckStats(*allocators[a], round + 1, round))
+                    return -1;
+            }
+        }
+        return 0;
+    }
+
+    // What DescriptorAllocator::Allocate did before: one static mutex, bump through heaps, never free
+    class BumpAllocator
+    {
+    public:
+        BumpAllocator() : m_heapCount(0), m_remaining(0), m_next(0) {}
+
+        uint32_t Allocate(uint32_t count)
+        {
+            std::lock_guard<std::mutex> lockGuard(m_mutex);
+            if (m_remaining < count)
+            {
+                m_next = m_heapCount++ * kDescriptorsPerHeap;
+                m_remaining = kDescriptorsPerHeap;
+            }
+            uint32_t index = m_next;
+            m_next += count;
+            m_remaining -= count;
+            return index;
+        }
+
+        uint32_t GetHeapCount() const { return m_heapCount; }
+
+    private:
+        std::mutex m_mutex;
+        uint32_t m_heapCount;
+        uint32_t m_remaining;
+        uint32_t m_next;
+    };
+
+    // Allocates single descriptors on every thread, keeping 'liveTarget' per thread and freeing the oldest.
+    // Returns allocations per second.
+    template <typename AllocateFn, typename FreeFn>
+    double MeasureChurn(uint32_t numThreads, uint32_t numAllocationsPerThread, uint32_t liveTarget, AllocateFn allocate, FreeFn free)
+    {
+        typedef std::chrono::high_resolution_clock Clock;
+
+        Clock::time_point start = Clock::now();
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < numThreads; ++t)
+        {
+            threads.emplace_back([&]()
+            {
+                std::vector<uint32_t> live(liveTarget);
+                for (uint32_t i = 0; i < numAllocationsPerThread; ++i)
+                {
+                    uint32_t& slot = live[i % liveTarget];
+                    if (i >= liveTarget)
+                        free(slot);
+                    slot = allocate();
+                }
+            });
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        return numThreads * numAllocationsPerThread / seconds;
+    }
+}
+
+int TestDescriptorAllocator(uint32_t seed)
+{
+    printf("descriptor allocator test (seed %u)\n", seed);
+
+    if (FuzzSingleThreaded(seed) != 0)
+        return -1;
+    printf("  fenced reuse and statistics: ok\n");
+
+    if (CheckSharedCacheSlots() != 0)
+        return -1;
+    printf("  allocators sharing thread cache slots: ok\n");
+
+    uint32_t numThreads = std::max(std::thread::hardware_concurrency(), 4u);
+    if (FuzzConcurrent(seed, numThreads) != 0)
+        return -1;
+    printf("  concurrent fuzz on %u threads: ok\n", numThreads);
+
+    return 0;
+}
+
+int BenchmarkDescriptorAllocator()
+{
+    const uint32_t numAllocations = 4000000;
+    const uint32_t liveTarget = 1024;
+    const uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 2u);
+
+    printf("descriptor allocator benchmark (single descriptors, %u live per thread)\n", liveTarget);
+    printf("%-12s %16s %8s %16s %8s\n", "", "bump + mutex", "heaps", "free lists", "heaps");
+
+    for (uint32_t numThreads = 1; ; numThreads = std::min(numThreads * 2, maxThreads))
+    {
+        const uint32_t perThread = numAllocations / numThreads;
+
+        BumpAllocator bump;
+        double bumpRate = MeasureChurn(numThreads, perThread, liveTarget,
+            [&]() { return bump.Allocate(1); }, [](uint32_t) {});
+
+        // Frees retire one fence later, as they would with a frame in flight
+        FakeFence fence;
+        DescriptorAllocatorCore allocator(kDescriptorsPerHeap, 1u << 20,
+            [&](uint64_t fenceValue) { return fence.IsComplete(fenceValue); }, [](uint32_t) {});
+        double coreRate = MeasureChurn(numThreads, perThread, liveTarget,
+            [&]() { return allocator.Allocate(1); },
+            [&](uint32_t index) { allocator.Free(index, 1, fence.Signal()); fence.CompleteThrough(fence.GetLastSignaled() - 1); });
+
+        char label[32];
+        sprintf_s(label, "%u thread%s", numThreads, numThreads > 1 ? "s" : "");
+        printf("%-12s %12.2f M/s %8u %12.2f M/s %8u\n", label, bumpRate / 1e6, bump.GetHeapCount(),
+            coreRate / 1e6, allocator.GetStats().heapCount);
+
+        if (numThreads == maxThreads)
+            break;
+    }
+
+    return 0;
+}
@@ -0,0 +1,37 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#pragma once
+
+#include <stdint.h>
+
+//-----------------------------------------------------------------------------
+//  DescriptorAllocatorCore checks
+//-----------------------------------------------------------------------------
+//  TestDescriptorAllocator runs random allocate/free sequences against a fake
+//  fence.  A shadow map of every index catches overlapping ranges, ranges that
+//  span two heaps and ranges reused before the fence they were freed with has
+//  completed, and the occupancy statistics must always add up to the
+//  capacity.  Once everything is freed and retired, a heap's worth of
+//  allocations must not create another heap.  More allocators than a thread
+//  has cache slots take turns allocating single descriptors, and each must
+//  get its whole heap.  A multithreaded pass does the same with single
+//  descriptors going through the per-thread caches.
+//  Returns 0 on success.
+//
+//  BenchmarkDescriptorAllocator prints single descriptor allocations per
+//  second for the bump allocator with a global mutex that DescriptorHeap.cpp
+//  used before, and for DescriptorAllocatorCore with steady state frees.
+//-----------------------------------------------------------------------------
+
+int TestDescriptorAllocator(uint32_t seed);
+
+int BenchmarkDescriptorAllocator();
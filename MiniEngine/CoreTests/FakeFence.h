@@ -0,0 +1,43 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+//-----------------------------------------------------------------------------
+//  FakeFence
+//-----------------------------------------------------------------------------
+//  Stands in for a command queue's fence in the checks that recycle memory
+//  behind the GPU.  Values are handed out in order, starting at 1, and
+//  complete only when the check says so, either all at once or up to a given
+//  value to keep some frames in flight.  Safe to signal and complete from
+//  several threads.
+//-----------------------------------------------------------------------------
+
+class FakeFence
+{
+public:
+    FakeFence() : m_NextValue(1), m_CompletedValue(0) {}
+
+    uint64_t Signal() { return m_NextValue.fetch_add(1, std::memory_order_relaxed); }
+    uint64_t GetLastSignaled() const { return m_NextValue.load(std::memory_order_relaxed) - 1; }
+
+    void CompleteThrough(uint64_t fenceValue) { m_CompletedValue.store(fenceValue, std::memory_order_release); }
+    void CompleteAll() { CompleteThrough(GetLastSignaled()); }
+
+    bool IsComplete(uint64_t fenceValue) const { return fenceValue <= m_CompletedValue.load(std::memory_order_acquire); }
+
+private:
+    std::atomic<uint64_t> m_NextValue;
+    std::atomic<uint64_t> m_CompletedValue;
+};
@@ -0,0 +1,234 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "InflateBenchmark.h"
+#include "GzipFileReader.h"
+
+#include <windows.h>
+#include <psapi.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#pragma comment(lib, "psapi.lib")
+
+namespace
+{
+    typedef std::chrono::high_resolution_clock Clock;
+
+    const char* const kPassModes[] = { "legacy", "stream", "into" };
+
+    std::wstring Widen(const char* text)
+    {
+        int length = MultiByteToWideChar(CP_ACP, 0, text, -1, nullptr, 0);
+        std::wstring wide(length > 0 ? length - 1 : 0, L'\0');
+        if (length > 1)
+            MultiByteToWideChar(CP_ACP, 0, text, -1, &wide[0], length);
+        return wide;
+    }
+
+    // What FileUtility's Inflate did before GzipFileReader
+    bool LegacyInflate(const wchar_t* fileName, std::vector<unsigned char>& output)
+    {
+        std::ifstream file(fileName, std::ios::in | std::ios::binary);
+        if (!file)
+            return false;
+
+        std::vector<unsigned char> compressed((size_t)file.seekg(0, std::ios::end).tellg());
+        file.seekg(0, std::ios::beg).read((char*)compressed.data(), compressed.size());
+        file.close();
+
+        const uint32_t chunkSize = 0x100000;
+        std::vector<std::unique_ptr<unsigned char[]>> blocks;
+
+        z_stream strm = {};
+        strm.data_type = Z_BINARY;
+        strm.total_in = strm.avail_in = (uInt)compressed.size();
+        strm.next_in = compressed.data();
+
+        int err = inflateInit2(&strm, (15 + 32));
+
+        // Unlike the original, stop when the input runs out so a truncated file can't spin forever
+        while (err == Z_OK || (err == Z_BUF_ERROR && strm.avail_in > 0))
+        {
+            blocks.emplace_back(new unsigned char[chunkSize]);
+            strm.avail_out = chunkSize;
+            strm.next_out = blocks.back().get();
+            err = inflate(&strm, Z_NO_FLUSH);
+        }
+
+        if (err != Z_STREAM_END)
+        {
+            inflateEnd(&strm);
+            return false;
+        }
+
+        output.resize(strm.total_out);
+
+        size_t remaining = output.size();
+        unsigned char* dest = output.data();
+        for (size_t i = 0; i < blocks.size() && remaining > 0; ++i)
+        {
+            size_t copySize = remaining < chunkSize ? remaining : chunkSize;
+            memcpy(dest, blocks[i].get(), copySize);
+            dest += copySize;
+            remaining -= copySize;
+        }
+
+        inflateEnd(&strm);
+        return true;
+    }
+
+    // Inflates through GzipFileReader into memory committed for the purpose, as a mapped upload heap would be
+    bool InflateIntoBuffer(const wchar_t* fileName, std::vector<unsigned char>* copy, size_t& size)
+    {
+        size_t sizeHint = GetGzipFileSizeHint(fileName);
+        if (sizeHint == 0)
+            return false;
+
+        void* dest = VirtualAlloc(nullptr, sizeHint, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        if (dest == nullptr)
+            return false;
+
+        size = InflateGzipFileInto(fileName, dest, sizeHint);
+        if (copy != nullptr)
+            copy->assign((unsigned char*)dest, (unsigned char*)dest + size);
+
+        VirtualFree(dest, 0, MEM_RELEASE);
+        return size > 0;
+    }
+
+    // Returns the child's peak working set in bytes, or 0 if it could not be run or failed
+    size_t RunPassInChildProcess(const char* mode, uint32_t iterations, const char* fileName)
+    {
+        char exePath[MAX_PATH];
+        if (GetModuleFileNameA(nullptr, exePath, MAX_PATH) == 0)
+            return 0;
+
+        std::string commandLine = std::string("\"") + exePath + "\" -benchmark_inflate_pass " + mode + " " +
+            std::to_string(iterations) + " \"" + fileName + "\"";
+
+        // The child shares the console
+        fflush(stdout);
+
+        STARTUPINFOA startupInfo = { sizeof(startupInfo) };
+        PROCESS_INFORMATION processInfo = {};
+        if (!CreateProcessA(nullptr, &commandLine[0], nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startupInfo, &processInfo))
+        {
+            printf("failed to start %s\n", commandLine.c_str());
+            return 0;
+        }
+
+        WaitForSingleObject(processInfo.hProcess, INFINITE);
+
+        DWORD exitCode = 1;
+        PROCESS_MEMORY_COUNTERS counters = {};
+        GetExitCodeProcess(processInfo.hProcess, &exitCode);
+        GetProcessMemoryInfo(processInfo.hProcess, &counters, sizeof(counters));
+
+        CloseHandle(processInfo.hThread);
+        CloseHandle(processInfo.hProcess);
+
+        return exitCode == 0 ? counters.PeakWorkingSetSize : 0;
+    }
+}
+
+int RunInflateBenchmarkPass(const char* mode, uint32_t iterations, const char* fileName)
+{
+    if (0 == strcmp(mode, "idle"))
+        return 0;
+
+    const std::wstring wideFileName = Widen(fileName);
+    size_t totalBytes = 0;
+
+    Clock::time_point start = Clock::now();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        bool ok = false;
+        size_t size = 0;
+
+        if (0 == strcmp(mode, "legacy"))
+        {
+            std::vector<unsigned char> output;
+            ok = LegacyInflate(wideFileName.c_str(), output);
+            size = output.size();
+        }
+        else if (0 == strcmp(mode, "stream"))
+        {
+            std::vector<unsigned char> output;
+            int error;
+            ok = InflateGzipFile(wideFileName.c_str(), output, error);
+            size = output.size();
+        }
+        else if (0 == strcmp(mode, "into"))
+        {
+            ok = InflateIntoBuffer(wideFileName.c_str(), nullptr, size);
+        }
+
+        if (!ok)
+        {
+            printf("%s: failed to inflate %s\n", mode, fileName);
+            return 1;
+        }
+        totalBytes += size;
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    printf("%-8s %8.1f MB/s", mode, totalBytes / (1024.0 * 1024.0) / seconds);
+    return 0;
+}
+
+int BenchmarkInflate(const char* fileName, uint32_t iterations)
+{
+    const std::wstring wideFileName = Widen(fileName);
+
+    std::vector<unsigned char> legacy, streamed, buffered;
+    int error = Z_OK;
+    size_t bufferedSize = 0;
+    if (!LegacyInflate(wideFileName.c_str(), legacy) ||
+        !InflateGzipFile(wideFileName.c_str(), streamed, error) ||
+        !InflateIntoBuffer(wideFileName.c_str(), &buffered, bufferedSize))
+    {
+        printf("failed to inflate %s (error %d)\n", fileName, error);
+        return 1;
+    }
+
+    if (streamed != legacy || buffered != legacy)
+    {
+        printf("MISMATCH: the inflated outputs differ\n");
+        return 1;
+    }
+
+    printf("inflate benchmark: %s, %zu bytes uncompressed, %u iterations\n", fileName, legacy.size(), iterations);
+
+    // Only the child processes should hold the file in memory
+    std::vector<unsigned char>().swap(legacy);
+    std::vector<unsigned char>().swap(streamed);
+    std::vector<unsigned char>().swap(buffered);
+
+    size_t idlePeak = RunPassInChildProcess("idle", iterations, fileName);
+    if (idlePeak == 0)
+        return 1;
+
+    for (const char* mode : kPassModes)
+    {
+        size_t peak = RunPassInChildProcess(mode, iterations, fileName);
+        if (peak == 0)
+            return 1;
+        printf("   peak working set %7.1f MB\n", (peak > idlePeak ? peak - idlePeak : 0) / (1024.0 * 1024.0));
+    }
+
+    return 0;
+}
@@ -0,0 +1,32 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#pragma once
+
+#include <stdint.h>
+
+//-----------------------------------------------------------------------------
+//  Gzip inflate benchmark
+//-----------------------------------------------------------------------------
+//  Times the whole-file inflate FileUtility used before (read the compressed
+//  file, inflate into 1 MB blocks, copy them into the result) against
+//  GzipFileReader, both into a vector sized from the gzip trailer and into a
+//  preallocated buffer standing in for an upload heap.  Each path runs in a
+//  child process so its peak working set can be measured on its own, and is
+//  reported above that of a child doing nothing.  The outputs must match; a
+//  mismatch returns non-zero.
+//
+//  RunInflateBenchmarkPass is the entry point of those child processes.
+//-----------------------------------------------------------------------------
+
+int BenchmarkInflate(const char* fileName, uint32_t iterations);
+
+int RunInflateBenchmarkPass(const char* mode, uint32_t iterations, const char* fileName);
@@ -0,0 +1,229 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "RecycleQueueBenchmark.h"
+#include "RecycleQueue.h"
+#include "FakeFence.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const size_t kMaxObjects = 1024;
+
+    // How far the fake GPU runs behind the last fence value handed out
+    const uint64_t kFenceLag = 64;
+
+    struct PooledObject
+    {
+        PooledObject() : owner(0), fenceValue(0) {}
+
+        std::atomic<uint32_t> owner;
+        std::atomic<uint64_t> fenceValue;
+    };
+
+    // Creating is rare in both pools and takes a lock in both
+    class ObjectStore
+    {
+    public:
+        PooledObject* Create()
+        {
+            std::lock_guard<std::mutex> lockGuard(m_mutex);
+            if (m_objects.size() == kMaxObjects)
+                return nullptr;
+            m_objects.emplace_back(new PooledObject);
+            return m_objects.back().get();
+        }
+
+        size_t Size()
+        {
+            std::lock_guard<std::mutex> lockGuard(m_mutex);
+            return m_objects.size();
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::vector<std::unique_ptr<PooledObject>> m_objects;
+    };
+
+    // The pattern the pools used before RecycleQueue
+    class MutexQueuePool
+    {
+    public:
+        PooledObject* Request(const FakeFence& fence)
+        {
+            {
+                std::lock_guard<std::mutex> lockGuard(m_mutex);
+                if (!m_retired.empty() && fence.IsComplete(m_retired.front().first))
+                {
+                    PooledObject* object = m_retired.front().second;
+                    m_retired.pop();
+                    return object;
+                }
+            }
+            return m_store.Create();
+        }
+
+        void Discard(uint64_t fenceValue, PooledObject* object)
+        {
+            std::lock_guard<std::mutex> lockGuard(m_mutex);
+            m_retired.push(std::make_pair(fenceValue, object));
+        }
+
+        size_t CreatedCount() { return m_store.Size(); }
+
+    private:
+        std::mutex m_mutex;
+        std::queue<std::pair<uint64_t, PooledObject*>> m_retired;
+        ObjectStore m_store;
+    };
+
+    // A ring smaller than the number of objects in flight spills into the queue's overflow list
+    template <size_t RingCapacity>
+    class RecycleQueuePool
+    {
+    public:
+        PooledObject* Request(const FakeFence& fence)
+        {
+            PooledObject* object = m_retired.Pop([&fence](uint64_t fenceValue) { return fence.IsComplete(fenceValue); });
+            return object != nullptr ? object : m_store.Create();
+        }
+
+        void Discard(uint64_t fenceValue, PooledObject* object)
+        {
+            m_retired.Push(fenceValue, object);
+        }
+
+        size_t CreatedCount() { return m_store.Size(); }
+
+        // Once every thread has discarded what it requested, every object created must be back
+        size_t RetiredCount() const { return m_retired.Size(); }
+
+    private:
+        RecycleQueue<PooledObject, RingCapacity> m_retired;
+        ObjectStore m_store;
+    };
+
+    // Returns request/discard pairs per second, or a negative value if the pool misbehaved
+    template <typename Pool>
+    double MeasureChurn(Pool& pool, uint32_t numThreads, uint32_t numRequestsPerThread)
+    {
+        typedef std::chrono::high_resolution_clock Clock;
+
+        FakeFence fence;
+        std::atomic<bool> done(false);
+        std::atomic<bool> failed(false);
+
+        std::thread gpu([&]()
+        {
+            while (!done)
+            {
+                uint64_t lastSignaled = fence.GetLastSignaled();
+                if (lastSignaled >= kFenceLag)
+                    fence.CompleteThrough(lastSignaled + 1 - kFenceLag);
+                std::this_thread::yield();
+            }
+        });
+
+        Clock::time_point start = Clock::now();
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < numThreads; ++t)
+        {
+            threads.emplace_back([&, t]()
+            {
+                for (uint32_t i = 0; i < numRequestsPerThread && !failed; ++i)
+                {
+                    // With every object in flight, wait for the GPU as a real pool would have to
+                    PooledObject* object;
+                    while ((object = pool.Request(fence)) == nullptr)
+                        std::this_thread::yield();
+
+                    if (object->owner.exchange(t + 1, std::memory_order_acquire) != 0)
+                    {
+                        printf("thread %u: object handed out twice\n", t);
+                        failed = true;
+                        break;
+                    }
+                    if (!fence.IsComplete(object->fenceValue.load(std::memory_order_relaxed)))
+                    {
+                        printf("thread %u: object reused before its fence completed\n", t);
+                        failed = true;
+                        break;
+                    }
+
+                    uint64_t fenceValue = fence.Signal();
+                    object->fenceValue.store(fenceValue, std::memory_order_relaxed);
+                    object->owner.store(0, std::memory_order_release);
+                    pool.Discard(fenceValue, object);
+                }
+            });
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        done = true;
+        gpu.join();
+
+        return failed ? -1.0 : numThreads * numRequestsPerThread / seconds;
+    }
+}
+
+int BenchmarkRecycleQueue(uint32_t maxThreads)
+{
+    const uint32_t numRequests = 4000000;
+    maxThreads = std::max(maxThreads, 1u);
+
+    printf("recycle queue benchmark (fence completes %llu values behind)\n", (unsigned long long)kFenceLag);
+    printf("%-12s %16s %8s %16s %8s\n", "", "mutex + queue", "created", "RecycleQueue", "created");
+
+    for (uint32_t numThreads = 1; ; numThreads = std::min(numThreads * 2, maxThreads))
+    {
+        MutexQueuePool mutexPool;
+        RecycleQueuePool<kMaxObjects> recyclePool;
+        double mutexRate = MeasureChurn(mutexPool, numThreads, numRequests / numThreads);
+        double recycleRate = MeasureChurn(recyclePool, numThreads, numRequests / numThreads);
+        if (mutexRate < 0.0 || recycleRate < 0.0)
+            return 1;
+        if (recyclePool.RetiredCount() != recyclePool.CreatedCount())
+        {
+            printf("%zu of %zu objects did not come back\n", recyclePool.CreatedCount() - recyclePool.RetiredCount(), recyclePool.CreatedCount());
+            return 1;
+        }
+
+        char label[32];
+        sprintf_s(label, "%u thread%s", numThreads, numThreads > 1 ? "s" : "");
+        printf("%-12s %12.2f M/s %8zu %12.2f M/s %8zu\n", label, mutexRate / 1e6, mutexPool.CreatedCount(),
+            recycleRate / 1e6, recyclePool.CreatedCount());
+
+        if (numThreads == maxThreads)
+            break;
+    }
+
+    RecycleQueuePool<16> overflowPool;
+    double overflowRate = MeasureChurn(overflowPool, maxThreads, numRequests / maxThreads);
+    if (overflowRate < 0.0 || overflowPool.RetiredCount() != overflowPool.CreatedCount())
+    {
+        printf("objects were lost or reused early with a 16 cell ring\n");
+        return 1;
+    }
+    printf("%-12s %25s %12.2f M/s %8zu\n", "16 cells", "", overflowRate / 1e6, overflowPool.CreatedCount());
+
+    return 0;
+}
@@ -0,0 +1,31 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#pragma once
+
+#include <stdint.h>
+
+//-----------------------------------------------------------------------------
+//  RecycleQueue stress benchmark
+//-----------------------------------------------------------------------------
+//  Simulates command contexts on many threads: each one requests an object
+//  (a command allocator or page), stamps it with the next value of a fake
+//  fence and discards it.  A stand-in GPU thread completes fence values a
+//  fixed distance behind.  The mutex + std::queue pools that
+//  CommandAllocatorPool, LinearAllocatorPageManager and DynamicDescriptorHeap
+//  used before are timed against RecycleQueue for 1 thread up to
+//  maxThreads, then once more with a ring too small for the objects in
+//  flight, so that discards spill into its overflow list.  An object held by
+//  two threads at once, reused before its fence completed or missing from
+//  the pool at the end returns non-zero.
+//-----------------------------------------------------------------------------
+
+int BenchmarkRecycleQueue(uint32_t maxThreads);
@@ -0,0 +1,96 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "RootSignatureHashTest.h"
+#include "RootSignature.h"
+
+#include <stdio.h>
+
+namespace
+{
+    // Every parameter type, plus a static sampler, the way the ModelViewer signatures are laid out
+    void InitParameters(RootSignature& Sig, D3D12_SHADER_VISIBILITY TableVisibility, UINT CBVRegister)
+    {
+        D3D12_SAMPLER_DESC SamplerDesc = {};
+        SamplerDesc.Filter = D3D12_FILTER_ANISOTROPIC;
+        SamplerDesc.AddressU = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+        SamplerDesc.AddressV = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+        SamplerDesc.AddressW = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+        SamplerDesc.MaxAnisotropy = 8;
+        SamplerDesc.ComparisonFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL;
+        SamplerDesc.MaxLOD = D3D12_FLOAT32_MAX;
+
+        Sig[0].InitAsConstantBuffer(CBVRegister, D3D12_SHADER_VISIBILITY_VERTEX);
+        Sig[1].InitAsConstants(1, 4, D3D12_SHADER_VISIBILITY_PIXEL);
+        Sig[2].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0, 6, TableVisibility);
+        Sig[3].InitAsBufferSRV(6);
+        Sig[4].InitAsBufferUAV(0);
+        Sig.InitStaticSampler(0, SamplerDesc, D3D12_SHADER_VISIBILITY_PIXEL);
+    }
+
+    void BuildSignature(RootSignature& Sig, D3D12_SHADER_VISIBILITY TableVisibility, UINT CBVRegister)
+    {
+        Sig.Reset(5, 1);
+        InitParameters(Sig, TableVisibility, CBVRegister);
+    }
+
+    // Leaves a different parameter type's fields behind in every slot before building the signature
+    void BuildSignatureOverStaleParameters(RootSignature& Sig)
+    {
+        Sig.Reset(5, 1);
+        Sig[0].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 3, 9);
+        Sig[1].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 2, 1);
+        Sig[2].InitAsConstants(7, 16);
+        Sig[3].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 5, 2);
+        Sig[4].InitAsConstants(4, 2);
+        for (UINT Param = 0; Param < 5; ++Param)
+            Sig[Param].Clear();
+
+        InitParameters(Sig, D3D12_SHADER_VISIBILITY_PIXEL, 0);
+    }
+}
+
+int TestRootSignatureHash()
+{
+    RootSignature Reference, Rebuilt, OtherVisibility, OtherRegister;
+    BuildSignature(Reference, D3D12_SHADER_VISIBILITY_PIXEL, 0);
+    BuildSignatureOverStaleParameters(Rebuilt);
+    BuildSignature(OtherVisibility, D3D12_SHADER_VISIBILITY_ALL, 0);
+    BuildSignature(OtherRegister, D3D12_SHADER_VISIBILITY_PIXEL, 1);
+
+    const D3D12_ROOT_SIGNATURE_FLAGS Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
+    const size_t ReferenceHash = Reference.ComputeHashCode(Flags);
+
+    int result = 0;
+    if (Rebuilt.ComputeHashCode(Flags) != ReferenceHash)
+    {
+        printf("identical root signatures hash differently\n");
+        result = 1;
+    }
+    if (OtherVisibility.ComputeHashCode(Flags) == ReferenceHash)
+    {
+        printf("descriptor table visibility does not change the hash\n");
+        result = 1;
+    }
+    if (OtherRegister.ComputeHashCode(Flags) == ReferenceHash)
+    {
+        printf("root CBV register does not change the hash\n");
+        result = 1;
+    }
+    if (Reference.ComputeHashCode() == ReferenceHash)
+    {
+        printf("root signature flags do not change the hash\n");
+        result = 1;
+    }
+
+    printf("root signature hash: %s\n", result == 0 ? "passed" : "FAILED");
+    return result;
+}
@@ -0,0 +1,25 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#pragma once
+
+//-----------------------------------------------------------------------------
+//  RootSignature hash checks
+//-----------------------------------------------------------------------------
+//  The root signature hash feeds the PSO disk cache key, so it must only
+//  depend on what the signature declares.  TestRootSignatureHash builds the
+//  same signature twice, once with its parameters reused from a different
+//  layout, and requires both to hash the same.  Changing a visibility, a
+//  register or the flags must change the hash.  No device is needed.
+//  Returns 0 on success.
+//-----------------------------------------------------------------------------
+
+int TestRootSignatureHash();
@@ -0,0 +1,232 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "StateObjectCacheBenchmark.h"
+#include "StateObjectCache.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    typedef std::chrono::high_resolution_clock Clock;
+
+    struct StubPipelineState
+    {
+        explicit StubPipelineState(size_t hashCode) : m_HashCode(hashCode), m_RefCount(1) {}
+
+        unsigned long Release()
+        {
+            unsigned long count = --m_RefCount;
+            if (count == 0)
+                delete this;
+            return count;
+        }
+
+        const size_t m_HashCode;
+        std::atomic<unsigned long> m_RefCount;
+    };
+
+    // Stands in for ID3D12Device: compiling busy-waits for a fixed time, like a driver would keep a core busy
+    class StubDevice
+    {
+    public:
+        explicit StubDevice(uint32_t compileMicroseconds) : m_CompileTime(std::chrono::microseconds(compileMicroseconds)), m_CompileCount(0) {}
+
+        StubPipelineState* CreatePipelineState(size_t hashCode)
+        {
+            Clock::time_point end = Clock::now() + m_CompileTime;
+            while (Clock::now() < end)
+                ;
+            ++m_CompileCount;
+            return new StubPipelineState(hashCode);
+        }
+
+        uint32_t GetCompileCount() const { return m_CompileCount; }
+
+    private:
+        const Clock::duration m_CompileTime;
+        std::atomic<uint32_t> m_CompileCount;
+    };
+
+    // What GraphicsPSO::Finalize did before StateObjectCache
+    class MutexMapCache
+    {
+    public:
+        ~MutexMapCache()
+        {
+            for (auto& entry : m_Map)
+                entry.second.load()->Release();
+        }
+
+        StubPipelineState* GetOrCreate(StubDevice& device, size_t hashCode)
+        {
+            std::atomic<StubPipelineState*>* ref = nullptr;
+            bool firstCompile = false;
+            {
+                std::lock_guard<std::mutex> CS(m_Mutex);
+                auto iter = m_Map.find(hashCode);
+                if (iter == m_Map.end())
+                {
+                    firstCompile = true;
+                    ref = &m_Map.emplace(hashCode, nullptr).first->second;
+                }
+                else
+                    ref = &iter->second;
+            }
+
+            if (firstCompile)
+            {
+                StubPipelineState* PSO = device.CreatePipelineState(hashCode);
+                ref->store(PSO);
+                return PSO;
+            }
+
+            while (ref->load() == nullptr)
+                std::this_thread::yield();
+            return ref->load();
+        }
+
+    private:
+        std::mutex m_Mutex;
+        std::map<size_t, std::atomic<StubPipelineState*>> m_Map;
+    };
+
+    std::vector<size_t> GenerateHashes(uint32_t count)
+    {
+        std::mt19937_64 rng(count);
+        std::vector<size_t> hashes(count);
+        for (size_t& hash : hashes)
+            hash = (size_t)rng();
+        return hashes;
+    }
+
+    // Runs every thread over all hashes in its own shuffled order, checking that all threads
+    // agree on the object for each hash.  Returns elapsed seconds, or a negative value on mismatch.
+    template <typename GetOrCreateFn>
+    double RunLoad(const std::vector<size_t>& hashes, uint32_t numThreads, GetOrCreateFn&& GetOrCreate)
+    {
+        std::vector<std::vector<StubPipelineState*>> results(numThreads, std::vector<StubPipelineState*>(hashes.size()));
+        std::vector<std::thread> threads;
+
+        Clock::time_point start = Clock::now();
+        for (uint32_t t = 0; t < numThreads; ++t)
+        {
+            threads.emplace_back([&, t]()
+            {
+                std::vector<uint32_t> order(hashes.size());
+                for (uint32_t i = 0; i < (uint32_t)order.size(); ++i)
+                    order[i] = i;
+                std::shuffle(order.begin(), order.end(), std::mt19937(t));
+
+                for (uint32_t i : order)
+                    results[t][i] = GetOrCreate(hashes[i]);
+            });
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        for (size_t i = 0; i < hashes.size(); ++i)
+        {
+            for (uint32_t t = 0; t < numThreads; ++t)
+            {
+                if (results[t][i] != results[0][i] || results[t][i]->m_HashCode != hashes[i])
+                    return -1.0;
+            }
+        }
+        return seconds;
+    }
+}
+
+int BenchmarkStateObjectCache(uint32_t compileMicroseconds)
+{
+    const uint32_t numHashes = 4096;
+    const uint32_t numThreads = std::max(std::thread::hardware_concurrency(), 2u);
+    const std::vector<size_t> hashes = GenerateHashes(numHashes);
+
+    printf("state object cache benchmark (%u PSOs, %u threads, %u us per compile)\n", numHashes, numThreads, compileMicroseconds);
+    printf("%-24s %12s %12s\n", "", "seconds", "compiles");
+
+    double seconds;
+    {
+        StubDevice device(compileMicroseconds);
+        MutexMapCache cache;
+        seconds = RunLoad(hashes, numThreads, [&](size_t hashCode) { return cache.GetOrCreate(device, hashCode); });
+        if (seconds < 0.0 || device.GetCompileCount() != numHashes)
+        {
+            printf("mutex + std::map: threads disagree or hashes were compiled more than once\n");
+            return -1;
+        }
+        printf("%-24s %12.3f %12u\n", "mutex + std::map", seconds, device.GetCompileCount());
+    }
+
+    {
+        StubDevice device(compileMicroseconds);
+        StateObjectCache<StubPipelineState> cache;
+        seconds = RunLoad(hashes, numThreads, [&](size_t hashCode)
+        {
+            return cache.GetOrCreate(hashCode, [&]() { return device.CreatePipelineState(hashCode); });
+        });
+        if (seconds < 0.0 || device.GetCompileCount() != numHashes)
+        {
+            printf("StateObjectCache: threads disagree or hashes were compiled more than once\n");
+            return -1;
+        }
+        printf("%-24s %12.3f %12u\n", "StateObjectCache", seconds, device.GetCompileCount());
+    }
+
+    // The first compile fails; it must wake the threads waiting on it, and exactly one of them compiles again
+    {
+        StubDevice device(compileMicroseconds);
+        StateObjectCache<StubPipelineState> cache;
+        std::atomic<uint32_t> attempts(0);
+        std::vector<StubPipelineState*> results(numThreads);
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < numThreads; ++t)
+        {
+            threads.emplace_back([&, t]()
+            {
+                results[t] = cache.GetOrCreate(hashes[0], [&]() -> StubPipelineState*
+                {
+                    if (attempts.fetch_add(1) == 0)
+                        return nullptr;
+                    return device.CreatePipelineState(hashes[0]);
+                });
+            });
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+
+        uint32_t numFailed = 0;
+        for (StubPipelineState* PSO : results)
+        {
+            if (PSO == nullptr)
+                ++numFailed;
+            else if (PSO->m_HashCode != hashes[0])
+                numFailed = numThreads;
+        }
+        if (numFailed != 1 || device.GetCompileCount() != 1)
+        {
+            printf("StateObjectCache: a failed compile was not retried exactly once\n");
+            return -1;
+        }
+    }
+
+    return 0;
+}
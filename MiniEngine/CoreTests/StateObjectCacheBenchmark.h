@@ -0,0 +1,27 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#pragma once
+
+#include <stdint.h>
+
+//-----------------------------------------------------------------------------
+//  StateObjectCache contention benchmark
+//-----------------------------------------------------------------------------
+//  Simulates a level load: every thread finalizes the same set of PSOs in its
+//  own order, against a stub device whose compiles take compileMicroseconds.
+//  The mutex + std::map + yield scheme that PipelineState.cpp used before is
+//  timed against StateObjectCache.  Both must compile each hash exactly once
+//  and hand every thread the same object; a mismatch returns non-zero.  It
+//  also checks that a failed compile wakes its waiters and is retried once.
+//-----------------------------------------------------------------------------
+
+int BenchmarkStateObjectCache(uint32_t compileMicroseconds);
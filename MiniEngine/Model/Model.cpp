@@ -18,11 +18,19 @@
 Model::Model()
     : m_pMesh(nullptr)
     , m_pMaterial(nullptr)
+    , m_pMeshletRange(nullptr)
+    , m_pMeshlet(nullptr)
+    , m_pMeshletVertices(nullptr)
+    , m_pMeshletTriangles(nullptr)
     , m_pVertexData(nullptr)
     , m_pIndexData(nullptr)
     , m_pVertexDataDepth(nullptr)
     , m_pIndexDataDepth(nullptr)
     , m_SRVs(nullptr)
+    , m_DepthStreamLoaded(false)
+    , m_DepthStreamMapping(nullptr)
+    , m_DepthVertexDataOffset(0)
+    , m_DepthIndexDataOffset(0)
 {
     Clear();
 }
@@ -38,6 +46,8 @@ void Model::Clear()
     m_IndexBuffer.Destroy();
     m_VertexBufferDepth.Destroy();
     m_IndexBufferDepth.Destroy();
+    m_DepthStreamLoaded = false;
+    ReleaseDepthStreamMapping();
 
     delete [] m_pMesh;
     m_pMesh = nullptr;
@@ -60,6 +70,17 @@ void Model::Clear()
     m_Header.vertexDataByteSizeDepth = 0;
     m_pIndexDataDepth = nullptr;
 
+    delete [] m_pMeshletRange;
+    delete [] m_pMeshlet;
+    delete [] m_pMeshletVertices;
+    delete [] m_pMeshletTriangles;
+
+    m_pMeshletRange = nullptr;
+    m_pMeshlet = nullptr;
+    m_pMeshletVertices = nullptr;
+    m_pMeshletTriangles = nullptr;
+    memset(&m_MeshletHeader, 0, sizeof(m_MeshletHeader));
+
     ReleaseTextures();
 
     m_Header.boundingBox.min = Vector3(0.0f);
@@ -114,6 +114,10 @@ public:
     };
     Header m_Header;
 
+    // Quantized meshes (ModelConverter -quantize) store positions as normalized ushorts relative
+    // to the mesh bounding box, and normals as two normalized shorts in octahedral encoding.  The
+    // tangent is octahedral too, with the bitangent's sign in its third component; such meshes have
+    // no bitangent attribute, and the bitangent is sign * cross(normal, tangent).
     struct Attrib
     {
         uint16_t offset; // byte offset from the start of the vertex
@@ -169,13 +173,52 @@ public:
     };
     Material *m_pMaterial;
 
+    // Optional clusters for GPU-driven culling, stored after the depth index data.  Files
+    // written without them load as before.
+    enum {maxMeshletVertices = 64};
+    enum {maxMeshletTriangles = 126};
+    enum {meshletTag = 0x3154454d}; // "MET1"
+
+    struct MeshletHeader
+    {
+        uint32_t tag;
+        uint32_t meshletCount;
+        uint32_t vertexCount;
+        uint32_t triangleCount;
+    };
+    MeshletHeader m_MeshletHeader;
+
+    struct MeshletRange
+    {
+        uint32_t meshletOffset;
+        uint32_t meshletCount;
+    };
+    struct Meshlet
+    {
+        uint32_t vertexOffset; // into m_pMeshletVertices
+        uint32_t vertexCount;
+        uint32_t triangleOffset; // into m_pMeshletTriangles
+        uint32_t triangleCount;
+
+        // The meshlet is entirely back-facing, and can be culled, when
+        // dot(center - eye, coneAxis) >= coneCutoff * length(center - eye) + radius.
+        // A cutoff of 1 means the cone is too wide to ever cull.
+        float boundingSphere[4]; // center, radius
+        float coneAxis[3];
+        float coneCutoff;
+    };
+    MeshletRange *m_pMeshletRange; // one per mesh
+    Meshlet *m_pMeshlet;
+    uint32_t *m_pMeshletVertices; // mesh-relative vertex indices
+    uint32_t *m_pMeshletTriangles; // three meshlet-relative 8-bit indices per triangle
+
     unsigned char *m_pVertexData;
     unsigned char *m_pIndexData;
     StructuredBuffer m_VertexBuffer;
     ByteAddressBuffer m_IndexBuffer;
     uint32_t m_VertexStride;
 
-    // optimized for depth-only rendering
+    // optimized for depth-only rendering; call LoadDepthStream() before using the buffers
     unsigned char *m_pVertexDataDepth;
     unsigned char *m_pIndexDataDepth;
     StructuredBuffer m_VertexBufferDepth;
@@ -192,15 +235,29 @@ public:
         return m_Header.boundingBox;
     }
 
+    bool HasQuantizedVertices() const
+    {
+        return m_Header.meshCount > 0 && m_pMesh[0].attrib[attrib_position].format == attrib_format_ushort;
+    }
+
     D3D12_CPU_DESCRIPTOR_HANDLE* GetSRVs( uint32_t materialIdx ) const
     {
         return m_SRVs + materialIdx * 6;
     }
 
+    // H3D containers leave the depth stream in the file until the first depth pass asks for it.
+    // Creates m_VertexBufferDepth and m_IndexBufferDepth if they don't exist yet; a model without
+    // a depth stream leaves them unallocated.
+    void LoadDepthStream();
+
 protected:
 
     bool LoadH3D(const char *filename);
+    bool LoadH3DContainer(const char *filename);
+    bool LoadH3DLegacy(const char *filename);
     bool SaveH3D(const char *filename) const;
+    void InitVertexLayout();
+    void ReleaseDepthStreamMapping();
 
     void ComputeMeshBoundingBox(unsigned int meshIndex, BoundingBox &bbox) const;
     void ComputeGlobalBoundingBox(BoundingBox &bbox) const;
@@ -209,4 +266,9 @@ protected:
     void ReleaseTextures();
     void LoadTextures();
     D3D12_CPU_DESCRIPTOR_HANDLE* m_SRVs;
+
+    bool m_DepthStreamLoaded;
+    HANDLE m_DepthStreamMapping; // file mapping kept open until LoadDepthStream()
+    uint64_t m_DepthVertexDataOffset;
+    uint64_t m_DepthIndexDataOffset;
 };
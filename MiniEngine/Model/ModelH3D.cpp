@@ -17,7 +17,96 @@
 #include "GraphicsCore.h"
 #include "DescriptorHeap.h"
 #include "CommandContext.h"
+#include "Math/Common.h"
 #include <stdio.h>
+#include <algorithm>
+
+namespace
+{
+    // H3D container:  a header and a section table, then the sections.  Each section starts on a
+    // kSectionAlignment boundary and is zero padded up to the next one, so geometry can be uploaded
+    // straight out of a file mapping (the upload copy wants 16 byte aligned, 16 byte granular
+    // sources).  Files that don't start with kContainerTag have the original sequential layout.
+    const uint32_t kContainerTag = 'H3DC';
+    const uint32_t kContainerVersion = 1;
+    const uint32_t kSectionAlignment = 4096;
+
+    // Never renumber these; sections at or past a file's sectionCount are treated as absent
+    enum
+    {
+        section_header,
+        section_mesh,
+        section_material,
+        section_vertex,
+        section_index,
+        section_vertex_depth,
+        section_index_depth,
+        section_meshlet_header,
+        section_meshlet_range,
+        section_meshlet,
+        section_meshlet_vertices,
+        section_meshlet_triangles,
+
+        section_count
+    };
+
+    struct ContainerHeader
+    {
+        uint32_t tag;
+        uint32_t version;
+        uint32_t sectionAlignment;
+        uint32_t sectionCount;
+    };
+
+    struct Section
+    {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    HANDLE CreateReadOnlyMapping( const char* filename, uint64_t& fileSize )
+    {
+#if WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP)
+        HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+#else
+        HANDLE file = CreateFile2(MakeWStr(filename).c_str(), GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr);
+#endif
+        if (file == INVALID_HANDLE_VALUE)
+            return nullptr;
+
+        LARGE_INTEGER size;
+        HANDLE mapping = nullptr;
+        if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+        {
+            fileSize = (uint64_t)size.QuadPart;
+#if WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP)
+            mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+#else
+            mapping = CreateFileMappingFromApp(file, nullptr, PAGE_READONLY, 0, nullptr);
+#endif
+        }
+
+        // the mapping keeps the file open
+        CloseHandle(file);
+        return mapping;
+    }
+
+    // Views must start on an allocation granularity boundary, so the returned pointer may be
+    // inside the view.  Unmap with UnmapViewOfFile(view).
+    const unsigned char* MapRange( HANDLE mapping, uint64_t offset, uint64_t size, void*& view )
+    {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        const uint64_t viewOffset = offset - offset % info.dwAllocationGranularity;
+
+#if WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP)
+        view = MapViewOfFile(mapping, FILE_MAP_READ, (DWORD)(viewOffset >> 32), (DWORD)viewOffset, (SIZE_T)(offset + size - viewOffset));
+#else
+        view = MapViewOfFileFromApp(mapping, FILE_MAP_READ, viewOffset, (SIZE_T)(offset + size - viewOffset));
+#endif
+        return view == nullptr ? nullptr : (const unsigned char*)view + (offset - viewOffset);
+    }
+}
 
 bool Model::LoadH3D(const char *filename)
 {
@@ -25,18 +114,192 @@ bool Model::LoadH3D(const char *filename)
     if (0 != fopen_s(&file, filename, "rb"))
         return false;
 
+    uint32_t tag = 0;
+    bool isContainer = 1 == fread(&tag, sizeof(tag), 1, file) && tag == kContainerTag;
+    fclose(file);
+
+    return isContainer ? LoadH3DContainer(filename) : LoadH3DLegacy(filename);
+}
+
+bool Model::LoadH3DContainer(const char *filename)
+{
+    uint64_t fileSize = 0;
+    HANDLE mapping = CreateReadOnlyMapping(filename, fileSize);
+    if (mapping == nullptr)
+        return false;
+
+    void* view = nullptr;
+    const unsigned char* fileData = MapRange(mapping, 0, fileSize, view);
+    if (fileData == nullptr)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+
     bool ok = false;
+    Section sections[section_count] = {};
 
-    if (1 != fread(&m_Header, sizeof(Header), 1, file)) goto h3d_load_fail;
+    // Returns the section's data if it's present, in bounds and at least minSize bytes
+    auto GetSection = [&](uint32_t id, uint64_t minSize) -> const unsigned char*
+    {
+        const Section& section = sections[id];
+        if (section.size == 0 || section.size < minSize || section.offset % kSectionAlignment != 0 ||
+            section.offset > fileSize || Math::AlignUp(section.size, 16) > fileSize - section.offset)
+        {
+            return nullptr;
+        }
+        return fileData + section.offset;
+    };
+
+    const unsigned char* header = nullptr;
+    const unsigned char* meshes = nullptr;
+    const unsigned char* materials = nullptr;
+    const unsigned char* vertices = nullptr;
+    const unsigned char* indices = nullptr;
+    const unsigned char* verticesDepth = nullptr;
+    const unsigned char* indicesDepth = nullptr;
+    const unsigned char* meshletHeader = nullptr;
+    uint32_t sectionCount = 0;
+
+    const ContainerHeader* container = (const ContainerHeader*)fileData;
+    if (fileSize < sizeof(ContainerHeader))
+    {
+        Utility::Printf("%s: H3D container is truncated or corrupt\n", filename);
+        goto h3d_container_load_fail;
+    }
+    if (container->version != kContainerVersion || container->sectionAlignment != kSectionAlignment)
+    {
+        Utility::Printf("%s: unsupported H3D container version\n", filename);
+        goto h3d_container_load_fail;
+    }
 
+    sectionCount = std::min<uint32_t>(container->sectionCount, section_count);
+    if (sizeof(ContainerHeader) + (uint64_t)container->sectionCount * sizeof(Section) > fileSize)
+        goto h3d_container_load_fail;
+    memcpy(sections, fileData + sizeof(ContainerHeader), sectionCount * sizeof(Section));
+
+    header = GetSection(section_header, sizeof(Header));
+    if (header == nullptr)
+        goto h3d_container_load_fail;
+    memcpy(&m_Header, header, sizeof(Header));
+
+    meshes = GetSection(section_mesh, sizeof(Mesh) * (uint64_t)m_Header.meshCount);
+    materials = GetSection(section_material, sizeof(Material) * (uint64_t)m_Header.materialCount);
+    vertices = GetSection(section_vertex, m_Header.vertexDataByteSize);
+    indices = GetSection(section_index, m_Header.indexDataByteSize);
+    verticesDepth = GetSection(section_vertex_depth, m_Header.vertexDataByteSizeDepth);
+    indicesDepth = GetSection(section_index_depth, m_Header.indexDataByteSize);
+    if (m_Header.meshCount == 0 || meshes == nullptr || vertices == nullptr || indices == nullptr ||
+        (m_Header.materialCount > 0 && materials == nullptr) ||
+        (m_Header.vertexDataByteSizeDepth > 0 && (verticesDepth == nullptr || indicesDepth == nullptr)))
+    {
+        Utility::Printf("%s: H3D container is truncated or corrupt\n", filename);
+        goto h3d_container_load_fail;
+    }
+
+    // Mesh and material descriptions are small and stay resident
     m_pMesh = new Mesh [m_Header.meshCount];
     m_pMaterial = new Material [m_Header.materialCount];
-
-    if (m_Header.meshCount > 0)
-        if (1 != fread(m_pMesh, sizeof(Mesh) * m_Header.meshCount, 1, file)) goto h3d_load_fail;
+    memcpy(m_pMesh, meshes, sizeof(Mesh) * m_Header.meshCount);
     if (m_Header.materialCount > 0)
-        if (1 != fread(m_pMaterial, sizeof(Material) * m_Header.materialCount, 1, file)) goto h3d_load_fail;
+        memcpy(m_pMaterial, materials, sizeof(Material) * m_Header.materialCount);
+
+    InitVertexLayout();
+
+    meshletHeader = GetSection(section_meshlet_header, sizeof(MeshletHeader));
+    if (meshletHeader != nullptr && ((const MeshletHeader*)meshletHeader)->tag == meshletTag)
+    {
+        memcpy(&m_MeshletHeader, meshletHeader, sizeof(MeshletHeader));
+
+        const unsigned char* ranges = GetSection(section_meshlet_range, sizeof(MeshletRange) * (uint64_t)m_Header.meshCount);
+        const unsigned char* meshlets = GetSection(section_meshlet, sizeof(Meshlet) * (uint64_t)m_MeshletHeader.meshletCount);
+        const unsigned char* meshletVertices = GetSection(section_meshlet_vertices, sizeof(uint32_t) * (uint64_t)m_MeshletHeader.vertexCount);
+        const unsigned char* meshletTriangles = GetSection(section_meshlet_triangles, sizeof(uint32_t) * (uint64_t)m_MeshletHeader.triangleCount);
+        if (ranges == nullptr || (m_MeshletHeader.meshletCount > 0 && meshlets == nullptr) ||
+            (m_MeshletHeader.vertexCount > 0 && meshletVertices == nullptr) ||
+            (m_MeshletHeader.triangleCount > 0 && meshletTriangles == nullptr))
+        {
+            goto h3d_container_load_fail;
+        }
+
+        m_pMeshletRange = new MeshletRange [m_Header.meshCount];
+        m_pMeshlet = new Meshlet [m_MeshletHeader.meshletCount];
+        m_pMeshletVertices = new uint32_t [m_MeshletHeader.vertexCount];
+        m_pMeshletTriangles = new uint32_t [m_MeshletHeader.triangleCount];
+        memcpy(m_pMeshletRange, ranges, sizeof(MeshletRange) * m_Header.meshCount);
+        if (m_MeshletHeader.meshletCount > 0)
+            memcpy(m_pMeshlet, meshlets, sizeof(Meshlet) * m_MeshletHeader.meshletCount);
+        if (m_MeshletHeader.vertexCount > 0)
+            memcpy(m_pMeshletVertices, meshletVertices, sizeof(uint32_t) * m_MeshletHeader.vertexCount);
+        if (m_MeshletHeader.triangleCount > 0)
+            memcpy(m_pMeshletTriangles, meshletTriangles, sizeof(uint32_t) * m_MeshletHeader.triangleCount);
+    }
+
+    // Uploaded directly from the mapped file, without a heap copy
+    m_VertexBuffer.Create(L"VertexBuffer", m_Header.vertexDataByteSize / m_VertexStride, m_VertexStride, vertices);
+    m_IndexBuffer.Create(L"IndexBuffer", m_Header.indexDataByteSize / sizeof(uint16_t), sizeof(uint16_t), indices);
+
+    // The depth stream stays in the file until LoadDepthStream().  Only the mapping object is kept;
+    // the view is released so the pages touched so far can leave the working set.  A model without
+    // a depth stream has empty sections and keeps nothing.
+    if (m_Header.vertexDataByteSizeDepth > 0)
+    {
+        m_DepthStreamMapping = mapping;
+        m_DepthVertexDataOffset = sections[section_vertex_depth].offset;
+        m_DepthIndexDataOffset = sections[section_index_depth].offset;
+        mapping = nullptr;
+    }
+
+    LoadTextures();
+
+    ok = true;
+
+h3d_container_load_fail:
+
+    UnmapViewOfFile(view);
+    if (mapping != nullptr)
+        CloseHandle(mapping);
+
+    return ok;
+}
+
+void Model::LoadDepthStream()
+{
+    if (m_DepthStreamLoaded || m_DepthStreamMapping == nullptr)
+        return;
+
+    // the index section follows the vertex section, so one view covers both
+    const uint64_t viewStart = std::min(m_DepthVertexDataOffset, m_DepthIndexDataOffset);
+    const uint64_t viewEnd = std::max(m_DepthVertexDataOffset + Math::AlignUp(m_Header.vertexDataByteSizeDepth, 16),
+        m_DepthIndexDataOffset + Math::AlignUp(m_Header.indexDataByteSize, 16));
+
+    void* view = nullptr;
+    const unsigned char* data = MapRange(m_DepthStreamMapping, viewStart, viewEnd - viewStart, view);
+    ASSERT(data != nullptr, "Failed to map the depth stream");
+    if (data != nullptr)
+    {
+        m_VertexBufferDepth.Create(L"VertexBufferDepth", m_Header.vertexDataByteSizeDepth / m_VertexStrideDepth, m_VertexStrideDepth,
+            data + (m_DepthVertexDataOffset - viewStart));
+        m_IndexBufferDepth.Create(L"IndexBufferDepth", m_Header.indexDataByteSize / sizeof(uint16_t), sizeof(uint16_t),
+            data + (m_DepthIndexDataOffset - viewStart));
+        UnmapViewOfFile(view);
+        m_DepthStreamLoaded = true;
+    }
 
+    ReleaseDepthStreamMapping();
+}
+
+void Model::ReleaseDepthStreamMapping()
+{
+    if (m_DepthStreamMapping != nullptr)
+        CloseHandle(m_DepthStreamMapping);
+    m_DepthStreamMapping = nullptr;
+    m_DepthVertexDataOffset = 0;
+    m_DepthIndexDataOffset = 0;
+}
+
+void Model::InitVertexLayout()
+{
     m_VertexStride = m_pMesh[0].vertexStride;
     m_VertexStrideDepth = m_pMesh[0].vertexStrideDepth;
 #if _DEBUG
@@ -50,19 +313,57 @@ bool Model::LoadH3D(const char *filename)
     {
         const Mesh& mesh = m_pMesh[meshIndex];
 
-        ASSERT( mesh.attribsEnabled ==
-            (attrib_mask_position | attrib_mask_texcoord0 | attrib_mask_normal | attrib_mask_tangent | attrib_mask_bitangent) );
-        ASSERT(mesh.attrib[0].components == 3 && mesh.attrib[0].format == Model::attrib_format_float); // position
-        ASSERT(mesh.attrib[1].components == 2 && mesh.attrib[1].format == Model::attrib_format_float); // texcoord0
-        ASSERT(mesh.attrib[2].components == 3 && mesh.attrib[2].format == Model::attrib_format_float); // normal
-        ASSERT(mesh.attrib[3].components == 3 && mesh.attrib[3].format == Model::attrib_format_float); // tangent
-        ASSERT(mesh.attrib[4].components == 3 && mesh.attrib[4].format == Model::attrib_format_float); // bitangent
-
-        ASSERT( mesh.attribsEnabledDepth ==
-            (attrib_mask_position) );
-        ASSERT(mesh.attrib[0].components == 3 && mesh.attrib[0].format == Model::attrib_format_float); // position
+        if (HasQuantizedVertices())
+        {
+            ASSERT( mesh.attribsEnabled ==
+                (attrib_mask_position | attrib_mask_texcoord0 | attrib_mask_normal | attrib_mask_tangent) );
+            ASSERT(mesh.attrib[0].components == 3 && mesh.attrib[0].format == Model::attrib_format_ushort && mesh.attrib[0].normalized); // position
+            ASSERT(mesh.attrib[1].components == 2 && mesh.attrib[1].format == Model::attrib_format_float); // texcoord0
+            ASSERT(mesh.attrib[2].components == 2 && mesh.attrib[2].format == Model::attrib_format_short && mesh.attrib[2].normalized); // octahedral normal
+            ASSERT(mesh.attrib[3].components == 3 && mesh.attrib[3].format == Model::attrib_format_short && mesh.attrib[3].normalized); // octahedral tangent, bitangent sign
+
+            ASSERT( mesh.attribsEnabledDepth ==
+                (attrib_mask_position) );
+            ASSERT(mesh.attribDepth[0].components == 3 && mesh.attribDepth[0].format == Model::attrib_format_ushort && mesh.attribDepth[0].normalized); // position
+        }
+        else
+        {
+            ASSERT( mesh.attribsEnabled ==
+                (attrib_mask_position | attrib_mask_texcoord0 | attrib_mask_normal | attrib_mask_tangent | attrib_mask_bitangent) );
+            ASSERT(mesh.attrib[0].components == 3 && mesh.attrib[0].format == Model::attrib_format_float); // position
+            ASSERT(mesh.attrib[1].components == 2 && mesh.attrib[1].format == Model::attrib_format_float); // texcoord0
+            ASSERT(mesh.attrib[2].components == 3 && mesh.attrib[2].format == Model::attrib_format_float); // normal
+            ASSERT(mesh.attrib[3].components == 3 && mesh.attrib[3].format == Model::attrib_format_float); // tangent
+            ASSERT(mesh.attrib[4].components == 3 && mesh.attrib[4].format == Model::attrib_format_float); // bitangent
+
+            ASSERT( mesh.attribsEnabledDepth ==
+                (attrib_mask_position) );
+            ASSERT(mesh.attribDepth[0].components == 3 && mesh.attribDepth[0].format == Model::attrib_format_float); // position
+        }
     }
 #endif
+}
+
+// Files written before the container format; every section is read into a heap copy first
+bool Model::LoadH3DLegacy(const char *filename)
+{
+    FILE *file = nullptr;
+    if (0 != fopen_s(&file, filename, "rb"))
+        return false;
+
+    bool ok = false;
+
+    if (1 != fread(&m_Header, sizeof(Header), 1, file)) goto h3d_load_fail;
+
+    m_pMesh = new Mesh [m_Header.meshCount];
+    m_pMaterial = new Material [m_Header.materialCount];
+
+    if (m_Header.meshCount > 0)
+        if (1 != fread(m_pMesh, sizeof(Mesh) * m_Header.meshCount, 1, file)) goto h3d_load_fail;
+    if (m_Header.materialCount > 0)
+        if (1 != fread(m_pMaterial, sizeof(Material) * m_Header.materialCount, 1, file)) goto h3d_load_fail;
+
+    InitVertexLayout();
 
     m_pVertexData = new unsigned char[ m_Header.vertexDataByteSize ];
     m_pIndexData = new unsigned char[ m_Header.indexDataByteSize ];
@@ -79,6 +380,28 @@ bool Model::LoadH3D(const char *filename)
     if (m_Header.indexDataByteSize > 0)
         if (1 != fread(m_pIndexDataDepth, m_Header.indexDataByteSize, 1, file)) goto h3d_load_fail;
 
+    // meshlets are optional and follow everything else
+    if (1 == fread(&m_MeshletHeader, sizeof(MeshletHeader), 1, file) && m_MeshletHeader.tag == meshletTag)
+    {
+        m_pMeshletRange = new MeshletRange [m_Header.meshCount];
+        m_pMeshlet = new Meshlet [m_MeshletHeader.meshletCount];
+        m_pMeshletVertices = new uint32_t [m_MeshletHeader.vertexCount];
+        m_pMeshletTriangles = new uint32_t [m_MeshletHeader.triangleCount];
+
+        if (m_Header.meshCount > 0)
+            if (1 != fread(m_pMeshletRange, sizeof(MeshletRange) * m_Header.meshCount, 1, file)) goto h3d_load_fail;
+        if (m_MeshletHeader.meshletCount > 0)
+            if (1 != fread(m_pMeshlet, sizeof(Meshlet) * m_MeshletHeader.meshletCount, 1, file)) goto h3d_load_fail;
+        if (m_MeshletHeader.vertexCount > 0)
+            if (1 != fread(m_pMeshletVertices, sizeof(uint32_t) * m_MeshletHeader.vertexCount, 1, file)) goto h3d_load_fail;
+        if (m_MeshletHeader.triangleCount > 0)
+            if (1 != fread(m_pMeshletTriangles, sizeof(uint32_t) * m_MeshletHeader.triangleCount, 1, file)) goto h3d_load_fail;
+    }
+    else
+    {
+        memset(&m_MeshletHeader, 0, sizeof(m_MeshletHeader));
+    }
+
     m_VertexBuffer.Create(L"VertexBuffer", m_Header.vertexDataByteSize / m_VertexStride, m_VertexStride, m_pVertexData);
     m_IndexBuffer.Create(L"IndexBuffer", m_Header.indexDataByteSize / sizeof(uint16_t), sizeof(uint16_t), m_pIndexData);
     delete [] m_pVertexData;
@@ -86,8 +409,12 @@ bool Model::LoadH3D(const char *filename)
     delete [] m_pIndexData;
     m_pIndexData = nullptr;
 
-    m_VertexBufferDepth.Create(L"VertexBufferDepth", m_Header.vertexDataByteSizeDepth / m_VertexStrideDepth, m_VertexStrideDepth, m_pVertexDataDepth);
-    m_IndexBufferDepth.Create(L"IndexBufferDepth", m_Header.indexDataByteSize / sizeof(uint16_t), sizeof(uint16_t), m_pIndexDataDepth);
+    if (m_Header.vertexDataByteSizeDepth > 0)
+    {
+        m_VertexBufferDepth.Create(L"VertexBufferDepth", m_Header.vertexDataByteSizeDepth / m_VertexStrideDepth, m_VertexStrideDepth, m_pVertexDataDepth);
+        m_IndexBufferDepth.Create(L"IndexBufferDepth", m_Header.indexDataByteSize / sizeof(uint16_t), sizeof(uint16_t), m_pIndexDataDepth);
+    }
+    m_DepthStreamLoaded = true;
     delete [] m_pVertexDataDepth;
     m_pVertexDataDepth = nullptr;
     delete [] m_pIndexDataDepth;
@@ -107,32 +434,69 @@ h3d_load_fail:
 
 bool Model::SaveH3D(const char *filename) const
 {
+    const bool hasMeshlets = m_MeshletHeader.tag == meshletTag;
+
+    struct SectionData
+    {
+        const void* data;
+        uint64_t size;
+    };
+    const SectionData contents[section_count] =
+    {
+        { &m_Header, sizeof(Header) },
+        { m_pMesh, sizeof(Mesh) * (uint64_t)m_Header.meshCount },
+        { m_pMaterial, sizeof(Material) * (uint64_t)m_Header.materialCount },
+        { m_pVertexData, m_Header.vertexDataByteSize },
+        { m_pIndexData, m_Header.indexDataByteSize },
+        { m_pVertexDataDepth, m_Header.vertexDataByteSizeDepth },
+        { m_pIndexDataDepth, m_Header.indexDataByteSize },
+        { &m_MeshletHeader, hasMeshlets ? sizeof(MeshletHeader) : 0 },
+        { m_pMeshletRange, hasMeshlets ? sizeof(MeshletRange) * (uint64_t)m_Header.meshCount : 0 },
+        { m_pMeshlet, hasMeshlets ? sizeof(Meshlet) * (uint64_t)m_MeshletHeader.meshletCount : 0 },
+        { m_pMeshletVertices, hasMeshlets ? sizeof(uint32_t) * (uint64_t)m_MeshletHeader.vertexCount : 0 },
+        { m_pMeshletTriangles, hasMeshlets ? sizeof(uint32_t) * (uint64_t)m_MeshletHeader.triangleCount : 0 },
+    };
+
+    ContainerHeader container = { kContainerTag, kContainerVersion, kSectionAlignment, section_count };
+    Section sections[section_count] = {};
+    uint64_t offset = Math::AlignUp(sizeof(ContainerHeader) + sizeof(sections), kSectionAlignment);
+    for (uint32_t id = 0; id < section_count; ++id)
+    {
+        if (contents[id].size == 0)
+            continue;
+        sections[id].offset = offset;
+        sections[id].size = contents[id].size;
+        offset += Math::AlignUp(contents[id].size, kSectionAlignment);
+    }
+
     FILE *file = nullptr;
     if (0 != fopen_s(&file, filename, "wb"))
         return false;
 
-    bool ok = false;
-
-    if (1 != fwrite(&m_Header, sizeof(Header), 1, file)) goto h3d_save_fail;
-
-    if (m_Header.meshCount > 0)
-        if (1 != fwrite(m_pMesh, sizeof(Mesh) * m_Header.meshCount, 1, file)) goto h3d_save_fail;
-    if (m_Header.materialCount > 0)
-        if (1 != fwrite(m_pMaterial, sizeof(Material) * m_Header.materialCount, 1, file)) goto h3d_save_fail;
-
-    if (m_Header.vertexDataByteSize > 0)
-        if (1 != fwrite(m_pVertexData, m_Header.vertexDataByteSize, 1, file)) goto h3d_save_fail;
-    if (m_Header.indexDataByteSize > 0)
-        if (1 != fwrite(m_pIndexData, m_Header.indexDataByteSize, 1, file)) goto h3d_save_fail;
-
-    if (m_Header.vertexDataByteSizeDepth > 0)
-        if (1 != fwrite(m_pVertexDataDepth, m_Header.vertexDataByteSizeDepth, 1, file)) goto h3d_save_fail;
-    if (m_Header.indexDataByteSize > 0)
-        if (1 != fwrite(m_pIndexDataDepth, m_Header.indexDataByteSize, 1, file)) goto h3d_save_fail;
-
-    ok = true;
+    static const unsigned char zeros[kSectionAlignment] = {};
+    uint64_t written = 0;
+    auto Write = [&](const void* data, uint64_t size) -> bool
+    {
+        written += size;
+        return size == 0 || 1 == fwrite(data, (size_t)size, 1, file);
+    };
+    auto PadTo = [&](uint64_t end) -> bool
+    {
+        while (written < end)
+        {
+            if (!Write(zeros, std::min<uint64_t>(end - written, sizeof(zeros))))
+                return false;
+        }
+        return true;
+    };
 
-h3d_save_fail:
+    bool ok = Write(&container, sizeof(container)) && Write(sections, sizeof(sections));
+    for (uint32_t id = 0; ok && id < section_count; ++id)
+    {
+        if (contents[id].size > 0)
+            ok = PadTo(sections[id].offset) && Write(contents[id].data, contents[id].size);
+    }
+    ok = ok && PadTo(offset);
 
     if (EOF == fclose(file))
         ok = false;
@@ -167,34 +531,44 @@ void Model::LoadTextures(void)
 
     const ManagedTexture* MatTextures[6] = {};
 
+    // The defaults are tiny and shown while the material's own textures stream in on the I/O threads.  A
+    // texture that fails to load keeps showing its default.
+    const ManagedTexture* DefaultDiffuse = TextureManager::LoadFromFile("default", true);
+    const ManagedTexture* DefaultSpecular = TextureManager::LoadFromFile("default_specular", true);
+    const ManagedTexture* DefaultNormal = TextureManager::LoadFromFile("default_normal", false);
+
     for (uint32_t materialIdx = 0; materialIdx < m_Header.materialCount; ++materialIdx)
     {
         const Material& pMaterial = m_pMaterial[materialIdx];
+        const std::string diffusePath = pMaterial.texDiffusePath;
 
         // Load diffuse
-        MatTextures[0] = TextureManager::LoadFromFile(pMaterial.texDiffusePath, true);
-        if (!MatTextures[0]->IsValid())
-            MatTextures[0] = TextureManager::LoadFromFile("default", true);
+        MatTextures[0] = DefaultDiffuse;
+        if (!diffusePath.empty())
+        {
+            MatTextures[0] = TextureManager::LoadFromFileAsync(diffusePath, true,
+                TextureManager::kLoadPriorityHigh, DefaultDiffuse);
+        }
 
         // Load specular
-        MatTextures[1] = TextureManager::LoadFromFile(pMaterial.texSpecularPath, true);
-        if (!MatTextures[1]->IsValid())
+        const std::string specularPath = pMaterial.texSpecularPath[0] != '\0' ? pMaterial.texSpecularPath : diffusePath + "_specular";
+        MatTextures[1] = DefaultSpecular;
+        if (!diffusePath.empty() || pMaterial.texSpecularPath[0] != '\0')
         {
-            MatTextures[1] = TextureManager::LoadFromFile(std::string(pMaterial.texDiffusePath) + "_specular", true);
-            if (!MatTextures[1]->IsValid())
-                MatTextures[1] = TextureManager::LoadFromFile("default_specular", true);
+            MatTextures[1] = TextureManager::LoadFromFileAsync(specularPath, true,
+                TextureManager::kLoadPriorityLow, DefaultSpecular);
         }
 
         // Load emissive
         //MatTextures[2] = TextureManager::LoadFromFile(pMaterial.texEmissivePath, true);
 
         // Load normal
-        MatTextures[3] = TextureManager::LoadFromFile(pMaterial.texNormalPath, false);
-        if (!MatTextures[3]->IsValid())
+        const std::string normalPath = pMaterial.texNormalPath[0] != '\0' ? pMaterial.texNormalPath : diffusePath + "_normal";
+        MatTextures[3] = DefaultNormal;
+        if (!diffusePath.empty() || pMaterial.texNormalPath[0] != '\0')
         {
-            MatTextures[3] = TextureManager::LoadFromFile(std::string(pMaterial.texDiffusePath) + "_normal", false);
-            if (!MatTextures[3]->IsValid())
-                MatTextures[3] = TextureManager::LoadFromFile("default_normal", false);
+            MatTextures[3] = TextureManager::LoadFromFileAsync(normalPath, false,
+                TextureManager::kLoadPriorityNormal, DefaultNormal);
         }
 
         // Load lightmap
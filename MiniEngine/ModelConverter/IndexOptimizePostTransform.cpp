@@ -461,3 +461,35 @@ void OptimizeFaces(const IndexType* indexList, uint32_t indexCount, IndexType* n
     delete [] faceSorted;
     delete [] faceReverseLookup;
 }
+
+template <typename IndexType>
+uint32_t ComputeVertexTransformCount(const IndexType* indexList, uint32_t indexCount, uint32_t fifoCacheSize)
+{
+    assert(fifoCacheSize > 0 && fifoCacheSize <= kMaxVertexCacheSize);
+
+    IndexType cache[kMaxVertexCacheSize];
+    uint32_t cacheEntries = 0;
+    uint32_t cacheHead = 0;
+    uint32_t transformCount = 0;
+
+    for (uint32_t i = 0; i < indexCount; ++i)
+    {
+        IndexType index = indexList[i];
+        if (std::find(cache, cache + cacheEntries, index) != cache + cacheEntries)
+            continue;
+
+        // a miss shades the vertex and pushes it into the FIFO, evicting the oldest entry when full
+        transformCount++;
+        if (cacheEntries < fifoCacheSize)
+        {
+            cache[cacheEntries++] = index;
+        }
+        else
+        {
+            cache[cacheHead] = index;
+            cacheHead = (cacheHead + 1) % fifoCacheSize;
+        }
+    }
+
+    return transformCount;
+}
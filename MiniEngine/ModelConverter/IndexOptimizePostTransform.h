@@ -32,3 +32,16 @@ void OptimizeFaces(const IndexType* indexList, uint32_t indexCount, IndexType* n
 
 template void OptimizeFaces<uint16_t>(const uint16_t* indexList, uint32_t indexCount, uint16_t* newIndexList, uint16_t lruCacheSize);
 template void OptimizeFaces<uint32_t>(const uint32_t* indexList, uint32_t indexCount, uint32_t* newIndexList, uint16_t lruCacheSize);
+
+//-----------------------------------------------------------------------------
+//  ComputeVertexTransformCount
+//-----------------------------------------------------------------------------
+//  Returns how many vertices a FIFO post-transform cache of fifoCacheSize
+//  entries would shade for indexList.  Divided by the triangle count this is
+//  the ACMR; divided by the unique vertex count it is the ATVR (1.0 is ideal).
+//-----------------------------------------------------------------------------
+template <typename IndexType>
+uint32_t ComputeVertexTransformCount(const IndexType* indexList, uint32_t indexCount, uint32_t fifoCacheSize);
+
+template uint32_t ComputeVertexTransformCount<uint16_t>(const uint16_t* indexList, uint32_t indexCount, uint32_t fifoCacheSize);
+template uint32_t ComputeVertexTransformCount<uint32_t>(const uint32_t* indexList, uint32_t indexCount, uint32_t fifoCacheSize);
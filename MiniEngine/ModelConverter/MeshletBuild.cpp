@@ -0,0 +1,175 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "MeshletBuild.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace
+{
+    const uint8_t kNotInMeshlet = 0xff;
+
+    struct Float3
+    {
+        float x, y, z;
+    };
+
+    inline Float3 LoadPosition(const unsigned char* positionData, uint32_t vertexStride, uint32_t index)
+    {
+        Float3 p;
+        memcpy(&p, positionData + (size_t)index * vertexStride, sizeof(p));
+        return p;
+    }
+
+    inline Float3 Sub(const Float3& a, const Float3& b) { Float3 r = { a.x - b.x, a.y - b.y, a.z - b.z }; return r; }
+    inline float Dot(const Float3& a, const Float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    inline Float3 Cross(const Float3& a, const Float3& b)
+    {
+        Float3 r = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+        return r;
+    }
+
+    void ComputeMeshletBounds(Model::Meshlet& meshlet, const uint32_t* vertices, const uint32_t* triangles,
+        const unsigned char* positionData, uint32_t vertexStride)
+    {
+        // sphere around the box center; loose, but cheap and never smaller than the meshlet
+        Float3 boxMin = { FLT_MAX, FLT_MAX, FLT_MAX };
+        Float3 boxMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        for (uint32_t v = 0; v < meshlet.vertexCount; ++v)
+        {
+            Float3 p = LoadPosition(positionData, vertexStride, vertices[v]);
+            boxMin.x = std::min(boxMin.x, p.x); boxMax.x = std::max(boxMax.x, p.x);
+            boxMin.y = std::min(boxMin.y, p.y); boxMax.y = std::max(boxMax.y, p.y);
+            boxMin.z = std::min(boxMin.z, p.z); boxMax.z = std::max(boxMax.z, p.z);
+        }
+        Float3 center = { (boxMin.x + boxMax.x) * 0.5f, (boxMin.y + boxMax.y) * 0.5f, (boxMin.z + boxMax.z) * 0.5f };
+
+        float radiusSq = 0.0f;
+        for (uint32_t v = 0; v < meshlet.vertexCount; ++v)
+        {
+            Float3 d = Sub(LoadPosition(positionData, vertexStride, vertices[v]), center);
+            radiusSq = std::max(radiusSq, Dot(d, d));
+        }
+
+        meshlet.boundingSphere[0] = center.x;
+        meshlet.boundingSphere[1] = center.y;
+        meshlet.boundingSphere[2] = center.z;
+        meshlet.boundingSphere[3] = sqrtf(radiusSq);
+
+        // normal cone: average the unit face normals, then find the widest deviation from it
+        const uint32_t kMaxTriangles = Model::maxMeshletTriangles;
+        Float3 normals[kMaxTriangles];
+        Float3 axis = { 0.0f, 0.0f, 0.0f };
+        uint32_t normalCount = 0;
+        for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+        {
+            uint32_t packed = triangles[t];
+            Float3 p0 = LoadPosition(positionData, vertexStride, vertices[(packed >> 0) & 0xff]);
+            Float3 p1 = LoadPosition(positionData, vertexStride, vertices[(packed >> 8) & 0xff]);
+            Float3 p2 = LoadPosition(positionData, vertexStride, vertices[(packed >> 16) & 0xff]);
+
+            Float3 n = Cross(Sub(p1, p0), Sub(p2, p0));
+            float length = sqrtf(Dot(n, n));
+            if (length == 0.0f)
+                continue; // degenerate triangles can face any way and don't constrain the cone
+
+            n.x /= length; n.y /= length; n.z /= length;
+            normals[normalCount++] = n;
+            axis.x += n.x; axis.y += n.y; axis.z += n.z;
+        }
+
+        meshlet.coneAxis[0] = meshlet.coneAxis[1] = meshlet.coneAxis[2] = 0.0f;
+        meshlet.coneCutoff = 1.0f;
+
+        float axisLength = sqrtf(Dot(axis, axis));
+        if (normalCount == 0 || axisLength == 0.0f)
+            return;
+
+        axis.x /= axisLength; axis.y /= axisLength; axis.z /= axisLength;
+        float minDot = 1.0f;
+        for (uint32_t t = 0; t < normalCount; ++t)
+            minDot = std::min(minDot, Dot(normals[t], axis));
+
+        meshlet.coneAxis[0] = axis.x;
+        meshlet.coneAxis[1] = axis.y;
+        meshlet.coneAxis[2] = axis.z;
+
+        // past ~84 degrees of spread the cone can hardly ever cull, so leave it disabled
+        if (minDot > 0.1f)
+            meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+    }
+}
+
+void BuildMeshlets(const uint16_t* indexList, uint32_t indexCount,
+    const unsigned char* positionData, uint32_t vertexStride, uint32_t vertexCount,
+    std::vector<Model::Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices, std::vector<uint32_t>& meshletTriangles)
+{
+    // meshlet-relative index of each mesh vertex in the meshlet being filled
+    std::vector<uint8_t> localIndex(vertexCount, kNotInMeshlet);
+
+    Model::Meshlet current = {};
+    current.vertexOffset = (uint32_t)meshletVertices.size();
+    current.triangleOffset = (uint32_t)meshletTriangles.size();
+
+    auto flush = [&]()
+    {
+        if (current.triangleCount == 0)
+            return;
+
+        ComputeMeshletBounds(current, meshletVertices.data() + current.vertexOffset,
+            meshletTriangles.data() + current.triangleOffset, positionData, vertexStride);
+        meshlets.push_back(current);
+
+        for (uint32_t v = 0; v < current.vertexCount; ++v)
+            localIndex[meshletVertices[current.vertexOffset + v]] = kNotInMeshlet;
+
+        current = Model::Meshlet();
+        current.vertexOffset = (uint32_t)meshletVertices.size();
+        current.triangleOffset = (uint32_t)meshletTriangles.size();
+    };
+
+    for (uint32_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        const uint16_t* tri = indexList + i;
+
+        uint32_t newVertices = 0;
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            if (localIndex[tri[k]] == kNotInMeshlet && (k == 0 || tri[k] != tri[0]) && (k < 2 || tri[k] != tri[1]))
+                newVertices++;
+        }
+
+        if (current.vertexCount + newVertices > Model::maxMeshletVertices ||
+            current.triangleCount + 1 > Model::maxMeshletTriangles)
+        {
+            flush();
+        }
+
+        uint32_t packed = 0;
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            uint8_t& local = localIndex[tri[k]];
+            if (local == kNotInMeshlet)
+            {
+                local = (uint8_t)current.vertexCount++;
+                meshletVertices.push_back(tri[k]);
+            }
+            packed |= (uint32_t)local << (k * 8);
+        }
+        meshletTriangles.push_back(packed);
+        current.triangleCount++;
+    }
+
+    flush();
+}
@@ -0,0 +1,40 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#pragma once
+
+#include "Model.h"
+
+#include <stdint.h>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+//  BuildMeshlets
+//-----------------------------------------------------------------------------
+//  Packs triangles into meshlets of at most Model::maxMeshletVertices
+//  vertices and Model::maxMeshletTriangles triangles, taking them in index
+//  order so a cache-optimized list yields compact clusters.  Each meshlet gets
+//  a bounding sphere and a normal cone for culling.
+//
+//  Parameters:
+//      indexList, indexCount
+//          the mesh's triangle list
+//      positionData
+//          the first vertex's float3 position
+//      vertexStride, vertexCount
+//          byte stride between positions and how many there are
+//      meshlets, meshletVertices, meshletTriangles
+//          appended to; offsets in new meshlets are relative to the sizes of
+//          meshletVertices and meshletTriangles on entry
+//-----------------------------------------------------------------------------
+void BuildMeshlets(const uint16_t* indexList, uint32_t indexCount,
+    const unsigned char* positionData, uint32_t vertexStride, uint32_t vertexCount,
+    std::vector<Model::Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices, std::vector<uint32_t>& meshletTriangles);
@@ -39,6 +39,13 @@ int AssimpModel::FormatFromFilename(const char *filename)
     return format_none;
 }
 
+AssimpModel::AssimpModel()
+    : m_VertexWeldTolerance(0.0f)
+    , m_BuildMeshlets(false)
+    , m_QuantizeVertices(false)
+{
+}
+
 bool AssimpModel::Load(const char *filename)
 {
     Clear();
@@ -27,9 +27,21 @@ public:
     static const char *s_FormatString[];
     static int FormatFromFilename(const char *filename);
 
+    AssimpModel();
+
     virtual bool Load(const char* filename) override;
     bool Save(const char* filename) const;
 
+    // vertices whose float components fall into the same cell of a grid with this
+    // spacing are merged when deduplicating.  Zero (the default) merges exact matches only.
+    void SetVertexWeldTolerance(float tolerance) { m_VertexWeldTolerance = tolerance; }
+
+    // when set, the main (non-depth) index data is also split into meshlets with culling bounds
+    void SetBuildMeshlets(bool buildMeshlets) { m_BuildMeshlets = buildMeshlets; }
+
+    // when set, vertices are written in the quantized layout described in Model.h
+    void SetQuantizeVertices(bool quantizeVertices) { m_QuantizeVertices = quantizeVertices; }
+
 private:
 
     bool LoadAssimp(const char *filename);
@@ -37,6 +49,13 @@ private:
     void Optimize();
     void OptimizeRemoveDuplicateVertices(bool depth);
     void OptimizePostTransform(bool depth);
-    void OptimizePreTransform(bool depth);
+    void OptimizePreTransform();
+    bool IsDepthProjection(const Mesh *mesh) const;
+    void BuildMeshlets();
+    void OptimizeQuantizeVertices();
+
+    float m_VertexWeldTolerance;
+    bool m_BuildMeshlets;
+    bool m_QuantizeVertices;
 };
 
@@ -12,15 +12,102 @@
 //
 
 #include "ModelAssimp.h"
+#include "VertexDeduplicate.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
 
 void PrintHelp()
 {
     printf("model_convert\n");
 
     printf("usage:\n");
-    printf("model_convert input_file output_file\n");
+    printf("model_convert [options] input_file output_file\n");
+    printf("model_convert -benchmark_dedup\n");
+    printf("options:\n");
+    printf("  -weld <tolerance>   merge vertices whose components are within a grid cell of this size\n");
+    printf("  -meshlets           also write meshlets (<=64 vertices, <=126 triangles) with culling bounds\n");
+    printf("  -quantize           16-bit positions, octahedral normals and tangents (28 instead of 56 byte vertices)\n");
+}
+
+// Generates a triangle soup for a grid of quads (6 vertices per quad, 4 of them unique),
+// with a 56 byte vertex to match the converter's float layout.
+static unsigned char* GenerateSyntheticMesh(uint32_t quadsPerSide, uint32_t vertexStride, uint32_t &vertexCount)
+{
+    vertexCount = quadsPerSide * quadsPerSide * 6;
+    unsigned char *vertexData = new unsigned char [(size_t)vertexCount * vertexStride];
+    memset(vertexData, 0, (size_t)vertexCount * vertexStride);
+
+    static const uint32_t cornerX[6] = { 0, 1, 1, 0, 1, 0 };
+    static const uint32_t cornerY[6] = { 0, 0, 1, 0, 1, 1 };
+
+    uint32_t v = 0;
+    for (uint32_t y = 0; y < quadsPerSide; y++)
+    {
+        for (uint32_t x = 0; x < quadsPerSide; x++)
+        {
+            for (uint32_t c = 0; c < 6; c++, v++)
+            {
+                float *f = (float*)(vertexData + (size_t)v * vertexStride);
+                f[0] = (float)(x + cornerX[c]);
+                f[1] = 0.0f;
+                f[2] = (float)(y + cornerY[c]);
+                f[3] = f[0] / quadsPerSide;
+                f[4] = f[2] / quadsPerSide;
+                f[6] = 1.0f; // normal +y
+            }
+        }
+    }
+
+    return vertexData;
+}
+
+static int BenchmarkDeduplication()
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    const uint32_t vertexStride = 56;
+
+    printf("vertex deduplication benchmark (%u byte vertices)\n", vertexStride);
+    printf("%10s %10s %14s %14s %10s\n", "vertices", "unique", "brute ms", "hashed ms", "speedup");
+
+    bool ok = true;
+    for (uint32_t quadsPerSide = 16; quadsPerSide <= 128; quadsPerSide *= 2)
+    {
+        uint32_t vertexCount = 0;
+        unsigned char *src = GenerateSyntheticMesh(quadsPerSide, vertexStride, vertexCount);
+        unsigned char *dstBrute = new unsigned char [(size_t)vertexCount * vertexStride];
+        unsigned char *dstHashed = new unsigned char [(size_t)vertexCount * vertexStride];
+        uint32_t *remapBrute = new uint32_t [vertexCount];
+        uint32_t *remapHashed = new uint32_t [vertexCount];
+
+        Clock::time_point t0 = Clock::now();
+        uint32_t uniqueBrute = DeduplicateVerticesBruteForce(src, vertexCount, vertexStride, dstBrute, remapBrute);
+        Clock::time_point t1 = Clock::now();
+        uint32_t uniqueHashed = DeduplicateVerticesHashed(src, vertexCount, vertexStride, dstHashed, remapHashed);
+        Clock::time_point t2 = Clock::now();
+
+        double bruteMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        double hashedMs = std::chrono::duration<double, std::milli>(t2 - t1).count();
+        printf("%10u %10u %14.3f %14.3f %9.1fx\n", vertexCount, uniqueHashed, bruteMs, hashedMs, bruteMs / hashedMs);
+
+        if (uniqueBrute != uniqueHashed
+            || 0 != memcmp(remapBrute, remapHashed, sizeof(uint32_t) * vertexCount)
+            || 0 != memcmp(dstBrute, dstHashed, (size_t)uniqueBrute * vertexStride))
+        {
+            printf("mismatch between brute force and hashed output\n");
+            ok = false;
+        }
+
+        delete [] src;
+        delete [] dstBrute;
+        delete [] dstHashed;
+        delete [] remapBrute;
+        delete [] remapHashed;
+    }
+
+    return ok ? 0 : -1;
 }
 
 void PrintModelStats(const Model *model)
@@ -112,20 +199,46 @@ void PrintModelStats(const Model *model)
 
 int main(int argc, char **argv)
 {
-    if (argc != 3)
+    AssimpModel model;
+
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++)
+    {
+        if (0 == strcmp(argv[arg], "-benchmark_dedup"))
+        {
+            return BenchmarkDeduplication();
+        }
+        else if (0 == strcmp(argv[arg], "-weld") && arg + 1 < argc)
+        {
+            model.SetVertexWeldTolerance((float)atof(argv[++arg]));
+        }
+        else if (0 == strcmp(argv[arg], "-meshlets"))
+        {
+            model.SetBuildMeshlets(true);
+        }
+        else if (0 == strcmp(argv[arg], "-quantize"))
+        {
+            model.SetQuantizeVertices(true);
+        }
+        else
+        {
+            PrintHelp();
+            return -1;
+        }
+    }
+
+    if (argc - arg != 2)
     {
         PrintHelp();
         return -1;
     }
 
-    const char *input_file = argv[1];
-    const char *output_file = argv[2];
+    const char *input_file = argv[arg];
+    const char *output_file = argv[arg + 1];
 
     printf("input file %s\n", input_file);
     printf("output file %s\n", output_file);
 
-    AssimpModel model;
-
     printf("loading...\n");
     if (!model.Load(input_file))
     {
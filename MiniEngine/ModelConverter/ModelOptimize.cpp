@@ -13,8 +13,17 @@
 
 #include "ModelAssimp.h"
 #include "IndexOptimizePostTransform.h"
+#include "VertexDeduplicate.h"
+#include "MeshletBuild.h"
+#include "VertexFetchCache.h"
+#include "VertexQuantize.h"
 
+#include <math.h>
+#include <stdio.h>
 #include <string.h>
+#include <algorithm>
+#include <vector>
+#include <ppl.h>
 
 void AssimpModel::OptimizeRemoveDuplicateVertices(bool depth)
 {
@@ -28,39 +37,12 @@ void AssimpModel::OptimizeRemoveDuplicateVertices(bool depth)
         unsigned char *meshVertexData = depth ? (m_pVertexDataDepth + mesh->vertexDataByteOffsetDepth) : (m_pVertexData + mesh->vertexDataByteOffset);
 
         unsigned char *meshDeduplicatedVertexData = deduplicatedVertexData + deduplicatedVertexDataSize;
-        unsigned int deduplicatedCount = 0;
 
         unsigned int vertexCount = depth ? mesh->vertexCountDepth : mesh->vertexCount;
         uint32_t *vertexRemap = new uint32_t [vertexCount];
-        memset(vertexRemap, (uint32_t)-1, sizeof(uint32_t) * vertexCount);
-        assert(vertexCount <= (uint32_t)-1);
-
-        for (unsigned int v1 = 0; v1 < vertexCount; v1++)
-        {
-            if (vertexRemap[v1] != (uint32_t)-1)
-                continue; // this was already found to be a duplicate
-
-            const unsigned char *v1Data = meshVertexData + v1 * vertexStride;
-
-            // this is a new unique vertex
-            uint32_t remappedSlot = deduplicatedCount++;
-            vertexRemap[v1] = remappedSlot;
-            memcpy(meshDeduplicatedVertexData + remappedSlot * vertexStride, v1Data, vertexStride);
 
-            // scan for duplicates
-            for (unsigned int v2 = v1 + 1; v2 < vertexCount; v2++)
-            {
-                if (vertexRemap[v2] != (uint32_t)-1)
-                    continue; // this was already found to be a duplicate of another vertex
-
-                const unsigned char *v2Data = meshVertexData + v2 * vertexStride;
-
-                if (0 == memcmp(v1Data, v2Data, vertexStride))
-                {
-                    vertexRemap[v2] = remappedSlot;
-                }
-            }
-        }
+        unsigned int deduplicatedCount = DeduplicateVerticesHashed(meshVertexData, vertexCount, vertexStride,
+            meshDeduplicatedVertexData, vertexRemap, m_VertexWeldTolerance);
 
         unsigned int indexCount = mesh->indexCount;
         uint16_t *indexArray = (uint16_t*)((depth ? m_pIndexDataDepth : m_pIndexData) + mesh->indexDataByteOffset);
@@ -101,8 +83,13 @@ void AssimpModel::OptimizeRemoveDuplicateVertices(bool depth)
 void AssimpModel::OptimizePostTransform(bool depth)
 {
     enum {lruCacheSize = 64};
+    enum {fifoCacheSize = 32}; // only used for the ACMR/ATVR report
 
-    for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
+    // meshes own disjoint index ranges, so they can be optimized in parallel
+    std::vector<uint32_t> transformsBefore(m_Header.meshCount);
+    std::vector<uint32_t> transformsAfter(m_Header.meshCount);
+
+    concurrency::parallel_for(0u, m_Header.meshCount, [&](unsigned int meshIndex)
     {
         Mesh *mesh = m_pMesh + meshIndex;
 
@@ -110,67 +97,470 @@ void AssimpModel::OptimizePostTransform(bool depth)
         uint16_t *dstIndices = (uint16_t*)((depth ? m_pIndexDataDepth : m_pIndexData) + mesh->indexDataByteOffset);
         memcpy(srcIndices, dstIndices, sizeof(uint16_t) * mesh->indexCount);
 
+        transformsBefore[meshIndex] = ComputeVertexTransformCount<uint16_t>(srcIndices, mesh->indexCount, fifoCacheSize);
         OptimizeFaces<uint16_t>(srcIndices, mesh->indexCount, dstIndices, lruCacheSize);
+        transformsAfter[meshIndex] = ComputeVertexTransformCount<uint16_t>(dstIndices, mesh->indexCount, fifoCacheSize);
 
         delete [] srcIndices;
+    });
+
+    uint64_t triangleCount = 0, vertexCount = 0, before = 0, after = 0;
+    for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
+    {
+        const Mesh *mesh = m_pMesh + meshIndex;
+        triangleCount += mesh->indexCount / 3;
+        vertexCount += depth ? mesh->vertexCountDepth : mesh->vertexCount;
+        before += transformsBefore[meshIndex];
+        after += transformsAfter[meshIndex];
+    }
+
+    if (triangleCount > 0 && vertexCount > 0)
+    {
+        printf("post-transform cache%s (%u entry FIFO): ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+            depth ? " (depth)" : "", (uint32_t)fifoCacheSize,
+            (double)before / triangleCount, (double)after / triangleCount,
+            (double)before / vertexCount, (double)after / vertexCount);
     }
 }
 
-void AssimpModel::OptimizePreTransform(bool depth)
+void AssimpModel::BuildMeshlets()
 {
-    unsigned char *reorderedVertexData = new unsigned char [depth ? m_Header.vertexDataByteSizeDepth : m_Header.vertexDataByteSize];
+    // built per mesh in parallel, then concatenated in mesh order
+    std::vector<std::vector<Meshlet>> meshMeshlets(m_Header.meshCount);
+    std::vector<std::vector<uint32_t>> meshVertices(m_Header.meshCount);
+    std::vector<std::vector<uint32_t>> meshTriangles(m_Header.meshCount);
 
+    concurrency::parallel_for(0u, m_Header.meshCount, [&](unsigned int meshIndex)
+    {
+        const Mesh *mesh = m_pMesh + meshIndex;
+        const uint16_t *indices = (const uint16_t*)(m_pIndexData + mesh->indexDataByteOffset);
+        const unsigned char *positions = m_pVertexData + mesh->vertexDataByteOffset + mesh->attrib[attrib_position].offset;
+
+        ::BuildMeshlets(indices, mesh->indexCount, positions, mesh->vertexStride, mesh->vertexCount,
+            meshMeshlets[meshIndex], meshVertices[meshIndex], meshTriangles[meshIndex]);
+    });
+
+    delete [] m_pMeshletRange;
+    delete [] m_pMeshlet;
+    delete [] m_pMeshletVertices;
+    delete [] m_pMeshletTriangles;
+
+    m_MeshletHeader.tag = meshletTag;
+    m_MeshletHeader.meshletCount = 0;
+    m_MeshletHeader.vertexCount = 0;
+    m_MeshletHeader.triangleCount = 0;
     for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
     {
-        Mesh *mesh = m_pMesh + meshIndex;
-        unsigned int indexCount = mesh->indexCount;
-        unsigned int vertexStride = depth ? mesh->vertexStrideDepth : mesh->vertexStride;
-        unsigned char *meshVertexData = depth ? (m_pVertexDataDepth + mesh->vertexDataByteOffsetDepth) : (m_pVertexData + mesh->vertexDataByteOffset);
+        m_MeshletHeader.meshletCount += (uint32_t)meshMeshlets[meshIndex].size();
+        m_MeshletHeader.vertexCount += (uint32_t)meshVertices[meshIndex].size();
+        m_MeshletHeader.triangleCount += (uint32_t)meshTriangles[meshIndex].size();
+    }
 
-        unsigned char *meshReorderedVertexData = reorderedVertexData + (depth ? mesh->vertexDataByteOffsetDepth : mesh->vertexDataByteOffset);
-        unsigned int reorderedCount = 0;
+    m_pMeshletRange = new MeshletRange [m_Header.meshCount];
+    m_pMeshlet = new Meshlet [m_MeshletHeader.meshletCount];
+    m_pMeshletVertices = new uint32_t [m_MeshletHeader.vertexCount];
+    m_pMeshletTriangles = new uint32_t [m_MeshletHeader.triangleCount];
 
-        unsigned int vertexCount = depth ? mesh->vertexCountDepth : mesh->vertexCount;
-        uint32_t *vertexRemap = new uint32_t [vertexCount];
+    uint32_t meshletOffset = 0, vertexOffset = 0, triangleOffset = 0;
+    for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
+    {
+        m_pMeshletRange[meshIndex].meshletOffset = meshletOffset;
+        m_pMeshletRange[meshIndex].meshletCount = (uint32_t)meshMeshlets[meshIndex].size();
+
+        for (Meshlet meshlet : meshMeshlets[meshIndex])
+        {
+            meshlet.vertexOffset += vertexOffset;
+            meshlet.triangleOffset += triangleOffset;
+            m_pMeshlet[meshletOffset++] = meshlet;
+        }
+
+        if (!meshVertices[meshIndex].empty())
+            memcpy(m_pMeshletVertices + vertexOffset, meshVertices[meshIndex].data(), sizeof(uint32_t) * meshVertices[meshIndex].size());
+        if (!meshTriangles[meshIndex].empty())
+            memcpy(m_pMeshletTriangles + triangleOffset, meshTriangles[meshIndex].data(), sizeof(uint32_t) * meshTriangles[meshIndex].size());
+        vertexOffset += (uint32_t)meshVertices[meshIndex].size();
+        triangleOffset += (uint32_t)meshTriangles[meshIndex].size();
+    }
+
+    if (m_MeshletHeader.meshletCount > 0)
+    {
+        printf("meshlets: %u (%.1f vertices, %.1f triangles on average)\n", m_MeshletHeader.meshletCount,
+            (double)m_MeshletHeader.vertexCount / m_MeshletHeader.meshletCount,
+            (double)m_MeshletHeader.triangleCount / m_MeshletHeader.meshletCount);
+    }
+}
+
+namespace
+{
+    // Numbers vertices in the order the index list first references them.  Unreferenced
+    // vertices follow in their original order, so the remap is always a permutation.
+    void ComputeFirstUseRemap(const uint16_t *indexArray, unsigned int indexCount, unsigned int vertexCount, uint32_t *vertexRemap)
+    {
         memset(vertexRemap, (uint32_t)-1, sizeof(uint32_t) * vertexCount);
-        assert(vertexCount <= (uint32_t)-1);
 
-        uint16_t *indexArray = (uint16_t*)((depth ? m_pIndexDataDepth : m_pIndexData) + mesh->indexDataByteOffset);
+        uint32_t reorderedCount = 0;
         for (unsigned int n = 0; n < indexCount; n++)
         {
             uint16_t index = indexArray[n];
             if (vertexRemap[index] == (uint32_t)-1)
+                vertexRemap[index] = reorderedCount++;
+        }
+        for (unsigned int v = 0; v < vertexCount; v++)
+        {
+            if (vertexRemap[v] == (uint32_t)-1)
+                vertexRemap[v] = reorderedCount++;
+        }
+        assert(reorderedCount == vertexCount);
+    }
+
+    void ApplyVertexRemap(const uint32_t *vertexRemap, unsigned int vertexCount, unsigned int vertexStride,
+        const unsigned char *srcVertexData, unsigned char *dstVertexData, uint16_t *indexArray, unsigned int indexCount)
+    {
+        for (unsigned int v = 0; v < vertexCount; v++)
+            memcpy(dstVertexData + vertexRemap[v] * vertexStride, srcVertexData + v * vertexStride, vertexStride);
+
+        for (unsigned int n = 0; n < indexCount; n++)
+            indexArray[n] = (uint16_t)vertexRemap[indexArray[n]];
+    }
+
+    // vertex fetch is simulated with 32 and 64 byte lines in a cache of this size
+    const uint32_t fetchCacheSizeBytes = 4096;
+    const uint32_t fetchLineSizes[] = { 32, 64 };
+    const unsigned int fetchLineSizeCount = _countof(fetchLineSizes);
+
+    struct FetchStats
+    {
+        uint64_t accesses[fetchLineSizeCount];
+        uint64_t missesBefore[fetchLineSizeCount];
+        uint64_t missesAfter[fetchLineSizeCount];
+    };
+
+    void MeasureFetchMisses(const uint16_t *indexArray, unsigned int indexCount, uint32_t vertexDataByteOffset,
+        unsigned int vertexStride, uint64_t *accesses, uint64_t *misses)
+    {
+        for (unsigned int i = 0; i < fetchLineSizeCount; i++)
+        {
+            misses[i] = ComputeVertexFetchMisses(indexArray, indexCount, vertexDataByteOffset, vertexStride,
+                fetchLineSizes[i], fetchCacheSizeBytes, accesses[i]);
+        }
+    }
+}
+
+bool AssimpModel::IsDepthProjection(const Mesh *mesh) const
+{
+    // the depth stream starts out as a position-only copy of the main stream, and stays one
+    // unless deduplication merged vertices that only differ in non-position attributes
+    if (mesh->vertexCountDepth != mesh->vertexCount)
+        return false;
+
+    const unsigned char *indices = m_pIndexData + mesh->indexDataByteOffset;
+    const unsigned char *indicesDepth = m_pIndexDataDepth + mesh->indexDataByteOffset;
+    if (memcmp(indices, indicesDepth, sizeof(uint16_t) * mesh->indexCount) != 0)
+        return false;
+
+    const unsigned char *positions = m_pVertexData + mesh->vertexDataByteOffset + mesh->attrib[attrib_position].offset;
+    const unsigned char *positionsDepth = m_pVertexDataDepth + mesh->vertexDataByteOffsetDepth + mesh->attribDepth[attrib_position].offset;
+    const size_t positionSize = sizeof(float) * 3;
+    for (unsigned int v = 0; v < mesh->vertexCount; v++)
+    {
+        if (memcmp(positions + v * mesh->vertexStride, positionsDepth + v * mesh->vertexStrideDepth, positionSize) != 0)
+            return false;
+    }
+    return true;
+}
+
+void AssimpModel::OptimizePreTransform()
+{
+    unsigned char *reorderedVertexData = new unsigned char [m_Header.vertexDataByteSize];
+    unsigned char *reorderedVertexDataDepth = new unsigned char [m_Header.vertexDataByteSizeDepth];
+
+    std::vector<FetchStats> fetchStats(m_Header.meshCount);
+    std::vector<FetchStats> fetchStatsDepth(m_Header.meshCount);
+    std::vector<char> sharedRemap(m_Header.meshCount);
+
+    // both streams of a mesh are reordered together; meshes write disjoint ranges
+    concurrency::parallel_for(0u, m_Header.meshCount, [&](unsigned int meshIndex)
+    {
+        const Mesh *mesh = m_pMesh + meshIndex;
+        unsigned int indexCount = mesh->indexCount;
+        uint16_t *indexArray = (uint16_t*)(m_pIndexData + mesh->indexDataByteOffset);
+        uint16_t *indexArrayDepth = (uint16_t*)(m_pIndexDataDepth + mesh->indexDataByteOffset);
+
+        FetchStats &stats = fetchStats[meshIndex];
+        FetchStats &statsDepth = fetchStatsDepth[meshIndex];
+        MeasureFetchMisses(indexArray, indexCount, mesh->vertexDataByteOffset, mesh->vertexStride, stats.accesses, stats.missesBefore);
+        MeasureFetchMisses(indexArrayDepth, indexCount, mesh->vertexDataByteOffsetDepth, mesh->vertexStrideDepth, statsDepth.accesses, statsDepth.missesBefore);
+
+        // must be checked before either index list is rewritten
+        sharedRemap[meshIndex] = IsDepthProjection(mesh);
+
+        std::vector<uint32_t> vertexRemap(mesh->vertexCount);
+        ComputeFirstUseRemap(indexArray, indexCount, mesh->vertexCount, vertexRemap.data());
+
+        // a projection keeps vertex i of both streams paired, so the depth index list is
+        // identical to the main one after the shared remap as well
+        std::vector<uint32_t> vertexRemapDepth;
+        if (!sharedRemap[meshIndex])
+        {
+            vertexRemapDepth.resize(mesh->vertexCountDepth);
+            ComputeFirstUseRemap(indexArrayDepth, indexCount, mesh->vertexCountDepth, vertexRemapDepth.data());
+        }
+        const uint32_t *remapDepth = sharedRemap[meshIndex] ? vertexRemap.data() : vertexRemapDepth.data();
+
+        ApplyVertexRemap(vertexRemap.data(), mesh->vertexCount, mesh->vertexStride,
+            m_pVertexData + mesh->vertexDataByteOffset, reorderedVertexData + mesh->vertexDataByteOffset,
+            indexArray, indexCount);
+        ApplyVertexRemap(remapDepth, mesh->vertexCountDepth, mesh->vertexStrideDepth,
+            m_pVertexDataDepth + mesh->vertexDataByteOffsetDepth, reorderedVertexDataDepth + mesh->vertexDataByteOffsetDepth,
+            indexArrayDepth, indexCount);
+
+        MeasureFetchMisses(indexArray, indexCount, mesh->vertexDataByteOffset, mesh->vertexStride, stats.accesses, stats.missesAfter);
+        MeasureFetchMisses(indexArrayDepth, indexCount, mesh->vertexDataByteOffsetDepth, mesh->vertexStrideDepth, statsDepth.accesses, statsDepth.missesAfter);
+    });
+
+    delete [] m_pVertexData;
+    m_pVertexData = reorderedVertexData;
+    delete [] m_pVertexDataDepth;
+    m_pVertexDataDepth = reorderedVertexDataDepth;
+
+    unsigned int sharedCount = 0;
+    for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
+        sharedCount += sharedRemap[meshIndex] ? 1 : 0;
+    printf("pre-transform reorder: depth remap shared by %u of %u meshes\n", sharedCount, m_Header.meshCount);
+
+    for (unsigned int depth = 0; depth < 2; depth++)
+    {
+        const std::vector<FetchStats> &stats = depth ? fetchStatsDepth : fetchStats;
+        for (unsigned int i = 0; i < fetchLineSizeCount; i++)
+        {
+            uint64_t accesses = 0, before = 0, after = 0;
+            for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
             {
-                // not relocated yet
-                const unsigned char *vSrc = meshVertexData + index * vertexStride;
-                unsigned char *vDst = meshReorderedVertexData + reorderedCount * vertexStride;
-                memcpy(vDst, vSrc, vertexStride);
+                accesses += stats[meshIndex].accesses[i];
+                before += stats[meshIndex].missesBefore[i];
+                after += stats[meshIndex].missesAfter[i];
+            }
 
-                vertexRemap[index] = reorderedCount;
-                reorderedCount++;
+            if (accesses > 0)
+            {
+                printf("vertex fetch cache%s (%u byte lines, %u bytes): miss rate %.1f%% -> %.1f%%\n",
+                    depth ? " (depth)" : "", fetchLineSizes[i], fetchCacheSizeBytes,
+                    100.0 * before / accesses, 100.0 * after / accesses);
             }
-            indexArray[n] = vertexRemap[index];
         }
+    }
+}
 
-        delete [] vertexRemap;
+namespace
+{
+    struct QuantizeError
+    {
+        float positionMax;
+        float positionMaxRelative; // to the largest mesh extent
+        float normalMax, tangentMax, bitangentMax; // degrees
+        double normalSum, tangentSum, bitangentSum;
+        uint32_t directionCount;
+    };
+
+    inline void SetAttrib(Model::Attrib &attrib, uint16_t offset, uint16_t normalized, uint16_t components, uint16_t format)
+    {
+        attrib.offset = offset;
+        attrib.normalized = normalized;
+        attrib.components = components;
+        attrib.format = format;
     }
 
-    if (depth)
+    inline float Dot3(const float *a, const float *b)
     {
-        delete [] m_pVertexDataDepth;
-        m_pVertexDataDepth = reorderedVertexData;
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
     }
-    else
+
+    // degrees between two directions, or 0 if either is degenerate
+    float AngleBetween(const float *a, const float *b)
     {
-        delete [] m_pVertexData;
-        m_pVertexData = reorderedVertexData;
+        float lengthSq = Dot3(a, a) * Dot3(b, b);
+        if (lengthSq <= 0.0f)
+            return 0.0f;
+
+        float cosine = Dot3(a, b) / sqrtf(lengthSq);
+        cosine = std::min(std::max(cosine, -1.0f), 1.0f);
+        return acosf(cosine) * (180.0f / 3.14159265f);
     }
 }
 
-void AssimpModel::Optimize()
+void AssimpModel::OptimizeQuantizeVertices()
 {
-    // TODO: quantize/compress vertex data
+    // position (ushort4, w unused), texcoord0 (float2), normal (short2), tangent (short4: octahedral xy, bitangent sign, unused)
+    const unsigned int quantizedStride = 28;
+    const unsigned int quantizedStrideDepth = 8;
+
+    uint32_t vertexDataByteSize = 0;
+    uint32_t vertexDataByteSizeDepth = 0;
+    std::vector<uint32_t> vertexDataByteOffset(m_Header.meshCount);
+    std::vector<uint32_t> vertexDataByteOffsetDepth(m_Header.meshCount);
+    for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
+    {
+        const Mesh *mesh = m_pMesh + meshIndex;
+        vertexDataByteOffset[meshIndex] = vertexDataByteSize;
+        vertexDataByteOffsetDepth[meshIndex] = vertexDataByteSizeDepth;
+        vertexDataByteSize += mesh->vertexCount * quantizedStride;
+        vertexDataByteSizeDepth += mesh->vertexCountDepth * quantizedStrideDepth;
+    }
+
+    unsigned char *quantizedVertexData = new unsigned char [vertexDataByteSize];
+    unsigned char *quantizedVertexDataDepth = new unsigned char [vertexDataByteSizeDepth];
+    std::vector<QuantizeError> errors(m_Header.meshCount);
+
+    concurrency::parallel_for(0u, m_Header.meshCount, [&](unsigned int meshIndex)
+    {
+        const Mesh *mesh = m_pMesh + meshIndex;
+        QuantizeError &error = errors[meshIndex];
+        memset(&error, 0, sizeof(error));
 
+        const float boundsMin[3] = { (float)mesh->boundingBox.min.GetX(), (float)mesh->boundingBox.min.GetY(), (float)mesh->boundingBox.min.GetZ() };
+        const float extent[3] =
+        {
+            (float)mesh->boundingBox.max.GetX() - boundsMin[0],
+            (float)mesh->boundingBox.max.GetY() - boundsMin[1],
+            (float)mesh->boundingBox.max.GetZ() - boundsMin[2],
+        };
+        const float maxExtent = std::max(extent[0], std::max(extent[1], extent[2]));
+
+        for (unsigned int v = 0; v < mesh->vertexCount; v++)
+        {
+            const unsigned char *src = m_pVertexData + mesh->vertexDataByteOffset + v * mesh->vertexStride;
+            unsigned char *dst = quantizedVertexData + vertexDataByteOffset[meshIndex] + v * quantizedStride;
+
+            float position[3], texcoord[2], normal[3], tangent[3], bitangent[3];
+            memcpy(position, src + mesh->attrib[attrib_position].offset, sizeof(position));
+            memcpy(texcoord, src + mesh->attrib[attrib_texcoord0].offset, sizeof(texcoord));
+            memcpy(normal, src + mesh->attrib[attrib_normal].offset, sizeof(normal));
+            memcpy(tangent, src + mesh->attrib[attrib_tangent].offset, sizeof(tangent));
+            memcpy(bitangent, src + mesh->attrib[attrib_bitangent].offset, sizeof(bitangent));
+
+            uint16_t quantizedPosition[4] = {};
+            for (int c = 0; c < 3; c++)
+            {
+                quantizedPosition[c] = QuantizeUnorm16(position[c], boundsMin[c], extent[c]);
+                float positionError = fabsf(DequantizeUnorm16(quantizedPosition[c], boundsMin[c], extent[c]) - position[c]);
+                error.positionMax = std::max(error.positionMax, positionError);
+                if (maxExtent > 0.0f)
+                    error.positionMaxRelative = std::max(error.positionMaxRelative, positionError / maxExtent);
+            }
+
+            float normalCrossTangent[3] =
+            {
+                normal[1] * tangent[2] - normal[2] * tangent[1],
+                normal[2] * tangent[0] - normal[0] * tangent[2],
+                normal[0] * tangent[1] - normal[1] * tangent[0],
+            };
+            const bool negativeBitangent = Dot3(normalCrossTangent, bitangent) < 0.0f;
+
+            int16_t quantizedNormal[2];
+            int16_t quantizedTangent[4] = { 0, 0, negativeBitangent ? (int16_t)-32767 : (int16_t)32767, 0 };
+            OctEncodeSnorm16(normal, quantizedNormal);
+            OctEncodeSnorm16(tangent, quantizedTangent);
+
+            memcpy(dst + 0, quantizedPosition, sizeof(quantizedPosition));
+            memcpy(dst + 8, texcoord, sizeof(texcoord));
+            memcpy(dst + 16, quantizedNormal, sizeof(quantizedNormal));
+            memcpy(dst + 20, quantizedTangent, sizeof(quantizedTangent));
+
+            // measure what the vertex shader will reconstruct
+            float decodedNormal[3], decodedTangent[3], decodedBitangent[3];
+            OctDecodeSnorm16(quantizedNormal, decodedNormal);
+            OctDecodeSnorm16(quantizedTangent, decodedTangent);
+            const float sign = negativeBitangent ? -1.0f : 1.0f;
+            decodedBitangent[0] = sign * (decodedNormal[1] * decodedTangent[2] - decodedNormal[2] * decodedTangent[1]);
+            decodedBitangent[1] = sign * (decodedNormal[2] * decodedTangent[0] - decodedNormal[0] * decodedTangent[2]);
+            decodedBitangent[2] = sign * (decodedNormal[0] * decodedTangent[1] - decodedNormal[1] * decodedTangent[0]);
+
+            float normalAngle = AngleBetween(normal, decodedNormal);
+            float tangentAngle = AngleBetween(tangent, decodedTangent);
+            float bitangentAngle = AngleBetween(bitangent, decodedBitangent);
+            error.normalMax = std::max(error.normalMax, normalAngle);
+            error.tangentMax = std::max(error.tangentMax, tangentAngle);
+            error.bitangentMax = std::max(error.bitangentMax, bitangentAngle);
+            error.normalSum += normalAngle;
+            error.tangentSum += tangentAngle;
+            error.bitangentSum += bitangentAngle;
+            error.directionCount++;
+        }
+
+        for (unsigned int v = 0; v < mesh->vertexCountDepth; v++)
+        {
+            const unsigned char *src = m_pVertexDataDepth + mesh->vertexDataByteOffsetDepth + v * mesh->vertexStrideDepth;
+            unsigned char *dst = quantizedVertexDataDepth + vertexDataByteOffsetDepth[meshIndex] + v * quantizedStrideDepth;
+
+            float position[3];
+            memcpy(position, src + mesh->attribDepth[attrib_position].offset, sizeof(position));
+
+            uint16_t quantizedPosition[4] = {};
+            for (int c = 0; c < 3; c++)
+                quantizedPosition[c] = QuantizeUnorm16(position[c], boundsMin[c], extent[c]);
+            memcpy(dst, quantizedPosition, sizeof(quantizedPosition));
+        }
+    });
+
+    for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
+    {
+        Mesh *mesh = m_pMesh + meshIndex;
+
+        memset(mesh->attrib, 0, sizeof(mesh->attrib));
+        SetAttrib(mesh->attrib[attrib_position], 0, 1, 3, attrib_format_ushort);
+        SetAttrib(mesh->attrib[attrib_texcoord0], 8, 0, 2, attrib_format_float);
+        SetAttrib(mesh->attrib[attrib_normal], 16, 1, 2, attrib_format_short);
+        SetAttrib(mesh->attrib[attrib_tangent], 20, 1, 3, attrib_format_short);
+        mesh->attribsEnabled = attrib_mask_position | attrib_mask_texcoord0 | attrib_mask_normal | attrib_mask_tangent;
+        mesh->vertexStride = quantizedStride;
+        mesh->vertexDataByteOffset = vertexDataByteOffset[meshIndex];
+
+        memset(mesh->attribDepth, 0, sizeof(mesh->attribDepth));
+        SetAttrib(mesh->attribDepth[attrib_position], 0, 1, 3, attrib_format_ushort);
+        mesh->attribsEnabledDepth = attrib_mask_position;
+        mesh->vertexStrideDepth = quantizedStrideDepth;
+        mesh->vertexDataByteOffsetDepth = vertexDataByteOffsetDepth[meshIndex];
+    }
+
+    printf("quantized vertex data: %u -> %u bytes, depth-only: %u -> %u bytes\n",
+        m_Header.vertexDataByteSize, vertexDataByteSize, m_Header.vertexDataByteSizeDepth, vertexDataByteSizeDepth);
+
+    delete [] m_pVertexData;
+    m_pVertexData = quantizedVertexData;
+    m_Header.vertexDataByteSize = vertexDataByteSize;
+    delete [] m_pVertexDataDepth;
+    m_pVertexDataDepth = quantizedVertexDataDepth;
+    m_Header.vertexDataByteSizeDepth = vertexDataByteSizeDepth;
+
+    QuantizeError total = {};
+    for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
+    {
+        const QuantizeError &error = errors[meshIndex];
+        total.positionMax = std::max(total.positionMax, error.positionMax);
+        total.positionMaxRelative = std::max(total.positionMaxRelative, error.positionMaxRelative);
+        total.normalMax = std::max(total.normalMax, error.normalMax);
+        total.tangentMax = std::max(total.tangentMax, error.tangentMax);
+        total.bitangentMax = std::max(total.bitangentMax, error.bitangentMax);
+        total.normalSum += error.normalSum;
+        total.tangentSum += error.tangentSum;
+        total.bitangentSum += error.bitangentSum;
+        total.directionCount += error.directionCount;
+    }
+
+    if (total.directionCount > 0)
+    {
+        printf("quantization error: position max %g (%.2g of mesh extent)\n", total.positionMax, total.positionMaxRelative);
+        printf("quantization error: normal max %.4f mean %.4f, tangent max %.4f mean %.4f degrees\n",
+            total.normalMax, total.normalSum / total.directionCount, total.tangentMax, total.tangentSum / total.directionCount);
+
+        // includes any non-orthogonality in the source tangent frame, which the sign cannot represent
+        printf("quantization error: reconstructed bitangent max %.4f mean %.4f degrees\n",
+            total.bitangentMax, total.bitangentSum / total.directionCount);
+    }
+}
+
+void AssimpModel::Optimize()
+{
     OptimizeRemoveDuplicateVertices(false);
     OptimizeRemoveDuplicateVertices(true);
 
@@ -179,6 +569,13 @@ void AssimpModel::Optimize()
     OptimizePostTransform(true);
 
     // re-order vertices for linear memory access
-    OptimizePreTransform(false);
-    OptimizePreTransform(true);
+    OptimizePreTransform();
+
+    // clusters reference final vertex and index order, so they are built last
+    if (m_BuildMeshlets)
+        BuildMeshlets();
+
+    // everything above reads float vertices
+    if (m_QuantizeVertices)
+        OptimizeQuantizeVertices();
 }
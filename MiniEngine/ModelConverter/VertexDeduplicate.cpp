@@ -0,0 +1,200 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author(s):  Alex Nankervis
+//
+
+#include "VertexDeduplicate.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+namespace
+{
+    const uint32_t kEmptySlot = (uint32_t)-1;
+
+    inline uint64_t HashMix(uint64_t h, uint32_t v)
+    {
+        h ^= v;
+        h *= 0x100000001b3ull; // FNV-1a prime, folded 32 bits at a time
+        return h;
+    }
+
+    inline uint64_t HashFinalize(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    inline int32_t QuantizeFloat(float f, float invStep)
+    {
+        return (int32_t)floorf(f * invStep + 0.5f);
+    }
+
+    struct ExactVertexKey
+    {
+        uint32_t stride;
+
+        uint64_t Hash(const unsigned char* v) const
+        {
+            uint64_t h = 0xcbf29ce484222325ull;
+            uint32_t n = 0;
+            for (; n + 4 <= stride; n += 4)
+            {
+                uint32_t word;
+                memcpy(&word, v + n, 4);
+                h = HashMix(h, word);
+            }
+            for (; n < stride; n++)
+                h = HashMix(h, v[n]);
+            return HashFinalize(h);
+        }
+
+        bool Equal(const unsigned char* a, const unsigned char* b) const
+        {
+            return 0 == memcmp(a, b, stride);
+        }
+    };
+
+    struct QuantizedVertexKey
+    {
+        uint32_t floatCount;
+        float invStep;
+
+        uint64_t Hash(const unsigned char* v) const
+        {
+            const float* f = (const float*)v;
+            uint64_t h = 0xcbf29ce484222325ull;
+            for (uint32_t n = 0; n < floatCount; n++)
+                h = HashMix(h, (uint32_t)QuantizeFloat(f[n], invStep));
+            return HashFinalize(h);
+        }
+
+        bool Equal(const unsigned char* a, const unsigned char* b) const
+        {
+            const float* fa = (const float*)a;
+            const float* fb = (const float*)b;
+            for (uint32_t n = 0; n < floatCount; n++)
+            {
+                if (QuantizeFloat(fa[n], invStep) != QuantizeFloat(fb[n], invStep))
+                    return false;
+            }
+            return true;
+        }
+    };
+
+    template <typename KeyType>
+    uint32_t DeduplicateWithTable(const KeyType& key, const unsigned char* srcVertexData, uint32_t vertexCount, uint32_t vertexStride,
+        unsigned char* dstVertexData, uint32_t* vertexRemap)
+    {
+        // keep the load factor at or below 0.5 so probe sequences stay short
+        uint32_t tableSize = 16;
+        while (tableSize < vertexCount * 2)
+            tableSize <<= 1;
+        const uint32_t tableMask = tableSize - 1;
+
+        // each entry is the slot of a unique vertex in dstVertexData
+        uint32_t* table = new uint32_t [tableSize];
+        memset(table, 0xff, sizeof(uint32_t) * tableSize);
+
+        uint32_t uniqueCount = 0;
+        for (uint32_t v = 0; v < vertexCount; v++)
+        {
+            const unsigned char* vData = srcVertexData + (size_t)v * vertexStride;
+            uint32_t bucket = (uint32_t)key.Hash(vData) & tableMask;
+
+            for (;;)
+            {
+                uint32_t slot = table[bucket];
+                if (slot == kEmptySlot)
+                {
+                    // this is a new unique vertex
+                    slot = uniqueCount++;
+                    table[bucket] = slot;
+                    memcpy(dstVertexData + (size_t)slot * vertexStride, vData, vertexStride);
+                    vertexRemap[v] = slot;
+                    break;
+                }
+                if (key.Equal(dstVertexData + (size_t)slot * vertexStride, vData))
+                {
+                    vertexRemap[v] = slot;
+                    break;
+                }
+                bucket = (bucket + 1) & tableMask; // linear probe
+            }
+        }
+
+        delete [] table;
+
+        return uniqueCount;
+    }
+}
+
+uint32_t DeduplicateVerticesBruteForce(const unsigned char* srcVertexData, uint32_t vertexCount, uint32_t vertexStride,
+    unsigned char* dstVertexData, uint32_t* vertexRemap)
+{
+    memset(vertexRemap, 0xff, sizeof(uint32_t) * vertexCount);
+
+    uint32_t deduplicatedCount = 0;
+    for (uint32_t v1 = 0; v1 < vertexCount; v1++)
+    {
+        if (vertexRemap[v1] != kEmptySlot)
+            continue; // this was already found to be a duplicate
+
+        const unsigned char *v1Data = srcVertexData + (size_t)v1 * vertexStride;
+
+        // this is a new unique vertex
+        uint32_t remappedSlot = deduplicatedCount++;
+        vertexRemap[v1] = remappedSlot;
+        memcpy(dstVertexData + (size_t)remappedSlot * vertexStride, v1Data, vertexStride);
+
+        // scan for duplicates
+        for (uint32_t v2 = v1 + 1; v2 < vertexCount; v2++)
+        {
+            if (vertexRemap[v2] != kEmptySlot)
+                continue; // this was already found to be a duplicate of another vertex
+
+            const unsigned char *v2Data = srcVertexData + (size_t)v2 * vertexStride;
+
+            if (0 == memcmp(v1Data, v2Data, vertexStride))
+            {
+                vertexRemap[v2] = remappedSlot;
+            }
+        }
+    }
+
+    return deduplicatedCount;
+}
+
+uint32_t DeduplicateVerticesHashed(const unsigned char* srcVertexData, uint32_t vertexCount, uint32_t vertexStride,
+    unsigned char* dstVertexData, uint32_t* vertexRemap, float quantizeStep)
+{
+    assert(vertexCount < 0x80000000); // table size must fit in 32 bits
+
+    if (quantizeStep > 0.0f)
+    {
+        // quantized mode only understands float attributes
+        assert((vertexStride % sizeof(float)) == 0);
+
+        QuantizedVertexKey key;
+        key.floatCount = vertexStride / sizeof(float);
+        key.invStep = 1.0f / quantizeStep;
+        return DeduplicateWithTable(key, srcVertexData, vertexCount, vertexStride, dstVertexData, vertexRemap);
+    }
+    else
+    {
+        ExactVertexKey key;
+        key.stride = vertexStride;
+        return DeduplicateWithTable(key, srcVertexData, vertexCount, vertexStride, dstVertexData, vertexRemap);
+    }
+}
@@ -0,0 +1,49 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author(s):  Alex Nankervis
+//
+
+#pragma once
+
+#include <stdint.h>
+
+//-----------------------------------------------------------------------------
+//  DeduplicateVertices
+//-----------------------------------------------------------------------------
+//  Both functions produce identical output: unique vertices are written to
+//  dstVertexData in order of first occurrence, and vertexRemap[v] receives
+//  the slot of vertex v in dstVertexData.  The return value is the number of
+//  unique vertices.
+//
+//  Parameters:
+//      srcVertexData
+//          input vertices, vertexCount * vertexStride bytes
+//      vertexCount
+//          the number of vertices in srcVertexData
+//      vertexStride
+//          the size of one vertex in bytes
+//      dstVertexData
+//          a pointer to a preallocated buffer the same size as srcVertexData
+//      vertexRemap
+//          a pointer to a preallocated array of vertexCount entries
+//      quantizeStep
+//          (hashed only) if greater than zero, vertices are treated as arrays
+//          of floats and two vertices match when every component falls into
+//          the same cell of a grid with this spacing.  Zero compares bytes.
+//-----------------------------------------------------------------------------
+
+// O(n^2) reference implementation
+uint32_t DeduplicateVerticesBruteForce(const unsigned char* srcVertexData, uint32_t vertexCount, uint32_t vertexStride,
+    unsigned char* dstVertexData, uint32_t* vertexRemap);
+
+// O(n) expected, open addressing hash table keyed on vertex contents
+uint32_t DeduplicateVerticesHashed(const unsigned char* srcVertexData, uint32_t vertexCount, uint32_t vertexStride,
+    unsigned char* dstVertexData, uint32_t* vertexRemap, float quantizeStep = 0.0f);
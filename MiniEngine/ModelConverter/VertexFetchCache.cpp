@@ -0,0 +1,62 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "VertexFetchCache.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <vector>
+
+uint64_t ComputeVertexFetchMisses(const uint16_t* indexList, uint32_t indexCount,
+    uint32_t baseByteOffset, uint32_t vertexStride, uint32_t lineSize, uint32_t cacheSizeBytes,
+    uint64_t& lineAccesses)
+{
+    assert(lineSize > 0 && cacheSizeBytes >= lineSize);
+
+    // most recently used line first; caches of a few KB keep this short enough to scan
+    std::vector<uint64_t> lines;
+    const size_t lineCount = cacheSizeBytes / lineSize;
+    lines.reserve(lineCount);
+
+    uint64_t misses = 0;
+    lineAccesses = 0;
+
+    for (uint32_t i = 0; i < indexCount; i++)
+    {
+        uint64_t start = baseByteOffset + (uint64_t)indexList[i] * vertexStride;
+        uint64_t firstLine = start / lineSize;
+        uint64_t lastLine = (start + vertexStride - 1) / lineSize;
+
+        for (uint64_t line = firstLine; line <= lastLine; line++)
+        {
+            lineAccesses++;
+
+            size_t slot = 0;
+            while (slot < lines.size() && lines[slot] != line)
+                slot++;
+
+            if (slot == lines.size())
+            {
+                misses++;
+                if (lines.size() < lineCount)
+                    lines.push_back(line);
+                slot = lines.size() - 1;
+            }
+
+            // move to front, dropping the least recently used line on a miss into a full cache
+            for (; slot > 0; slot--)
+                lines[slot] = lines[slot - 1];
+            lines[0] = line;
+        }
+    }
+
+    return misses;
+}
@@ -0,0 +1,29 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#pragma once
+
+#include <stdint.h>
+
+//-----------------------------------------------------------------------------
+//  ComputeVertexFetchMisses
+//-----------------------------------------------------------------------------
+//  Simulates the pre-transform (vertex fetch) cache as a fully associative
+//  LRU cache of cacheSizeBytes, split into lines of lineSize bytes.  Every
+//  index fetches the lines covering vertexStride bytes at
+//  baseByteOffset + index * vertexStride.
+//
+//  Returns the number of line misses; lineAccesses receives the number of
+//  lines touched, so misses / lineAccesses is the miss rate.
+//-----------------------------------------------------------------------------
+uint64_t ComputeVertexFetchMisses(const uint16_t* indexList, uint32_t indexCount,
+    uint32_t baseByteOffset, uint32_t vertexStride, uint32_t lineSize, uint32_t cacheSizeBytes,
+    uint64_t& lineAccesses);
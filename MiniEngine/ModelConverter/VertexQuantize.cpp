@@ -0,0 +1,111 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "VertexQuantize.h"
+
+#include <math.h>
+#include <algorithm>
+
+namespace
+{
+    inline float SnormToFloat(int16_t value)
+    {
+        // -32768 and -32767 both map to -1.0, as on the GPU
+        return std::max(value / 32767.0f, -1.0f);
+    }
+
+    inline int16_t FloatToSnorm(float value)
+    {
+        return (int16_t)std::min(std::max(value, -32767.0f), 32767.0f);
+    }
+
+    inline float SignNotZero(float value)
+    {
+        return value >= 0.0f ? 1.0f : -1.0f;
+    }
+}
+
+uint16_t QuantizeUnorm16(float value, float minValue, float extent)
+{
+    if (extent <= 0.0f)
+        return 0;
+
+    float unorm = (value - minValue) / extent;
+    unorm = std::min(std::max(unorm, 0.0f), 1.0f);
+    return (uint16_t)floorf(unorm * 65535.0f + 0.5f);
+}
+
+float DequantizeUnorm16(uint16_t value, float minValue, float extent)
+{
+    return minValue + (value / 65535.0f) * extent;
+}
+
+void OctDecodeSnorm16(const int16_t encoded[2], float direction[3])
+{
+    float x = SnormToFloat(encoded[0]);
+    float y = SnormToFloat(encoded[1]);
+    float z = 1.0f - fabsf(x) - fabsf(y);
+    if (z < 0.0f)
+    {
+        float foldedX = (1.0f - fabsf(y)) * SignNotZero(x);
+        float foldedY = (1.0f - fabsf(x)) * SignNotZero(y);
+        x = foldedX;
+        y = foldedY;
+    }
+
+    float length = sqrtf(x * x + y * y + z * z);
+    direction[0] = x / length;
+    direction[1] = y / length;
+    direction[2] = z / length;
+}
+
+void OctEncodeSnorm16(const float direction[3], int16_t encoded[2])
+{
+    float l1 = fabsf(direction[0]) + fabsf(direction[1]) + fabsf(direction[2]);
+    if (l1 == 0.0f)
+    {
+        encoded[0] = encoded[1] = 0;
+        return;
+    }
+
+    // project onto the octahedron, folding the lower hemisphere over the upper one
+    float x = direction[0] / l1;
+    float y = direction[1] / l1;
+    if (direction[2] < 0.0f)
+    {
+        float foldedX = (1.0f - fabsf(y)) * SignNotZero(x);
+        float foldedY = (1.0f - fabsf(x)) * SignNotZero(y);
+        x = foldedX;
+        y = foldedY;
+    }
+
+    float scaledX = x * 32767.0f;
+    float scaledY = y * 32767.0f;
+    float baseX = floorf(scaledX);
+    float baseY = floorf(scaledY);
+
+    float bestDot = -2.0f;
+    float invLength = 1.0f / sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+    for (int i = 0; i < 4; i++)
+    {
+        int16_t candidate[2] = { FloatToSnorm(baseX + (i & 1)), FloatToSnorm(baseY + (i >> 1)) };
+
+        float decoded[3];
+        OctDecodeSnorm16(candidate, decoded);
+        float dot = (decoded[0] * direction[0] + decoded[1] * direction[1] + decoded[2] * direction[2]) * invLength;
+        if (dot > bestDot)
+        {
+            bestDot = dot;
+            encoded[0] = candidate[0];
+            encoded[1] = candidate[1];
+        }
+    }
+}
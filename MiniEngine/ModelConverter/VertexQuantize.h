@@ -0,0 +1,35 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#pragma once
+
+#include <stdint.h>
+
+//-----------------------------------------------------------------------------
+//  QuantizeUnorm16, DequantizeUnorm16
+//-----------------------------------------------------------------------------
+//  Maps value within [minValue, minValue + extent] to the nearest 16-bit unorm
+//  and back.  Dequantization matches the input assembler's UNORM conversion
+//  followed by minValue + unorm * extent, which is what the shaders do.
+//-----------------------------------------------------------------------------
+uint16_t QuantizeUnorm16(float value, float minValue, float extent);
+float DequantizeUnorm16(uint16_t value, float minValue, float extent);
+
+//-----------------------------------------------------------------------------
+//  OctEncodeSnorm16, OctDecodeSnorm16
+//-----------------------------------------------------------------------------
+//  Octahedral encoding of a direction into two 16-bit snorms.  The encoder
+//  tries the four neighbouring grid points and keeps the one that decodes
+//  closest to the input, which roughly halves the worst case error over plain
+//  rounding.  A zero vector encodes as +z.
+//-----------------------------------------------------------------------------
+void OctEncodeSnorm16(const float direction[3], int16_t encoded[2]);
+void OctDecodeSnorm16(const int16_t encoded[2], float direction[3]);
@@ -42,6 +42,8 @@
 #include "CompiledShaders/DepthViewerPS.h"
 #include "CompiledShaders/ModelViewerVS.h"
 #include "CompiledShaders/ModelViewerPS.h"
+#include "CompiledShaders/DepthViewerQuantizedVS.h"
+#include "CompiledShaders/ModelViewerQuantizedVS.h"
 #ifdef _WAVE_OP
 #include "CompiledShaders/DepthViewerVS_SM6.h"
 #include "CompiledShaders/ModelViewerVS_SM6.h"
@@ -57,7 +59,7 @@ class ModelViewer : public GameCore::IGameApp
 {
 public:
 
-    ModelViewer( void ) {}
+    ModelViewer( void ) : m_LightShadowIndex(0) {}
 
     virtual void Startup( void ) override;
     virtual void Cleanup( void ) override;
@@ -69,8 +71,13 @@ private:
 
     void RenderLightShadows(GraphicsContext& gfxContext);
 
+    // Every view a mesh can be drawn into.  CullObjects() sets bit (1 << view) of a mesh's visibility mask
+    // when its bounding box intersects that view's frustum.
+    enum eCullView { kMainView, kSunShadowView, kLightShadowView, kNumCullViews };
+    void CullObjects( void );
+
     enum eObjectFilter { kOpaque = 0x1, kCutout = 0x2, kTransparent = 0x4, kAll = 0xF, kNone = 0x0 };
-    void RenderObjects( GraphicsContext& Context, const Matrix4& ViewProjMat, eObjectFilter Filter = kAll );
+    void RenderObjects( GraphicsContext& Context, const Matrix4& ViewProjMat, eCullView View, eObjectFilter Filter = kAll );
     void CreateParticleEffects();
     Camera m_Camera;
     std::auto_ptr<CameraController> m_CameraController;
@@ -101,6 +108,16 @@ private:
 
     Vector3 m_SunDirection;
     ShadowCamera m_SunShadow;
+
+    // The light whose shadow map RenderLightShadows() draws this frame
+    uint32_t m_LightShadowIndex;
+
+    // Mesh bounding boxes as structure-of-arrays for Frustum::IntersectBoundingBoxes(), padded to a multiple
+    // of four meshes, and the views each mesh is visible in this frame
+    std::vector<float> m_MeshBoundsMin[3];
+    std::vector<float> m_MeshBoundsMax[3];
+    std::vector<uint32_t> m_MeshVisibility;
+    uint32_t m_VisibleMeshCount[kNumCullViews];
 };
 
 CREATE_APPLICATION( ModelViewer )
@@ -114,6 +131,7 @@ NumVar ShadowDimY("Application/Lighting/Shadow Dim Y", 3000, 1000, 10000, 100 );
 NumVar ShadowDimZ("Application/Lighting/Shadow Dim Z", 3000, 1000, 10000, 100 );
 
 BoolVar ShowWaveTileCounts("Application/Forward+/Show Wave Tile Counts", false);
+BoolVar EnableFrustumCulling("Application/Frustum Culling/Enable", true);
 #ifdef _WAVE_OP
 BoolVar EnableWaveOps("Application/Forward+/Enable Wave Ops", true);
 #endif
@@ -130,9 +148,15 @@ void ModelViewer::Startup( void )
     m_RootSig[1].InitAsConstantBuffer(0, D3D12_SHADER_VISIBILITY_PIXEL);
     m_RootSig[2].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0, 6, D3D12_SHADER_VISIBILITY_PIXEL);
     m_RootSig[3].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 64, 6, D3D12_SHADER_VISIBILITY_PIXEL);
-    m_RootSig[4].InitAsConstants(1, 2, D3D12_SHADER_VISIBILITY_VERTEX);
+    m_RootSig[4].InitAsConstants(1, 8, D3D12_SHADER_VISIBILITY_VERTEX);
     m_RootSig.Finalize(L"ModelViewer", D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
+    // The vertex layout, and with it the input layout and vertex shaders, depends on the model
+    TextureManager::Initialize(L"Textures/");
+    ASSERT(m_Model.Load("Models/sponza.h3d"), "Failed to load model");
+    ASSERT(m_Model.m_Header.meshCount > 0, "Model contains no meshes");
+    const bool QuantizedVertices = m_Model.HasQuantizedVertices();
+
     DXGI_FORMAT ColorFormat = g_SceneColorBuffer.GetFormat();
     DXGI_FORMAT DepthFormat = g_SceneDepthBuffer.GetFormat();
 
@@ -145,15 +169,30 @@ void ModelViewer::Startup( void )
         { "BITANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
     };
 
+    // See Model.h; positions are dequantized with the per-mesh constants set in RenderObjects()
+    D3D12_INPUT_ELEMENT_DESC quantizedVertElem[] =
+    {
+        { "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "TANGENT", 0, DXGI_FORMAT_R16G16B16A16_SNORM, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+    };
+
     // Depth-only (2x rate)
     m_DepthPSO.SetRootSignature(m_RootSig);
     m_DepthPSO.SetRasterizerState(RasterizerDefault);
     m_DepthPSO.SetBlendState(BlendNoColorWrite);
     m_DepthPSO.SetDepthStencilState(DepthStateReadWrite);
-    m_DepthPSO.SetInputLayout(_countof(vertElem), vertElem);
+    if (QuantizedVertices)
+        m_DepthPSO.SetInputLayout(_countof(quantizedVertElem), quantizedVertElem);
+    else
+        m_DepthPSO.SetInputLayout(_countof(vertElem), vertElem);
     m_DepthPSO.SetPrimitiveTopologyType(D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE);
     m_DepthPSO.SetRenderTargetFormats(0, nullptr, DepthFormat);
-    m_DepthPSO.SetVertexShader(g_pDepthViewerVS, sizeof(g_pDepthViewerVS));
+    if (QuantizedVertices)
+        m_DepthPSO.SetVertexShader(g_pDepthViewerQuantizedVS, sizeof(g_pDepthViewerQuantizedVS));
+    else
+        m_DepthPSO.SetVertexShader(g_pDepthViewerVS, sizeof(g_pDepthViewerVS));
     m_DepthPSO.Finalize();
 
     // Depth-only shading but with alpha testing
@@ -179,19 +218,27 @@ void ModelViewer::Startup( void )
     m_ModelPSO.SetBlendState(BlendDisable);
     m_ModelPSO.SetDepthStencilState(DepthStateTestEqual);
     m_ModelPSO.SetRenderTargetFormats(1, &ColorFormat, DepthFormat);
-    m_ModelPSO.SetVertexShader( g_pModelViewerVS, sizeof(g_pModelViewerVS) );
+    if (QuantizedVertices)
+        m_ModelPSO.SetVertexShader( g_pModelViewerQuantizedVS, sizeof(g_pModelViewerQuantizedVS) );
+    else
+        m_ModelPSO.SetVertexShader( g_pModelViewerVS, sizeof(g_pModelViewerVS) );
     m_ModelPSO.SetPixelShader( g_pModelViewerPS, sizeof(g_pModelViewerPS) );
     m_ModelPSO.Finalize();
 
 #ifdef _WAVE_OP
+    // The SM6 vertex shaders only read the float layout, and SM6 pixel shaders can't be paired with
+    // SM5 vertex shaders, so quantized models render without wave ops
     m_DepthWaveOpsPSO = m_DepthPSO;
-    m_DepthWaveOpsPSO.SetVertexShader( g_pDepthViewerVS_SM6, sizeof(g_pDepthViewerVS_SM6) );
-    m_DepthWaveOpsPSO.Finalize();
-
     m_ModelWaveOpsPSO = m_ModelPSO;
-    m_ModelWaveOpsPSO.SetVertexShader( g_pModelViewerVS_SM6, sizeof(g_pModelViewerVS_SM6) );
-    m_ModelWaveOpsPSO.SetPixelShader( g_pModelViewerPS_SM6, sizeof(g_pModelViewerPS_SM6) );
-    m_ModelWaveOpsPSO.Finalize();
+    if (!QuantizedVertices)
+    {
+        m_DepthWaveOpsPSO.SetVertexShader( g_pDepthViewerVS_SM6, sizeof(g_pDepthViewerVS_SM6) );
+        m_DepthWaveOpsPSO.Finalize();
+
+        m_ModelWaveOpsPSO.SetVertexShader( g_pModelViewerVS_SM6, sizeof(g_pModelViewerVS_SM6) );
+        m_ModelWaveOpsPSO.SetPixelShader( g_pModelViewerPS_SM6, sizeof(g_pModelViewerPS_SM6) );
+        m_ModelWaveOpsPSO.Finalize();
+    }
 #endif
 
     m_CutoutModelPSO = m_ModelPSO;
@@ -208,10 +255,6 @@ void ModelViewer::Startup( void )
     m_ExtraTextures[0] = g_SSAOFullScreen.GetSRV();
     m_ExtraTextures[1] = g_ShadowBuffer.GetSRV();
 
-    TextureManager::Initialize(L"Textures/");
-    ASSERT(m_Model.Load("Models/sponza.h3d"), "Failed to load model");
-    ASSERT(m_Model.m_Header.meshCount > 0, "Model contains no meshes");
-
     // The caller of this function can override which materials are considered cutouts
     m_pMaterialIsCutout.resize(m_Model.m_Header.materialCount);
     for (uint32_t i = 0; i < m_Model.m_Header.materialCount; ++i)
@@ -229,6 +272,27 @@ void ModelViewer::Startup( void )
         }
     }
 
+    const uint32_t MeshCount = m_Model.m_Header.meshCount;
+    const uint32_t PaddedMeshCount = Math::AlignUp(MeshCount, 4);
+    for (int Axis = 0; Axis < 3; ++Axis)
+    {
+        m_MeshBoundsMin[Axis].resize(PaddedMeshCount, 0.0f);
+        m_MeshBoundsMax[Axis].resize(PaddedMeshCount, 0.0f);
+    }
+    for (uint32_t i = 0; i < MeshCount; ++i)
+    {
+        const Model::BoundingBox& Bounds = m_Model.m_pMesh[i].boundingBox;
+        m_MeshBoundsMin[0][i] = Bounds.min.GetX();
+        m_MeshBoundsMin[1][i] = Bounds.min.GetY();
+        m_MeshBoundsMin[2][i] = Bounds.min.GetZ();
+        m_MeshBoundsMax[0][i] = Bounds.max.GetX();
+        m_MeshBoundsMax[1][i] = Bounds.max.GetY();
+        m_MeshBoundsMax[2][i] = Bounds.max.GetZ();
+    }
+    m_MeshVisibility.resize(MeshCount, ~0u);
+    for (uint32_t View = 0; View < kNumCullViews; ++View)
+        m_VisibleMeshCount[View] = MeshCount;
+
     CreateParticleEffects();
 
     float modelRadius = Length(m_Model.m_Header.boundingBox.max - m_Model.m_Header.boundingBox.min) * .5f;
@@ -302,7 +366,43 @@ void ModelViewer::Update( float deltaT )
     m_MainScissor.bottom = (LONG)g_SceneColorBuffer.GetHeight();
 }
 
-void ModelViewer::RenderObjects( GraphicsContext& gfxContext, const Matrix4& ViewProjMat, eObjectFilter Filter )
+void ModelViewer::CullObjects( void )
+{
+    ScopedTimer _prof(L"Frustum Culling");
+
+    const uint32_t MeshCount = m_Model.m_Header.meshCount;
+
+    if (!EnableFrustumCulling)
+    {
+        for (uint32_t i = 0; i < MeshCount; ++i)
+            m_MeshVisibility[i] = ~0u;
+        for (uint32_t View = 0; View < kNumCullViews; ++View)
+            m_VisibleMeshCount[View] = MeshCount;
+        return;
+    }
+
+    // The light shadow view is only tested while there are light shadow maps left to render
+    Frustum Views[kNumCullViews];
+    Views[kMainView] = Frustum::MakeFromViewProjection(m_ViewProjMatrix);
+    Views[kSunShadowView] = Frustum::MakeFromViewProjection(m_SunShadow.GetViewProjMatrix());
+    uint32_t ViewCount = kLightShadowView;
+    if (m_LightShadowIndex < Lighting::MaxLights)
+        Views[ViewCount++] = Frustum::MakeFromViewProjection(Lighting::m_LightShadowMatrix[m_LightShadowIndex]);
+
+    const float* const MinBound[3] = { m_MeshBoundsMin[0].data(), m_MeshBoundsMin[1].data(), m_MeshBoundsMin[2].data() };
+    const float* const MaxBound[3] = { m_MeshBoundsMax[0].data(), m_MeshBoundsMax[1].data(), m_MeshBoundsMax[2].data() };
+    Frustum::IntersectBoundingBoxes(Views, ViewCount, MinBound, MaxBound, MeshCount, m_MeshVisibility.data());
+
+    for (uint32_t View = 0; View < kNumCullViews; ++View)
+        m_VisibleMeshCount[View] = 0;
+    for (uint32_t i = 0; i < MeshCount; ++i)
+    {
+        for (uint32_t View = 0; View < kNumCullViews; ++View)
+            m_VisibleMeshCount[View] += (m_MeshVisibility[i] >> View) & 1;
+    }
+}
+
+void ModelViewer::RenderObjects( GraphicsContext& gfxContext, const Matrix4& ViewProjMat, eCullView View, eObjectFilter Filter )
 {
     struct VSConstants
     {
@@ -319,9 +419,13 @@ void ModelViewer::RenderObjects( GraphicsContext& gfxContext, const Matrix4& Vie
     uint32_t materialIdx = 0xFFFFFFFFul;
 
     uint32_t VertexStride = m_Model.m_VertexStride;
+    const bool quantizedVertices = m_Model.HasQuantizedVertices();
 
     for (uint32_t meshIndex = 0; meshIndex < m_Model.m_Header.meshCount; meshIndex++)
     {
+        if ((m_MeshVisibility[meshIndex] & (1u << View)) == 0)
+            continue;
+
         const Model::Mesh& mesh = m_Model.m_pMesh[meshIndex];
 
         uint32_t indexCount = mesh.indexCount;
@@ -338,7 +442,28 @@ void ModelViewer::RenderObjects( GraphicsContext& gfxContext, const Matrix4& Vie
             gfxContext.SetDynamicDescriptors(2, 0, 6, m_Model.GetSRVs(materialIdx) );
         }
 
-        gfxContext.SetConstants(4, baseVertex, materialIdx);
+        struct MeshConstants
+        {
+            XMFLOAT3 positionScale;
+            uint32_t baseVertex;
+            XMFLOAT3 positionBias;
+            uint32_t materialIdx;
+        } meshConstants;
+
+        // quantized positions are relative to the mesh bounds; float positions pass through
+        if (quantizedVertices)
+        {
+            XMStoreFloat3(&meshConstants.positionScale, mesh.boundingBox.max - mesh.boundingBox.min);
+            XMStoreFloat3(&meshConstants.positionBias, mesh.boundingBox.min);
+        }
+        else
+        {
+            meshConstants.positionScale = XMFLOAT3(1.0f, 1.0f, 1.0f);
+            meshConstants.positionBias = XMFLOAT3(0.0f, 0.0f, 0.0f);
+        }
+        meshConstants.baseVertex = baseVertex;
+        meshConstants.materialIdx = materialIdx;
+        gfxContext.SetConstantArray(4, sizeof(meshConstants) / 4, &meshConstants);
 
         gfxContext.DrawIndexed(indexCount, startIndex, baseVertex);
     }
@@ -350,16 +475,16 @@ void ModelViewer::RenderLightShadows(GraphicsContext& gfxContext)
 
     ScopedTimer _prof(L"RenderLightShadows", gfxContext);
 
-    static uint32_t LightIndex = 0;
+    const uint32_t LightIndex = m_LightShadowIndex;
     if (LightIndex >= MaxLights)
         return;
 
     m_LightShadowTempBuffer.BeginRendering(gfxContext);
     {
         gfxContext.SetPipelineState(m_ShadowPSO);
-        RenderObjects(gfxContext, m_LightShadowMatrix[LightIndex], kOpaque);
+        RenderObjects(gfxContext, m_LightShadowMatrix[LightIndex], kLightShadowView, kOpaque);
         gfxContext.SetPipelineState(m_CutoutShadowPSO);
-        RenderObjects(gfxContext, m_LightShadowMatrix[LightIndex], kCutout);
+        RenderObjects(gfxContext, m_LightShadowMatrix[LightIndex], kLightShadowView, kCutout);
     }
     m_LightShadowTempBuffer.EndRendering(gfxContext);
 
@@ -370,7 +495,7 @@ void ModelViewer::RenderLightShadows(GraphicsContext& gfxContext)
 
     gfxContext.TransitionResource(m_LightShadowArray, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
 
-    ++LightIndex;
+    ++m_LightShadowIndex;
 }
 
 void ModelViewer::RenderScene( void )
@@ -433,6 +558,19 @@ void ModelViewer::RenderScene( void )
 
     pfnSetupGraphicsState();
 
+    // The sun shadow's matrix is needed to cull for it before anything is drawn
+    m_SunShadow.UpdateMatrix(-m_SunDirection, Vector3(0, -500.0f, 0), Vector3(ShadowDimX, ShadowDimY, ShadowDimZ),
+        (uint32_t)g_ShadowBuffer.GetWidth(), (uint32_t)g_ShadowBuffer.GetHeight(), 16);
+
+    CullObjects();
+
+    // Shown with the "Frustum Culling" timer in the profiler display
+    EngineProfiling::SetCounter(L"Meshes", m_Model.m_Header.meshCount);
+    EngineProfiling::SetCounter(L"Meshes Drawn: Camera", m_VisibleMeshCount[kMainView]);
+    EngineProfiling::SetCounter(L"Meshes Drawn: Sun Shadow", m_VisibleMeshCount[kSunShadowView]);
+    EngineProfiling::SetCounter(L"Meshes Drawn: Light Shadow",
+        m_LightShadowIndex < Lighting::MaxLights ? m_VisibleMeshCount[kLightShadowView] : 0);
+
     RenderLightShadows(gfxContext);
 
     {
@@ -452,13 +590,13 @@ void ModelViewer::RenderScene( void )
 #endif
             gfxContext.SetDepthStencilTarget(g_SceneDepthBuffer.GetDSV());
             gfxContext.SetViewportAndScissor(m_MainViewport, m_MainScissor);
-            RenderObjects(gfxContext, m_ViewProjMatrix, kOpaque );
+            RenderObjects(gfxContext, m_ViewProjMatrix, kMainView, kOpaque );
         }
 
         {
             ScopedTimer _prof2(L"Cutout", gfxContext);
             gfxContext.SetPipelineState(m_CutoutDepthPSO);
-            RenderObjects(gfxContext, m_ViewProjMatrix, kCutout );
+            RenderObjects(gfxContext, m_ViewProjMatrix, kMainView, kCutout );
         }
     }
 
@@ -478,14 +616,11 @@ void ModelViewer::RenderScene( void )
         {
             ScopedTimer _prof3(L"Render Shadow Map", gfxContext);
 
-            m_SunShadow.UpdateMatrix(-m_SunDirection, Vector3(0, -500.0f, 0), Vector3(ShadowDimX, ShadowDimY, ShadowDimZ),
-                (uint32_t)g_ShadowBuffer.GetWidth(), (uint32_t)g_ShadowBuffer.GetHeight(), 16);
-
             g_ShadowBuffer.BeginRendering(gfxContext);
             gfxContext.SetPipelineState(m_ShadowPSO);
-            RenderObjects(gfxContext, m_SunShadow.GetViewProjMatrix(), kOpaque);
+            RenderObjects(gfxContext, m_SunShadow.GetViewProjMatrix(), kSunShadowView, kOpaque);
             gfxContext.SetPipelineState(m_CutoutShadowPSO);
-            RenderObjects(gfxContext, m_SunShadow.GetViewProjMatrix(), kCutout);
+            RenderObjects(gfxContext, m_SunShadow.GetViewProjMatrix(), kSunShadowView, kCutout);
             g_ShadowBuffer.EndRendering(gfxContext);
         }
 
@@ -514,12 +649,12 @@ void ModelViewer::RenderScene( void )
             gfxContext.SetRenderTarget(g_SceneColorBuffer.GetRTV(), g_SceneDepthBuffer.GetDSV_DepthReadOnly());
             gfxContext.SetViewportAndScissor(m_MainViewport, m_MainScissor);
 
-            RenderObjects( gfxContext, m_ViewProjMatrix, kOpaque );
+            RenderObjects( gfxContext, m_ViewProjMatrix, kMainView, kOpaque );
 
             if (!ShowWaveTileCounts)
             {
                 gfxContext.SetPipelineState(m_CutoutModelPSO);
-                RenderObjects( gfxContext, m_ViewProjMatrix, kCutout );
+                RenderObjects( gfxContext, m_ViewProjMatrix, kMainView, kCutout );
             }
         }
 
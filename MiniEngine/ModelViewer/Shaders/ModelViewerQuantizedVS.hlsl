@@ -0,0 +1,3 @@
+#define QUANTIZED_VERTICES
+
+#include "ModelViewerVS.hlsl"
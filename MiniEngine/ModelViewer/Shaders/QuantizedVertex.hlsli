@@ -0,0 +1,33 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Decoding for the quantized vertex layout written by ModelConverter -quantize
+//
+
+cbuffer MeshConstants : register(b1)
+{
+    float3 PositionScale;   // mesh bounding box extent
+    uint BaseVertex;
+    float3 PositionBias;    // mesh bounding box minimum
+    uint MaterialIdx;
+};
+
+float3 DecodePosition( float3 Unorm )
+{
+    return PositionBias + Unorm * PositionScale;
+}
+
+float3 OctDecode( float2 Oct )
+{
+    float3 N = float3(Oct, 1.0 - abs(Oct.x) - abs(Oct.y));
+    if (N.z < 0.0)
+        N.xy = (1.0 - abs(N.yx)) * (N.xy >= 0.0 ? 1.0 : -1.0);
+    return normalize(N);
+}
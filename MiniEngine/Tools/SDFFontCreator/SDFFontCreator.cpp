@@ -4,6 +4,7 @@
 #include <ft2build.h>
 #include <cstdint>
 #include <thread>
+#include <chrono>
 #include <vector>
 #include <algorithm>
 #include <intrin.h>
@@ -45,6 +46,8 @@ uint32_t g_MapWidth = 0;
 uint32_t g_MapHeight = 0;
 volatile int32_t g_nextGlyphIdx = 0;
 volatile bool g_ReadyToPaint = false;
+bool g_compareSearch = false;   // Also build the map with the windowed search, and report differences and timings
+bool g_useWindowedSearch = false;
 
 void PrintAssertMessage( const char* file, uint32_t line, const char* cond, const char* msg, ...)
 {
@@ -235,6 +238,140 @@ float DistanceFromOutside(const Canvas& canvas, uint32_t xCoord, uint32_t yCoord
     return sqrt((float)bestDistSq) / (float)radius;
 }
 
+// Scratch memory for ComputeDistances(), kept for the life of a painting thread so that glyphs after the
+// first one don't allocate
+struct DistanceTransform
+{
+    vector<uint8_t> pixels;         // The canvas around the glyph cell, column by column
+    vector<uint32_t> featureRows;   // Rows of the feature pixels in the current column
+    vector<uint32_t> columnDistSq;  // Per texel row and canvas column, distance to the column's nearest feature
+    vector<uint32_t> envelope;      // Columns whose parabolas form the lower envelope of the current row
+    vector<double> boundaries;      // Where each parabola of the envelope takes over from the previous one
+};
+
+// Exact Euclidean distance transform (Felzenszwalb and Huttenlocher) from the center of each texel in a glyph cell
+// to the nearest canvas pixel that reads as 'feature'.  Distances are squared, measured in half canvas pixels, and
+// clamped to the search radius, which matches the window searched by DistanceFromInside/Outside.  The transform is
+// separable, so the cost is linear in the size of the canvas:  every column is reduced to its nearest feature for
+// each texel row, and then every texel row takes the lower envelope of one parabola per column.
+void ComputeDistances( const Canvas& canvas, uint32_t cellWidth, uint32_t cellHeight, bool feature,
+    DistanceTransform& dt, vector<uint32_t>& distSq )
+{
+    const uint32_t radius = g_maxDistance * 32;
+    const uint32_t maxDistSq = radius * radius;
+
+    // Pixels further than the radius from every texel center can't change the result
+    const uint32_t margin = g_maxDistance * 16;
+    const uint32_t gridWidth = cellWidth * 16 + margin * 2;
+    const uint32_t gridHeight = cellHeight * 16 + margin * 2;
+
+    // Read the canvas once, transposed so that the column pass walks memory in order.  Coordinates left of and
+    // above the cell wrap around to large values, which ReadCanvasBit() reports as empty.
+    dt.pixels.resize(gridWidth * gridHeight);
+    for (uint32_t y = 0; y < gridHeight; ++y)
+    {
+        for (uint32_t x = 0; x < gridWidth; ++x)
+            dt.pixels[x * gridHeight + y] = ReadCanvasBit(canvas, x - margin, y - margin) ? 1 : 0;
+    }
+
+    // Texel centers are at 32 * i + 15 in half pixels, offset here by the margin
+    const int32_t firstCenter = 15 + (int32_t)margin * 2;
+
+    dt.columnDistSq.resize(cellHeight * gridWidth);
+    for (uint32_t x = 0; x < gridWidth; ++x)
+    {
+        const uint8_t* column = &dt.pixels[x * gridHeight];
+
+        dt.featureRows.clear();
+        for (uint32_t y = 0; y < gridHeight; ++y)
+        {
+            if (column[y] == (feature ? 1 : 0))
+                dt.featureRows.push_back(y);
+        }
+
+        // The texel centers are visited in order, so the nearest feature only ever moves down the column
+        size_t next = 0;
+        for (uint32_t row = 0; row < cellHeight; ++row)
+        {
+            const int32_t center = firstCenter + (int32_t)row * 32;
+            while (next < dt.featureRows.size() && (int32_t)dt.featureRows[next] * 2 < center)
+                ++next;
+
+            uint32_t bestDistSq = maxDistSq;
+            if (next < dt.featureRows.size())
+            {
+                uint32_t d = (uint32_t)((int32_t)dt.featureRows[next] * 2 - center);
+                bestDistSq = min(bestDistSq, d * d);
+            }
+            if (next > 0)
+            {
+                uint32_t d = (uint32_t)(center - (int32_t)dt.featureRows[next - 1] * 2);
+                bestDistSq = min(bestDistSq, d * d);
+            }
+            dt.columnDistSq[row * gridWidth + x] = bestDistSq;
+        }
+    }
+
+    dt.envelope.resize(gridWidth);
+    dt.boundaries.resize(gridWidth + 1);
+    distSq.resize(cellWidth * cellHeight);
+
+    for (uint32_t row = 0; row < cellHeight; ++row)
+    {
+        const uint32_t* columnDistSq = &dt.columnDistSq[row * gridWidth];
+
+        // Build the lower envelope of (2 * x - center)^2 + columnDistSq[x] over the columns that have a feature
+        // within the radius.  The parabolas all have the same shape, so each pair crosses exactly once.
+        int32_t k = -1;
+        for (uint32_t x = 0; x < gridWidth; ++x)
+        {
+            if (columnDistSq[x] >= maxDistSq)
+                continue;
+
+            const double position = x * 2.0;
+            const double height = columnDistSq[x] + position * position;
+            double crossing = -HUGE_VAL;
+
+            while (k >= 0)
+            {
+                const double lastPosition = dt.envelope[k] * 2.0;
+                const double lastHeight = columnDistSq[dt.envelope[k]] + lastPosition * lastPosition;
+                crossing = (height - lastHeight) / (2.0 * (position - lastPosition));
+                if (crossing > dt.boundaries[k])
+                    break;
+                --k;
+            }
+
+            ++k;
+            dt.envelope[k] = x;
+            dt.boundaries[k] = k == 0 ? -HUGE_VAL : crossing;
+        }
+
+        uint32_t* rowDistSq = &distSq[row * cellWidth];
+
+        if (k < 0)
+        {
+            for (uint32_t col = 0; col < cellWidth; ++col)
+                rowDistSq[col] = maxDistSq;
+            continue;
+        }
+
+        dt.boundaries[k + 1] = HUGE_VAL;
+
+        int32_t segment = 0;
+        for (uint32_t col = 0; col < cellWidth; ++col)
+        {
+            const int32_t center = firstCenter + (int32_t)col * 32;
+            while (dt.boundaries[segment + 1] < center)
+                ++segment;
+
+            const uint32_t x = dt.envelope[segment];
+            const int64_t d = (int64_t)x * 2 - center;
+            rowDistSq[col] = (uint32_t)min<int64_t>(maxDistSq, d * d + columnDistSq[x]);
+        }
+    }
+}
+
 // Get width and spacing of a given glyph to compute necessary space and layout in final texture.
 inline uint16_t GetGlyphMetrics( wchar_t c, GlyphInfo& info )
 {
@@ -285,6 +422,10 @@ uint32_t UnwrapUVs(uint32_t textureWidth)
 
 void PaintCharacters( float* distanceMap, uint32_t width, uint32_t /*height*/ )
 {
+    DistanceTransform dt;
+    vector<uint32_t> insideDistSq, outsideDistSq;
+    const float radius = (float)(g_maxDistance * 32);
+
     int32_t i = -1;
     while ((i = _InterlockedExchangeAdd((volatile long*)&g_nextGlyphIdx, 1)) < g_numGlyphs)
     {
@@ -300,11 +441,20 @@ void PaintCharacters( float* distanceMap, uint32_t width, uint32_t /*height*/ )
         uint32_t charHeight = align16(g_maxGlyphHeight) / 16;
         uint32_t startX = ch.u / 16 - g_borderSize;
         uint32_t startY = ch.v / 16 - g_borderSize;
+        uint32_t cellWidth = charWidth + g_borderSize * 2;
+        uint32_t cellHeight = charHeight + g_borderSize * 2;
+
+        if (!g_useWindowedSearch)
+        {
+            // Inside texels measure to the nearest empty pixel, outside texels to the nearest filled one
+            ComputeDistances(canvas, cellWidth, cellHeight, false, dt, insideDistSq);
+            ComputeDistances(canvas, cellWidth, cellHeight, true, dt, outsideDistSq);
+        }
 
         // Convert high-res bitmap to low-res distance map
-        for (uint32_t x = 0; x < charWidth + g_borderSize * 2; ++x)
+        for (uint32_t x = 0; x < cellWidth; ++x)
         {
-            for (uint32_t y = 0; y < charHeight + g_borderSize * 2; ++y)
+            for (uint32_t y = 0; y < cellHeight; ++y)
             {
                 uint32_t left = x * 16 + 7;
                 uint32_t top = y * 16 + 7;
@@ -312,15 +462,20 @@ void PaintCharacters( float* distanceMap, uint32_t width, uint32_t /*height*/ )
                 bool inside = ReadCanvasBit(canvas, left, top) & ReadCanvasBit(canvas, left + 1, top) &
                     ReadCanvasBit(canvas, left, top + 1) & ReadCanvasBit(canvas, left + 1, top + 1);
 
-                if (inside)
-                    distanceMap[startX + x + (startY + y) * width] = +DistanceFromInside(canvas, x, y);
+                float distance;
+                if (g_useWindowedSearch)
+                    distance = inside ? DistanceFromInside(canvas, x, y) : DistanceFromOutside(canvas, x, y);
                 else
-                    distanceMap[startX + x + (startY + y) * width] = -DistanceFromOutside(canvas, x, y);
+                    distance = sqrt((float)(inside ? insideDistSq : outsideDistSq)[x + y * cellWidth]) / radius;
+
+                distanceMap[startX + x + (startY + y) * width] = inside ? +distance : -distance;
             }
         }
     }
 }
 
+typedef std::chrono::high_resolution_clock Clock;
+
 void WorkerFunc( void )
 {
     // We can initialize FreeType while we wait to paint the alphabet
@@ -335,6 +490,52 @@ void WorkerFunc( void )
     ShutdownFont();
 }
 
+// Paint every glyph again with the windowed search that the distance transform replaced, and report how much the
+// two maps differ and how long each took.  The search time includes starting FreeType on the worker threads.
+void CompareWithWindowedSearch( double transformSeconds )
+{
+    float* transformMap = g_DistanceMap;
+    g_DistanceMap = new float[g_MapWidth * g_MapHeight];
+    for (size_t x = g_MapWidth * g_MapHeight; x > 0; --x)
+        g_DistanceMap[x - 1] = -1.0f;
+
+    g_useWindowedSearch = true;
+    g_nextGlyphIdx = 0;
+    __faststorefence();
+
+    Clock::time_point start = Clock::now();
+
+    // g_ReadyToPaint is still set, so these start painting as soon as FreeType is up
+    std::vector<std::thread> Threads;
+    for (size_t i = 1; i < std::thread::hardware_concurrency(); ++i)
+        Threads.push_back(std::thread(WorkerFunc));
+
+    PaintCharacters(g_DistanceMap, g_MapWidth, g_MapHeight);
+    for_each( Threads.begin(), Threads.end(), []( std::thread& T ) { T.join(); } );
+
+    double searchSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    float maxDifference = 0.0f;
+    double totalDifference = 0.0;
+    uint32_t changedTexels = 0;
+    for (uint32_t i = 0; i < g_MapWidth * g_MapHeight; ++i)
+    {
+        float difference = fabs(transformMap[i] - g_DistanceMap[i]);
+        maxDifference = max(maxDifference, difference);
+        totalDifference += difference;
+        if ((int8_t)(transformMap[i] * 127.0f) != (int8_t)(g_DistanceMap[i] * 127.0f))
+            ++changedTexels;
+    }
+
+    printf("Windowed search: %.3f sec, distance transform: %.3f sec\n", searchSeconds, transformSeconds);
+    printf("Max difference: %g, mean difference: %g, %u of %u texels differ once quantized\n\n", maxDifference,
+        totalDifference / (g_MapWidth * g_MapHeight), changedTexels, g_MapWidth * g_MapHeight);
+
+    delete [] g_DistanceMap;
+    g_DistanceMap = transformMap;
+    g_useWindowedSearch = false;
+}
+
 struct BMP_Header
 {
     // Bitmap file header
@@ -474,6 +675,8 @@ void CompileFont(const string& outputName)
     // Make sure all of the parameters are flushed to memory before we trigger the threads to paint.
     __faststorefence();
 
+    Clock::time_point start = Clock::now();
+
     g_ReadyToPaint = true;
 
     // Also paint on the main thread
@@ -485,6 +688,12 @@ void CompileFont(const string& outputName)
         for_each( Threads.begin(), Threads.end(), []( std::thread& T ) { T.join(); } );
     }
 
+    double paintSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    printf("Painted %u glyphs in %.3f sec\n", g_numGlyphs, paintSeconds);
+
+    if (g_compareSearch)
+        CompareWithWindowedSearch(paintSeconds);
+
     uint8_t* compressedMap8 = new uint8_t[g_MapWidth * g_MapHeight];
 
     for (uint32_t i = 0; i < g_MapWidth * g_MapHeight; ++i)
@@ -563,7 +772,9 @@ void main( int argc, const char** argv )
             if (argv[arg][0] != '-')
                 throw exception("Malformed option");
 
-            if (arg + 1 == argc)
+            if (strcmp("-compare", argv[arg]) == 0)
+                g_compareSearch = true;
+            else if (arg + 1 == argc)
                 throw exception("Missing operand");
             else if (strcmp("-size", argv[arg]) == 0)
                 size = atoi(argv[++arg]);
@@ -591,6 +802,7 @@ void main( int argc, const char** argv )
             "-size <integer>\n\tThe font pixel resolution.\n"
             "-radius <integer>\n\tThe search radius.\n\tDefaults to font size / 8.\n"
             "-border_size <integer>\n\tExtra spacing around glyphs for various effects.\n\tDefaults to the search radius.\n"
+            "-compare\n\tAlso build the map with the old windowed search and report the differences and timings.\n"
             "\n\nExample:  %s myfont.ttf -character_set Japanese.txt -output japanese\n\n", e.what(), argv[0], argv[0]);
         return;
     }